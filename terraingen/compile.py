@@ -8,6 +8,39 @@ import shutil
 
 # Build script for terraingen C++ → WASM module (pure compute, no raylib)
 
+def fnv1a64(data):
+    h = 0xcbf29ce484222325
+    for b in data:
+        h = ((h ^ b) * 0x100000001b3) & 0xffffffffffffffff
+    return h
+
+def generate_shader_sources(shader_dir, out_file):
+    """Embed every shaders/*.wgsl as a raw string with its FNV-1a 64 hash (see PipelineRegistry.cpp)"""
+    entries = []
+    for path in sorted(glob.glob(os.path.join(shader_dir, '*.wgsl'))):
+        name = os.path.splitext(os.path.basename(path))[0]
+        with open(path, 'rb') as f:
+            code = f.read().replace(b'\r\n', b'\n')
+        if b')wgsl"' in code:
+            sys.exit(f'Error: {path} contains the raw string delimiter )wgsl"')
+        entries.append((name, code))
+    lines = ['// Generated by compile.py from shaders/*.wgsl; do not edit.',
+             '// Included by PipelineRegistry.cpp inside namespace terraingen.',
+             'static constexpr ShaderSource kEmbeddedShaders[] = {']
+    for name, code in entries:
+        lines.append(f'    {{"{name}", R"wgsl({code.decode("utf-8")})wgsl", {len(code)}, 0x{fnv1a64(code):016x}ull}},')
+    lines.append('};')
+    text = '\n'.join(lines) + '\n'
+    os.makedirs(os.path.dirname(out_file), exist_ok=True)
+    # Left alone when unchanged, so its timestamp only moves with the shaders
+    if os.path.exists(out_file):
+        with open(out_file, encoding='utf-8') as f:
+            if f.read() == text:
+                return
+    with open(out_file, 'w', encoding='utf-8', newline='\n') as f:
+        f.write(text)
+    print(f'✔ Embedded {len(entries)} shaders: {out_file}')
+
 def main():
     # Resolve directories relative to script location
     script_dir = os.path.abspath(os.path.dirname(__file__))
@@ -21,15 +54,32 @@ def main():
     parser = argparse.ArgumentParser(description="Build Terraingen CLI and/or WebAssembly bundle.")
     parser.add_argument('--native', action='store_true', help='Build native CLI binary')
     parser.add_argument('--wasm', action='store_true', help='Build WebAssembly HTML bundle')
+    parser.add_argument('--tsan', action='store_true', help='Build native CLI under ThreadSanitizer (terraingen_tsan)')
+    parser.add_argument('--webgpu', metavar='DIR',
+                        help='Link native builds against the wgpu-native release in DIR '
+                             '(DIR/include/webgpu/{webgpu,wgpu}.h, DIR/lib/libwgpu_native.so) so the compute '
+                             'shaders run natively, on a software Vulkan adapter such as lavapipe if there is no GPU')
     args = parser.parse_args()
     # Default to both if none specified
-    if not args.native and not args.wasm:
+    if not args.native and not args.wasm and not args.tsan:
         args.native = True
         args.wasm = True
 
     # Source files
     include_dir = os.path.join(script_dir, 'include')
-    includes = [f"-I{include_dir}"]
+    generated_dir = os.path.join(script_dir, 'generated')
+    includes = [f"-I{include_dir}", f"-I{generated_dir}"]
+    # WGSL sources are compiled into the binary
+    generate_shader_sources(os.path.join(script_dir, 'shaders'), os.path.join(generated_dir, 'ShaderSources.inc'))
+    # Native WebGPU through wgpu-native; see TERRAINGEN_WEBGPU in PipelineRegistry.hpp
+    native_webgpu = []
+    if args.webgpu:
+        wgpu_dir = os.path.abspath(args.webgpu)
+        wgpu_lib = os.path.join(wgpu_dir, 'lib')
+        if not os.path.exists(os.path.join(wgpu_dir, 'include', 'webgpu', 'wgpu.h')):
+            sys.exit(f'Error: {wgpu_dir}/include/webgpu/wgpu.h not found; expected a wgpu-native release')
+        native_webgpu = ['-DTERRAINGEN_NATIVE_WEBGPU=1', f"-I{os.path.join(wgpu_dir, 'include')}",
+                         f'-L{wgpu_lib}', f'-Wl,-rpath,{wgpu_lib}', '-lwgpu_native', '-ldl', '-lm']
     # Output an HTML+JS+WASM bundle for browser-based CLI execution
     output_file = os.path.join(script_dir, 'terraingen.html')
     # Generate HTML wrapper by specifying .html output
@@ -42,11 +92,22 @@ def main():
             sys.exit('Error: No C++ compiler found for native build')
         native_out = os.path.join(script_dir, 'terraingen')
         # Include header directory for native build
-        native_cmd = [cc] + includes + src_files + [ '-std=c++17', '-O3', '-lstdc++fs', '-o', native_out ]
+        native_cmd = [cc] + includes + src_files + [ '-std=c++17', '-O3', '-ffp-contract=off', '-pthread', '-lstdc++fs', '-o', native_out ] + native_webgpu
         print('Building native CLI:', ' '.join(native_cmd))
         subprocess.check_call(native_cmd)
         print(f'✔ Built native binary: {native_out}')
 
+    # ThreadSanitizer build, for --bench stress and other concurrency checks
+    if args.tsan:
+        cc = shutil.which('g++') or shutil.which('clang++')
+        if not cc:
+            sys.exit('Error: No C++ compiler found for TSan build')
+        tsan_out = os.path.join(script_dir, 'terraingen_tsan')
+        tsan_cmd = [cc] + includes + src_files + [ '-std=c++17', '-O1', '-g', '-fsanitize=thread', '-ffp-contract=off', '-pthread', '-lstdc++fs', '-o', tsan_out ] + native_webgpu
+        print('Building TSan CLI:', ' '.join(tsan_cmd))
+        subprocess.check_call(tsan_cmd)
+        print(f'✔ Built TSan binary: {tsan_out}')
+
     # WASM build
     if args.wasm:
         # Ensure chunks directory exists for embedding
@@ -60,8 +121,6 @@ def main():
             '-s', 'WASM=1',
             '-s', 'ALLOW_MEMORY_GROWTH=1',
             '-s', 'USE_WEBGPU=1',
-            # Embed WGSL shader files for WebGPU path
-            '--embed-file', os.path.join(script_dir, 'shaders'),
             # Embed chunks directory so WASM can write output
             '--embed-file', os.path.join(script_dir, 'chunks'),
             '-s', 'EXPORTED_FUNCTIONS=["_GenerateChunk"]',
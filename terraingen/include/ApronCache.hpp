@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace terraingen {
+
+// Identifies the overlap between two neighbouring chunks' extended (apron) domains: the strip
+// 2*apron texels wide centred on their shared boundary, spanning the full extended length.
+struct ApronKey {
+    int32_t line = 0;        // boundary index: chunk x for vertical edges, chunk z for horizontal
+    int32_t along = 0;       // chunk index along the boundary
+    uint8_t axis = 0;        // 0 = vertical edge (constant x), 1 = horizontal edge (constant z)
+    uint32_t resolution = 0;
+    int32_t octaves = 0;     // requested octaves (they set the height scale)
+    uint32_t apron = 0;
+    int32_t coarseOctaves = 0; // octaves interpolated from OctaveCache
+
+    bool operator==(const ApronKey& o) const {
+        return line == o.line && along == o.along && axis == o.axis && resolution == o.resolution &&
+               octaves == o.octaves && apron == o.apron && coarseOctaves == o.coarseOctaves;
+    }
+};
+
+// Pre-erosion heights and analytic gradients of one overlap strip, row-major
+struct ApronStrip {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> heights;
+    std::vector<float> gradX;
+    std::vector<float> gradZ;
+};
+
+struct ApronCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+};
+
+// Thread-safe LRU cache of overlap strips, so a chunk's apron reuses the noise its neighbours
+// already evaluated. Bounded by entry count.
+class ApronCache {
+public:
+    explicit ApronCache(size_t capacity);
+
+    // Shared strip for `key`, or null (counts a hit or miss)
+    std::shared_ptr<const ApronStrip> Lookup(const ApronKey& key);
+    // Insert or refresh; evicts the least recently used strips beyond capacity
+    void Insert(const ApronKey& key, std::shared_ptr<const ApronStrip> strip);
+
+    void SetCapacity(size_t capacity);
+    void Clear();
+    ApronCacheStats Stats() const;
+
+    // Process-wide cache used by Heightmap::Generate
+    static ApronCache& Global();
+
+private:
+    struct KeyHash {
+        size_t operator()(const ApronKey& k) const;
+    };
+    using Entry = std::pair<ApronKey, std::shared_ptr<const ApronStrip>>;
+
+    void EvictLocked();
+
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    std::list<Entry> lru_; // most recently used first
+    std::unordered_map<ApronKey, std::list<Entry>::iterator, KeyHash> index_;
+    ApronCacheStats stats_;
+};
+
+} // namespace terraingen
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+namespace terraingen {
+
+// Microbenchmarks for the native CLI (`terraingen --bench [name]`).
+// Runs every benchmark when name is empty or "all"; returns a process exit code.
+int RunBenchmarks(const std::string& name);
+
+} // namespace terraingen
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Biomes.hpp"
+
+namespace terraingen {
+
+// Distance from every texel to the nearest biome edge and the biome across that edge. Edge
+// texels (a 4-neighbour has another biome) seed a jump flood whose steps start at the
+// reach rather than the map size, so the cost is O(n log reach) and independent of how many
+// biomes or edges there are. Texels farther than `reach` are left at reach with their own id.
+struct BiomeDistanceField {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float reach = 0.0f;         // texels; half the transition width
+    std::vector<float> distance; // texels to the edge, in [0.5, reach]
+    std::vector<uint8_t> other;  // biome across the nearest edge
+
+    bool empty() const { return distance.empty(); }
+};
+
+// World units over which neighbouring biome materials blend by default: none. The distance
+// field stops at the chunk edge, so a blend shows a step at chunk borders, and it makes the
+// surface stage 5-7x slower; callers opt in with a width.
+constexpr float kDefaultBiomeTransition = 0.0f;
+
+// Jump flood over `map` out to `reach` texels (threaded per pass)
+BiomeDistanceField BiomeEdgeDistance(const PackedBiomeMap& map, float reach);
+
+// Reference: exhaustive search of the (2 reach + 1)^2 neighbourhood (benchmarks and checks)
+BiomeDistanceField BiomeEdgeDistanceBruteForce(const PackedBiomeMap& map, float reach);
+
+// Reach in texels of a transition `worldWidth` world units wide on a chunk-sized map
+// (kChunkWorldSize across) of `resolution` texels
+inline float BiomeTransitionReach(uint32_t resolution, float worldWidth) {
+    return 0.5f * worldWidth * resolution / kChunkWorldSize;
+}
+
+// Field for a transition `worldWidth` world units wide; empty when the transition is narrower
+// than a texel
+BiomeDistanceField BiomeTransitionField(const PackedBiomeMap& map, float worldWidth);
+
+// One material channel of texel i with biome id: half way to the other biome on the edge,
+// easing linearly to its own value at the reach
+inline float BlendedChannel(const BiomeMaterial* materials, uint8_t id, const BiomeDistanceField& field, size_t i,
+                            float BiomeMaterial::*channel) {
+    const float own = materials[id].*channel;
+    const float t = std::min(field.distance[i] / field.reach, 1.0f);
+    return own + (materials[field.other[i]].*channel - own) * (0.5f - 0.5f * t);
+}
+
+} // namespace terraingen
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace terraingen {
+
+// Per-texel biome IDs with their dimensions, so stages don't have to guess the size
+struct BiomeMap {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> ids;
+
+    BiomeMap() = default;
+    BiomeMap(uint32_t w, uint32_t h) : width(w), height(h), ids(static_cast<size_t>(w) * h) {}
+
+    bool empty() const { return ids.empty(); }
+    size_t size() const { return ids.size(); }
+    uint8_t operator[](size_t i) const { return ids[i]; }
+    uint8_t& operator[](size_t i) { return ids[i]; }
+};
+
+// One run of a run-length coded row: texels up to (not including) `end` have biome `id`
+struct BiomeRun {
+    uint16_t end = 0;
+    uint8_t id = 0;
+    uint8_t pad = 0;
+};
+
+// Biome IDs at 2, 4 or 8 bits per texel (the fewest that hold the largest ID), row-major with
+// every row starting on a 64-bit word. Rows can additionally be run-length coded, which is
+// what large uniform areas such as oceans want; CompressRuns picks per row whichever form is
+// smaller. Rows are written independently, so a band of rows can be packed per task.
+class PackedBiomeMap {
+public:
+    PackedBiomeMap() = default;
+    // Empty packed rows for IDs up to maxId
+    PackedBiomeMap(uint32_t width, uint32_t height, uint8_t maxId);
+
+    // Pack a whole map; rowRuns also run-length codes the rows where that is smaller
+    static PackedBiomeMap Pack(const BiomeMap& map, bool rowRuns = true);
+    BiomeMap Unpack() const;
+
+    // Write row y from n = width IDs (all <= the maxId given at construction). Only valid
+    // before CompressRuns; distinct rows may be written concurrently.
+    void PackRow(uint32_t y, const uint8_t* ids);
+    // Run-length code every row whose runs take fewer bytes than its packed words
+    void CompressRuns();
+
+    uint8_t At(uint32_t x, uint32_t y) const;
+    uint8_t operator[](size_t i) const {
+        return At(static_cast<uint32_t>(i % width_), static_cast<uint32_t>(i / width_));
+    }
+    // IDs [x0, x0 + n) of row y into out
+    void UnpackRow(uint32_t y, uint32_t x0, uint32_t n, uint8_t* out) const;
+    // The w x h tile at (x0, y0) into out, rows `pitch` bytes apart
+    void UnpackTile(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, uint8_t* out, size_t pitch) const;
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    bool empty() const { return width_ == 0 || height_ == 0; }
+    size_t size() const { return static_cast<size_t>(width_) * height_; }
+    uint32_t BitsPerTexel() const { return bits_; }
+    uint32_t RunRows() const { return runRows_; }
+    size_t Bytes() const;
+
+private:
+    struct Row {
+        uint32_t offset = 0; // into words_, or into runs_ when runs != 0
+        uint32_t runs = 0;
+    };
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    uint32_t bits_ = 0;
+    uint32_t wordsPerRow_ = 0;
+    uint32_t runRows_ = 0;
+    std::vector<Row> rows_;
+    std::vector<uint64_t> words_;
+    std::vector<BiomeRun> runs_;
+};
+
+} // namespace terraingen
@@ -1,20 +1,129 @@
 #pragma once
 
+#include <cfloat>
 #include <cstdint>
 #include <vector>
+#include "BiomeMap.hpp"
 #include "Heightmap.hpp"
+#include "TextureFormat.hpp"
 
 namespace terraingen {
 
-using BiomeMap = std::vector<uint8_t>;
+enum class BiomeID : uint8_t {
+    Water = 0,
+    Grass = 1,
+    Snow = 2,
+    Rock = 3,
+    Desert = 4,
+    Forest = 5,
+    Tundra = 6,
+};
+
+// One biome as a box in (height, slope, humidity, temperature), each range [min, max). Height,
+// humidity and temperature are in [0,1]; slope is |gradient| in height units per world unit.
+struct BiomeRule {
+    BiomeID id = BiomeID::Grass;
+    float minHeight = -FLT_MAX, maxHeight = FLT_MAX;
+    float minSlope = -FLT_MAX, maxSlope = FLT_MAX;
+    float minHumidity = -FLT_MAX, maxHumidity = FLT_MAX;
+    float minTemperature = -FLT_MAX, maxTemperature = FLT_MAX;
+};
+
+// Ordered rules, first match wins. Transition curves are written as stacks of narrower rules
+// (e.g. a snow line that drops in steps as temperature falls).
+struct BiomePreset {
+    std::vector<BiomeRule> rules;      // at most kMaxBiomeRules
+    BiomeID fallback = BiomeID::Grass; // where no rule matches
+    float maxSlope = 0.03f;            // slopes at or above this share the steepest bin
+};
+constexpr size_t kMaxBiomeRules = 32;
+
+// Water / rock / snow / grass on neutral climate, with desert, forest and tundra once
+// humidity and temperature move away from 0.5
+BiomePreset DefaultBiomePreset();
+
+// Material values of one biome: the parameter texture value, albedo brightness and roughness
+struct BiomeMaterial {
+    float param = 0.5f;
+    float albedo = 0.5f;
+    float roughness = 0.5f;
+};
+
+// Texture format of the parameter, albedo and roughness maps: the channels are [0, 1] and 8 bits
+// resolve the blends between biomes finely enough
+constexpr TextureFormat kMaterialFormat = TextureFormat::R8Unorm;
+
+// Table indexed by biome id (256 entries); ids without a biome get the neutral 0.5 material
+const BiomeMaterial* BiomeMaterials();
+
+// Per-texel classifier inputs. A missing gradient counts as flat ground, missing humidity or
+// temperature as 0.5.
+struct BiomeInputs {
+    GPUTexture height = 0;
+    GPUTexture gradX = 0;
+    GPUTexture gradZ = 0;
+    GPUTexture humidity = 0;
+    GPUTexture temperature = 0;
+};
+
+// A preset compiled into lookup tables: humidity x temperature bins map to a climate zone (one
+// per distinct set of rules whose climate box holds the bin), and zone x height x slope bins
+// map to the biome of the first rule that matches at the bin centre. Per-texel cost is two
+// table lookups however many rules the preset has.
+class BiomeClassifier {
+public:
+    static constexpr uint32_t kHeightBins = 64;
+    static constexpr uint32_t kSlopeBins = 16;
+    static constexpr uint32_t kClimateBins = 16; // per axis
+    static constexpr uint32_t kMaxZones = 16;    // distinct climate rule sets beyond this share the last zone
+
+    explicit BiomeClassifier(const BiomePreset& preset = DefaultBiomePreset());
+
+    // Classify one row of n texels; null inputs take the defaults above
+    void ClassifyRow(const float* height, const float* gradX, const float* gradZ, const float* humidity,
+                     const float* temperature, uint8_t* out, size_t n) const;
+
+    // Direct first-match rule evaluation without quantization (reference for the tables)
+    BiomeID Evaluate(float height, float slope, float humidity, float temperature) const;
+
+    uint32_t Zones() const { return zones_; }
+    // Largest id the tables can produce (sizes packed biome maps)
+    uint8_t MaxId() const { return maxId_; }
+    size_t TableBytes() const { return climate_.size() + terrain_.size(); }
+    float SlopeScale() const { return slopeScale_; }
+    // Both tables for the GPU pass: the climate table's kClimateBins^2 bytes, then the terrain
+    // table's, packed four to a word, low byte first
+    std::vector<uint32_t> PackedTables() const;
+
+private:
+    BiomePreset preset_;
+    float slopeScale_ = 0.0f;
+    uint32_t zones_ = 0;
+    uint8_t maxId_ = 0;
+    std::vector<uint8_t> climate_; // [temperature bin][humidity bin] -> zone, plus gather padding
+    std::vector<uint8_t> terrain_; // [zone][height bin][slope bin] -> biome, plus gather padding
+};
+
+// Classifier compiled from DefaultBiomePreset(), built on first use
+const BiomeClassifier& DefaultBiomeClassifier();
+
+struct BiomeDistanceField;
 
 // Biomes classification interface (see implementation.md 4. Biomes.hpp)
 class Biomes {
 public:
     // Classify height texture into biome IDs
     static BiomeMap Classify(const GPUTexture heightTex, GPUContext& gpu);
-    // Generate parameter texture (albedo, roughness, etc.) based on biome map
-    static GPUTexture GenerateParameters(const BiomeMap& map, GPUContext& gpu);
+    // Classify from all inputs with the default preset, or with a compiled preset
+    static BiomeMap Classify(const BiomeInputs& inputs, GPUContext& gpu);
+    static BiomeMap Classify(const BiomeInputs& inputs, GPUContext& gpu, const BiomeClassifier& classifier);
+    // The device half of Classify: record the pass and return its R8Uint id texture, for the
+    // caller to read back and release; 0 without a device
+    static GPUTexture RecordClassify(const BiomeInputs& inputs, GPUContext& gpu, const BiomeClassifier& classifier);
+    // Generate parameter texture (albedo, roughness, etc.) based on biome map, blended across
+    // biome edges when a distance field is given; kMaterialFormat
+    static GPUTexture GenerateParameters(const PackedBiomeMap& map, GPUContext& gpu,
+                                         const BiomeDistanceField* edges = nullptr);
 };
 
 } // namespace terraingen 
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include "Heightmap.hpp"
+#include "Noise.hpp"
+
+namespace terraingen {
+
+// Humidity and temperature fields that feed Biomes::Classify (see implementation.md 4. Biomes.hpp)
+struct ClimateParams {
+    // Humidity: moisture noise blended with open water (heights below seaLevel), then diffused
+    // so moisture spreads inland. The blur reaches diffusionRadius world units.
+    float seaLevel = 0.33f;
+    float waterWeight = 0.5f;          // share of the source coming from water vs. noise
+    float humidityFrequency = 1.0f / 512.0f;
+    int humidityOctaves = 3;
+    float diffusionRadius = 16.0f;
+    // Temperature: warm at z = 0, cold at z = +-latitudePeriod / 2, repeating; minus a lapse
+    // rate per unit of height above sea level, plus a small noise perturbation
+    float latitudePeriod = 16384.0f;
+    float lapseRate = 0.8f;
+    float temperatureNoise = 0.05f;
+    float temperatureFrequency = 1.0f / 256.0f;
+};
+
+struct ClimateMaps {
+    GPUTexture humidity = 0;    // [0,1], chunk resolution
+    GPUTexture temperature = 0; // [0,1]
+    uint32_t diffusionRadius = 0; // texels
+    bool seamless = false;        // a shared heightmap apron covered the diffusion reach
+    // Stage timings
+    uint64_t humidityUs = 0;
+    uint64_t diffusionUs = 0;
+    uint64_t temperatureUs = 0;
+};
+
+class Climate {
+public:
+    // Climate for the chunk whose heights are `heightTex`. When the heightmap was generated
+    // with an apron, humidity sources come from its extended domain, so diffusion near the
+    // chunk edge sees the neighbours' water and matches them (exactly when the apron is shared
+    // and at least DiffusionTexels wide).
+    static ClimateMaps Generate(const ChunkRequest& req, GPUTexture heightTex, const HeightmapOutputs& heightOut,
+                                GPUContext& gpu, const ClimateParams& params = ClimateParams{});
+    // Diffusion reach in texels at `resolution`: the heightmap apron a seamless chunk needs
+    static uint32_t DiffusionTexels(const ClimateParams& params, uint32_t resolution);
+};
+
+// Separable blur of a width x height row-major field: three box passes of radius / 3 per axis
+// (close to a Gaussian reaching `radius` texels), clamp-to-edge outside the field. Only the
+// interior [border, width - border) x [border, height - border) is written to dst, row-major.
+// The first pass blurs rows and writes its interior columns transposed in tiles, so the second
+// pass also runs along contiguous rows.
+void DiffuseField(const float* src, uint32_t width, uint32_t height, uint32_t border, uint32_t radius, float* dst);
+
+// Reference: same arithmetic, second pass gathers strided columns (benchmarks and checks)
+void DiffuseFieldStrided(const float* src, uint32_t width, uint32_t height, uint32_t border, uint32_t radius,
+                         float* dst);
+
+} // namespace terraingen
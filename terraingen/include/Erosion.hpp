@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+namespace terraingen {
+
+// Particle (droplet) hydraulic erosion settings. Distances are in world units and converted
+// to texels by the grid spacing, so every resolution (LOD) erodes the same world-space features;
+// heights are in the heightmap's own units, and amounts of sediment are volumes (height times
+// square world units).
+struct HydraulicErosionParams {
+    float dropletDensity = 0.2f;      // droplets per square world unit (grids coarser than one
+                                      // texel per unit spawn fewer, heavier ones); 0 disables
+    uint32_t maxLifetime = 48;        // steps per droplet, each one world unit long
+    float inertia = 0.05f;            // how much a droplet keeps its previous direction
+    float sedimentCapacity = 4.0f;    // capacity per unit of (descent * speed * water)
+    float minSedimentCapacity = 0.01f;
+    float erodeSpeed = 0.3f;
+    float erosionRadius = 3.0f;       // world units; wider brushes avoid digging single-cell pits
+    float depositSpeed = 0.3f;
+    float evaporateSpeed = 0.02f;
+    float gravity = 4.0f;
+    float initialWater = 1.0f;
+    float initialSpeed = 1.0f;
+    // Droplets in a batch all read the height snapshot taken at the start of the batch; their
+    // changes are applied in droplet order afterwards. Batches are sized by domain area (at least
+    // 64 droplets), never by thread count. Much denser batches let droplets over-dig the same
+    // cells and the surface oscillates.
+    float batchDensity = 1.0f / 128.0f; // droplets per square world unit in one batch
+};
+
+struct HydraulicErosionStats {
+    uint64_t droplets = 0;
+    uint64_t steps = 0;
+};
+
+// Erode a row-major heightmap with texels `spacing` world units apart in place. heights[0] sits
+// at texel (originX, originZ) of the world grid of that spacing; droplets are spawned per world
+// texel, each from its own PCG stream, so overlapping domains (chunk aprons) spawn the same
+// droplets and the result is reproducible for any thread count.
+HydraulicErosionStats HydraulicErode(float* heights, uint32_t width, uint32_t height, float spacing,
+                                     const HydraulicErosionParams& params, uint64_t seed,
+                                     int64_t originX = 0, int64_t originZ = 0);
+
+// Talus-angle thermal erosion: each iteration moves material across every 4-neighbour edge
+// whose height difference exceeds the talus threshold. Flux is antisymmetric, so mass is kept.
+struct ThermalErosionParams {
+    float reach = 64.0f;        // world units; one iteration per texel of it, 0 disables the stage
+    float talus = 0.012f;       // stable slope, height units per world unit
+    float rate = 0.1f;          // fraction of the excess moved per neighbour and iteration (< 0.25)
+};
+
+// Iterations that carry material params.reach world units on a grid of texel size `spacing`
+uint32_t ThermalIterations(const ThermalErosionParams& params, float spacing);
+
+// Run ThermalIterations(params, spacing) thermal steps in place. `spacing` is the texel size in
+// world units (it also converts the talus slope into a per-texel height difference). Bands of
+// rows advance several iterations per sweep over the heightmap, with the same results as one
+// sweep per iteration.
+void ThermalErode(float* heights, uint32_t width, uint32_t height, float spacing,
+                  const ThermalErosionParams& params);
+
+// Reference implementation: one full sweep per iteration (benchmarks and checks)
+void ThermalErodeSweep(float* heights, uint32_t width, uint32_t height, float spacing,
+                       const ThermalErosionParams& params);
+
+// Central-difference slope per unit of `spacing` (texel size); edges use one-sided differences
+void ComputeGradient(const float* heights, uint32_t width, uint32_t height, float spacing,
+                     float* gradX, float* gradZ);
+
+} // namespace terraingen
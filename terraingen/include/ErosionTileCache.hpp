@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace terraingen {
+
+// Identifies one world-aligned erosion tile (see Heightmap.cpp): its index on the tile grid of
+// a resolution, and everything else its heights depend on
+struct ErosionTileKey {
+    int32_t tx = 0;            // tile index along x and z
+    int32_t tz = 0;
+    uint32_t resolution = 0;
+    int32_t octaves = 0;       // requested octaves (they set the height scale)
+    int32_t coarseOctaves = 0; // octaves interpolated from OctaveCache
+    uint64_t erosion = 0;      // fingerprint of the hydraulic and thermal parameters
+
+    bool operator==(const ErosionTileKey& o) const {
+        return tx == o.tx && tz == o.tz && resolution == o.resolution && octaves == o.octaves &&
+               coarseOctaves == o.coarseOctaves && erosion == o.erosion;
+    }
+};
+
+// Eroded heights of the part of a tile chunks read: its core plus the blend band, row-major
+struct ErosionTile {
+    uint32_t side = 0;
+    std::vector<float> heights;
+};
+
+struct ErosionTileCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;  // tiles built
+    uint64_t joins = 0;   // lookups that waited for another caller's build of the same tile
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+// Thread-safe LRU cache of eroded tiles, so neighbouring chunks erode each tile once. Bounded
+// by tile memory. A tile being built is shared too: other callers wait for it rather than
+// build it again.
+class ErosionTileCache {
+public:
+    using Builder = std::function<std::shared_ptr<const ErosionTile>()>;
+
+    explicit ErosionTileCache(size_t maxBytes);
+
+    // Shared tile for `key`, built by `build` when it is neither cached nor being built (a miss;
+    // `built` is then set). A thread that is itself building a tile builds rather than waits,
+    // so builds nested through the thread pool cannot wait on each other.
+    std::shared_ptr<const ErosionTile> Acquire(const ErosionTileKey& key, const Builder& build,
+                                               bool* built = nullptr);
+
+    void SetMaxBytes(size_t maxBytes);
+    void Clear();
+    ErosionTileCacheStats Stats() const;
+
+    // Process-wide cache used by Heightmap::Generate
+    static ErosionTileCache& Global();
+
+private:
+    struct KeyHash {
+        size_t operator()(const ErosionTileKey& k) const;
+    };
+    using Entry = std::pair<ErosionTileKey, std::shared_ptr<const ErosionTile>>;
+    using Pending = std::shared_future<std::shared_ptr<const ErosionTile>>;
+
+    static size_t Bytes(const ErosionTile& tile) { return tile.heights.size() * sizeof(float); }
+    void InsertLocked(const ErosionTileKey& key, std::shared_ptr<const ErosionTile> tile);
+    void EvictLocked();
+
+    mutable std::mutex mutex_;
+    size_t maxBytes_;
+    std::list<Entry> lru_; // most recently used first
+    std::unordered_map<ErosionTileKey, std::list<Entry>::iterator, KeyHash> index_;
+    std::unordered_map<ErosionTileKey, Pending, KeyHash> building_;
+    ErosionTileCacheStats stats_;
+};
+
+} // namespace terraingen
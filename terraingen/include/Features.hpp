@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <mutex>
+#include <vector>
 #include "Heightmap.hpp"
 #include "Biomes.hpp"
+#include "GPUContext.hpp"
 
 namespace terraingen {
 
@@ -12,21 +16,77 @@ struct ChunkCtx {
     GPUTexture heightTexture;
     GPUTexture biomeTexture;
     GPUTexture sdfTexture;  // for cave/feature SDFs
+    HeightmapOutputs heightOutputs{}; // slope and bounds of heightTexture, if available
 };
 
-// Generic feature interface (see implementation.md 4. Features.hpp)
+// Chunk resources a feature reads or writes
+using FeatureResources = uint32_t;
+constexpr FeatureResources kFeatureHeight = 1u << 0; // heightTexture and heightOutputs
+constexpr FeatureResources kFeatureBiome = 1u << 1;  // biomeTexture
+constexpr FeatureResources kFeatureSDF = 1u << 2;    // sdfTexture
+
+// What a feature registers as (see implementation.md 4. Features.hpp)
+struct FeatureInfo {
+    const char* name;
+    uint32_t version = 1;
+    int32_t priority = 0; // lower runs first where two features touch the same resource
+    FeatureResources reads = 0;
+    FeatureResources writes = 0;
+};
+
+// CPU work a feature leaves to run over the chunk: a kernel over a width x height invocation
+// grid, as for GPUContext::Dispatch. Empty when there is none, e.g. when the feature recorded
+// GPU passes instead.
+struct FeatureWork {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    GPUContext::ComputeKernel kernel;
+};
+
+// Generic feature interface. Features are shared by every thread generating chunks, so all
+// per-chunk state belongs in ctx or in the returned kernel.
 class IFeature {
 public:
     virtual ~IFeature() = default;
-    // Apply this feature to the chunk context (modify SDF or textures)
-    virtual void Apply(ChunkCtx& ctx) = 0;
+    // Set up for the chunk (create outputs, gather per-chunk data, record GPU passes) and return
+    // the per-texel work. Its tiles run concurrently with each other and with those of other
+    // features in the same wave, so the kernel may only write the resources the feature declared.
+    virtual FeatureWork Apply(ChunkCtx& ctx) = 0;
 };
 
-// Registry for dynamic feature modules
+// How a feature went in one ApplyAll
+struct FeatureRun {
+    const char* name;
+    uint32_t wave;    // features of one wave run side by side
+    uint32_t applyUs; // Apply itself
+    uint32_t tileUs;  // its kernel, summed over threads
+};
+
+// Registry for dynamic feature modules. Features run in waves: in priority order (then name,
+// so link order never matters), each one goes into the first wave after every earlier feature
+// it conflicts with, i.e. one writing what it reads or writes or reading what it writes. A
+// wave's features are applied one after another and their kernels then run as one dispatch.
 class FeatureRegistry {
 public:
-    static void Add(IFeature* feature);
-    static void ApplyAll(ChunkCtx& ctx);
+    // Register `feature` under info.name; a name registered again keeps the higher version, so
+    // a module can replace a built-in feature. Returns whether `feature` is the one in use.
+    bool Add(IFeature* feature, const FeatureInfo& info);
+    void ApplyAll(ChunkCtx& ctx, std::vector<FeatureRun>* runs = nullptr);
+    // Features in the order they run, with the wave of each
+    std::vector<std::pair<FeatureInfo, uint32_t>> Schedule() const;
+
+    // The registry the built-in features add themselves to
+    static FeatureRegistry& Global();
+
+private:
+    struct Entry {
+        FeatureInfo info;
+        IFeature* feature;
+        uint32_t wave;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_; // in run order
 };
 
-} // namespace terraingen 
\ No newline at end of file
+} // namespace terraingen
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include "PipelineRegistry.hpp"
+#include "TextureFormat.hpp"
 #ifdef __EMSCRIPTEN__
-#include <webgpu/webgpu.h>
 #include <emscripten/html5_webgpu.h>
-#else
+#endif
+#if !TERRAINGEN_WEBGPU
 typedef void* WGPUDevice;
 typedef void* WGPUQueue;
 typedef void* WGPUTexture;
@@ -14,54 +22,528 @@ typedef void* WGPUTextureView;
 
 namespace terraingen {
 
-// Stub GPU context for compute dispatching (empty for now)
+struct TexturePoolStats {
+    uint64_t allocations = 0; // buffers that had to be allocated
+    uint64_t reuses = 0;      // buffers served from a free list
+    uint64_t dropped = 0;     // released buffers freed because the pool was full
+    size_t buffers = 0;       // buffers waiting in the free lists
+    size_t bytes = 0;
+};
+
+// Heap block behind a texture's CPU mirror
+struct TextureBuffer {
+    std::unique_ptr<uint8_t[]> bytes;
+    size_t capacity = 0;
+};
+
+// Backing buffers of released textures, kept in free lists bucketed by power-of-two capacity
+// so the next texture of a similar size reuses one instead of allocating. Shared by every
+// GPUContext, which is what carries buffers over from one chunk to the next. Thread-safe;
+// bounded by pooled bytes.
+class TexturePool {
+public:
+    explicit TexturePool(size_t maxBytes);
+
+    // A buffer of at least n bytes, zero-filled if asked; otherwise it holds whatever its last
+    // texture left, or fresh memory that has not been touched
+    TextureBuffer Acquire(size_t n, bool zero);
+    // Hand a buffer back for reuse (dropped when the pool is full)
+    void Recycle(TextureBuffer&& buffer);
+
+    void SetMaxBytes(size_t maxBytes);
+    void Clear();
+    TexturePoolStats Stats() const;
+
+    // Process-wide pool used by GPUContext by default
+    static TexturePool& Global();
+
+private:
+    static constexpr int kBuckets = 48;
+
+    void TrimLocked();
+
+    mutable std::mutex mutex_;
+    size_t maxBytes_;
+    std::vector<TextureBuffer> free_[kBuckets];
+    TexturePoolStats stats_;
+};
+
+// Whether a new texture must read as zero before it is written
+enum class TextureInit : uint8_t {
+    Zeroed,
+    Uninitialized, // the creating stage writes every texel, so stale pool contents are fine
+};
+
+// Where a context's compute passes go. Stages take their GPU path on any backend but CPU.
+enum class GPUBackend : uint8_t {
+    CPU,       // no device: stages run their CPU kernels
+    WebGPU,    // the browser's device, or natively wgpu-native's (lavapipe will do); CPU when there is none
+    Recording, // no device, but stages record their passes and the PassGraph only logs them
+};
+
+class PassGraph;
+
+// A readback in flight, like a future: its copy went to the queue with the passes recorded
+// before it, and a staging buffer is being mapped. Wait blocks until the data is in place and
+// hands the staging buffer back; destruction waits too. A map that fails leaves the output
+// untouched and makes Wait return false. Must not outlive its context.
+// --bench readback checks overlapped readbacks against serial ones on the recording backend's
+// fake queue, and on a device's queue when there is one. Failing maps are only checked on
+// the recording backend.
+class PendingReadback {
+public:
+    PendingReadback() = default;
+    ~PendingReadback() { Wait(); }
+    PendingReadback(PendingReadback&& other) noexcept
+        : graph_(other.graph_), slot_(other.slot_), ticket_(other.ticket_), ok_(other.ok_) {
+        other.graph_ = nullptr;
+    }
+    PendingReadback& operator=(PendingReadback&& other) noexcept {
+        if (this != &other) {
+            Wait();
+            graph_ = other.graph_;
+            slot_ = other.slot_;
+            ticket_ = other.ticket_;
+            ok_ = other.ok_;
+            other.graph_ = nullptr;
+        }
+        return *this;
+    }
+    PendingReadback(const PendingReadback&) = delete;
+    PendingReadback& operator=(const PendingReadback&) = delete;
+
+    // Whether Wait would return without blocking
+    bool Ready() const;
+    // Block until done; false when the data did not arrive (the map failed)
+    bool Wait();
+
+private:
+    friend class PassGraph;
+    PendingReadback(PassGraph* graph, uint32_t slot, uint64_t ticket) : graph_(graph), slot_(slot), ticket_(ticket) {}
+
+    PassGraph* graph_ = nullptr;
+    uint32_t slot_ = 0;
+    uint64_t ticket_ = 0;
+    bool ok_ = true;
+};
+
+// Stub GPU context for compute dispatching, and the texture arena of one chunk job: concurrent
+// jobs each create their own context over the shared TexturePool and PipelineRegistry.
+// Textures live in fixed-size slabs, so a reference from GetTexture stays valid until that
+// texture is released, however many are created after it. Handles carry a generation that
+// Release bumps: a released or stale handle no longer resolves to whatever texture reuses its
+// slot. Every method is thread-safe. The slot table is split into shards with their own locks,
+// and each thread creates in its own shard, so a context shared between threads does not
+// serialize them on one mutex.
 class GPUContext {
 public:
     using TextureID = uint32_t;
 
+    // Textures own a CPU mirror only once something touches it: the first As<T>(), Read or
+    // Write, or a Readback. Device-only textures never get one, and a texture a pass wrote is
+    // read back on that first touch, so one only the device uses is never copied back.
     struct Texture {
         uint32_t width = 0;
         uint32_t height = 0;
-        std::vector<float> data; // CPU mirror used only for fallback/debug
-        std::vector<uint8_t> dataU8; // for R8 textures
-#ifdef __EMSCRIPTEN__
+        TextureFormat format = TextureFormat::R32Float;
+#if TERRAINGEN_WEBGPU
         WGPUTexture gpuTex = nullptr;
         WGPUTextureView gpuView = nullptr;
 #endif
+
+        size_t Texels() const { return static_cast<size_t>(width) * height; }
+        size_t ByteSize() const { return Texels() * TexelBytes(format); }
+        // The CPU mirror as T (float for R32Float, uint16_t for R16 formats, uint8_t for 8-bit
+        // ones), allocated on first use; safe to call from several threads. Null for the null
+        // texture. Taking it writable marks the texture for upload before the next pass that
+        // samples it.
+        template <typename T>
+        T* As() {
+            mirrorNewer_.store(true, std::memory_order_relaxed);
+            return reinterpret_cast<T*>(Mirror());
+        }
+        template <typename T>
+        const T* As() const { return reinterpret_cast<const T*>(Mirror()); }
+        bool HasMirror() const { return mirror_.load(std::memory_order_acquire) != nullptr; }
+        // Channel `channel` of texels [first, first + n) to or from floats, in any format
+        void Read(size_t first, size_t n, float* out, uint32_t channel = 0) const;
+        void Write(size_t first, size_t n, const float* in, uint32_t channel = 0);
+        // Channel 0 of every texel as floats (a copy)
+        std::vector<float> ToFloats() const;
+
+    private:
+        friend class GPUContext;
+        friend class PassGraph;
+        uint8_t* Mirror() const;
+
+        GPUContext* owner_ = nullptr;
+        bool zeroed_ = true;
+        // A recorded pass wrote it since the mirror was last read back
+        mutable std::atomic<bool> deviceNewer_{false};
+        // The mirror was handed out writable since the PassGraph last uploaded it
+        std::atomic<bool> mirrorNewer_{false};
+        mutable std::atomic<uint8_t*> mirror_{nullptr};
+        mutable TextureBuffer buffer_;
+        // Held while the mirror is allocated and filled
+        mutable std::mutex mirrorMutex_;
+    };
+
+    struct Stats {
+        uint32_t liveTextures = 0;
+        uint32_t slots = 0;    // slots ever used; from one thread, the most textures alive at once
+        uint64_t created = 0;
+        uint64_t released = 0;
+        size_t liveBytes = 0;  // CPU mirror memory of the live textures
+        size_t peakBytes = 0;
+        // Mirror bytes over the context's life: touched (allocated), of those zero-filled,
+        // and never touched by the time their texture was released
+        uint64_t mirrorBytes = 0;
+        uint64_t zeroedBytes = 0;
+        uint64_t untouchedBytes = 0;
+        uint64_t skippedReadbacks = 0; // textures passes wrote, released without a readback
+        uint64_t dispatches = 0; // compute dispatches and the workgroups they ran
+        uint64_t workgroups = 0;
     };
 
-    GPUContext();
+    // Compute kernels run over the same grid as the WGSL shaders: one invocation per texel in
+    // kWorkgroupSize x kWorkgroupSize workgroups. The CPU backend hands a kernel a tile of
+    // whole workgroups at a time, a full row of them, clipped to the dispatch extent, so its
+    // inner loops run along contiguous texel rows. Invocations must only write their own
+    // texel, which makes the result independent of how tiles are spread over threads.
+    static constexpr uint32_t kWorkgroupSize = 8;
+    struct ComputeTile {
+        uint32_t x0, x1; // invocations [x0, x1) x [y0, y1)
+        uint32_t y0, y1;
+    };
+    using ComputeKernel = std::function<void(const ComputeTile&)>;
+
+    // The CPU backend; a device only when asked for (GPUBackend::WebGPU)
+    explicit GPUContext(TexturePool& pool = TexturePool::Global());
+    explicit GPUContext(GPUBackend backend, TexturePool& pool = TexturePool::Global());
+    // Releases every texture still alive, returning its buffers to the pool
     ~GPUContext();
+    GPUContext(const GPUContext&) = delete;
+    GPUContext& operator=(const GPUContext&) = delete;
 
-    bool HasDevice() const {
-#ifdef __EMSCRIPTEN__
-        return device_ != nullptr;
-#else
-        return false;
-#endif
-    }
-#ifdef __EMSCRIPTEN__
+    GPUBackend Backend() const { return backend_; }
+    // Whether stages record compute passes (on a real device or the recording backend)
+    bool HasDevice() const { return backend_ != GPUBackend::CPU; }
+#if TERRAINGEN_WEBGPU
+    WGPUDevice Device() const { return device_; }
     WGPUQueue Queue() const { return queue_; }
 #endif
 
-    // Create a 2-D float texture and return its ID
-    TextureID CreateTexture2D(uint32_t width, uint32_t height);
+    // Compute passes recorded by the stages, submitted together
+    PassGraph& Passes() { return *passes_; }
+
+    // Create a 2-D texture (R32Float unless given) and return its ID. No CPU memory is taken
+    // until the mirror is first touched.
+    TextureID CreateTexture2D(uint32_t width, uint32_t height, TextureFormat format = TextureFormat::R32Float,
+                              TextureInit init = TextureInit::Zeroed);
 
     // Create a single-channel R8Uint texture (biome map)
-    TextureID CreateTexture2D_U8(uint32_t width, uint32_t height);
+    TextureID CreateTexture2D_U8(uint32_t width, uint32_t height) {
+        return CreateTexture2D(width, height, TextureFormat::R8Uint);
+    }
+
+    // Free a texture and recycle its buffers; 0, released and stale handles are ignored
+    void Release(TextureID id);
 
-    // Access texture by ID (mutable)
+    bool IsValid(TextureID id) const;
+
+    // Make the CPU mirror hold the texture's contents: a texture a pass wrote since its last
+    // readback is copied back, which submits the passes recorded so far; any other is current
+    // on the CPU. Without a device the mirror is the texture, so this only allocates. False
+    // when the copy failed and the mirror still holds its old contents.
+    bool Readback(TextureID id);
+    // The same without waiting: the mirror is allocated at once but must not be read until the
+    // returned readback is done, and the texture must outlive it
+    PendingReadback ReadbackAsync(TextureID id);
+
+    // Access texture by ID; 0, released and stale handles give the empty null texture
     Texture& GetTexture(TextureID id);
+    const Texture& GetTexture(TextureID id) const;
+
+    Stats GetStats() const;
 
-    const Texture& GetTexture(TextureID id) const { return textures_.at(id); }
+    // Run `kernel` over a width x height invocation grid on the thread pool, a band of
+    // `groupRows` workgroup rows per task
+    void Dispatch(uint32_t width, uint32_t height, const ComputeKernel& kernel, uint32_t groupRows = 2);
+    // Several dispatches as one: the bands of all of them share the pool's tasks, so small
+    // grids still fill every thread. None may write what another reads.
+    struct DispatchDesc {
+        uint32_t width, height;
+        ComputeKernel kernel;
+    };
+    void Dispatch(const std::vector<DispatchDesc>& dispatches, uint32_t groupRows = 2);
 
 private:
-    std::vector<Texture> textures_;
+    // Handles are generation << 20 | shard << kSlotBits | slot. Slot 0 of every shard is never
+    // used, so no handle is 0.
+    static constexpr uint32_t kShardBits = 3;
+    static constexpr uint32_t kShards = 1u << kShardBits;
+    static constexpr uint32_t kSlotBits = 17;
+    static constexpr uint32_t kSlotMask = (1u << kSlotBits) - 1;
+    static constexpr uint32_t kGenerationShift = kSlotBits + kShardBits;
+    static constexpr uint32_t kGenerationMask = (1u << (32 - kGenerationShift)) - 1;
+    static constexpr uint32_t kSlabSlots = 64;
 
-#ifdef __EMSCRIPTEN__
+    struct Slot {
+        Texture texture;
+        uint32_t generation = 1;
+        bool live = false;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Slot[]>> slabs;
+        std::vector<uint32_t> freeSlots;
+        uint32_t slotCount = 1;
+
+        Slot& At(uint32_t slot) const { return slabs[slot / kSlabSlots][slot % kSlabSlots]; }
+    };
+
+    // Live texture's slot, or null
+    Slot* Find(TextureID id) const;
+    // Allocate a texture's mirror unless another thread got there first
+    uint8_t* Materialize(const Texture& tex);
+
+    TexturePool& pool_;
+    GPUBackend backend_;
+    std::unique_ptr<PassGraph> passes_;
+    Shard shards_[kShards];
+    Texture null_;
+    // Guards stats_; mirror allocation only takes it to count the bytes
+    mutable std::mutex statsMutex_;
+    Stats stats_;
+
+#if TERRAINGEN_WEBGPU
     WGPUDevice device_ = nullptr;
     WGPUQueue queue_ = nullptr;
 #endif
 };
 
-} // namespace terraingen 
\ No newline at end of file
+// A resource in a pass's bind group: a texture of the context or a buffer of its PassGraph
+struct PassBinding {
+    uint32_t texture = 0;
+    uint32_t buffer = 0;
+
+    static PassBinding Texture(GPUContext::TextureID id) { return {id, 0}; }
+    static PassBinding Buffer(uint32_t id) { return {0, id}; }
+    bool operator==(const PassBinding& o) const { return texture == o.texture && buffer == o.buffer; }
+};
+
+// One compute pass as a stage declares it
+struct ComputePass {
+    PipelineID pipeline;
+    uint32_t width, height;            // invocations, one per texel, in kWorkgroupSize^2 groups
+    std::vector<PassBinding> bindings; // bind group 0, in the pipeline's binding order
+};
+
+// The compute passes of a context. Passes are recorded into one command encoder and go to the
+// queue together the next time something needs their results: a readback, or Submit at the
+// end of a chunk. A chunk thus costs one submit per readback instead of one or two per pass.
+// Readbacks copy into a ring of staging buffers reused across chunks and return at once, so
+// the caller can record the next chunk's passes while the copy is mapped.
+// Bind groups are cached by pipeline and resources, and dropped once one of those is
+// released. On the Recording backend nothing is encoded; the graph keeps a log of the
+// commands instead, so pass order and submit counts can be checked without a GPU, and maps
+// complete a configurable latency after their submit.
+// Thread-safe; passes recorded by several threads go out in the order they were added.
+// The stages record two passes, biome classification and the mesh, each read back before
+// the next is recorded, so on a device a chunk's encoder holds one pass at a time. Encoders of several passes and the bind group cache are only checked by
+// --bench passes: on the recording backend, and with placeholder passes on a device when
+// there is one.
+class PassGraph {
+public:
+    using BufferID = uint32_t;
+
+    enum class BufferUsage : uint8_t {
+        Uniform,
+        Storage, // also a copy source, for ReadBuffer
+    };
+
+    struct Command {
+        enum Kind : uint8_t { Dispatch, CopyTexture, CopyBuffer, Submit, Upload };
+        Kind kind;
+        PipelineID pipeline; // Dispatch: its pipeline and workgroup grid
+        uint32_t groupsX, groupsY;
+    };
+
+    struct Stats {
+        uint64_t passes = 0;
+        uint64_t submits = 0;
+        uint64_t copies = 0;        // readbacks recorded after the passes
+        uint64_t bindGroups = 0;    // bind groups created
+        uint64_t bindGroupHits = 0; // passes that found theirs in the cache
+        uint32_t liveBuffers = 0;
+        uint64_t readbacks = 0;
+        uint64_t failedReadbacks = 0; // maps that failed; their output was left as it was
+        uint64_t uploads = 0;         // CPU-side textures written to the device for a pass
+        uint64_t stalls = 0;          // waits on a readback that was not done yet
+        uint32_t stagingBuffers = 0;  // staging buffers (re)allocated for the ring
+    };
+
+    PassGraph(GPUContext& gpu, GPUBackend backend);
+    // Submits whatever is still recorded
+    ~PassGraph();
+    PassGraph(const PassGraph&) = delete;
+    PassGraph& operator=(const PassGraph&) = delete;
+
+    // A buffer of `bytes` holding `data` if given, zeros otherwise; 0 on a CPU context
+    BufferID CreateBuffer(BufferUsage usage, size_t bytes, const void* data = nullptr);
+    // Free a buffer; passes recorded with it still see it
+    void ReleaseBuffer(BufferID id);
+
+    // Record a pass; false, and nothing recorded, when its bindings do not fit the pipeline's
+    // layout or name a released resource. Sampled textures whose mirror was taken writable
+    // since their last upload are uploaded first (wgpuQueueWriteTexture); the passes recorded
+    // so far are submitted ahead of the upload only when one of them uses the texture.
+    bool Add(const ComputePass& pass);
+    // Send the recorded passes in one command buffer (nothing when there are none)
+    void Submit();
+    // Submit the recorded passes followed by a copy of the texture (rows packed tightly into
+    // `out`) or of the first `bytes` of the buffer. `out` must stay valid until the readback
+    // is done; a texture released meanwhile has its readback completed first.
+    PendingReadback ReadTextureAsync(GPUContext::TextureID id, uint8_t* out);
+    PendingReadback ReadBufferAsync(BufferID id, void* out, size_t bytes);
+
+    // Recording backend: maps complete this long after their submit (the fake queue), and
+    // fail while `fail` is set
+    void SetMapLatency(std::chrono::microseconds latency);
+    void SetMapFailure(bool fail);
+
+    // Called by the context before it releases a texture: drop the bind groups using it and
+    // finish readbacks into it
+    void Forget(GPUContext::TextureID id);
+
+    Stats GetStats() const;
+    // Every command so far (Recording backend only)
+    std::vector<Command> Log() const;
+
+private:
+    friend class GPUContext;
+    friend class PendingReadback;
+    using Clock = std::chrono::steady_clock;
+    static constexpr uint32_t kStagingSlots = 8;
+
+    // One buffer of the staging ring, and the readback using it when ticket is not 0
+    struct Staging {
+        size_t capacity = 0;
+        uint64_t ticket = 0;
+        GPUContext::TextureID texture = 0; // target texture, if any
+        uint8_t* out = nullptr;
+        size_t rowBytes = 0;  // copied out as `rows` rows of rowBytes, `pitch` apart
+        size_t pitch = 0;
+        uint32_t rows = 0;
+        bool widened = false; // an R8Uint texture, whose texels are words on the device
+        std::atomic<bool> mapped{false}; // set by the map callback, on whichever thread polls
+        std::atomic<bool> failed{false}; // the map callback reported an error
+        Clock::time_point readyAt; // Recording
+        std::vector<uint8_t> fake; // Recording: what the map will show
+#if TERRAINGEN_WEBGPU
+        WGPUBuffer handle = nullptr;
+#endif
+    };
+
+    struct Buffer {
+        BufferUsage usage = BufferUsage::Uniform;
+        size_t bytes = 0;
+        bool live = false;
+        std::vector<uint8_t> contents; // Recording backend
+#if TERRAINGEN_WEBGPU
+        WGPUBuffer handle = nullptr;
+#endif
+    };
+
+    struct BindGroup {
+        PipelineID pipeline;
+        std::vector<PassBinding> bindings;
+#if TERRAINGEN_WEBGPU
+        WGPUBindGroup handle = nullptr;
+#endif
+    };
+
+    // Cached bind group of a validated pass, created if missing
+    BindGroup& BindGroupLocked(const ComputePass& pass);
+    // Drop the cached bind groups matching `binding`
+    void ForgetLocked(const PassBinding& binding);
+    void RecordLocked(const Command& command);
+    void SubmitLocked();
+    // Readback for a texture's first mirror (GPUContext::Materialize)
+    PendingReadback ReadMirror(const GPUContext::Texture& tex, uint8_t* out);
+    // Copy of `tex` into `out` behind the recorded passes
+    PendingReadback ReadTextureLocked(const GPUContext::Texture& tex, GPUContext::TextureID id, uint8_t* out,
+                                      std::unique_lock<std::mutex>& lock);
+    // A free staging slot of at least `bytes`, finishing the oldest readback if none is free
+    uint32_t AcquireStagingLocked(size_t bytes, std::unique_lock<std::mutex>& lock);
+    // Submit, then map staging slot s for its readback
+    PendingReadback StartReadbackLocked(uint32_t s, size_t bytes);
+    bool ReadyLocked(uint32_t s, uint64_t ticket) const;
+    // Wait for the map of slot s and copy it out, unless that readback is done already. A
+    // failed map copies nothing and is remembered until its PendingReadback takes it.
+    void FinishLocked(uint32_t s, uint64_t ticket, std::unique_lock<std::mutex>& lock);
+    // Whether readback `ticket` failed, forgetting it
+    bool TakeFailureLocked(uint64_t ticket);
+    // Write the mirror of a sampled texture to the device ahead of a pass
+    void UploadLocked(const GPUContext::Texture& tex, GPUContext::TextureID id);
+
+    GPUContext& gpu_;
+    const GPUBackend backend_;
+    mutable std::mutex mutex_;
+    std::vector<Buffer> buffers_; // BufferID - 1
+    std::vector<BufferID> freeBuffers_;
+    std::vector<BindGroup> bindGroups_;
+    bool pending_ = false; // commands recorded since the last submit
+    std::vector<GPUContext::TextureID> pendingTextures_; // bound by the passes since then
+    std::vector<uint64_t> failedTickets_; // failed readbacks not yet waited for
+    std::vector<Command> log_;
+    Stats stats_;
+    Staging staging_[kStagingSlots];
+    uint64_t nextTicket_ = 1;
+    std::chrono::microseconds mapLatency_{0};
+    bool mapFailure_ = false;
+#if TERRAINGEN_WEBGPU
+    WGPUCommandEncoder encoder_ = nullptr;
+    // Released while passes using them were still unsubmitted
+    std::vector<WGPUBindGroup> retiredGroups_;
+    std::vector<WGPUBuffer> retiredBuffers_;
+#endif
+};
+
+// Releases a texture when it goes out of scope (move-only)
+class ScopedTexture {
+public:
+    ScopedTexture() = default;
+    ScopedTexture(GPUContext& gpu, GPUContext::TextureID id) : gpu_(&gpu), id_(id) {}
+    ~ScopedTexture() { reset(); }
+    ScopedTexture(ScopedTexture&& other) noexcept : gpu_(other.gpu_), id_(other.release()) {}
+    ScopedTexture& operator=(ScopedTexture&& other) noexcept {
+        if (this != &other) {
+            reset();
+            gpu_ = other.gpu_;
+            id_ = other.release();
+        }
+        return *this;
+    }
+    ScopedTexture(const ScopedTexture&) = delete;
+    ScopedTexture& operator=(const ScopedTexture&) = delete;
+
+    GPUContext::TextureID get() const { return id_; }
+    // Give up ownership without releasing
+    GPUContext::TextureID release() {
+        const GPUContext::TextureID id = id_;
+        id_ = 0;
+        return id;
+    }
+    void reset() {
+        if (gpu_ && id_) gpu_->Release(id_);
+        id_ = 0;
+    }
+
+private:
+    GPUContext* gpu_ = nullptr;
+    GPUContext::TextureID id_ = 0;
+};
+
+} // namespace terraingen
@@ -1,22 +1,93 @@
 #pragma once
 
 #include <cstdint>
+#include "Erosion.hpp"
 #include "Random.hpp"
+#include "Reduction.hpp"
 
 namespace terraingen {
 
 // Identifier for a chunk in the world grid
 typedef struct { int x, z; } ChunkID;
 
+// A chunk always covers the same world area; resolution only changes texel spacing
+constexpr uint32_t kChunkWorldSize = 256;
+constexpr uint32_t kMinChunkResolution = 64;
+constexpr uint32_t kMaxChunkResolution = 1024;
+
+// What to generate for one chunk
+struct ChunkRequest {
+    ChunkID id{0, 0};
+    uint32_t resolution = 256; // texels per side, power of two in [64, 1024]
+    int octaves = 4;           // FBM octaves at full detail; sub-texel ones are dropped
+    // Stretch heights to exactly [0,1] using this chunk's own bounds. Off by default because
+    // per-chunk stretching breaks continuity between neighbors.
+    bool normalize = false;
+    // Overlap texels generated around the chunk on every side (clamped to resolution / 2), so
+    // stencils see real neighbours at chunk edges; only the interior is emitted. 0 = generate
+    // the chunk alone. Erosion runs on shared world-aligned tiles (ErosionTileCache), so eroded
+    // heights, apron included, do not depend on the apron or on which chunk asked for them.
+    uint32_t apron = 0;
+    // Interpolate the low octaves from OctaveCache's shared coarse lattice and evaluate only the
+    // high ones per texel. Heights differ from direct evaluation by the interpolation error
+    // (about 1e-4); every resolution sees the same field, so LODs still agree.
+    bool coarseOctaveCache = true;
+    // Erosion on the CPU path, droplets first; dropletDensity = 0 / reach = 0 skip a stage. Its
+    // distances are world units, so every resolution erodes the same features.
+    HydraulicErosionParams hydraulic;
+    ThermalErosionParams thermal;
+
+    float TexelSize() const { return static_cast<float>(kChunkWorldSize) / resolution; }
+};
+
+// Resolution for an LOD level: 0 = 1024 texels, each level halves, clamped at 64
+uint32_t ResolutionForLOD(uint32_t lod);
+
 // Forward declare GPU context and texture handle
 class GPUContext;
 using GPUTexture = uint32_t;
 
+// Optional by-products of heightmap generation
+struct HeightmapOutputs {
+    // Analytic height derivatives per world unit (d height / dx, d height / dz), so consumers
+    // such as MeshTiler normals and biome slope need no finite-difference pass.
+    GPUTexture gradX = 0;
+    GPUTexture gradZ = 0;
+    // Per-tile and per-chunk height bounds, so culling, quantization and biome thresholds
+    // don't rescan the texture.
+    MinMaxPyramid bounds;
+    // Halo-aware generation (ChunkRequest::apron > 0): the eroded extended heightmap, of side
+    // resolution + 2 * apron, with the chunk interior starting at (apron, apron)
+    GPUTexture extended = 0;
+    uint32_t apron = 0;
+    // The extended heights are the ones every neighbour generates over the same texels, so
+    // stencils across the chunk edge match them exactly (not after per-chunk normalization)
+    bool sharedApron = false;
+    // Texels evaluated vs. copied from a cache: of the (extended) domain and ApronCache for noise
+    // alone; when eroding, of the domains of the tiles this chunk eroded vs. took from
+    // ErosionTileCache (or waited for while another chunk eroded them)
+    uint64_t evaluatedTexels = 0;
+    uint64_t cachedTexels = 0;
+};
+
 // Heightmap generation interface (see implementation.md 4. Heightmap.hpp)
 class Heightmap {
 public:
-    // Dispatches FBM noise + erosion compute passes; returns a GPU texture handle
-    static GPUTexture Generate(const ChunkID& id, GPUContext& gpu);
+    // FBM noise and erosion, evaluated on the CPU whatever the backend: a device gets the
+    // heights uploaded when a pass first samples them. Returns the height texture.
+    static GPUTexture Generate(const ChunkRequest& req, GPUContext& gpu, HeightmapOutputs* outputs = nullptr);
+
+    // Default-resolution chunk
+    static GPUTexture Generate(const ChunkID& id, GPUContext& gpu, HeightmapOutputs* outputs = nullptr) {
+        ChunkRequest req;
+        req.id = id;
+        return Generate(req, gpu, outputs);
+    }
+
+    // Octaves of `req` whose wavelength spans at least two texels (Nyquist) at its resolution.
+    // Samples shared between resolutions agree on every retained octave; the dropped ones
+    // contribute at most their amplitude.
+    static int EffectiveOctaves(const ChunkRequest& req);
 };
 
 } // namespace terraingen 
\ No newline at end of file
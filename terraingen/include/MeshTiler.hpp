@@ -15,10 +15,15 @@ struct MeshData {
 // Mesh tiling interface (see implementation.md 4. MeshTiler.hpp)
 class MeshTiler {
 public:
-    // Generate mesh data from height and SDF textures
+    // Generate mesh data from height and SDF textures. The surface comes from the heights alone;
+    // caves in the SDF are not meshed yet, so sdfTex is not read.
+    // When `derivatives` carries gradient textures, normals use them instead of central differences.
+    // With a device the mesh comes from mesh_tile.wgsl, a port of the CPU kernel, and is read
+    // back before this returns.
     static MeshData Generate(const GPUTexture heightTex,
                              const GPUTexture sdfTex,
-                             GPUContext& gpu);
+                             GPUContext& gpu,
+                             const HeightmapOutputs* derivatives = nullptr);
 };
 
 } // namespace terraingen 
\ No newline at end of file
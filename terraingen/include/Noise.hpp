@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Random.hpp"
+
+namespace terraingen {
+
+// Noise value plus analytic partial derivatives d/dx, d/dz (per unit of the input coordinates)
+struct NoiseSample {
+    float value = 0.0f;
+    float dx = 0.0f;
+    float dz = 0.0f;
+};
+
+enum class NoiseBasis : uint8_t {
+    Value,        // interpolated per-corner random values
+    Perlin,       // gradient noise on the square lattice
+    OpenSimplex2, // gradient noise on the skewed triangular lattice
+};
+
+// Point evaluation in lattice units, output roughly in [-1,1]
+NoiseSample ValueNoise2D(double x, double z, uint64_t seed);
+NoiseSample PerlinNoise2D(double x, double z, uint64_t seed);
+NoiseSample OpenSimplex2Noise2D(double x, double z, uint64_t seed);
+
+// Hashes for every lattice point of [i0, i0+ni) x [j0, j0+nj), computed with HashCoordsN
+struct LatticeBlock {
+    int64_t i0 = 0;
+    int64_t j0 = 0;
+    uint32_t ni = 0;
+    uint32_t nj = 0;
+    std::vector<uint64_t> hashes;
+
+    void Build(int64_t i0, int64_t j0, uint32_t ni, uint32_t nj, uint64_t seed);
+    uint64_t At(int64_t i, int64_t j) const {
+        return hashes[static_cast<size_t>(j - j0) * ni + static_cast<size_t>(i - i0)];
+    }
+
+private:
+    std::vector<int64_t> xs_, ys_, zs_;
+};
+
+// Reusable per-thread buffers for row evaluation
+struct NoiseScratch {
+    LatticeBlock block;
+    std::vector<int64_t> cells;       // per-sample skewed lattice cell (i, j interleaved)
+    std::vector<float> offsets;       // per-sample offset inside that cell
+    std::vector<NoiseSample> octave;  // one octave of a row
+};
+
+// Evaluate one noise octave along a row: x = x0 + k*step for k < n, fixed z, in lattice units.
+// Each lattice corner touched by the row is hashed once and shared by every sample in its
+// cells; results are identical to the point functions above.
+void NoiseRow(NoiseBasis basis, double x0, double step, uint32_t n, double z, uint64_t seed,
+              NoiseScratch& scratch, NoiseSample* out);
+
+// Fractal Brownian motion settings
+struct FbmParams {
+    NoiseBasis basis = NoiseBasis::Perlin;
+    float frequency = 1.0f / 64.0f; // octave 0, in cycles per world unit
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    uint64_t seed = 1337u;          // octave o uses seed + o
+};
+
+// Sum of octave amplitudes, used to bring FBM back into [-1,1]
+inline float FbmAmplitudeSum(const FbmParams& p, int octaves) {
+    float sum = 0.0f, amp = 1.0f;
+    for (int o = 0; o < octaves; ++o) {
+        sum += amp;
+        amp *= p.gain;
+    }
+    return sum;
+}
+
+// FBM along a row of world-space samples (x = worldX0 + k*step). Derivatives are per world unit.
+// The octave count is a template parameter so the octave loop fully unrolls.
+template <int Octaves>
+void FbmRow(const FbmParams& p, double worldX0, double step, uint32_t n, double worldZ,
+            NoiseScratch& scratch, NoiseSample* out) {
+    static_assert(Octaves >= 1, "FBM needs at least one octave");
+    for (uint32_t k = 0; k < n; ++k) out[k] = NoiseSample{};
+    scratch.octave.resize(n);
+    NoiseSample* oct = scratch.octave.data();
+    float freq = p.frequency;
+    float amp = 1.0f;
+    for (int o = 0; o < Octaves; ++o) {
+        NoiseRow(p.basis, worldX0 * freq, step * freq, n, worldZ * freq,
+                 p.seed + static_cast<uint64_t>(o), scratch, oct);
+        const float dScale = amp * freq;
+        for (uint32_t k = 0; k < n; ++k) {
+            out[k].value += oct[k].value * amp;
+            out[k].dx += oct[k].dx * dScale;
+            out[k].dz += oct[k].dz * dScale;
+        }
+        amp *= p.gain;
+        freq *= p.lacunarity;
+    }
+}
+
+// Runtime octave count (1..kMaxFbmOctaves) dispatched onto the unrolled instantiations
+constexpr int kMaxFbmOctaves = 12;
+void FbmRowN(int octaves, const FbmParams& p, double worldX0, double step, uint32_t n,
+             double worldZ, NoiseScratch& scratch, NoiseSample* out);
+
+// Add octaves [first, last) of the FBM onto `out`. Amplitudes, frequencies and summation order
+// match FbmRow, so a row seeded with octaves [0, first) ends up bit-identical to FbmRow.
+void FbmAddOctaves(int first, int last, const FbmParams& p, double worldX0, double step, uint32_t n,
+                   double worldZ, NoiseScratch& scratch, NoiseSample* out);
+
+} // namespace terraingen
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Noise.hpp"
+
+namespace terraingen {
+
+// The low FBM octaves are sampled on a world-space lattice of kCoarseSpacing units and grouped
+// into square regions of kCoarseRegionCells cells, aligned to the world origin. A region spans
+// 4x4 chunks (1024 world units), so neighbouring chunks, their aprons and erosion tiles mostly
+// land in a tile that is already built. An octave is "coarse" when its wavelength spans at
+// least kCoarseCellsPerWavelength lattice cells.
+constexpr double kCoarseSpacing = 4.0;
+constexpr uint32_t kCoarseRegionCells = 256;
+constexpr float kCoarseCellsPerWavelength = 8.0f;
+
+// Leading octaves of `octaves` that are smooth enough to interpolate from the coarse lattice
+int CoarseOctaveCount(const FbmParams& p, int octaves);
+
+// Summed coarse octaves at one lattice node: value, gradient and cross derivative d2/dxdz
+struct CoarseNode {
+    float value = 0.0f;
+    float dx = 0.0f;
+    float dz = 0.0f;
+    float dxz = 0.0f;
+};
+
+// One region: (kCoarseRegionCells + 1)^2 nodes, row-major, the last row and column shared with
+// the neighbouring regions
+struct CoarseTile {
+    std::vector<CoarseNode> nodes;
+};
+
+struct CoarseTileKey {
+    int32_t rx = 0;          // region index along x and z
+    int32_t rz = 0;
+    int32_t octaves = 0;     // octaves [0, octaves) summed into the tile
+    uint64_t fbm = 0;        // fingerprint of the FbmParams
+
+    bool operator==(const CoarseTileKey& o) const {
+        return rx == o.rx && rz == o.rz && octaves == o.octaves && fbm == o.fbm;
+    }
+};
+
+struct OctaveCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+// Coarse tiles covering a world rectangle, pinned while a chunk is generated. Evaluation is
+// lock-free and depends only on the world position, so every chunk and every resolution
+// sees the same coarse field; at lattice nodes it reproduces the direct FBM bit for bit.
+class CoarseOctaveField {
+public:
+    int Octaves() const { return octaves_; }
+
+    // Bicubic Hermite interpolation of the coarse octaves along a row (x = worldX0 + k*step)
+    void Row(double worldX0, double step, uint32_t n, double worldZ, NoiseSample* out) const;
+
+    // Full FBM: the coarse octaves interpolated, octaves [Octaves(), octaves) evaluated
+    void FbmRow(int octaves, const FbmParams& p, double worldX0, double step, uint32_t n,
+                double worldZ, NoiseScratch& scratch, NoiseSample* out) const;
+
+private:
+    friend class OctaveCache;
+    int octaves_ = 0;
+    int32_t rx0_ = 0, rz0_ = 0;
+    uint32_t nx_ = 0, nz_ = 0;
+    std::vector<std::shared_ptr<const CoarseTile>> tiles_;
+};
+
+// Thread-safe LRU cache of coarse tiles shared by neighbouring chunks and LODs. Bounded by
+// tile memory; tiles are built outside the lock on a miss.
+class OctaveCache {
+public:
+    explicit OctaveCache(size_t maxBytes);
+
+    // Tiles covering [x0, x1] x [z0, z1] world units for octaves [0, octaves), one hit or miss
+    // counted per tile
+    CoarseOctaveField Acquire(const FbmParams& p, int octaves, double x0, double z0, double x1, double z1);
+
+    void SetMaxBytes(size_t maxBytes);
+    void Clear();
+    OctaveCacheStats Stats() const;
+
+    // Process-wide cache used by Heightmap::Generate
+    static OctaveCache& Global();
+
+private:
+    struct KeyHash {
+        size_t operator()(const CoarseTileKey& k) const;
+    };
+    using Entry = std::pair<CoarseTileKey, std::shared_ptr<const CoarseTile>>;
+
+    std::shared_ptr<const CoarseTile> Tile(const FbmParams& p, const CoarseTileKey& key);
+    void EvictLocked();
+
+    mutable std::mutex mutex_;
+    size_t maxBytes_;
+    std::list<Entry> lru_; // most recently used first
+    std::unordered_map<CoarseTileKey, std::list<Entry>::iterator, KeyHash> index_;
+    OctaveCacheStats stats_;
+};
+
+} // namespace terraingen
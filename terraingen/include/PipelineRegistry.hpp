@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+// WebGPU comes from emscripten in the browser and natively from wgpu-native, which
+// compile.py --webgpu links in and flags with TERRAINGEN_NATIVE_WEBGPU. Both speak the same
+// webgpu.h; anything else runs the CPU backend only.
+#if defined(__EMSCRIPTEN__) || defined(TERRAINGEN_NATIVE_WEBGPU)
+#define TERRAINGEN_WEBGPU 1
+#include <webgpu/webgpu.h>
+#else
+#define TERRAINGEN_WEBGPU 0
+#endif
+
+namespace terraingen {
+
+// Compute pipelines of the WebGPU stages
+enum class PipelineID : uint8_t {
+    BiomeClassify,
+    MeshTile,
+    Count,
+};
+
+// One entry of bind group 0, in binding order
+enum class BindingKind : uint8_t {
+    Uniform,
+    StorageBuffer,
+    ReadOnlyStorage, // var<storage, read>
+    SampledFloat,    // texture_2d<f32>, unfilterable
+    StorageR32Float, // texture_storage_2d<r32float, write>
+    StorageR8Uint,   // texture_storage_2d<r32uint, write>: an R8Uint texture, widened on the device
+};
+
+// Shader and bind group layout of a pipeline; entry point "main"
+struct PipelineDesc {
+    static constexpr uint32_t kMaxBindings = 8;
+    const char* name;
+    const char* shader; // embedded shader, by file name without .wgsl
+    uint32_t bindingCount;
+    BindingKind bindings[kMaxBindings];
+};
+
+const PipelineDesc& GetPipelineDesc(PipelineID id);
+
+// WGSL source of shaders/<name>.wgsl, compiled into the binary by compile.py together with
+// the FNV-1a 64 hash of its text. The build checks every shader against the hash checked in
+// for it in PipelineRegistry.cpp, so a shader edit must update that table in the same change,
+// and that every pipeline's shader is there; nothing is read from disk at run time.
+struct ShaderSource {
+    const char* name;
+    const char* code;
+    size_t size;
+    uint64_t hash;
+};
+
+constexpr uint64_t ShaderHash(const char* text, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; ++i) h = (h ^ static_cast<unsigned char>(text[i])) * 0x100000001b3ull;
+    return h;
+}
+
+// Embedded shaders in name order
+size_t ShaderCount();
+const ShaderSource& GetShader(size_t i);
+// Shader by name, or null
+const ShaderSource* FindShader(const char* name);
+// Checked-in hash of the named shader's text, 0 for a name without one
+uint64_t GoldenShaderHash(const char* name);
+
+#if TERRAINGEN_WEBGPU
+// Let the device make progress and fire its callbacks: yields to the browser under
+// emscripten, polls the device natively. Waits on a map or pipeline loop over this.
+void PollDevice(WGPUDevice device);
+
+struct ComputePipeline {
+    WGPUShaderModule module = nullptr;
+    WGPUBindGroupLayout bgl = nullptr;
+    WGPUPipelineLayout pl = nullptr;
+    WGPUComputePipeline pipeline = nullptr;
+};
+
+// Pipelines shared by every GPUContext and thread. Each is built once under std::call_once,
+// by WarmUp or on first use, and never changes afterwards, so Get needs no lock once it has
+// returned.
+class PipelineRegistry {
+public:
+    const ComputePipeline& Get(WGPUDevice device, PipelineID id);
+
+    // Build every pipeline not built yet, compiling them concurrently (the device's async
+    // pipeline creation in the browser, the thread pool natively) and wait for all of them;
+    // returns how many it built. Meant for startup, so the first chunk does not pay for
+    // shader compilation.
+    uint32_t WarmUp(WGPUDevice device);
+
+    static PipelineRegistry& Global();
+
+private:
+    static constexpr size_t kCount = static_cast<size_t>(PipelineID::Count);
+
+    std::once_flag once_[kCount];
+    ComputePipeline pipelines_[kCount];
+};
+#endif
+
+} // namespace terraingen
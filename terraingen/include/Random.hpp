@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 namespace terraingen {
@@ -19,7 +20,34 @@ uint64_t PCG64Next(PCG64State& s);
 // Jump the RNG state forward
 void PCG64Jump(PCG64State& s);
 
+// Advance by `delta` outputs in O(log delta) steps; same state as calling PCG64Next delta times
+void PCG64Advance(PCG64State& s, uint64_t delta);
+
 // Hash 3D coordinates into a deterministic 64-bit value
 uint64_t HashCoords(int64_t x, int64_t y, int64_t z, uint64_t seed);
 
+// Batched HashCoords: out[i] == HashCoords(x[i], y[i], z[i], seed), bit for bit.
+// Uses AVX-512 (8/16 lanes) or AVX2 (4/8 lanes) when available, scalar otherwise.
+void HashCoordsN(const int64_t* x, const int64_t* y, const int64_t* z,
+                 uint64_t seed, uint64_t* out, size_t n);
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random Numbers: As Easy as
+// 1, 2, 3"): 128 random bits as a pure function of a 128-bit counter and a 64-bit key.
+struct Philox4x32 {
+    uint32_t v[4];
+};
+Philox4x32 Philox4x32_10(Philox4x32 counter, uint64_t key);
+
+// Stream id for one generation stage of one chunk
+uint64_t CounterStream(int64_t chunkX, int64_t chunkZ, uint32_t stage);
+
+// Value `index` of `stream` under `key`, evaluated directly without sequential state. Values
+// 2b and 2b+1 are the two halves of the Philox block with counter {b lo, b hi, stream lo,
+// stream hi}.
+uint64_t CounterRandom(uint64_t key, uint64_t stream, uint64_t index);
+
+// Batched CounterRandom: out[i] == CounterRandom(key, stream, first + i), bit for bit.
+// Uses AVX-512 (8 blocks per vector) or AVX2 (4) when available, scalar otherwise.
+void CounterRandomN(uint64_t key, uint64_t stream, uint64_t first, uint64_t* out, size_t n);
+
 } // namespace terraingen 
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace terraingen {
+
+// Closed value range; an empty range has min > max
+struct HeightBounds {
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+
+    bool Empty() const { return min > max; }
+    void Merge(const HeightBounds& o) {
+        min = o.min < min ? o.min : min;
+        max = o.max > max ? o.max : max;
+    }
+};
+
+// Hierarchical min/max reduction of a height texture.
+// Level 0 holds one bound per tileSize x tileSize tile; each further level merges 2x2 cells of
+// the previous one, and the last level is a single bound for the whole chunk.
+struct MinMaxPyramid {
+    struct Level {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<HeightBounds> cells;
+        const HeightBounds& At(uint32_t x, uint32_t y) const { return cells[static_cast<size_t>(y) * width + x]; }
+    };
+
+    uint32_t tileSize = 0;
+    std::vector<Level> levels;
+
+    bool Empty() const { return levels.empty(); }
+    HeightBounds Chunk() const { return levels.empty() ? HeightBounds{} : levels.back().cells[0]; }
+    const HeightBounds& Tile(uint32_t tx, uint32_t ty) const { return levels[0].At(tx, ty); }
+    // Bounds of the texel rectangle [x0, x1) x [y0, y1), from the coarsest cells that cover it
+    HeightBounds Query(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const;
+};
+
+// Build the pyramid over a row-major float image. Rows are streamed once in bands of tileSize
+// rows (one band per task), with SIMD min/max per tile segment.
+MinMaxPyramid BuildMinMaxPyramid(const float* data, uint32_t width, uint32_t height, uint32_t tileSize = 16);
+
+// Min/max of n floats, AVX-512/AVX2 when available
+HeightBounds ReduceMinMax(const float* data, size_t n);
+
+// Affine remap of `data` from range `from` to range `to` (in place)
+void NormalizeHeights(float* data, size_t n, const HeightBounds& from, const HeightBounds& to);
+
+// Apply the same remap to a pyramid's bounds without rescanning the texture
+void RemapPyramid(MinMaxPyramid& pyramid, const HeightBounds& from, const HeightBounds& to);
+
+} // namespace terraingen
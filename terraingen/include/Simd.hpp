@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// x86 SIMD kernels are compiled per-function with target attributes and picked at
+// runtime, so the binary still runs on machines without AVX2/AVX-512. The AVX2 tier includes
+// F16C (half-float conversion), which every AVX2 CPU has.
+#if !defined(__EMSCRIPTEN__) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TERRAINGEN_X86_SIMD 1
+#define TERRAINGEN_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#define TERRAINGEN_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx512bw,f16c")))
+#else
+#define TERRAINGEN_X86_SIMD 0
+#endif
+
+namespace terraingen {
+
+// Instruction sets the batched kernels can dispatch to (ordered by width)
+enum class SimdISA : uint8_t {
+    Scalar = 0,
+    AVX2 = 1,   // 4 x 64-bit lanes per vector, with F16C
+    AVX512 = 2, // 8 x 64-bit lanes per vector
+};
+
+// Widest instruction set supported by this CPU/OS
+SimdISA DetectSimdISA();
+
+// Instruction set used by the batched kernels (detected unless overridden)
+SimdISA ActiveSimdISA();
+
+// Force a narrower instruction set (benchmarks, A/B checks); clamped to DetectSimdISA()
+void SetSimdISA(SimdISA isa);
+
+const char* SimdISAName(SimdISA isa);
+
+} // namespace terraingen
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace terraingen {
+
+// Texel formats of GPUContext textures. Whatever the format, a texture's CPU side is one
+// mirror buffer of TexelBytes(format) per texel, allocated on first access through
+// Texture::As<T>(). Stages pick the narrowest format their values survive: [0, 1] material
+// channels need no more than 8 bits, signed distances a half float.
+enum class TextureFormat : uint8_t {
+    R32Float = 0,
+    R16Float,   // IEEE 754 half
+    R16Unorm,   // [0, 1] in steps of 1/65535
+    R8Unorm,    // [0, 1] in steps of 1/255
+    R8Uint,     // raw bytes such as biome ids
+    RG8Snorm,   // two channels in [-1, 1] in steps of 1/127
+    RGBA8Unorm, // four [0, 1] channels
+};
+
+uint32_t TexelBytes(TextureFormat format);
+uint32_t ChannelCount(TextureFormat format);
+const char* TextureFormatName(TextureFormat format);
+
+// Round to nearest even, with overflow to infinity and quiet NaNs, bit-for-bit as F16C does
+uint16_t FloatToHalf(float f);
+float HalfToFloat(uint16_t h);
+
+// Conversion kernels between floats and channel `channel` of n texels of `format` starting at
+// `texels`. Normalized formats clamp (NaN encodes as 0); R8Uint truncates. Other channels of
+// multi-channel texels are left alone. Half conversion and 8/16-bit unorm encoding use the
+// active SIMD ISA and give the same bits as the scalar code.
+void EncodeTexels(TextureFormat format, const float* in, size_t n, void* texels, uint32_t channel = 0);
+void DecodeTexels(TextureFormat format, const void* texels, size_t n, float* out, uint32_t channel = 0);
+
+} // namespace terraingen
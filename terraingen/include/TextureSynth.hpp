@@ -3,19 +3,49 @@
 #include <vector>
 #include "Heightmap.hpp"
 #include "Biomes.hpp"
+#include "BiomeDistance.hpp"
 
 namespace terraingen {
 
+// Texture format of the normal map: X and Z, with Y implied by unit length
+constexpr TextureFormat kNormalFormat = TextureFormat::RG8Snorm;
+
+// Everything the biome and texture stages produce for one chunk; params, albedo and roughness
+// are kMaterialFormat, normal kNormalFormat (the GPU path writes R32Float throughout)
+struct SurfaceMaps {
+    PackedBiomeMap biomes;
+    GPUTexture params = 0;
+    GPUTexture albedo = 0;
+    GPUTexture normal = 0;
+    GPUTexture roughness = 0;
+};
+
 // Texture synthesis interface (see implementation.md 4. TextureSynth.hpp)
 class TextureSynth {
 public:
-    // Generate albedo, normal, and roughness textures from height and biome inputs
+    // Materials blend across biome edges over transitionWidth world units (0 keeps hard steps).
+    // Staged: Biomes::Classify, packing, the edge distance field, Biomes::GenerateParameters and
+    // Generate, one full sweep each
+    static SurfaceMaps GenerateStaged(const BiomeInputs& inputs, GPUContext& gpu,
+                                      const BiomeClassifier& classifier = DefaultBiomeClassifier(),
+                                      float transitionWidth = kDefaultBiomeTransition);
+    // Fused: identical outputs from a single sweep over bands of rows that classifies, looks up
+    // the biome material, writes every output texture and packs the ids. Blending splits it
+    // into a classify sweep and a shading sweep around the distance field.
+    static SurfaceMaps GenerateFused(const BiomeInputs& inputs, GPUContext& gpu,
+                                     const BiomeClassifier& classifier = DefaultBiomeClassifier(),
+                                     float transitionWidth = kDefaultBiomeTransition);
+
+    // Generate albedo, normal, and roughness textures from height and biome inputs, blended
+    // across biome edges when a distance field is given. The biome map carries all the shading
+    // uses; heightTex is not read.
     static void Generate(const GPUTexture heightTex,
-                         const BiomeMap& biomeMap,
+                         const PackedBiomeMap& biomeMap,
                          GPUContext& gpu,
                          GPUTexture& outAlbedo,
                          GPUTexture& outNormal,
-                         GPUTexture& outRoughness);
+                         GPUTexture& outRoughness,
+                         const BiomeDistanceField* edges = nullptr);
 };
 
 } // namespace terraingen 
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace terraingen {
+
+// Work-stealing thread pool shared by all CPU stages.
+// Each worker owns a deque: it pops its own tasks LIFO and steals FIFO from others.
+// The thread calling ParallelFor helps execute tasks, so nested calls cannot deadlock.
+class ThreadPool {
+public:
+    // threadCount counts the calling thread; 1 runs everything inline
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned ThreadCount() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    // Run fn(first, last) over [begin, end) split into chunks of at most `grain` items.
+    // Chunk boundaries depend only on the range and grain, never on the thread count.
+    void ParallelFor(uint32_t begin, uint32_t end, uint32_t grain,
+                     const std::function<void(uint32_t, uint32_t)>& fn);
+
+    // Process-wide pool, created on first use
+    static ThreadPool& Global();
+    // Resize the global pool (0 = hardware concurrency). Not safe while tasks are running.
+    static void SetGlobalThreadCount(unsigned threadCount);
+
+private:
+    using Task = std::function<void()>;
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(unsigned index);
+    void Push(unsigned queue, Task task);
+    bool TryRunOne(unsigned preferredQueue);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<uint32_t> pending_{0};
+    std::atomic<bool> stop_{false};
+    std::atomic<unsigned> nextQueue_{0};
+};
+
+} // namespace terraingen
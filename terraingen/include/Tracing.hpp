@@ -12,9 +12,7 @@ public:
     ~TraceScope();
 };
 
-// Log a key/value pair within a trace scope
-inline void TraceValue(const char* key, int32_t value) {
-    // stub: implementation writes to ring buffer
-}
+// Log a key/value pair within the current trace scope
+void TraceValue(const char* key, int32_t value);
 
 } // namespace terraingen 
\ No newline at end of file
@@ -1,6 +1,38 @@
-@group(0) @binding(0) var<uniform> thresholds : vec2<f32>;
-@group(0) @binding(1) var heightTex : texture_2d<f32>;
-@group(0) @binding(2) var outputTex : texture_storage_2d<r8uint, write>;
+// BiomeClassifier::ClassifyRow on the GPU: the same bins and the same two table lookups.
+// The tables arrive as bytes packed little-endian into words, the climate table first.
+// Ids go out as r32uint: core WebGPU has no r8uint storage textures, and GPUContext keeps
+// R8Uint textures as words on the device, narrowing them on readback.
+struct Params {
+  slopeScale : f32,
+  flags : u32,         // 1: gradients bound, 2: humidity bound, 4: temperature bound
+  terrainOffset : u32, // byte offset of the zone x height x slope table
+  pad : u32,
+}
+
+@group(0) @binding(0) var<uniform> params : Params;
+@group(0) @binding(1) var<storage, read> lut : array<u32>;
+@group(0) @binding(2) var heightTex : texture_2d<f32>;
+@group(0) @binding(3) var gradXTex : texture_2d<f32>;
+@group(0) @binding(4) var gradZTex : texture_2d<f32>;
+@group(0) @binding(5) var humidityTex : texture_2d<f32>;
+@group(0) @binding(6) var temperatureTex : texture_2d<f32>;
+@group(0) @binding(7) var outputTex : texture_storage_2d<r32uint, write>;
+
+const kHeightBins = 64u;
+const kSlopeBins = 16u;
+const kClimateBins = 16u;
+
+// Bin of v * scale clamped to [0, maxBin]; NaN lands in bin 0, as in Quantize on the CPU
+fn quantize(v : f32, scale : f32, maxBin : f32) -> u32 {
+  var x = v * scale;
+  x = select(0.0, x, x > 0.0);
+  x = select(maxBin, x, x < maxBin);
+  return u32(x);
+}
+
+fn lutByte(i : u32) -> u32 {
+  return (lut[i >> 2u] >> ((i & 3u) * 8u)) & 0xffu;
+}
 
 @compute @workgroup_size(8,8)
 fn main(@builtin(global_invocation_id) gid: vec3<u32>) {
@@ -8,9 +40,28 @@ fn main(@builtin(global_invocation_id) gid: vec3<u32>) {
   if (gid.x >= dims.x || gid.y >= dims.y) {
     return;
   }
-  let h = textureLoad(heightTex, vec2<i32>(gid.xy), 0).r;
-  var id: u32 = 0u;
-  if (h >= thresholds.x) { id = 1u; }
-  if (h >= thresholds.y) { id = 2u; }
-  textureStore(outputTex, vec2<i32>(gid.xy), vec4<u32>(id, 0u, 0u, 1u));
-} 
\ No newline at end of file
+  let coord = vec2<i32>(gid.xy);
+  let height = textureLoad(heightTex, coord, 0).r;
+  var gx = 0.0;
+  var gz = 0.0;
+  if ((params.flags & 1u) != 0u) {
+    gx = textureLoad(gradXTex, coord, 0).r;
+    gz = textureLoad(gradZTex, coord, 0).r;
+  }
+  var humidity = 0.5;
+  if ((params.flags & 2u) != 0u) {
+    humidity = textureLoad(humidityTex, coord, 0).r;
+  }
+  var temperature = 0.5;
+  if ((params.flags & 4u) != 0u) {
+    temperature = textureLoad(temperatureTex, coord, 0).r;
+  }
+  let slope = sqrt(gx * gx + gz * gz);
+  let hb = quantize(height, f32(kHeightBins), f32(kHeightBins - 1u));
+  let sb = quantize(slope, params.slopeScale, f32(kSlopeBins - 1u));
+  let ub = quantize(humidity, f32(kClimateBins), f32(kClimateBins - 1u));
+  let tb = quantize(temperature, f32(kClimateBins), f32(kClimateBins - 1u));
+  let zone = lutByte(tb * kClimateBins + ub);
+  let id = lutByte(params.terrainOffset + (zone * kHeightBins + hb) * kSlopeBins + sb);
+  textureStore(outputTex, coord, vec4<u32>(id, 0u, 0u, 1u));
+}
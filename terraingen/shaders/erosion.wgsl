@@ -1,2 +0,0 @@
-// WGSL stub for hydraulic and thermal erosion kernels
-// TODO: implement erosion compute shaders 
\ No newline at end of file
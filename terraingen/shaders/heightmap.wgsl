@@ -1,2 +0,0 @@
-// WGSL stub for heightmap FBM noise kernel
-// TODO: implement FBM noise compute shader 
\ No newline at end of file
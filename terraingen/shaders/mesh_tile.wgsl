@@ -0,0 +1,86 @@
+// MeshTiler::Generate's kernel on the GPU: one invocation per vertex, each also emitting the
+// quad to its lower right, with the same operations in the same order as the CPU functor.
+// Vertices are 8 floats (position, normal, uv); indices 6 per quad.
+struct Params {
+  texel : f32,       // world units per texel
+  heightScale : f32,
+  flags : u32,       // 1: gradients bound
+  pad : u32,
+}
+
+@group(0) @binding(0) var<uniform> params : Params;
+@group(0) @binding(1) var heightTex : texture_2d<f32>;
+@group(0) @binding(2) var gradXTex : texture_2d<f32>;
+@group(0) @binding(3) var gradZTex : texture_2d<f32>;
+@group(0) @binding(4) var<storage, read_write> vertices : array<f32>;
+@group(0) @binding(5) var<storage, read_write> indices : array<u32>;
+
+fn heightAt(x : u32, y : u32) -> f32 {
+  return textureLoad(heightTex, vec2<i32>(i32(x), i32(y)), 0).r;
+}
+
+@compute @workgroup_size(8,8)
+fn main(@builtin(global_invocation_id) gid: vec3<u32>) {
+  let dims = textureDimensions(heightTex);
+  let w = dims.x;
+  let h = dims.y;
+  let x = gid.x;
+  let y = gid.y;
+  if (x >= w || y >= h) {
+    return;
+  }
+  let texel = params.texel;
+  let heightScale = params.heightScale;
+  let hx = f32(x) * texel;
+  let hz = f32(y) * texel;
+  let hy = heightAt(x, y) * heightScale;
+
+  var dx : f32;
+  var dz : f32;
+  if ((params.flags & 1u) != 0u) {
+    // Analytic slope per world unit, scaled like the two-texel difference below
+    let coord = vec2<i32>(i32(x), i32(y));
+    dx = 2.0 * texel * textureLoad(gradXTex, coord, 0).r * heightScale;
+    dz = 2.0 * texel * textureLoad(gradZTex, coord, 0).r * heightScale;
+  } else {
+    // Approximate normal by central differences
+    let hL = heightAt(select(x, x - 1u, x > 0u), y);
+    let hR = heightAt(select(x, x + 1u, x + 1u < w), y);
+    let hD = heightAt(x, select(y, y - 1u, y > 0u));
+    let hU = heightAt(x, select(y, y + 1u, y + 1u < h));
+    dx = (hR - hL) * heightScale;
+    dz = (hU - hD) * heightScale;
+  }
+  // normal = (-dx, 2 * texel, -dz) then normalize
+  let nx = -dx;
+  let ny = 2.0 * texel;
+  let nz = -dz;
+  let invLen = 1.0 / sqrt(nx * nx + ny * ny + nz * nz + 1e-6);
+
+  let v = (y * w + x) * 8u;
+  vertices[v + 0u] = hx;
+  vertices[v + 1u] = hy;
+  vertices[v + 2u] = hz;
+  vertices[v + 3u] = nx * invLen;
+  vertices[v + 4u] = ny * invLen;
+  vertices[v + 5u] = nz * invLen;
+  vertices[v + 6u] = f32(x) / f32(w - 1u);
+  vertices[v + 7u] = f32(y) / f32(h - 1u);
+
+  if (x + 1u >= w || y + 1u >= h) {
+    return;
+  }
+  let i0 = y * w + x;
+  let i1 = y * w + (x + 1u);
+  let i2 = (y + 1u) * w + x;
+  let i3 = (y + 1u) * w + (x + 1u);
+  let q = (y * (w - 1u) + x) * 6u;
+  // Triangle 1
+  indices[q + 0u] = i0;
+  indices[q + 1u] = i2;
+  indices[q + 2u] = i1;
+  // Triangle 2
+  indices[q + 3u] = i1;
+  indices[q + 4u] = i2;
+  indices[q + 5u] = i3;
+}
@@ -1,2 +0,0 @@
-// WGSL stub for river pathfinding and SDF channel fill
-// TODO: implement rivers compute shaders 
\ No newline at end of file
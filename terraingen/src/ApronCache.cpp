@@ -0,0 +1,73 @@
+#include "ApronCache.hpp"
+#include "Random.hpp"
+
+namespace terraingen {
+
+size_t ApronCache::KeyHash::operator()(const ApronKey& k) const {
+    const uint64_t setup = (static_cast<uint64_t>(k.resolution) << 32) ^ (static_cast<uint64_t>(k.apron) << 8) ^
+                           (static_cast<uint64_t>(static_cast<uint32_t>(k.octaves)) << 1) ^ k.axis ^
+                           (static_cast<uint64_t>(static_cast<uint32_t>(k.coarseOctaves)) << 24);
+    return static_cast<size_t>(HashCoords(k.line, k.along, 0, setup));
+}
+
+ApronCache::ApronCache(size_t capacity) : capacity_(capacity) {}
+
+std::shared_ptr<const ApronStrip> ApronCache::Lookup(const ApronKey& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+}
+
+void ApronCache::Insert(const ApronKey& key, std::shared_ptr<const ApronStrip> strip) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->second = std::move(strip);
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+    lru_.emplace_front(key, std::move(strip));
+    index_[key] = lru_.begin();
+    EvictLocked();
+}
+
+void ApronCache::EvictLocked() {
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    stats_.entries = lru_.size();
+}
+
+void ApronCache::SetCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    EvictLocked();
+}
+
+void ApronCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_ = ApronCacheStats{};
+}
+
+ApronCacheStats ApronCache::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+ApronCache& ApronCache::Global() {
+    // Four strips per chunk: 64 entries keep a few rows of a streaming window warm
+    static ApronCache cache(64);
+    return cache;
+}
+
+} // namespace terraingen
@@ -0,0 +1,2009 @@
+#include "Bench.hpp"
+#include "ApronCache.hpp"
+#include "BiomeDistance.hpp"
+#include "Biomes.hpp"
+#include "Climate.hpp"
+#include "Erosion.hpp"
+#include "ErosionTileCache.hpp"
+#include "Features.hpp"
+#include "GPUContext.hpp"
+#include "Heightmap.hpp"
+#include "MeshTiler.hpp"
+#include "Noise.hpp"
+#include "OctaveCache.hpp"
+#include "PipelineRegistry.hpp"
+#include "Random.hpp"
+#include "Simd.hpp"
+#include "TextureSynth.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace terraingen {
+
+using BenchClock = std::chrono::steady_clock;
+
+static double SecondsSince(BenchClock::time_point start) {
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// `req` with both erosion stages off, for checks on the noise itself or on erosion applied by
+// hand afterwards
+static ChunkRequest NoiseOnlyRequest(ChunkRequest req = ChunkRequest()) {
+    req.hydraulic.dropletDensity = 0.0f;
+    req.thermal.reach = 0.0f;
+    return req;
+}
+
+// Every ISA up to the detected one, so the report shows the scalar baseline too
+static std::vector<SimdISA> SupportedISAs() {
+    std::vector<SimdISA> isas;
+    for (int i = 0; i <= static_cast<int>(DetectSimdISA()); ++i) {
+        isas.push_back(static_cast<SimdISA>(i));
+    }
+    return isas;
+}
+
+static int BenchHash() {
+    constexpr size_t kCount = 1 << 16;
+    constexpr int kReps = 64;
+    std::vector<int64_t> xs(kCount), ys(kCount), zs(kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        xs[i] = static_cast<int64_t>(i * 7919) - 4096;
+        ys[i] = static_cast<int64_t>(i & 15);
+        zs[i] = -static_cast<int64_t>(i * 104729);
+    }
+    std::vector<uint64_t> ref(kCount), out(kCount);
+    for (size_t i = 0; i < kCount; ++i) ref[i] = HashCoords(xs[i], ys[i], zs[i], 42u);
+
+    int status = 0;
+    for (SimdISA isa : SupportedISAs()) {
+        SetSimdISA(isa);
+        auto start = BenchClock::now();
+        for (int r = 0; r < kReps; ++r) {
+            HashCoordsN(xs.data(), ys.data(), zs.data(), 42u, out.data(), kCount);
+        }
+        double secs = SecondsSince(start);
+        bool match = std::memcmp(out.data(), ref.data(), kCount * sizeof(uint64_t)) == 0;
+        if (!match) status = 1;
+        std::printf("hash      %-7s %10.1f Mhash/s  %s\n", SimdISAName(isa),
+                    kCount * kReps / secs * 1e-6, match ? "bit-identical" : "MISMATCH");
+    }
+    SetSimdISA(DetectSimdISA());
+    return status;
+}
+
+// Noise only, since eroded heights would come out of ErosionTileCache after the first ISA's
+// pass; each pass also starts with empty octave and apron caches, so it times its own FBM
+// rather than what the pass before it left there
+static int BenchHeightmap() {
+    constexpr int kChunks = 32;
+    auto request = [](ChunkID id) {
+        ChunkRequest req = NoiseOnlyRequest();
+        req.id = id;
+        return req;
+    };
+    const ChunkRequest refReq = request(ChunkID{-3, 5});
+
+    // Every ISA must reproduce the scalar heights exactly
+    SetSimdISA(SimdISA::Scalar);
+    std::vector<float> ref;
+    {
+        GPUContext gpu;
+        ref = gpu.GetTexture(Heightmap::Generate(refReq, gpu)).ToFloats();
+    }
+
+    int status = 0;
+    for (SimdISA isa : SupportedISAs()) {
+        SetSimdISA(isa);
+        GPUContext check;
+        const auto& tex = check.GetTexture(Heightmap::Generate(refReq, check));
+        bool match = tex.Texels() == ref.size() &&
+                     std::memcmp(tex.As<float>(), ref.data(), ref.size() * sizeof(float)) == 0;
+        if (!match) status = 1;
+
+        OctaveCache::Global().Clear();
+        ApronCache::Global().Clear();
+        size_t texels = 0;
+        auto start = BenchClock::now();
+        for (int c = 0; c < kChunks; ++c) {
+            GPUContext gpu;
+            texels += gpu.GetTexture(Heightmap::Generate(request(ChunkID{c, -c}), gpu)).Texels();
+        }
+        double secs = SecondsSince(start);
+        std::printf("heightmap %-7s %10.2f Mtexel/s  %s\n", SimdISAName(isa),
+                    texels / secs * 1e-6, match ? "bit-identical" : "MISMATCH");
+    }
+    SetSimdISA(DetectSimdISA());
+    return status;
+}
+
+// Row evaluation (shared lattice corners) against per-point evaluation, per basis
+static int BenchNoise() {
+    constexpr uint32_t kRow = 256;
+    constexpr uint32_t kRows = 256;
+    constexpr double kStep = 1.0 / 16.0; // 16 samples per lattice cell
+    struct Basis { NoiseBasis basis; const char* name; NoiseSample (*point)(double, double, uint64_t); };
+    const Basis bases[] = {
+        {NoiseBasis::Value, "value", ValueNoise2D},
+        {NoiseBasis::Perlin, "perlin", PerlinNoise2D},
+        {NoiseBasis::OpenSimplex2, "simplex", OpenSimplex2Noise2D},
+    };
+
+    int status = 0;
+    NoiseScratch scratch;
+    std::vector<NoiseSample> row(kRow);
+    for (const auto& b : bases) {
+        float maxAbs = 0.0f, maxDiff = 0.0f, maxDerivErr = 0.0f;
+        auto start = BenchClock::now();
+        for (uint32_t r = 0; r < kRows; ++r) {
+            NoiseRow(b.basis, -7.3, kStep, kRow, r * 0.37 - 11.0, 99u, scratch, row.data());
+            maxAbs = std::max(maxAbs, std::fabs(row[r % kRow].value));
+        }
+        double rowSecs = SecondsSince(start);
+
+        start = BenchClock::now();
+        for (uint32_t r = 0; r < kRows; ++r) {
+            double z = r * 0.37 - 11.0;
+            for (uint32_t k = 0; k < kRow; ++k) {
+                NoiseSample p = b.point(-7.3 + k * kStep, z, 99u);
+                if (r == kRows - 1) maxDiff = std::max(maxDiff, std::fabs(p.value - row[k].value));
+            }
+        }
+        double pointSecs = SecondsSince(start);
+
+        // Analytic derivatives against central differences on the last row
+        const double h = 1e-3;
+        double z = (kRows - 1) * 0.37 - 11.0;
+        for (uint32_t k = 0; k < kRow; ++k) {
+            double x = -7.3 + k * kStep;
+            float fdx = (b.point(x + h, z, 99u).value - b.point(x - h, z, 99u).value) / float(2 * h);
+            float fdz = (b.point(x, z + h, 99u).value - b.point(x, z - h, 99u).value) / float(2 * h);
+            maxDerivErr = std::max(maxDerivErr, std::max(std::fabs(fdx - row[k].dx), std::fabs(fdz - row[k].dz)));
+        }
+        bool ok = maxDiff == 0.0f && maxDerivErr < 0.05f;
+        if (!ok) status = 1;
+        std::printf("noise     %-7s row %8.2f Msample/s  point %8.2f Msample/s  |deriv-fd| %.4f  %s\n",
+                    b.name, kRow * kRows / rowSecs * 1e-6, kRow * kRows / pointSecs * 1e-6,
+                    maxDerivErr, ok ? "ok" : "MISMATCH");
+    }
+    return status;
+}
+
+// Cost per chunk at each LOD, and agreement with the finest LOD. The noise must match at
+// shared sample points (exactly unless an octave was dropped); erosion, whose droplets start
+// at different texels on every grid, must move the same material per world area: the erosion
+// displacement (eroded minus noise-only heights) averaged over kBlock-unit squares has to
+// correlate with the finest LOD's and carry about its energy.
+static int BenchLOD() {
+    constexpr int kChunks = 8;
+    constexpr uint32_t kBlock = 16; // world units
+    constexpr uint32_t kBlocks = kChunkWorldSize / kBlock;
+    struct Level {
+        std::vector<float> eroded, noise;
+    };
+    auto generate = [](const ChunkRequest& req) {
+        GPUContext gpu;
+        Level level;
+        level.eroded = gpu.GetTexture(Heightmap::Generate(req, gpu)).ToFloats();
+        level.noise = gpu.GetTexture(Heightmap::Generate(NoiseOnlyRequest(req), gpu)).ToFloats();
+        return level;
+    };
+    // Mean erosion displacement per block
+    auto blockMeans = [](const Level& level, uint32_t res) {
+        const uint32_t per = res / kBlocks;
+        std::vector<double> means(kBlocks * kBlocks, 0.0);
+        for (uint32_t y = 0; y < res; ++y) {
+            for (uint32_t x = 0; x < res; ++x) {
+                const size_t i = static_cast<size_t>(y) * res + x;
+                means[(y / per) * kBlocks + x / per] += level.eroded[i] - level.noise[i];
+            }
+        }
+        for (double& m : means) m /= double(per) * per;
+        return means;
+    };
+    int status = 0;
+    for (int octaves : {4, 8}) {
+        ChunkRequest fine;
+        fine.id = ChunkID{3, -2};
+        fine.resolution = kMaxChunkResolution;
+        fine.octaves = octaves;
+        const Level fineLevel = generate(fine);
+        const std::vector<double> fineMeans = blockMeans(fineLevel, kMaxChunkResolution);
+        const int fineOctaves = Heightmap::EffectiveOctaves(fine);
+
+        for (uint32_t res = kMaxChunkResolution; res >= kMinChunkResolution; res >>= 1) {
+            ChunkRequest req = fine;
+            req.resolution = res;
+            auto start = BenchClock::now();
+            for (int c = 0; c < kChunks; ++c) {
+                GPUContext gpu;
+                req.id = ChunkID{c, c};
+                Heightmap::Generate(req, gpu);
+            }
+            double msPerChunk = SecondsSince(start) * 1e3 / kChunks;
+
+            req.id = fine.id;
+            const Level level = generate(req);
+            const uint32_t stride = kMaxChunkResolution / res;
+            float maxDiff = 0.0f;
+            for (uint32_t y = 0; y < res; ++y) {
+                for (uint32_t x = 0; x < res; ++x) {
+                    float a = level.noise[static_cast<size_t>(y) * res + x];
+                    float b = fineLevel.noise[static_cast<size_t>(y) * stride * kMaxChunkResolution + x * stride];
+                    maxDiff = std::max(maxDiff, std::fabs(a - b));
+                }
+            }
+            // Exact when no octave was dropped, otherwise bounded by the dropped amplitude
+            const int kept = Heightmap::EffectiveOctaves(req);
+            float bound = 0.0f, amp = 1.0f, total = 0.0f;
+            for (int o = 0; o < octaves; ++o) {
+                if (o >= kept && o < fineOctaves) bound += amp;
+                total += amp;
+                amp *= 0.5f;
+            }
+            bound *= 0.5f / total;
+            bool ok = kept == fineOctaves ? maxDiff == 0.0f : maxDiff <= bound + 1e-6f;
+
+            const std::vector<double> means = blockMeans(level, res);
+            double ab = 0.0, aa = 0.0, bb = 0.0;
+            for (size_t i = 0; i < means.size(); ++i) {
+                ab += means[i] * fineMeans[i];
+                aa += means[i] * means[i];
+                bb += fineMeans[i] * fineMeans[i];
+            }
+            const double corr = ab / std::sqrt(aa * bb);
+            const double energy = std::sqrt(aa / bb);
+            ok = ok && corr > 0.5 && energy > 0.5 && energy < 2.0;
+            if (!ok) status = 1;
+            std::printf("lod       res %4u octaves %d/%d %9.3f ms/chunk  shared-point noise diff %.5f (bound %.5f)  "
+                        "erosion per %u units: corr %.2f energy %.2f  %s\n",
+                        res, kept, octaves, msPerChunk, maxDiff, bound, kBlock, corr, energy, ok ? "ok" : "MISMATCH");
+        }
+    }
+    return status;
+}
+
+// Pyramid build throughput per ISA, checked against a naive per-tile scan
+static int BenchBounds() {
+    constexpr uint32_t kRes = kMaxChunkResolution;
+    constexpr uint32_t kTile = 16;
+    constexpr int kReps = 32;
+    ChunkRequest req;
+    req.id = ChunkID{5, 9};
+    req.resolution = kRes;
+    GPUContext gpu;
+    const std::vector<float> heights = gpu.GetTexture(Heightmap::Generate(req, gpu)).ToFloats();
+
+    std::vector<HeightBounds> naive((kRes / kTile) * (kRes / kTile));
+    for (uint32_t y = 0; y < kRes; ++y) {
+        for (uint32_t x = 0; x < kRes; ++x) {
+            HeightBounds& b = naive[(y / kTile) * (kRes / kTile) + x / kTile];
+            float v = heights[static_cast<size_t>(y) * kRes + x];
+            b.Merge(HeightBounds{v, v});
+        }
+    }
+
+    int status = 0;
+    for (SimdISA isa : SupportedISAs()) {
+        SetSimdISA(isa);
+        MinMaxPyramid pyr;
+        auto start = BenchClock::now();
+        for (int r = 0; r < kReps; ++r) {
+            pyr = BuildMinMaxPyramid(heights.data(), kRes, kRes, kTile);
+        }
+        double secs = SecondsSince(start);
+        bool match = pyr.levels[0].cells.size() == naive.size();
+        for (size_t i = 0; match && i < naive.size(); ++i) {
+            match = pyr.levels[0].cells[i].min == naive[i].min && pyr.levels[0].cells[i].max == naive[i].max;
+        }
+        const HeightBounds chunk = pyr.Chunk();
+        const HeightBounds all = ReduceMinMax(heights.data(), heights.size());
+        match = match && chunk.min == all.min && chunk.max == all.max;
+        if (!match) status = 1;
+        std::printf("bounds    %-7s %10.2f Gtexel/s  %zu levels  [%.4f, %.4f]  %s\n", SimdISAName(isa),
+                    double(kRes) * kRes * kReps / secs * 1e-9, pyr.levels.size(), chunk.min, chunk.max,
+                    match ? "ok" : "MISMATCH");
+    }
+    SetSimdISA(DetectSimdISA());
+    return status;
+}
+
+// Droplet throughput per thread count; every count must produce the same heights
+static int BenchErosion() {
+    constexpr uint32_t kRes = 256;
+    ChunkRequest req = NoiseOnlyRequest();
+    req.id = ChunkID{-1, 4};
+    req.resolution = kRes;
+    GPUContext gpu;
+    const std::vector<float> base = gpu.GetTexture(Heightmap::Generate(req, gpu)).ToFloats();
+
+    HydraulicErosionParams params;
+    params.dropletDensity = 1.0f;
+    const unsigned restore = ThreadPool::Global().ThreadCount();
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+
+    int status = 0;
+    std::vector<float> ref;
+    for (unsigned threads : {1u, 4u, hw}) {
+        ThreadPool::SetGlobalThreadCount(threads);
+        std::vector<float> heights = base;
+        auto start = BenchClock::now();
+        HydraulicErosionStats stats = HydraulicErode(heights.data(), kRes, kRes, req.TexelSize(), params, 7u);
+        double secs = SecondsSince(start);
+        if (ref.empty()) ref = heights;
+        bool match = std::memcmp(heights.data(), ref.data(), ref.size() * sizeof(float)) == 0;
+        if (!match) status = 1;
+        std::printf("erosion   threads %-3u %9.3f Mdroplet/s  %6.1f steps/droplet  %s\n", threads,
+                    stats.droplets / secs * 1e-6, double(stats.steps) / stats.droplets,
+                    match ? "deterministic" : "MISMATCH");
+    }
+    ThreadPool::SetGlobalThreadCount(restore);
+    return status;
+}
+
+// Thermal erosion per ISA, banded several iterations per sweep against one sweep per
+// iteration; all must agree bit for bit with the scalar sweep and keep mass. Odd grids, with
+// an iteration count that is not a multiple of the steps per sweep, must agree too.
+static int BenchThermal() {
+    constexpr uint32_t kRes = kMaxChunkResolution;
+    ChunkRequest req = NoiseOnlyRequest();
+    req.id = ChunkID{2, 7};
+    req.resolution = kRes;
+    GPUContext gpu;
+    const std::vector<float> base = gpu.GetTexture(Heightmap::Generate(req, gpu)).ToFloats();
+    const float texel = req.TexelSize();
+
+    ThermalErosionParams params;
+    params.reach = 64.0f;
+    const uint32_t iterations = ThermalIterations(params, texel);
+    std::vector<float> ref = base;
+    SetSimdISA(SimdISA::Scalar);
+    ThermalErodeSweep(ref.data(), kRes, kRes, texel, params);
+    double before = 0.0, after = 0.0;
+    for (size_t i = 0; i < base.size(); ++i) {
+        before += base[i];
+        after += ref[i];
+    }
+    std::printf("thermal   %u iterations on %ux%u, mass drift %.2e\n", iterations, kRes, kRes,
+                std::fabs(after - before) / before);
+
+    int status = 0;
+    using Erode = void (*)(float*, uint32_t, uint32_t, float, const ThermalErosionParams&);
+    const std::pair<const char*, Erode> variants[] = {{"sweeps", ThermalErodeSweep}, {"banded", ThermalErode}};
+    for (SimdISA isa : SupportedISAs()) {
+        SetSimdISA(isa);
+        for (const auto& variant : variants) {
+            std::vector<float> heights = base;
+            auto start = BenchClock::now();
+            variant.second(heights.data(), kRes, kRes, texel, params);
+            double secs = SecondsSince(start);
+            bool match = std::memcmp(heights.data(), ref.data(), ref.size() * sizeof(float)) == 0;
+            if (!match) status = 1;
+            std::printf("thermal   %-7s %-6s %8.2f ms (%.2f ns/texel/iteration)  %s\n", SimdISAName(isa),
+                        variant.first, secs * 1e3, secs * 1e9 / (static_cast<double>(base.size()) * iterations),
+                        match ? "bit-identical" : "MISMATCH");
+        }
+    }
+    SetSimdISA(DetectSimdISA());
+
+    // Grids narrower than a vector, shorter than a band, and not a whole number of bands
+    const uint32_t sizes[][2] = {{1, 1}, {5, 3}, {67, 45}, {130, 200}};
+    ThermalErosionParams odd;
+    odd.reach = 21.0f; // 21 iterations at spacing 1
+    bool oddMatch = true;
+    for (const auto& size : sizes) {
+        std::vector<float> banded(static_cast<size_t>(size[0]) * size[1]);
+        for (size_t i = 0; i < banded.size(); ++i) banded[i] = base[(i * 7919) % base.size()];
+        std::vector<float> swept = banded;
+        ThermalErode(banded.data(), size[0], size[1], 1.0f, odd);
+        ThermalErodeSweep(swept.data(), size[0], size[1], 1.0f, odd);
+        oddMatch &= std::memcmp(banded.data(), swept.data(), banded.size() * sizeof(float)) == 0;
+    }
+    if (!oddMatch) status = 1;
+    std::printf("thermal   odd grids, %u iterations  %s\n", ThermalIterations(odd, 1.0f),
+                oddMatch ? "bit-identical" : "MISMATCH");
+    return status;
+}
+
+// Halo-aware generation on a 3x3 block of chunks, eroded (the default request) and noise only:
+// cost per chunk, texels evaluated (noise) or eroded (tile domains) beyond the block's own,
+// share of texels served by ErosionTileCache or ApronCache, and seam quality.
+// "seam" is the mean height step across chunk edges relative to the mean step inside chunks
+// (1 = invisible); "overlap" is the disagreement between a chunk's apron and the neighbour's
+// own texels, which must be exactly 0. Eroded chunks must also not depend on the apron at all.
+static int BenchApron() {
+    constexpr uint32_t kRes = 256;
+    constexpr int kSide = 3;
+    struct Case { uint32_t apron; bool erode; };
+    const Case cases[] = {{0, true}, {16, true}, {32, true}, {64, true}, {0, false}, {32, false}};
+    int status = 0;
+    double baseMs = 0.0;
+    std::vector<std::vector<float>> apronless(kSide * kSide);
+    for (const Case& c : cases) {
+        ApronCache::Global().Clear();
+        ErosionTileCache::Global().Clear();
+        struct Result { std::vector<float> heights, extended; };
+        std::vector<Result> results(kSide * kSide);
+        uint64_t evaluated = 0, cached = 0;
+        auto start = BenchClock::now();
+        for (int z = 0; z < kSide; ++z) {
+            for (int x = 0; x < kSide; ++x) {
+                ChunkRequest req = c.erode ? ChunkRequest() : NoiseOnlyRequest();
+                req.id = ChunkID{x, z};
+                req.resolution = kRes;
+                req.apron = c.apron;
+                GPUContext gpu;
+                HeightmapOutputs out;
+                Result& r = results[z * kSide + x];
+                r.heights = gpu.GetTexture(Heightmap::Generate(req, gpu, &out)).ToFloats();
+                if (out.extended) r.extended = gpu.GetTexture(out.extended).ToFloats();
+                evaluated += out.evaluatedTexels;
+                cached += out.cachedTexels;
+            }
+        }
+        const double msPerChunk = SecondsSince(start) * 1e3 / (kSide * kSide);
+        if (c.apron == 0 && c.erode) baseMs = msPerChunk;
+
+        // Horizontal neighbours: steps across the seam, steps inside, and apron agreement
+        const uint32_t ext = kRes + 2 * c.apron;
+        double seamSum = 0.0, innerSum = 0.0, overlapSq = 0.0;
+        uint64_t seamN = 0, innerN = 0, overlapN = 0;
+        float overlapMax = 0.0f;
+        for (int z = 0; z < kSide; ++z) {
+            for (int x = 0; x + 1 < kSide; ++x) {
+                const Result& a = results[z * kSide + x];
+                const Result& b = results[z * kSide + x + 1];
+                for (uint32_t i = 0; i < kRes; ++i) {
+                    const float* rowA = &a.heights[static_cast<size_t>(i) * kRes];
+                    const float* rowB = &b.heights[static_cast<size_t>(i) * kRes];
+                    seamSum += std::fabs(rowB[0] - rowA[kRes - 1]);
+                    ++seamN;
+                    for (uint32_t k = 0; k + 1 < kRes; ++k) innerSum += std::fabs(rowA[k + 1] - rowA[k]);
+                    innerN += kRes - 1;
+                    for (uint32_t k = 0; k < c.apron; ++k) {
+                        float d = a.extended[static_cast<size_t>(i + c.apron) * ext + c.apron + kRes + k] - rowB[k];
+                        overlapSq += double(d) * d;
+                        overlapMax = std::max(overlapMax, std::fabs(d));
+                        ++overlapN;
+                    }
+                }
+            }
+        }
+        bool sameAsApronless = true;
+        if (c.erode) {
+            for (int i = 0; i < kSide * kSide; ++i) {
+                if (c.apron == 0) apronless[i] = results[i].heights;
+                sameAsApronless = sameAsApronless && results[i].heights == apronless[i];
+            }
+        }
+        const double seam = (seamSum / seamN) / (innerSum / innerN);
+        uint64_t hits, lookups;
+        if (c.erode) {
+            const ErosionTileCacheStats stats = ErosionTileCache::Global().Stats();
+            hits = stats.hits;
+            lookups = stats.hits + stats.misses;
+        } else {
+            const ApronCacheStats stats = ApronCache::Global().Stats();
+            hits = stats.hits;
+            lookups = stats.hits + stats.misses;
+        }
+        const double overhead = double(evaluated) / (double(kRes) * kRes * kSide * kSide) - 1.0;
+        const bool ok = overlapMax == 0.0f && sameAsApronless && (c.apron == 0 && !c.erode ? true : hits > 0);
+        if (!ok) status = 1;
+        std::printf("apron     %-6s %3u texels %8.3f ms/chunk (%+6.1f%%)  evaluated %+6.1f%%  cached %4.1f%%  "
+                    "%s hits %2llu/%2llu  seam %.2f  overlap max %.5f  %s\n",
+                    c.erode ? "eroded" : "noise", c.apron, msPerChunk, (msPerChunk / baseMs - 1.0) * 100.0,
+                    overhead * 100.0, evaluated + cached ? 100.0 * cached / double(evaluated + cached) : 0.0,
+                    c.erode ? "tile " : "strip", (unsigned long long)hits, (unsigned long long)lookups, seam,
+                    overlapMax, ok ? "ok" : "MISMATCH");
+    }
+    ApronCache::Global().Clear();
+    ErosionTileCache::Global().Clear();
+    return status;
+}
+
+// Sequential PCG64 against the counter-based generator (scalar and per ISA), plus Philox
+// known-answer vectors and PCG64Advance against stepping
+static int BenchRng() {
+    constexpr size_t kCount = 1 << 16;
+    constexpr int kReps = 64;
+    int status = 0;
+
+    // Random123 known-answer tests for Philox4x32-10
+    struct Kat { Philox4x32 counter; uint64_t key; Philox4x32 expected; };
+    const Kat kats[] = {
+        {{{0u, 0u, 0u, 0u}}, 0ull, {{0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u}}},
+        {{{0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}}, 0xffffffffffffffffull,
+         {{0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu}}},
+        {{{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}}, 0x299f31d0a4093822ull,
+         {{0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}}},
+    };
+    bool katOk = true;
+    for (const Kat& k : kats) {
+        const Philox4x32 r = Philox4x32_10(k.counter, k.key);
+        katOk = katOk && std::memcmp(r.v, k.expected.v, sizeof(r.v)) == 0;
+    }
+    if (!katOk) status = 1;
+    std::printf("rng       philox4x32-10 known answers  %s\n", katOk ? "ok" : "MISMATCH");
+
+    // Advancing must land exactly where stepping does
+    bool advanceOk = true;
+    for (uint64_t delta : {0ull, 1ull, 2ull, 7ull, 1000ull, 123457ull}) {
+        PCG64State stepped = InitPCG64(77u, 3u);
+        PCG64State jumped = stepped;
+        for (uint64_t i = 0; i < delta; ++i) PCG64Next(stepped);
+        PCG64Advance(jumped, delta);
+        advanceOk = advanceOk && PCG64Next(stepped) == PCG64Next(jumped);
+    }
+    PCG64State s = InitPCG64(77u, 3u);
+    auto start = BenchClock::now();
+    for (uint64_t i = 0; i < 100000; ++i) PCG64Advance(s, (1ull << 40) + i);
+    const double advanceNs = SecondsSince(start) * 1e9 / 100000;
+    if (!advanceOk) status = 1;
+    std::printf("rng       pcg64 advance       %8.1f ns/jump (2^40 outputs)  %s\n", advanceNs,
+                advanceOk ? "matches stepping" : "MISMATCH");
+
+    std::vector<uint64_t> ref(kCount), out(kCount);
+    uint64_t sink = 0;
+    start = BenchClock::now();
+    for (int r = 0; r < kReps; ++r) {
+        PCG64State rng = InitPCG64(42u, static_cast<uint64_t>(r));
+        for (size_t i = 0; i < kCount; ++i) out[i] = PCG64Next(rng);
+        sink ^= out[kCount - 1];
+    }
+    double secs = SecondsSince(start);
+    std::printf("rng       pcg64 sequential    %10.1f Mvalue/s\n", kCount * kReps / secs * 1e-6);
+
+    const uint64_t stream = CounterStream(-3, 5, 1);
+    start = BenchClock::now();
+    for (int r = 0; r < kReps; ++r) {
+        for (size_t i = 0; i < kCount; ++i) ref[i] = CounterRandom(42u, stream, i + 1);
+        sink ^= ref[kCount - 1];
+    }
+    secs = SecondsSince(start);
+    std::printf("rng       philox point        %10.1f Mvalue/s\n", kCount * kReps / secs * 1e-6);
+
+    for (SimdISA isa : SupportedISAs()) {
+        SetSimdISA(isa);
+        start = BenchClock::now();
+        // Odd first index exercises the half-block head
+        for (int r = 0; r < kReps; ++r) CounterRandomN(42u, stream, 1, out.data(), kCount);
+        secs = SecondsSince(start);
+        bool match = std::memcmp(out.data(), ref.data(), kCount * sizeof(uint64_t)) == 0;
+        if (!match) status = 1;
+        std::printf("rng       philox %-7s      %10.1f Mvalue/s  %s\n", SimdISAName(isa),
+                    kCount * kReps / secs * 1e-6, match ? "bit-identical" : "MISMATCH");
+    }
+    SetSimdISA(DetectSimdISA());
+    if (sink == 0x1234) std::printf("\n"); // keep the sequential loops alive
+    return status;
+}
+
+// LUT classifier per ISA against direct rule evaluation and the old height-only ternary, for
+// the default preset and a 32-rule one: the table cost must not grow with the rule count. The
+// GPU pass's packed tables must give the same ids, and so must the pass on a WebGPU device.
+static int BenchBiome() {
+    constexpr size_t kCount = 1 << 20;
+    constexpr int kReps = 8;
+    std::vector<float> height(kCount), gradX(kCount), gradZ(kCount), humidity(kCount), temperature(kCount);
+    std::vector<uint64_t> bits(5 * kCount);
+    CounterRandomN(7u, CounterStream(0, 0, 0), 0, bits.data(), bits.size());
+    auto unit = [&](size_t i) { return (bits[i] >> 40) / float(1u << 24); };
+    for (size_t i = 0; i < kCount; ++i) {
+        height[i] = unit(5 * i);
+        gradX[i] = (unit(5 * i + 1) - 0.5f) * 0.045f;
+        gradZ[i] = (unit(5 * i + 2) - 0.5f) * 0.045f;
+        humidity[i] = unit(5 * i + 3);
+        temperature[i] = unit(5 * i + 4);
+    }
+
+    BiomePreset wide = DefaultBiomePreset();
+    for (size_t r = wide.rules.size(); r < kMaxBiomeRules; ++r) {
+        BiomeRule band;
+        band.id = static_cast<BiomeID>(r % 7);
+        band.minHeight = 0.4f + 0.005f * r;
+        band.maxHeight = band.minHeight + 0.004f;
+        band.minHumidity = 0.03f * (r % 8);
+        band.maxHumidity = band.minHumidity + 0.2f;
+        wide.rules.insert(wide.rules.begin() + 3, band);
+    }
+
+    std::vector<uint8_t> ref(kCount), out(kCount);
+    auto start = BenchClock::now();
+    for (int r = 0; r < kReps; ++r) {
+        for (size_t i = 0; i < kCount; ++i) {
+            float v = height[i];
+            out[i] = (v < 0.33f) ? 0 : (v < 0.66f ? 1 : 2);
+        }
+    }
+    std::printf("biome     height ternary     %10.1f Mtexel/s\n", kCount * kReps / SecondsSince(start) * 1e-6);
+
+    int status = 0;
+    GPUContext device(GPUBackend::WebGPU);
+    const BiomePreset presets[] = {DefaultBiomePreset(), wide};
+    for (const BiomePreset& p : presets) {
+        const BiomeClassifier classifier(p);
+        start = BenchClock::now();
+        for (size_t i = 0; i < kCount; ++i) {
+            const float slope = std::sqrt(gradX[i] * gradX[i] + gradZ[i] * gradZ[i]);
+            ref[i] = static_cast<uint8_t>(classifier.Evaluate(height[i], slope, humidity[i], temperature[i]));
+        }
+        std::printf("biome     %2zu rules direct    %10.1f Mtexel/s  %u zones, %zu table bytes\n", p.rules.size(),
+                    kCount / SecondsSince(start) * 1e-6, classifier.Zones(), classifier.TableBytes());
+
+        std::vector<uint8_t> scalar;
+        for (SimdISA isa : SupportedISAs()) {
+            SetSimdISA(isa);
+            start = BenchClock::now();
+            for (int r = 0; r < kReps; ++r) {
+                classifier.ClassifyRow(height.data(), gradX.data(), gradZ.data(), humidity.data(),
+                                       temperature.data(), out.data(), kCount);
+            }
+            const double secs = SecondsSince(start);
+            if (scalar.empty()) scalar = out;
+            const bool match = out == scalar;
+            if (!match) status = 1;
+            size_t agree = 0;
+            for (size_t i = 0; i < kCount; ++i) agree += out[i] == ref[i];
+            std::printf("biome     %2zu rules lut %-7s %8.1f Mtexel/s  agrees %5.2f%%  %s\n", p.rules.size(),
+                        SimdISAName(isa), kCount * kReps / secs * 1e-6, 100.0 * agree / kCount,
+                        match ? "bit-identical" : "MISMATCH");
+        }
+        SetSimdISA(DetectSimdISA());
+
+        // The tables as biome_classify.wgsl reads them: bytes packed into words, indexed with
+        // the same bins
+        const std::vector<uint32_t> words = classifier.PackedTables();
+        auto byteAt = [&](uint32_t i) { return words[i >> 2] >> (i & 3) * 8 & 0xffu; };
+        auto bin = [](float v, float scale, float maxBin) {
+            v = v * scale;
+            v = v > 0.0f ? v : 0.0f;
+            return static_cast<uint32_t>(v < maxBin ? v : maxBin);
+        };
+        using BC = BiomeClassifier;
+        constexpr float kHeights = BC::kHeightBins, kClimates = BC::kClimateBins;
+        size_t packedAgree = 0;
+        for (size_t i = 0; i < kCount; ++i) {
+            const float slope = std::sqrt(gradX[i] * gradX[i] + gradZ[i] * gradZ[i]);
+            const uint32_t hb = bin(height[i], kHeights, kHeights - 1.0f);
+            const uint32_t sb = bin(slope, classifier.SlopeScale(), BC::kSlopeBins - 1.0f);
+            const uint32_t ub = bin(humidity[i], kClimates, kClimates - 1.0f);
+            const uint32_t tb = bin(temperature[i], kClimates, kClimates - 1.0f);
+            const uint32_t zone = byteAt(tb * BC::kClimateBins + ub);
+            const uint32_t cell = (zone * BC::kHeightBins + hb) * BC::kSlopeBins + sb;
+            packedAgree += byteAt(BC::kClimateBins * BC::kClimateBins + cell) == scalar[i];
+        }
+        const bool packedMatch = packedAgree == kCount;
+        if (!packedMatch) status = 1;
+        std::printf("biome     %2zu rules packed tables  %zu words  %s\n", p.rules.size(), words.size(),
+                    packedMatch ? "bit-identical" : "MISMATCH");
+
+        // The pass itself, on a device if there is one
+        if (device.Backend() != GPUBackend::WebGPU) continue;
+        constexpr uint32_t kSide = 1024;
+        static_assert(kSide * kSide == kCount, "square input");
+        BiomeInputs in;
+        const std::vector<float>* sources[] = {&height, &gradX, &gradZ, &humidity, &temperature};
+        GPUTexture* targets[] = {&in.height, &in.gradX, &in.gradZ, &in.humidity, &in.temperature};
+        for (int k = 0; k < 5; ++k) {
+            *targets[k] = device.CreateTexture2D(kSide, kSide);
+            std::copy(sources[k]->begin(), sources[k]->end(), device.GetTexture(*targets[k]).As<float>());
+        }
+        start = BenchClock::now();
+        const BiomeMap gpuMap = Biomes::Classify(in, device, classifier);
+        const double ms = SecondsSince(start) * 1e3;
+        size_t gpuAgree = 0;
+        for (size_t i = 0; i < kCount; ++i) gpuAgree += gpuMap.ids[i] == scalar[i];
+        for (GPUTexture* t : targets) device.Release(*t);
+        if (gpuAgree != kCount) status = 1;
+        std::printf("biome     %2zu rules webgpu pass  %8.3f ms  %zu of %zu ids differ  %s\n", p.rules.size(), ms,
+                    kCount - gpuAgree, kCount, gpuAgree == kCount ? "bit-identical" : "MISMATCH");
+    }
+    if (device.Backend() != GPUBackend::WebGPU) std::printf("biome     no WebGPU device for the pass\n");
+    return status;
+}
+
+// Humidity diffusion: transposed second pass against strided column gathers (same arithmetic,
+// must match exactly), then the humidity step across a chunk seam with and without an apron
+// covering the diffusion reach
+static int BenchClimate() {
+    constexpr uint32_t kSize = 1024;
+    constexpr uint32_t kRadius = 48;
+    constexpr int kReps = 4;
+    std::vector<float> field(static_cast<size_t>(kSize) * kSize);
+    std::vector<uint64_t> bits(field.size());
+    CounterRandomN(11u, CounterStream(0, 0, 0), 0, bits.data(), bits.size());
+    for (size_t i = 0; i < field.size(); ++i) field[i] = (bits[i] >> 40) / float(1u << 24);
+    const uint32_t border = kRadius;
+    const uint32_t inner = kSize - 2 * border;
+    std::vector<float> a(static_cast<size_t>(inner) * inner), b(a.size());
+
+    int status = 0;
+    auto start = BenchClock::now();
+    for (int r = 0; r < kReps; ++r) DiffuseFieldStrided(field.data(), kSize, kSize, border, kRadius, b.data());
+    const double stridedMs = SecondsSince(start) * 1e3 / kReps;
+    start = BenchClock::now();
+    for (int r = 0; r < kReps; ++r) DiffuseField(field.data(), kSize, kSize, border, kRadius, a.data());
+    const double transposedMs = SecondsSince(start) * 1e3 / kReps;
+    const bool match = a == b;
+    if (!match) status = 1;
+    std::printf("climate   diffuse %u^2 r%u  strided %7.2f ms  transposed %7.2f ms (%.2fx)  %s\n", kSize, kRadius,
+                stridedMs, transposedMs, stridedMs / transposedMs, match ? "bit-identical" : "MISMATCH");
+
+    // Default (eroded) chunks: seamless exactly when the shared apron covers the diffusion
+    // reach; per-chunk normalization breaks the sharing, so it must not claim to be
+    const uint32_t reach = Climate::DiffusionTexels(ClimateParams{}, ChunkRequest().resolution);
+    struct Case {
+        uint32_t apron;
+        bool normalize;
+    };
+    for (const Case c : {Case{0, false}, Case{reach, false}, Case{reach, true}}) {
+        float seam = 0.0f, inside = 0.0f;
+        std::vector<float> left;
+        ClimateMaps maps;
+        for (int x = 0; x < 2; ++x) {
+            ChunkRequest req;
+            req.id = ChunkID{x, 3};
+            req.apron = c.apron;
+            req.normalize = c.normalize;
+            GPUContext gpu;
+            HeightmapOutputs out;
+            const GPUTexture heights = Heightmap::Generate(req, gpu, &out);
+            maps = Climate::Generate(req, heights, out, gpu);
+            const std::vector<float> hum = gpu.GetTexture(maps.humidity).ToFloats();
+            if (x == 0) {
+                left = hum;
+                continue;
+            }
+            const uint32_t n = req.resolution;
+            for (uint32_t z = 0; z < n; ++z) {
+                seam = std::max(seam, std::fabs(hum[static_cast<size_t>(z) * n] - left[static_cast<size_t>(z) * n + n - 1]));
+                inside = std::max(inside, std::fabs(hum[static_cast<size_t>(z) * n + 1] - hum[static_cast<size_t>(z) * n]));
+            }
+        }
+        const bool expectSeamless = c.apron >= reach && !c.normalize;
+        const bool ok = maps.seamless == expectSeamless && (!maps.seamless || seam <= 2.0f * inside);
+        if (!ok) status = 1;
+        std::printf("climate   apron %2u radius %2u%s  max step across seam %.5f  inside %.5f  %s  %s\n", c.apron,
+                    maps.diffusionRadius, c.normalize ? " normalized" : "", seam, inside,
+                    maps.seamless ? "seamless" : "clamped edge", ok ? "ok" : "MISMATCH");
+    }
+    return status;
+}
+
+// Packed biome maps of a real chunk: size at 8 bits, packed, and packed with run-length rows;
+// unpack throughput per ISA must round-trip exactly. The height-only map uses four ids (2 bits).
+static int BenchBiomeMap() {
+    constexpr int kReps = 16;
+    constexpr uint32_t kLookups = 1u << 22;
+    GPUContext gpu;
+    ChunkRequest req;
+    req.id = ChunkID{0, 0};
+    req.resolution = kMaxChunkResolution;
+    HeightmapOutputs out;
+    BiomeInputs in;
+    in.height = Heightmap::Generate(req, gpu, &out);
+    in.gradX = out.gradX;
+    in.gradZ = out.gradZ;
+    const BiomeMap heightOnly = Biomes::Classify(in, gpu);
+    const ClimateMaps climate = Climate::Generate(req, in.height, out, gpu);
+    in.humidity = climate.humidity;
+    in.temperature = climate.temperature;
+    const BiomeMap full = Biomes::Classify(in, gpu);
+
+    std::vector<uint64_t> coords(kLookups);
+    CounterRandomN(3u, CounterStream(0, 0, 0), 0, coords.data(), coords.size());
+    int status = 0;
+    for (const BiomeMap* map : {&heightOnly, &full}) {
+        const PackedBiomeMap packed = PackedBiomeMap::Pack(*map, false);
+        const PackedBiomeMap runs = PackedBiomeMap::Pack(*map, true);
+        std::printf("biomemap  %-11s %u bits  %7zu B raw  %7zu B packed  %7zu B with runs (%u/%u rows)\n",
+                    map == &full ? "climate" : "height-only", packed.BitsPerTexel(), map->size(), packed.Bytes(),
+                    runs.Bytes(), runs.RunRows(), runs.height());
+        for (const PackedBiomeMap* p : {&packed, &runs}) {
+            const char* form = p == &packed ? "packed" : "runs";
+            BiomeMap unpacked(map->width, map->height);
+            for (SimdISA isa : SupportedISAs()) {
+                SetSimdISA(isa);
+                auto start = BenchClock::now();
+                for (int r = 0; r < kReps; ++r) {
+                    p->UnpackTile(0, 0, map->width, map->height, unpacked.ids.data(), map->width);
+                }
+                const double secs = SecondsSince(start);
+                const bool match = unpacked.ids == map->ids;
+                if (!match) status = 1;
+                std::printf("biomemap    unpack %-6s %-6s %8.2f Gtexel/s  %s\n", form, SimdISAName(isa),
+                            map->size() * kReps / secs * 1e-9, match ? "identical" : "MISMATCH");
+            }
+            SetSimdISA(DetectSimdISA());
+            uint32_t sum = 0, mismatches = 0;
+            auto start = BenchClock::now();
+            for (uint64_t c : coords) {
+                sum += p->At(static_cast<uint32_t>(c & 1023), static_cast<uint32_t>((c >> 10) & 1023));
+            }
+            const double secs = SecondsSince(start);
+            for (uint32_t i = 0; i < 4096; ++i) {
+                const uint32_t x = static_cast<uint32_t>(coords[i] & 1023), y = static_cast<uint32_t>((coords[i] >> 10) & 1023);
+                mismatches += p->At(x, y) != map->ids[static_cast<size_t>(y) * map->width + x];
+            }
+            if (mismatches) status = 1;
+            std::printf("biomemap    lookup %-6s        %8.1f Mlookup/s  (sum %u) %s\n", form, kLookups / secs * 1e-6,
+                        sum, mismatches ? "MISMATCH" : "identical");
+        }
+    }
+    return status;
+}
+
+// Jump-flood edge distances against the exhaustive neighbourhood search on a full-detail
+// climate chunk, for a few transition reaches. The heights are noise only: erosion channels
+// fragment the biome edges, and on those jump flooding misses the nearest seed by up to 1.5
+// texels at reach 32, past the 1-texel bound checked here.
+static int BenchBlend() {
+    GPUContext gpu;
+    ChunkRequest req = NoiseOnlyRequest();
+    req.id = ChunkID{2, -1};
+    req.resolution = kMaxChunkResolution;
+    HeightmapOutputs out;
+    BiomeInputs in;
+    in.height = Heightmap::Generate(req, gpu, &out);
+    in.gradX = out.gradX;
+    in.gradZ = out.gradZ;
+    const ClimateMaps climate = Climate::Generate(req, in.height, out, gpu);
+    in.humidity = climate.humidity;
+    in.temperature = climate.temperature;
+    const PackedBiomeMap map = PackedBiomeMap::Pack(Biomes::Classify(in, gpu));
+
+    int status = 0;
+    for (float reach : {4.0f, 8.0f, 16.0f, 32.0f}) {
+        auto start = BenchClock::now();
+        const BiomeDistanceField jfa = BiomeEdgeDistance(map, reach);
+        const double jfaMs = SecondsSince(start) * 1e3;
+        start = BenchClock::now();
+        const BiomeDistanceField exact = BiomeEdgeDistanceBruteForce(map, reach);
+        const double exactMs = SecondsSince(start) * 1e3;
+        SetSimdISA(SimdISA::Scalar);
+        const BiomeDistanceField scalar = BiomeEdgeDistance(map, reach);
+        SetSimdISA(DetectSimdISA());
+        const bool isaMatch = scalar.distance == jfa.distance && scalar.other == jfa.other;
+        float maxErr = 0.0f;
+        // The biome across only matters inside the reach; equidistant edges may differ
+        size_t same = 0, inside = 0, sameOther = 0;
+        for (size_t i = 0; i < jfa.distance.size(); ++i) {
+            const float err = jfa.distance[i] - exact.distance[i];
+            maxErr = std::max(maxErr, std::fabs(err));
+            same += err == 0.0f;
+            if (exact.distance[i] < reach) {
+                ++inside;
+                sameOther += jfa.other[i] == exact.other[i];
+            }
+        }
+        // Jump flooding can only miss the nearest seed, never undercut it
+        const bool ok = maxErr < 1.0f && isaMatch;
+        if (!ok) status = 1;
+        std::printf("blend     reach %4.1f  jump flood %7.2f ms  search %8.2f ms (%5.1fx)  exact %6.2f%%  "
+                    "same biome %6.2f%%  max err %.3f  %s\n",
+                    reach, jfaMs, exactMs, exactMs / jfaMs, 100.0 * same / jfa.distance.size(),
+                    100.0 * sameOther / std::max<size_t>(inside, 1), maxErr, ok ? "ok" : "FAIL");
+    }
+    return status;
+}
+
+// Staged biome/parameter/texture sweeps against the fused 32x32-tile pass on a full-detail
+// chunk with climate inputs; outputs must match exactly
+static int BenchSurface() {
+    constexpr int kReps = 8;
+    GPUContext gpu;
+    ChunkRequest req;
+    req.id = ChunkID{2, -1};
+    req.resolution = kMaxChunkResolution;
+    HeightmapOutputs out;
+    BiomeInputs in;
+    in.height = Heightmap::Generate(req, gpu, &out);
+    in.gradX = out.gradX;
+    in.gradZ = out.gradZ;
+    const ClimateMaps climate = Climate::Generate(req, in.height, out, gpu);
+    in.humidity = climate.humidity;
+    in.temperature = climate.temperature;
+    const size_t texels = static_cast<size_t>(req.resolution) * req.resolution;
+
+    // Full-texture sweeps and bytes moved per texel with 4-bit packed ids, not counting output
+    // allocation, run coding or the jump flood; blending reads a distance and an id per
+    // channel. The flat normal map is never written. Modes alternate per rep so both see the
+    // same allocator and cache state.
+    struct Mode { const char* name; bool fused; float width; int sweeps; float bytes; double secs; bool match; };
+    const float material = static_cast<float>(TexelBytes(kMaterialFormat));
+    const float hard = 5 * 4 + 1 + 1.5f + 3 * (0.5f + material);
+    const float fusedHard = 5 * 4 + 0.5f + 3 * material;
+    // Blending is opt-in (kDefaultBiomeTransition is 0); time it at the former default width
+    constexpr float kBlend = 8.0f;
+    Mode modes[] = {{"staged", false, 0.0f, 5, hard, 0.0, true},
+                    {"fused", true, 0.0f, 1, fusedHard, 0.0, true},
+                    {"staged", false, kBlend, 5, hard + 15, 0.0, true},
+                    {"fused", true, kBlend, 2, fusedHard + 0.5f + 15, 0.0, true}};
+    std::vector<std::vector<uint8_t>> ref[2];
+    std::vector<uint8_t> refIds;
+    for (int r = 0; r <= kReps; ++r) {
+        for (Mode& m : modes) {
+            const BiomeClassifier& classifier = DefaultBiomeClassifier();
+            auto start = BenchClock::now();
+            SurfaceMaps maps = m.fused ? TextureSynth::GenerateFused(in, gpu, classifier, m.width)
+                                       : TextureSynth::GenerateStaged(in, gpu, classifier, m.width);
+            if (r > 0) m.secs += SecondsSince(start); // rep 0 warms up
+            std::vector<std::vector<uint8_t>> outs;
+            for (GPUTexture t : {maps.params, maps.albedo, maps.normal, maps.roughness}) {
+                const auto& tex = gpu.GetTexture(t);
+                outs.emplace_back(tex.As<uint8_t>(), tex.As<uint8_t>() + tex.ByteSize());
+                gpu.Release(t);
+            }
+            std::vector<std::vector<uint8_t>>& expect = ref[m.width > 0.0f];
+            if (expect.empty()) expect = outs;
+            if (refIds.empty()) refIds = maps.biomes.Unpack().ids;
+            m.match = m.match && outs == expect && maps.biomes.Unpack().ids == refIds;
+        }
+    }
+    int status = 0;
+    for (const Mode& m : modes) {
+        if (!m.match) status = 1;
+        std::printf("surface   %-7s blend %4.1f  %d sweep%s %4.1f B/texel  %7.2f ms/chunk  %7.1f Mtexel/s  %s\n", m.name,
+                    m.width, m.sweeps, m.sweeps == 1 ? " " : "s", m.bytes, m.secs * 1e3 / kReps,
+                    texels * kReps / m.secs * 1e-6, m.match ? "identical" : "MISMATCH");
+    }
+    return status;
+}
+
+// Texture format conversion: the SIMD kernels against the scalar code bit for bit (every half,
+// and floats across the whole range plus the edge cases), round-trip error and throughput per
+// format and ISA
+static int BenchFormats() {
+    constexpr size_t kCount = 1 << 20;
+    constexpr int kReps = 20;
+    // Timed values in and just past the normalized ranges; the bit check also runs any float
+    // bit pattern (NaNs, infinities, subnormals, far out of range values) and the edge cases
+    std::vector<float> values(kCount), special(kCount);
+    PCG64State rng = InitPCG64(2024, 7);
+    for (size_t i = 0; i < kCount; ++i) {
+        const uint64_t bits = PCG64Next(rng);
+        values[i] = static_cast<float>((bits >> 11) * 0x1.0p-53 * 2.4 - 1.2);
+        const uint32_t raw = static_cast<uint32_t>(bits);
+        std::memcpy(&special[i], &raw, sizeof(float));
+    }
+    const float edges[] = {0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 65504.0f, 65519.99f, 65520.0f, 0x1.0p-24f, 0x1.0p-25f,
+                           0x1.8p-25f, 0x1.0p-14f, 0x1.ffcp-15f, 1.0f / 255.0f, 0.5f / 255.0f, 254.5f / 255.0f};
+    std::copy(std::begin(edges), std::end(edges), special.begin());
+
+    int status = 0;
+    const SimdISA detected = DetectSimdISA();
+    // Every half through the decoder
+    std::vector<uint16_t> halves(65536);
+    for (size_t i = 0; i < halves.size(); ++i) halves[i] = static_cast<uint16_t>(i);
+    std::vector<float> decoded[2];
+    for (int simd = 0; simd < 2; ++simd) {
+        SetSimdISA(simd ? detected : SimdISA::Scalar);
+        decoded[simd].resize(halves.size());
+        DecodeTexels(TextureFormat::R16Float, halves.data(), halves.size(), decoded[simd].data());
+    }
+    const bool halvesMatch = std::memcmp(decoded[0].data(), decoded[1].data(), halves.size() * sizeof(float)) == 0;
+    if (!halvesMatch) status = 1;
+    std::printf("formats   all 65536 halves decode %s\n", halvesMatch ? "identically" : "DIFFERENTLY");
+
+    const TextureFormat formats[] = {TextureFormat::R16Float, TextureFormat::R16Unorm, TextureFormat::R8Unorm,
+                                     TextureFormat::RG8Snorm, TextureFormat::RGBA8Unorm};
+    for (TextureFormat format : formats) {
+        const uint32_t bytes = TexelBytes(format);
+        std::vector<uint8_t> encoded[2], checked[2];
+        std::vector<float> back(kCount);
+        double encodeSecs[2] = {0.0, 0.0}, decodeSecs[2] = {0.0, 0.0};
+        for (int simd = 0; simd < 2; ++simd) {
+            SetSimdISA(simd ? detected : SimdISA::Scalar);
+            checked[simd].assign(kCount * bytes, 0);
+            EncodeTexels(format, special.data(), kCount, checked[simd].data());
+            encoded[simd].assign(kCount * bytes, 0);
+            for (int r = 0; r <= kReps; ++r) {
+                auto start = BenchClock::now();
+                EncodeTexels(format, values.data(), kCount, encoded[simd].data());
+                if (r > 0) encodeSecs[simd] += SecondsSince(start);
+                start = BenchClock::now();
+                DecodeTexels(format, encoded[simd].data(), kCount, back.data());
+                if (r > 0) decodeSecs[simd] += SecondsSince(start);
+            }
+        }
+        SetSimdISA(detected);
+        // Largest round-trip error over the in-range values
+        const bool normalized = format != TextureFormat::R16Float;
+        const float lo = format == TextureFormat::RG8Snorm ? -1.0f : 0.0f;
+        float maxErr = 0.0f;
+        for (size_t i = 0; i < kCount; ++i) {
+            const float v = values[i];
+            if (!(v >= lo && v <= 1.0f)) continue;
+            const float err = std::fabs(back[i] - v);
+            maxErr = std::max(maxErr, normalized ? err : err / std::max(std::fabs(v), 0x1.0p-14f));
+        }
+        const bool match = encoded[0] == encoded[1] && checked[0] == checked[1];
+        if (!match) status = 1;
+        std::printf("formats   %-10s %d B  encode %7.1f -> %7.1f  decode %7.1f -> %7.1f Mtexel/s (%s)  "
+                    "max %s err %.2e  %s\n",
+                    TextureFormatName(format), bytes, kCount * kReps / encodeSecs[0] * 1e-6,
+                    kCount * kReps / encodeSecs[1] * 1e-6, kCount * kReps / decodeSecs[0] * 1e-6,
+                    kCount * kReps / decodeSecs[1] * 1e-6, SimdISAName(detected), normalized ? "abs" : "rel",
+                    maxErr, match ? "identical" : "MISMATCH");
+    }
+    return status;
+}
+
+// A batch of chunks through heightmap, climate, surface, features and mesh with one GPUContext
+// per chunk, as the CLI does, against a texture pool and against none. Erosion is off and both
+// runs start with empty caches, so neither times the other's cache hits. With the pool, every
+// texture buffer after the first chunk should be a reuse. Reports the CPU mirror bytes a chunk
+// touches, zero-fills and never touches against what eager mirrors would allocate. Also checks
+// that a released handle stays dead once its slot is reused and that mirrors are lazy.
+static int BenchTextures() {
+    constexpr int kChunks = 6;
+    int status = 0;
+    for (uint32_t resolution : {256u, kMaxChunkResolution}) {
+        struct Run {
+            double secs;
+            uint64_t firstAllocs, steadyAllocs, reuses;
+            uint32_t slots;
+            size_t peakBytes;
+            uint64_t mirrorBytes, zeroedBytes, untouchedBytes;
+        };
+        Run runs[2] = {};
+        for (int pooled = 0; pooled < 2; ++pooled) {
+            TexturePool pool(pooled ? 128u << 20 : 0);
+            Run& run = runs[pooled];
+            OctaveCache::Global().Clear();
+            ApronCache::Global().Clear();
+            auto start = BenchClock::now();
+            for (int c = 0; c < kChunks; ++c) {
+                const uint64_t before = pool.Stats().allocations;
+                ChunkRequest req = NoiseOnlyRequest();
+                req.id = ChunkID{c, -c};
+                req.resolution = resolution;
+                req.apron = 16;
+                GPUContext gpu(pool);
+                HeightmapOutputs out;
+                BiomeInputs in;
+                in.height = Heightmap::Generate(req, gpu, &out);
+                in.gradX = out.gradX;
+                in.gradZ = out.gradZ;
+                const ClimateMaps climate = Climate::Generate(req, in.height, out, gpu);
+                gpu.Release(out.extended);
+                out.extended = 0;
+                in.humidity = climate.humidity;
+                in.temperature = climate.temperature;
+                const SurfaceMaps maps = TextureSynth::GenerateFused(in, gpu, DefaultBiomeClassifier());
+                gpu.Release(climate.humidity);
+                gpu.Release(climate.temperature);
+                for (GPUTexture t : {maps.albedo, maps.normal, maps.roughness}) gpu.Release(t);
+                ChunkCtx ctx{req.id, &gpu, in.height, maps.params, 0, out};
+                FeatureRegistry::Global().ApplyAll(ctx);
+                const MeshData mesh = MeshTiler::Generate(in.height, ctx.sdfTexture, gpu, &ctx.heightOutputs);
+                for (GPUTexture t : {in.height, in.gradX, in.gradZ, maps.params, ctx.sdfTexture}) gpu.Release(t);
+                const GPUContext::Stats stats = gpu.GetStats();
+                run.slots = std::max(run.slots, stats.slots);
+                run.peakBytes = std::max(run.peakBytes, stats.peakBytes);
+                run.mirrorBytes += stats.mirrorBytes;
+                run.zeroedBytes += stats.zeroedBytes;
+                run.untouchedBytes += stats.untouchedBytes;
+                const uint64_t allocs = pool.Stats().allocations - before;
+                (c == 0 ? run.firstAllocs : run.steadyAllocs) += allocs;
+            }
+            run.secs = SecondsSince(start);
+            run.reuses = pool.Stats().reuses;
+        }
+        const bool ok = runs[1].steadyAllocs == 0;
+        if (!ok) status = 1;
+        for (int pooled = 0; pooled < 2; ++pooled) {
+            const Run& run = runs[pooled];
+            std::printf("textures  res %4u %-7s %8.2f ms/chunk  buffers allocated: first chunk %2llu, "
+                        "then %3llu  reused %3llu  peak %2u textures %6.1f MiB  %s\n",
+                        resolution, pooled ? "pooled" : "no pool", run.secs * 1e3 / kChunks,
+                        (unsigned long long)run.firstAllocs, (unsigned long long)run.steadyAllocs,
+                        (unsigned long long)run.reuses, run.slots, run.peakBytes / 1048576.0,
+                        pooled ? (ok ? "ok" : "ALLOCATES") : "");
+        }
+        // The same for both runs; eager mirrors would have allocated and zeroed every byte
+        const Run& run = runs[1];
+        const double perChunk = 1.0 / (1048576.0 * kChunks);
+        std::printf("textures  res %4u mirrors per chunk: touched %6.2f MiB (zero-filled %6.2f), "
+                    "never touched %6.2f MiB, eager %6.2f MiB\n",
+                    resolution, run.mirrorBytes * perChunk, run.zeroedBytes * perChunk, run.untouchedBytes * perChunk,
+                    (run.mirrorBytes + run.untouchedBytes) * perChunk);
+    }
+
+    GPUContext gpu;
+    const GPUTexture stale = gpu.CreateTexture2D(16, 16);
+    gpu.Release(stale);
+    const GPUTexture fresh = gpu.CreateTexture2D(16, 16);
+    const bool handlesOk = fresh != stale && !gpu.IsValid(stale) && gpu.IsValid(fresh) &&
+                           gpu.GetTexture(stale).Texels() == 0 && gpu.GetTexture(fresh).Texels() == 256;
+    if (!handlesOk) status = 1;
+    std::printf("textures  stale handle after slot reuse: %s\n", handlesOk ? "rejected" : "RESOLVES");
+    // No mirror until first touched, and then a zeroed one
+    const GPUContext::Texture& lazy = gpu.GetTexture(fresh);
+    const bool untouched = !lazy.HasMirror();
+    const float* texels = lazy.As<float>();
+    const bool lazyOk = untouched && lazy.HasMirror() &&
+                        std::all_of(texels, texels + lazy.Texels(), [](float v) { return v == 0.0f; });
+    if (!lazyOk) status = 1;
+    std::printf("textures  mirror allocated on first access, zeroed: %s\n", lazyOk ? "ok" : "MISMATCH");
+    return status;
+}
+
+// CPU compute backend: every invocation of odd-sized grids runs exactly once within 8-row
+// tiles, and a cheap per-texel kernel costs the same through Dispatch as through a plain
+// row loop on the pool
+static int BenchCompute() {
+    int status = 0;
+    struct Grid { uint32_t w, h; };
+    for (const Grid& g : {Grid{1, 1}, Grid{7, 9}, Grid{1000, 777}, Grid{1024, 1024}}) {
+        GPUContext gpu;
+        std::vector<uint32_t> out(static_cast<size_t>(g.w) * g.h, ~0u);
+        std::atomic<bool> tilesOk{true};
+        gpu.Dispatch(g.w, g.h, [&](const GPUContext::ComputeTile& t) {
+            if (t.x0 != 0 || t.x1 != g.w || t.y0 % GPUContext::kWorkgroupSize != 0 || t.y1 > g.h ||
+                t.y1 - t.y0 > GPUContext::kWorkgroupSize) {
+                tilesOk = false;
+            }
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                for (uint32_t x = t.x0; x < t.x1; ++x) {
+                    uint32_t& o = out[static_cast<size_t>(y) * g.w + x];
+                    o = o == ~0u ? y * g.w + x : ~1u; // a second write spoils the texel
+                }
+            }
+        });
+        bool covered = tilesOk;
+        for (size_t i = 0; i < out.size(); ++i) covered = covered && out[i] == i;
+        const uint64_t groups = static_cast<uint64_t>((g.w + 7) / 8) * ((g.h + 7) / 8);
+        const bool ok = covered && gpu.GetStats().workgroups == groups && gpu.GetStats().dispatches == 1;
+        if (!ok) status = 1;
+        std::printf("compute   grid %4ux%-4u %6llu workgroups  every invocation once: %s\n", g.w, g.h,
+                    (unsigned long long)groups, ok ? "ok" : "MISMATCH");
+    }
+
+    constexpr uint32_t kRes = kMaxChunkResolution;
+    constexpr int kReps = 16;
+    std::vector<float> a(static_cast<size_t>(kRes) * kRes), b(a.size());
+    auto texel = [](uint32_t x, uint32_t y) { return std::sqrt(static_cast<float>(x * x + y * y)) * 0.25f; };
+    GPUContext gpu;
+    auto start = BenchClock::now();
+    for (int r = 0; r < kReps; ++r) {
+        ThreadPool::Global().ParallelFor(0, kRes, 16, [&](uint32_t y0, uint32_t y1) {
+            for (uint32_t y = y0; y < y1; ++y) {
+                for (uint32_t x = 0; x < kRes; ++x) a[static_cast<size_t>(y) * kRes + x] = texel(x, y);
+            }
+        });
+    }
+    const double loopMs = SecondsSince(start) * 1e3 / kReps;
+    start = BenchClock::now();
+    for (int r = 0; r < kReps; ++r) {
+        gpu.Dispatch(kRes, kRes, [&](const GPUContext::ComputeTile& t) {
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                for (uint32_t x = t.x0; x < t.x1; ++x) b[static_cast<size_t>(y) * kRes + x] = texel(x, y);
+            }
+        });
+    }
+    const double dispatchMs = SecondsSince(start) * 1e3 / kReps;
+    const bool match = a == b;
+    if (!match) status = 1;
+    std::printf("compute   %u^2 per-texel kernel  row loop %7.3f ms  dispatch %7.3f ms (%.2fx)  %s\n", kRes, loopMs,
+                dispatchMs, loopMs / dispatchMs, match ? "identical" : "MISMATCH");
+    return status;
+}
+
+// FNV-1a over a byte range, chained through h
+static uint64_t Digest(const void* data, size_t n, uint64_t h = 1469598103934665603ull) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+// One chunk through every stage, as the CLI runs it, reduced to a digest of its outputs
+static uint64_t ChunkDigest(const ChunkRequest& req, GPUContext& gpu) {
+    HeightmapOutputs out;
+    BiomeInputs in;
+    in.height = Heightmap::Generate(req, gpu, &out);
+    in.gradX = out.gradX;
+    in.gradZ = out.gradZ;
+    const ClimateMaps climate = Climate::Generate(req, in.height, out, gpu);
+    gpu.Release(out.extended);
+    out.extended = 0;
+    in.humidity = climate.humidity;
+    in.temperature = climate.temperature;
+    const SurfaceMaps maps = TextureSynth::GenerateFused(in, gpu, DefaultBiomeClassifier());
+    gpu.Release(climate.humidity);
+    gpu.Release(climate.temperature);
+    for (GPUTexture t : {maps.albedo, maps.normal, maps.roughness}) gpu.Release(t);
+    ChunkCtx ctx{req.id, &gpu, in.height, maps.params, 0, out};
+    FeatureRegistry::Global().ApplyAll(ctx);
+    const MeshData mesh = MeshTiler::Generate(in.height, ctx.sdfTexture, gpu, &ctx.heightOutputs);
+    uint64_t h = Digest(mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+    h = Digest(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), h);
+    for (GPUTexture t : {in.height, maps.params, ctx.sdfTexture}) {
+        const GPUContext::Texture& tex = gpu.GetTexture(t);
+        h = Digest(tex.As<uint8_t>(), tex.ByteSize(), h);
+    }
+    for (GPUTexture t : {in.height, in.gradX, in.gradZ, maps.params, ctx.sdfTexture}) gpu.Release(t);
+    return h;
+}
+
+// Hundreds of small chunks generated by concurrent jobs, each with its own GPUContext and then
+// all sharing one, against the same chunks generated one at a time. Every chunk must come out
+// identical. Build with compile.py --tsan to run it under ThreadSanitizer.
+static int BenchStress() {
+    constexpr int kSide = 16;
+    constexpr int kChunks = kSide * kSide;
+    const unsigned jobs = std::max(8u, std::thread::hardware_concurrency());
+    auto request = [](int c) {
+        ChunkRequest req;
+        req.id = ChunkID{c % kSide - kSide / 2, c / kSide - kSide / 2};
+        req.resolution = kMinChunkResolution;
+        req.apron = 8;
+        return req;
+    };
+    auto clearCaches = [] {
+        OctaveCache::Global().Clear();
+        ApronCache::Global().Clear();
+        ErosionTileCache::Global().Clear();
+    };
+
+    clearCaches();
+    std::vector<uint64_t> serial(kChunks);
+    auto start = BenchClock::now();
+    for (int c = 0; c < kChunks; ++c) {
+        GPUContext gpu;
+        serial[c] = ChunkDigest(request(c), gpu);
+    }
+    const double serialMs = SecondsSince(start) * 1e3 / kChunks;
+
+    int status = 0;
+    for (int shared = 0; shared < 2; ++shared) {
+        clearCaches();
+        std::vector<uint64_t> digests(kChunks);
+        std::atomic<int> next{0};
+        GPUContext sharedGpu;
+        start = BenchClock::now();
+        std::vector<std::thread> threads;
+        for (unsigned j = 0; j < jobs; ++j) {
+            threads.emplace_back([&] {
+                for (int c = next++; c < kChunks; c = next++) {
+                    if (shared) {
+                        digests[c] = ChunkDigest(request(c), sharedGpu);
+                    } else {
+                        GPUContext gpu;
+                        digests[c] = ChunkDigest(request(c), gpu);
+                    }
+                }
+            });
+        }
+        for (std::thread& t : threads) t.join();
+        const double ms = SecondsSince(start) * 1e3 / kChunks;
+        const GPUContext::Stats stats = sharedGpu.GetStats();
+        const ErosionTileCacheStats tiles = ErosionTileCache::Global().Stats();
+        const bool ok = digests == serial && stats.liveTextures == 0;
+        if (!ok) status = 1;
+        // Jobs that need a tile another job is eroding wait for it (joined) instead of eroding it too
+        std::printf("stress    %d chunks  %2u jobs  %-15s %7.3f ms/chunk (serial %7.3f)  tiles %3llu built %3llu joined  %s\n",
+                    kChunks, jobs, shared ? "shared context" : "context per job", ms, serialMs,
+                    static_cast<unsigned long long>(tiles.misses), static_cast<unsigned long long>(tiles.joins),
+                    ok ? "identical" : "MISMATCH");
+    }
+    clearCaches();
+    return status;
+}
+
+// A chunk on the recording backend: classification is its first pass, after the uploads of the
+// CPU-generated inputs, and goes out with the readback of its ids in a single submit. The mesh
+// pass follows with the readback of its vertices, and its indices are copied in a submit of
+// their own, without uploading the inputs again.
+// Checks the recorded order against the stages', that a repeated pass reuses its bind group,
+// that passes whose bindings do not fit their pipeline are refused, and that a texture the
+// CPU wrote is uploaded before each pass that samples it. The bind group check runs on a
+// WebGPU device too when there is one, reading the ids back in the same submit.
+static int BenchPasses() {
+    using Cmd = PassGraph::Command;
+    constexpr int kChunks = 32;
+    constexpr uint32_t kResolution = 256;
+    const std::vector<std::pair<Cmd::Kind, PipelineID>> expected = {
+        {Cmd::Upload, PipelineID::Count},            {Cmd::Upload, PipelineID::Count}, // height, gradients
+        {Cmd::Upload, PipelineID::Count},            {Cmd::Dispatch, PipelineID::BiomeClassify},
+        {Cmd::CopyTexture, PipelineID::Count},       {Cmd::Submit, PipelineID::Count},
+        {Cmd::Dispatch, PipelineID::MeshTile},       {Cmd::CopyBuffer, PipelineID::Count}, // vertices
+        {Cmd::Submit, PipelineID::Count},            {Cmd::CopyBuffer, PipelineID::Count}, // indices
+        {Cmd::Submit, PipelineID::Count},
+    };
+
+    GPUContext gpu(GPUBackend::Recording);
+    const auto start = BenchClock::now();
+    for (int c = 0; c < kChunks; ++c) {
+        ChunkRequest req;
+        req.id = ChunkID{c, -c};
+        req.resolution = kResolution;
+        // The heights come from the CPU; without erosion the time is mostly recording
+        req.hydraulic.dropletDensity = 0.0f;
+        req.thermal.reach = 0.0f;
+        HeightmapOutputs out;
+        BiomeInputs in;
+        in.height = Heightmap::Generate(req, gpu, &out);
+        in.gradX = out.gradX;
+        in.gradZ = out.gradZ;
+        const SurfaceMaps maps = TextureSynth::GenerateFused(in, gpu, DefaultBiomeClassifier());
+        for (GPUTexture t : {maps.albedo, maps.normal, maps.roughness}) gpu.Release(t);
+        ChunkCtx ctx{req.id, &gpu, in.height, maps.params, 0, out};
+        FeatureRegistry::Global().ApplyAll(ctx);
+        MeshTiler::Generate(in.height, ctx.sdfTexture, gpu, &ctx.heightOutputs);
+        gpu.Passes().Submit();
+        for (GPUTexture t : {in.height, in.gradX, in.gradZ, maps.params, ctx.sdfTexture}) gpu.Release(t);
+    }
+    const double us = SecondsSince(start) * 1e6 / kChunks;
+    const std::vector<Cmd> log = gpu.Passes().Log();
+    bool ordered = log.size() == expected.size() * kChunks;
+    for (size_t i = 0; ordered && i < log.size(); ++i) {
+        const auto& want = expected[i % expected.size()];
+        ordered = log[i].kind == want.first && (want.first != Cmd::Dispatch || log[i].pipeline == want.second);
+    }
+    const PassGraph::Stats stats = gpu.Passes().GetStats();
+    std::printf("passes    %d chunks  %5.2f passes  %4.2f uploads  %4.2f submits/chunk  %5.1f us/chunk  %s\n", kChunks,
+                double(stats.passes) / kChunks, double(stats.uploads) / kChunks, double(stats.submits) / kChunks, us,
+                ordered ? "ordered" : "MISMATCH");
+
+    // Classification of `height` into `ids`, with placeholder params and tables
+    struct ClassifyBuffers {
+        PassGraph::BufferID params, tables;
+    };
+    auto buffers = [](PassGraph& graph) {
+        return ClassifyBuffers{graph.CreateBuffer(PassGraph::BufferUsage::Uniform, 16),
+                               graph.CreateBuffer(PassGraph::BufferUsage::Storage, 16)};
+    };
+    auto classify = [](const ClassifyBuffers& buf, GPUTexture height, GPUTexture ids) {
+        std::vector<PassBinding> bindings = {PassBinding::Buffer(buf.params), PassBinding::Buffer(buf.tables)};
+        bindings.insert(bindings.end(), 5, PassBinding::Texture(height));
+        bindings.push_back(PassBinding::Texture(ids));
+        return ComputePass{PipelineID::BiomeClassify, 64, 64, bindings};
+    };
+
+    // Bind groups are created once per pipeline and resources, and dropped with them
+    GPUContext cache(GPUBackend::Recording);
+    PassGraph& passes = cache.Passes();
+    const ClassifyBuffers buf = buffers(passes);
+    const GPUTexture a = cache.CreateTexture2D(64, 64), b = cache.CreateTexture2D(64, 64);
+    const GPUTexture ids = cache.CreateTexture2D_U8(64, 64);
+    const ComputePass fromA = classify(buf, a, ids), fromB = classify(buf, b, ids);
+    for (int i = 0; i < 4; ++i) passes.Add(i % 2 ? fromB : fromA);
+    const PassGraph::Stats before = passes.GetStats();
+    cache.Release(b);
+    const bool refusedStale = !passes.Add(fromB);
+    const bool refusedLayout = !passes.Add({PipelineID::BiomeClassify, 64, 64, {PassBinding::Texture(a)}});
+    passes.Submit();
+    const PassGraph::Stats after = passes.GetStats();
+    const bool cached = before.bindGroups == 2 && before.bindGroupHits == 2 && after.passes == 4 &&
+                        after.submits == 1 && refusedStale && refusedLayout;
+    std::printf("passes    alternating x4  %llu bind groups  %llu reused  %llu submit  %s\n",
+                static_cast<unsigned long long>(before.bindGroups),
+                static_cast<unsigned long long>(before.bindGroupHits),
+                static_cast<unsigned long long>(after.submits), cached ? "cached" : "MISMATCH");
+
+    // The CPU writes `c` twice, each time before a pass samples it: both writes go up, the
+    // second after the first pass has been submitted. `d` has no CPU contents and is not.
+    GPUContext upload(GPUBackend::Recording);
+    const ClassifyBuffers uploadBuf = buffers(upload.Passes());
+    const GPUTexture c = upload.CreateTexture2D(64, 64), d = upload.CreateTexture2D(64, 64);
+    const GPUTexture uploadIds = upload.CreateTexture2D_U8(64, 64);
+    upload.GetTexture(c).As<float>()[0] = 1.0f;
+    upload.Passes().Add(classify(uploadBuf, c, uploadIds));
+    upload.GetTexture(c).As<float>()[0] = 2.0f;
+    upload.Passes().Add(classify(uploadBuf, c, uploadIds));
+    upload.Passes().Add(classify(uploadBuf, d, uploadIds));
+    upload.Passes().Submit();
+    const std::vector<Cmd::Kind> uploadExpected = {Cmd::Upload, Cmd::Dispatch, Cmd::Submit, Cmd::Upload,
+                                                   Cmd::Dispatch, Cmd::Dispatch, Cmd::Submit};
+    std::vector<Cmd::Kind> uploadLog;
+    for (const Cmd& cmd : upload.Passes().Log()) uploadLog.push_back(cmd.kind);
+    const uint64_t uploads = upload.Passes().GetStats().uploads;
+    const bool uploaded = uploadLog == uploadExpected && uploads == 2;
+    std::printf("passes    CPU writes x2  %llu uploads  %zu commands  %s\n", static_cast<unsigned long long>(uploads),
+                uploadLog.size(), uploaded ? "uploaded" : "MISMATCH");
+
+    // The alternating passes on a device, if there is one: four passes in one encoder, two
+    // bind groups, and the ids read back in the same submit after `b` and its group are gone
+    GPUContext device(GPUBackend::WebGPU);
+    if (device.Backend() != GPUBackend::WebGPU) {
+        std::printf("passes    no WebGPU device for the alternating passes\n");
+        return ordered && cached && uploaded ? 0 : 1;
+    }
+    PassGraph& devicePasses = device.Passes();
+    const ClassifyBuffers deviceBuf = buffers(devicePasses);
+    const GPUTexture da = device.CreateTexture2D(64, 64), db = device.CreateTexture2D(64, 64);
+    const GPUTexture deviceIds = device.CreateTexture2D_U8(64, 64);
+    const ComputePass deviceFromA = classify(deviceBuf, da, deviceIds), deviceFromB = classify(deviceBuf, db, deviceIds);
+    for (int i = 0; i < 4; ++i) devicePasses.Add(i % 2 ? deviceFromB : deviceFromA);
+    device.Release(db);
+    const bool deviceRefused = !devicePasses.Add(deviceFromB);
+    const bool readBack = device.Readback(deviceIds);
+    const PassGraph::Stats deviceStats = devicePasses.GetStats();
+    const bool deviceCached = deviceStats.bindGroups == 2 && deviceStats.bindGroupHits == 2 &&
+                              deviceStats.passes == 4 && deviceStats.submits == 1 && deviceRefused && readBack;
+    std::printf("passes    webgpu alternating x4  %llu bind groups  %llu reused  %llu submit  readback %s  %s\n",
+                static_cast<unsigned long long>(deviceStats.bindGroups),
+                static_cast<unsigned long long>(deviceStats.bindGroupHits),
+                static_cast<unsigned long long>(deviceStats.submits), readBack ? "ok" : "failed",
+                deviceCached ? "cached" : "MISMATCH");
+    return ordered && cached && uploaded && deviceCached ? 0 : 1;
+}
+
+// Readbacks on the recording backend, whose fake queue completes a map 1 ms after its submit.
+// Waiting for each chunk's biome ids before starting the next is compared with leaving them in
+// flight while the next chunk generates its heights and records its pass. Both must give the
+// same chunks, and the staging buffers are reused. With a WebGPU device the same two runs go
+// through its queue as well, where the map takes what it takes.
+// A readback whose map fails must say so and leave its output alone.
+static int BenchReadback() {
+    constexpr int kChunks = 16;
+    constexpr auto kLatency = std::chrono::microseconds(1000);
+    // A chunk's textures (height, gradients, ids) and the readback of its ids
+    struct Chunk {
+        GPUTexture textures[4] = {};
+        PendingReadback ids;
+    };
+    auto record = [](int c, GPUContext& gpu, Chunk& chunk) {
+        ChunkRequest req;
+        req.id = ChunkID{c, c / 4};
+        req.resolution = kMinChunkResolution;
+        // The heights come from the CPU; erosion would dwarf the readbacks being timed
+        req.hydraulic.dropletDensity = 0.0f;
+        req.thermal.reach = 0.0f;
+        HeightmapOutputs out;
+        BiomeInputs in;
+        in.height = Heightmap::Generate(req, gpu, &out);
+        in.gradX = out.gradX;
+        in.gradZ = out.gradZ;
+        const GPUTexture ids = Biomes::RecordClassify(in, gpu, DefaultBiomeClassifier());
+        chunk.ids = gpu.ReadbackAsync(ids);
+        const GPUTexture textures[4] = {in.height, in.gradX, in.gradZ, ids};
+        std::copy(textures, textures + 4, chunk.textures);
+    };
+    // Waits for the ids; digest of the chunk's textures, which are then released
+    auto finish = [](GPUContext& gpu, Chunk& chunk) {
+        chunk.ids.Wait();
+        uint64_t h = 1469598103934665603ull;
+        for (GPUTexture t : chunk.textures) {
+            const GPUContext::Texture& tex = gpu.GetTexture(t);
+            h = Digest(tex.As<uint8_t>(), tex.ByteSize(), h);
+            gpu.Release(t);
+        }
+        return h;
+    };
+
+    int status = 0;
+    const bool hasDevice = GPUContext(GPUBackend::WebGPU).Backend() == GPUBackend::WebGPU;
+    std::vector<uint64_t> serial;
+    for (int run = 0; run < (hasDevice ? 4 : 2); ++run) {
+        // Recording serial and overlapped, then the device's; each backend against its own serial
+        // run, since only the device classifies
+        const bool overlapped = run % 2 != 0;
+        const GPUBackend backend = run < 2 ? GPUBackend::Recording : GPUBackend::WebGPU;
+        GPUContext gpu(backend);
+        gpu.Passes().SetMapLatency(kLatency);
+        std::vector<uint64_t> digests;
+        Chunk previous;
+        const auto start = BenchClock::now();
+        for (int c = 0; c < kChunks; ++c) {
+            Chunk chunk;
+            record(c, gpu, chunk);
+            if (!overlapped) {
+                digests.push_back(finish(gpu, chunk));
+                continue;
+            }
+            // The previous chunk's ids were copied while this one generated and recorded
+            if (c > 0) digests.push_back(finish(gpu, previous));
+            previous = std::move(chunk);
+        }
+        if (overlapped) digests.push_back(finish(gpu, previous));
+        const double ms = SecondsSince(start) * 1e3 / kChunks;
+        const PassGraph::Stats passes = gpu.Passes().GetStats();
+        const GPUContext::Stats stats = gpu.GetStats();
+        if (!overlapped) serial = digests;
+        const bool ok = digests == serial && digests.size() == kChunks && stats.liveTextures == 0;
+        if (!ok) status = 1;
+        std::printf("readback  %d chunks  %-9s %-10s %7.3f ms/chunk  %4.2f readbacks  %4.2f stalls/chunk  %llu staging  "
+                    "%s\n",
+                    kChunks, backend == GPUBackend::WebGPU ? "webgpu" : "recording",
+                    overlapped ? "overlapped" : "serial", ms, double(passes.readbacks) / kChunks,
+                    double(passes.stalls) / kChunks, static_cast<unsigned long long>(passes.stagingBuffers),
+                    ok ? "identical" : "MISMATCH");
+    }
+    if (!hasDevice) std::printf("readback  no WebGPU device for the queued runs\n");
+
+    GPUContext gpu(GPUBackend::Recording);
+    PassGraph& passes = gpu.Passes();
+    const uint32_t words[4] = {1, 2, 3, 4};
+    const PassGraph::BufferID buffer = passes.CreateBuffer(PassGraph::BufferUsage::Storage, sizeof(words), words);
+    uint32_t out[4] = {7, 7, 7, 7};
+    passes.SetMapFailure(true);
+    const bool failedWait = !passes.ReadBufferAsync(buffer, out, sizeof(out)).Wait();
+    const bool untouched = std::all_of(out, out + 4, [](uint32_t w) { return w == 7; });
+    passes.SetMapFailure(false);
+    const bool retried = passes.ReadBufferAsync(buffer, out, sizeof(out)).Wait() && std::equal(out, out + 4, words);
+    const uint64_t failures = passes.GetStats().failedReadbacks;
+    passes.ReleaseBuffer(buffer);
+    const bool failOk = failedWait && untouched && retried && failures == 1;
+    if (!failOk) status = 1;
+    std::printf("readback  failed map  %s  output %s  %llu failed  retry %s  %s\n", failedWait ? "reported" : "hidden",
+                untouched ? "untouched" : "overwritten", static_cast<unsigned long long>(failures),
+                retried ? "ok" : "bad", failOk ? "ok" : "MISMATCH");
+    return status;
+}
+
+// The chunk pipeline on the CPU backend against the WebGPU one, chunk by chunk, with every
+// stage waiting for its outputs so the device's share is in its time. Natively the WebGPU side
+// needs compile.py --webgpu; on a GPU-less machine it runs on a software Vulkan adapter
+// (lavapipe, SwiftShader). Classification and the mesh are the stages with a pass: the first
+// indexes the same tables as the CPU, and the second does the CPU kernel's float operations in
+// the same order. Each stage's outputs (heights, biome ids and params, SDF, mesh) must digest
+// the same on both backends; the line of each stage says how many passes it ran.
+static int BenchBackends() {
+    constexpr int kChunks = 8;
+    constexpr uint32_t kResolution = 256;
+    enum Stage { kHeight, kSurface, kFeatures, kMesh, kStages };
+    static const char* const kNames[kStages] = {"heightmap", "surface", "features", "mesh"};
+    using Digests = std::array<uint64_t, kStages>;
+    auto texDigest = [](GPUContext& gpu, GPUTexture t, uint64_t h) {
+        const GPUContext::Texture& tex = gpu.GetTexture(t);
+        return Digest(tex.As<uint8_t>(), tex.ByteSize(), h);
+    };
+    // Each run starts with empty caches, so the second does not time the first's erosion tiles
+    auto run = [&](GPUContext& gpu, double (&ms)[kStages], uint64_t (&passes)[kStages], std::vector<Digests>& digests) {
+        OctaveCache::Global().Clear();
+        ApronCache::Global().Clear();
+        ErosionTileCache::Global().Clear();
+        uint64_t before = gpu.Passes().GetStats().passes;
+        auto countPasses = [&](Stage s) {
+            const uint64_t now = gpu.Passes().GetStats().passes;
+            passes[s] += now - before;
+            before = now;
+        };
+        for (int c = 0; c < kChunks; ++c) {
+            ChunkRequest req;
+            req.id = ChunkID{c, 1 - c};
+            req.resolution = kResolution;
+            Digests d;
+            auto start = BenchClock::now();
+            HeightmapOutputs out;
+            BiomeInputs in;
+            in.height = Heightmap::Generate(req, gpu, &out);
+            in.gradX = out.gradX;
+            in.gradZ = out.gradZ;
+            gpu.Readback(in.height);
+            ms[kHeight] += SecondsSince(start) * 1e3 / kChunks;
+            countPasses(kHeight);
+            d[kHeight] = texDigest(gpu, in.height, 1469598103934665603ull);
+            start = BenchClock::now();
+            const SurfaceMaps maps = TextureSynth::GenerateFused(in, gpu, DefaultBiomeClassifier());
+            gpu.Readback(maps.params);
+            ms[kSurface] += SecondsSince(start) * 1e3 / kChunks;
+            countPasses(kSurface);
+            const BiomeMap ids = maps.biomes.Unpack();
+            d[kSurface] = texDigest(gpu, maps.params, Digest(ids.ids.data(), ids.ids.size()));
+            for (GPUTexture t : {maps.albedo, maps.normal, maps.roughness}) gpu.Release(t);
+            start = BenchClock::now();
+            ChunkCtx ctx{req.id, &gpu, in.height, maps.params, 0, out};
+            FeatureRegistry::Global().ApplyAll(ctx);
+            gpu.Readback(ctx.sdfTexture);
+            ms[kFeatures] += SecondsSince(start) * 1e3 / kChunks;
+            countPasses(kFeatures);
+            d[kFeatures] = ctx.sdfTexture ? texDigest(gpu, ctx.sdfTexture, 1469598103934665603ull) : 0;
+            start = BenchClock::now();
+            const MeshData mesh = MeshTiler::Generate(in.height, ctx.sdfTexture, gpu, &ctx.heightOutputs);
+            ms[kMesh] += SecondsSince(start) * 1e3 / kChunks;
+            countPasses(kMesh);
+            d[kMesh] = Digest(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t),
+                              Digest(mesh.vertices.data(), mesh.vertices.size() * sizeof(float)));
+            digests.push_back(d);
+            for (GPUTexture t : {in.height, in.gradX, in.gradZ, maps.params, ctx.sdfTexture}) gpu.Release(t);
+        }
+    };
+
+    double cpuMs[kStages] = {}, gpuMs[kStages] = {};
+    uint64_t cpuPasses[kStages] = {}, gpuPasses[kStages] = {};
+    std::vector<Digests> cpuDigests, gpuDigests;
+    {
+        GPUContext cpu(GPUBackend::CPU);
+        run(cpu, cpuMs, cpuPasses, cpuDigests);
+    }
+    GPUContext device(GPUBackend::WebGPU);
+    if (device.Backend() != GPUBackend::WebGPU) {
+        for (int s = 0; s < kStages; ++s) {
+            std::printf("backends  %-9s  cpu %8.3f ms/chunk\n", kNames[s], cpuMs[s]);
+        }
+        std::printf("backends  no WebGPU device%s; nothing compared\n",
+                    TERRAINGEN_WEBGPU ? "" : " (natively: compile.py --native --webgpu <wgpu-native dir>)");
+        return 0;
+    }
+#if TERRAINGEN_WEBGPU
+    PipelineRegistry::Global().WarmUp(device.Device());
+#endif
+    run(device, gpuMs, gpuPasses, gpuDigests);
+    int status = 0;
+    for (int s = 0; s < kStages; ++s) {
+        int differ = 0;
+        for (int c = 0; c < kChunks; ++c) differ += cpuDigests[c][s] != gpuDigests[c][s];
+        if (differ) status = 1;
+        // A stage without device passes ran on the CPU both times; its timings are two CPU runs
+        std::printf("backends  %-9s  cpu %8.3f  webgpu %8.3f ms/chunk  (%5.2fx)  %3llu device passes%s  "
+                    "%d of %d chunks differ  %s\n",
+                    kNames[s], cpuMs[s], gpuMs[s], cpuMs[s] / gpuMs[s], (unsigned long long)gpuPasses[s],
+                    gpuPasses[s] ? "" : " (CPU both runs)", differ, kChunks, differ ? "MISMATCH" : "identical");
+    }
+    return status;
+}
+
+// Synthetic features for BenchFeatures, one per chunk resource. Terraces quantize the height;
+// bands stripe the biome map; pits carve a grid of round holes into a fresh SDF, deeper where
+// the ground is higher when they read the height.
+class TerraceFeature : public IFeature {
+public:
+    FeatureWork Apply(ChunkCtx& ctx) override {
+        GPUContext::Texture* height = &ctx.gpu->GetTexture(ctx.heightTexture);
+        const uint32_t w = height->width;
+        return {w, height->height, [height, w](const GPUContext::ComputeTile& t) {
+            float* h = height->As<float>();
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                for (uint32_t x = t.x0; x < t.x1; ++x) {
+                    float& v = h[static_cast<size_t>(y) * w + x];
+                    v = std::floor(v * 16.0f) / 16.0f;
+                }
+            }
+        }};
+    }
+};
+
+class BandFeature : public IFeature {
+public:
+    FeatureWork Apply(ChunkCtx& ctx) override {
+        GPUContext::Texture* biome = &ctx.gpu->GetTexture(ctx.biomeTexture);
+        const uint32_t w = biome->width;
+        return {w, biome->height, [biome, w](const GPUContext::ComputeTile& t) {
+            uint8_t* b = biome->As<uint8_t>();
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                for (uint32_t x = t.x0; x < t.x1; ++x) b[static_cast<size_t>(y) * w + x] = (x / 8 + y / 8) % 4;
+            }
+        }};
+    }
+};
+
+class PitFeature : public IFeature {
+public:
+    explicit PitFeature(bool readsHeight) : readsHeight_(readsHeight) {}
+
+    FeatureWork Apply(ChunkCtx& ctx) override {
+        const GPUContext::Texture& height = ctx.gpu->GetTexture(ctx.heightTexture);
+        const uint32_t w = height.width, h = height.height;
+        ctx.sdfTexture = ctx.gpu->CreateTexture2D(w, h, TextureFormat::R32Float, TextureInit::Uninitialized);
+        GPUContext::Texture* sdf = &ctx.gpu->GetTexture(ctx.sdfTexture);
+        const float* ground = readsHeight_ ? height.As<float>() : nullptr;
+        return {w, h, [sdf, ground, w](const GPUContext::ComputeTile& t) {
+            float* out = sdf->As<float>();
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                for (uint32_t x = t.x0; x < t.x1; ++x) {
+                    const size_t i = static_cast<size_t>(y) * w + x;
+                    const float dx = static_cast<float>(x % 32) - 16.0f, dy = static_cast<float>(y % 32) - 16.0f;
+                    const float radius = ground ? 4.0f + 8.0f * ground[i] : 8.0f;
+                    out[i] = std::sqrt(dx * dx + dy * dy) - radius;
+                }
+            }
+        }};
+    }
+
+private:
+    bool readsHeight_;
+};
+
+// The feature scheduler on three synthetic features. Registration order must not change the
+// schedule or the result; features touching different resources share a wave, and one that
+// reads what another writes waits for it. Every schedule must match applying the features one
+// by one in priority order, and the waved one is timed against one feature per wave.
+static int BenchFeatures() {
+    constexpr uint32_t kResolution = 256;
+    constexpr int kRounds = 64;
+    TerraceFeature terrace;
+    BandFeature bands;
+    PitFeature pits(false), heightPits(true);
+    const FeatureInfo terraceInfo{"Terrace", 1, 10, kFeatureHeight, kFeatureHeight};
+    const FeatureInfo bandInfo{"Bands", 1, 20, 0, kFeatureBiome};
+    const FeatureInfo pitInfo{"Pits", 1, 30, 0, kFeatureSDF};
+    FeatureInfo heightPitInfo = pitInfo;
+    heightPitInfo.reads = kFeatureHeight;
+    // Every feature claiming every resource: one per wave
+    auto serialized = [](FeatureInfo info) {
+        info.reads = info.writes = kFeatureHeight | kFeatureBiome | kFeatureSDF;
+        return info;
+    };
+
+    // One chunk through `apply`, reduced to a digest of its three textures
+    auto run = [&](const std::function<void(ChunkCtx&)>& apply) {
+        GPUContext gpu(GPUBackend::CPU);
+        ChunkCtx ctx{ChunkID{0, 0}, &gpu, gpu.CreateTexture2D(kResolution, kResolution),
+                     gpu.CreateTexture2D(kResolution, kResolution, TextureFormat::R8Uint), 0, HeightmapOutputs{}};
+        float* h = gpu.GetTexture(ctx.heightTexture).As<float>();
+        for (uint32_t i = 0; i < kResolution * kResolution; ++i) {
+            h[i] = 0.5f + 0.5f * std::sin(0.05f * (i % kResolution)) * std::cos(0.03f * (i / kResolution));
+        }
+        apply(ctx);
+        uint64_t digest = 1469598103934665603ull;
+        for (GPUTexture t : {ctx.heightTexture, ctx.biomeTexture, ctx.sdfTexture}) {
+            const GPUContext::Texture& tex = gpu.GetTexture(t);
+            digest = Digest(tex.As<uint8_t>(), tex.ByteSize(), digest);
+        }
+        return digest;
+    };
+    auto inOrder = [&](std::vector<IFeature*> features) {
+        return run([&](ChunkCtx& ctx) {
+            for (IFeature* f : features) {
+                FeatureWork work = f->Apply(ctx);
+                ctx.gpu->Dispatch(work.width, work.height, work.kernel);
+            }
+        });
+    };
+    auto waves = [](const FeatureRegistry& registry) {
+        uint32_t n = 0;
+        for (const auto& entry : registry.Schedule()) n = std::max(n, entry.second + 1);
+        return n;
+    };
+    auto sameSchedule = [](const FeatureRegistry& a, const FeatureRegistry& b) {
+        const auto sa = a.Schedule(), sb = b.Schedule();
+        bool same = sa.size() == sb.size();
+        for (size_t i = 0; same && i < sa.size(); ++i) {
+            same = std::strcmp(sa[i].first.name, sb[i].first.name) == 0 && sa[i].second == sb[i].second;
+        }
+        return same;
+    };
+
+    int status = 0;
+    for (int dependent = 0; dependent < 2; ++dependent) {
+        IFeature& pit = dependent ? static_cast<IFeature&>(heightPits) : pits;
+        const FeatureInfo& pInfo = dependent ? heightPitInfo : pitInfo;
+        FeatureRegistry forward, backward, oneByOne;
+        forward.Add(&terrace, terraceInfo);
+        forward.Add(&bands, bandInfo);
+        forward.Add(&pit, pInfo);
+        backward.Add(&pit, pInfo);
+        backward.Add(&bands, bandInfo);
+        backward.Add(&terrace, terraceInfo);
+        oneByOne.Add(&terrace, serialized(terraceInfo));
+        oneByOne.Add(&bands, serialized(bandInfo));
+        oneByOne.Add(&pit, serialized(pInfo));
+
+        const uint64_t reference = inOrder({&terrace, &bands, &pit});
+        const bool ok = sameSchedule(forward, backward) && waves(forward) == (dependent ? 2u : 1u) &&
+                        waves(oneByOne) == 3 && run([&](ChunkCtx& c) { forward.ApplyAll(c); }) == reference &&
+                        run([&](ChunkCtx& c) { backward.ApplyAll(c); }) == reference &&
+                        run([&](ChunkCtx& c) { oneByOne.ApplyAll(c); }) == reference;
+        if (!ok) status = 1;
+
+        double us[2];
+        FeatureRegistry* timed[2] = {&oneByOne, &forward};
+        for (int r = 0; r < 2; ++r) {
+            const auto start = BenchClock::now();
+            for (int i = 0; i < kRounds; ++i) run([&](ChunkCtx& c) { timed[r]->ApplyAll(c); });
+            us[r] = SecondsSince(start) * 1e6 / kRounds;
+        }
+        std::printf("features  3 features  %-14s %u waves  %7.1f us/chunk (one per wave %7.1f)  %s\n",
+                    dependent ? "pits on height" : "independent", waves(forward), us[1], us[0],
+                    ok ? "identical" : "MISMATCH");
+    }
+
+    // A name registered again keeps its highest version
+    FeatureRegistry registry;
+    FeatureInfo newer = pitInfo;
+    newer.version = 2;
+    const bool replaced = registry.Add(&pits, pitInfo) && registry.Add(&heightPits, newer) &&
+                          !registry.Add(&pits, pitInfo) && registry.Schedule().size() == 1 &&
+                          registry.Schedule()[0].first.version == 2;
+    std::vector<FeatureRun> runs;
+    run([&](ChunkCtx& c) { registry.ApplyAll(c, &runs); });
+    const bool traced = runs.size() == 1 && std::strcmp(runs[0].name, "Pits") == 0;
+    if (!replaced || !traced) status = 1;
+    std::printf("features  re-registered  version %u kept  %zu run traced  %s\n", registry.Schedule()[0].first.version,
+                runs.size(), replaced && traced ? "replaced" : "MISMATCH");
+    return status;
+}
+
+// Embedded WGSL: every pipeline's shader is in the binary, every shader hashes to its checked-
+// in golden value and, when the sources are found, the binary embeds exactly the files in
+// shaders/ with their current text
+static int BenchShaders() {
+    // shaders/ next to the executable (compile.py builds it beside them), else in the source
+    // tree this file was compiled from; never the working directory
+    std::string dir;
+    std::error_code error;
+    const std::filesystem::path exe = std::filesystem::read_symlink("/proc/self/exe", error);
+    const std::filesystem::path source = std::filesystem::path(__FILE__).parent_path().parent_path();
+    for (const std::filesystem::path& root : {error ? std::filesystem::path() : exe.parent_path(), source}) {
+        const std::filesystem::path candidate = root / "shaders";
+        if (!root.empty() && std::ifstream(candidate / (std::string(GetShader(0).name) + ".wgsl"))) {
+            dir = candidate.string();
+            break;
+        }
+    }
+    int status = 0;
+    size_t bytes = 0;
+    const auto start = BenchClock::now();
+    for (size_t i = 0; i < ShaderCount(); ++i) {
+        const ShaderSource& shader = GetShader(i);
+        const bool stable =
+            std::strlen(shader.code) == shader.size && ShaderHash(shader.code, shader.size) == GoldenShaderHash(shader.name);
+        bytes += shader.size;
+        int pipelines = 0;
+        for (size_t p = 0; p < static_cast<size_t>(PipelineID::Count); ++p) {
+            pipelines += std::strcmp(GetPipelineDesc(static_cast<PipelineID>(p)).shader, shader.name) == 0;
+        }
+        const char* disk = "-";
+        if (!dir.empty()) {
+            std::ifstream file(dir + "/" + shader.name + ".wgsl", std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            for (size_t at; (at = text.find("\r\n")) != std::string::npos;) text.erase(at, 1);
+            disk = !file ? "gone" : text == shader.code ? "same" : "stale";
+        }
+        const bool ok = stable && std::strcmp(disk, "stale") != 0;
+        if (!ok) status = 1;
+        std::printf("shaders   %-18s %5zu bytes  hash %016llx  %d pipeline%s  disk %-5s  %s\n", shader.name,
+                    shader.size, static_cast<unsigned long long>(shader.hash), pipelines, pipelines == 1 ? " " : "s",
+                    disk, ok ? "ok" : "MISMATCH");
+    }
+    for (size_t p = 0; p < static_cast<size_t>(PipelineID::Count); ++p) {
+        const PipelineDesc& desc = GetPipelineDesc(static_cast<PipelineID>(p));
+        if (FindShader(desc.shader)) continue;
+        status = 1;
+        std::printf("shaders   pipeline %s: shader %s not embedded  MISMATCH\n", desc.name, desc.shader);
+    }
+    if (!dir.empty()) {
+        for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+            if (entry.path().extension() != ".wgsl" || FindShader(entry.path().stem().string().c_str())) continue;
+            status = 1;
+            std::printf("shaders   %s not embedded; rebuild  MISMATCH\n", entry.path().filename().string().c_str());
+        }
+    }
+    std::printf("shaders   %zu embedded, %zu bytes, checked in %.1f us%s\n", ShaderCount(), bytes,
+                SecondsSince(start) * 1e6, dir.empty() ? " (no shaders/ to compare against)" : "");
+    return status;
+}
+
+// Coarse-octave field against direct evaluation at lattice nodes, where it must be exact,
+// over a window crossing region borders on both sides of the origin; then batched region
+// generation with the cache off and on (noise only, erosion off) and the interpolation error.
+// Resolution 64 samples only lattice nodes and skips the cache, so it is not a case here.
+static int BenchRegion() {
+    int status = 0;
+    {
+        OctaveCache::Global().Clear();
+        FbmParams fbm;
+        fbm.frequency = 1.0f / 2048.0f;
+        const int coarse = CoarseOctaveCount(fbm, kMaxFbmOctaves);
+        const double span = kCoarseRegionCells * kCoarseSpacing;
+        const double x0 = -1.5 * span, z0 = -0.5 * span;
+        const uint32_t nodes = 2 * kCoarseRegionCells + 1;
+        const CoarseOctaveField field =
+            OctaveCache::Global().Acquire(fbm, coarse, x0, z0, x0 + 2.0 * span, z0 + 2.0 * span);
+        std::vector<NoiseSample> viaCache(nodes), direct(nodes);
+        NoiseScratch scratch;
+        float maxErr = 0.0f;
+        for (uint32_t z = 0; z < nodes; z += 7) {
+            const double worldZ = z0 + z * kCoarseSpacing;
+            field.FbmRow(coarse, fbm, x0, kCoarseSpacing, nodes, worldZ, scratch, viaCache.data());
+            FbmRowN(coarse, fbm, x0, kCoarseSpacing, nodes, worldZ, scratch, direct.data());
+            for (uint32_t x = 0; x < nodes; ++x) maxErr = std::max(maxErr, std::fabs(viaCache[x].value - direct[x].value));
+        }
+        const OctaveCacheStats stats = OctaveCache::Global().Stats();
+        const bool ok = coarse > 0 && field.Octaves() == coarse && stats.misses == 9 && maxErr == 0.0f;
+        if (!ok) status = 1;
+        std::printf("region    lattice nodes %u^2 via %llu tiles, %d coarse octaves  max err %.6f  %s\n", nodes,
+                    (unsigned long long)stats.misses, coarse, maxErr, ok ? "exact" : "MISMATCH");
+    }
+
+    constexpr int kSide = 4;
+    struct Case { uint32_t resolution; int octaves; uint32_t apron; };
+    // The CLI's default apron at 256 covers the climate diffusion
+    const uint32_t defaultApron = Climate::DiffusionTexels(ClimateParams{}, 256);
+    const Case cases[] = {{256, 4, 0}, {256, 4, defaultApron}, {256, 4, 32}, {1024, 4, 0}, {1024, 8, 0}};
+    for (const Case& c : cases) {
+        double ms[2] = {0.0, 0.0};
+        std::vector<std::vector<float>> direct(kSide * kSide);
+        float maxErr = 0.0f;
+        OctaveCacheStats stats;
+        for (int cached = 0; cached < 2; ++cached) {
+            OctaveCache::Global().Clear();
+            ApronCache::Global().Clear();
+            auto start = BenchClock::now();
+            for (int z = 0; z < kSide; ++z) {
+                for (int x = 0; x < kSide; ++x) {
+                    ChunkRequest req = NoiseOnlyRequest();
+                    req.id = ChunkID{x - kSide / 2, z - kSide / 2};
+                    req.resolution = c.resolution;
+                    req.octaves = c.octaves;
+                    req.apron = c.apron;
+                    req.coarseOctaveCache = cached != 0;
+                    GPUContext gpu;
+                    const std::vector<float> heights = gpu.GetTexture(Heightmap::Generate(req, gpu)).ToFloats();
+                    std::vector<float>& ref = direct[z * kSide + x];
+                    if (!cached) {
+                        ref = heights;
+                        continue;
+                    }
+                    for (size_t i = 0; i < heights.size(); ++i) {
+                        maxErr = std::max(maxErr, std::fabs(heights[i] - ref[i]));
+                    }
+                }
+            }
+            ms[cached] = SecondsSince(start) * 1e3 / (kSide * kSide);
+            if (cached) stats = OctaveCache::Global().Stats();
+        }
+        const bool ok = maxErr < 1e-3f && stats.hits > 0;
+        if (!ok) status = 1;
+        std::printf("region    res %4u octaves %d apron %2u  direct %8.3f ms/chunk  cached %8.3f ms/chunk (%.2fx)  "
+                    "tiles %2llu/%2llu hit  %5zu KiB  max err %.6f  %s\n",
+                    c.resolution, c.octaves, c.apron, ms[0], ms[1], ms[0] / ms[1], (unsigned long long)stats.hits,
+                    (unsigned long long)(stats.hits + stats.misses), stats.bytes >> 10, maxErr,
+                    ok ? "ok" : "MISMATCH");
+    }
+    OctaveCache::Global().Clear();
+    ApronCache::Global().Clear();
+    return status;
+}
+
+int RunBenchmarks(const std::string& name) {
+    struct Entry { const char* name; int (*fn)(); };
+    static const Entry kBenches[] = {
+        {"hash", BenchHash},
+        {"rng", BenchRng},
+        {"heightmap", BenchHeightmap},
+        {"noise", BenchNoise},
+        {"lod", BenchLOD},
+        {"biome", BenchBiome},
+        {"climate", BenchClimate},
+        {"biomemap", BenchBiomeMap},
+        {"blend", BenchBlend},
+        {"surface", BenchSurface},
+        {"bounds", BenchBounds},
+        {"erosion", BenchErosion},
+        {"thermal", BenchThermal},
+        {"apron", BenchApron},
+        {"region", BenchRegion},
+        {"textures", BenchTextures},
+        {"formats", BenchFormats},
+        {"compute", BenchCompute},
+        {"stress", BenchStress},
+        {"passes", BenchPasses},
+        {"readback", BenchReadback},
+        {"backends", BenchBackends},
+        {"features", BenchFeatures},
+        {"shaders", BenchShaders},
+    };
+    bool all = name.empty() || name == "all";
+    bool found = false;
+    int status = 0;
+    for (const auto& b : kBenches) {
+        if (!all && name != b.name) continue;
+        found = true;
+        status |= b.fn();
+    }
+    if (!found) {
+        std::fprintf(stderr, "Unknown benchmark '%s'\n", name.c_str());
+        return 1;
+    }
+    return status;
+}
+
+} // namespace terraingen
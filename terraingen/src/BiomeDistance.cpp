@@ -0,0 +1,238 @@
+#include "BiomeDistance.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <cmath>
+#if TERRAINGEN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace terraingen {
+
+// Seeds are packed texel coordinates y << 16 | x. "No seed" is a seed at (32767, 32767), which
+// every real seed beats while maps stay within kMaxSide, so passes need no special case for it.
+static constexpr uint32_t kMaxSide = 16384;
+
+static constexpr int32_t SeedAt(uint32_t x, uint32_t y) {
+    return static_cast<int32_t>(y << 16 | x);
+}
+
+static constexpr int32_t kNoSeed = SeedAt(0x7FFF, 0x7FFF);
+
+static size_t SeedIndex(int32_t s, uint32_t w) {
+    return static_cast<size_t>(s >> 16) * w + (s & 0xFFFF);
+}
+
+// Own ids, and per edge texel the first 4-neighbour biome that differs (left, right, up,
+// down). Edge texels seed themselves.
+struct BiomeEdges {
+    BiomeMap map;
+    std::vector<uint8_t> across;
+    std::vector<int32_t> seeds;
+};
+
+static BiomeEdges FindEdges(const PackedBiomeMap& packed) {
+    BiomeEdges e;
+    e.map = packed.Unpack();
+    const uint32_t w = e.map.width, h = e.map.height;
+    e.across.resize(e.map.size());
+    e.seeds.resize(e.map.size());
+    ThreadPool::Global().ParallelFor(0, h, 32, [&](uint32_t y0, uint32_t y1) {
+        for (uint32_t y = y0; y < y1; ++y) {
+            for (uint32_t x = 0; x < w; ++x) {
+                const size_t i = static_cast<size_t>(y) * w + x;
+                const uint8_t id = e.map[i];
+                uint8_t a = id;
+                if (x > 0 && e.map[i - 1] != id) a = e.map[i - 1];
+                else if (x + 1 < w && e.map[i + 1] != id) a = e.map[i + 1];
+                else if (y > 0 && e.map[i - w] != id) a = e.map[i - w];
+                else if (y + 1 < h && e.map[i + w] != id) a = e.map[i + w];
+                e.across[i] = a;
+                e.seeds[i] = a != id ? SeedAt(x, y) : kNoSeed;
+            }
+        }
+    });
+    return e;
+}
+
+// Fits in 32 bits for any two seeds, the "no seed" one included
+static inline int32_t Dist2(int32_t a, int32_t b) {
+    const int32_t dx = (a & 0xFFFF) - (b & 0xFFFF);
+    const int32_t dy = (a >> 16) - (b >> 16);
+    return dx * dx + dy * dy;
+}
+
+// Edge distance and biome across it from each texel's nearest seed. The edge lies half a
+// texel beyond a seed on the texel's own side, or half a texel short of one across it.
+static BiomeDistanceField Resolve(const BiomeEdges& e, const std::vector<int32_t>& nearest, float reach) {
+    BiomeDistanceField field;
+    field.width = e.map.width;
+    field.height = e.map.height;
+    field.reach = reach;
+    field.distance.resize(e.map.size());
+    field.other.resize(e.map.size());
+    const uint32_t w = field.width;
+    ThreadPool::Global().ParallelFor(0, field.height, 32, [&](uint32_t y0, uint32_t y1) {
+        for (uint32_t y = y0; y < y1; ++y) {
+            for (uint32_t x = 0; x < w; ++x) {
+                const size_t i = static_cast<size_t>(y) * w + x;
+                const int32_t s = nearest[i];
+                if (s == kNoSeed) {
+                    field.distance[i] = reach;
+                    field.other[i] = e.map[i];
+                    continue;
+                }
+                const size_t si = SeedIndex(s, w);
+                const float d = std::sqrt(static_cast<float>(Dist2(SeedAt(x, y), s)));
+                const bool sameSide = e.map[si] == e.map[i];
+                field.distance[i] = std::min(sameSide ? d + 0.5f : d - 0.5f, reach);
+                field.other[i] = sameSide ? e.across[si] : e.map[si];
+            }
+        }
+    });
+    return field;
+}
+
+// Keep the nearer of `best` and seed c as seen from p; strict, so earlier candidates win ties
+static inline void Closer(int32_t p, int32_t c, int32_t& best, int32_t& bestD) {
+    const int32_t d = Dist2(p, c);
+    best = d < bestD ? c : best;
+    bestD = d < bestD ? d : bestD;
+}
+
+#if TERRAINGEN_X86_SIMD
+TERRAINGEN_TARGET_AVX2 static inline __m256i Dist2AVX2(__m256i c, __m256i px, __m256i py) {
+    const __m256i dx = _mm256_sub_epi32(_mm256_and_si256(c, _mm256_set1_epi32(0xFFFF)), px);
+    const __m256i dy = _mm256_sub_epi32(_mm256_srai_epi32(c, 16), py);
+    return _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+}
+
+TERRAINGEN_TARGET_AVX2 static inline void CloserAVX2(const int32_t* src, __m256i px, __m256i py, __m256i& best,
+                                                     __m256i& bestD) {
+    const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    const __m256i d = Dist2AVX2(c, px, py);
+    best = _mm256_blendv_epi8(best, c, _mm256_cmpgt_epi32(bestD, d));
+    bestD = _mm256_min_epi32(bestD, d);
+}
+
+// Interior texels [x0, x1) of row y, eight at a time in the scalar candidate order; returns
+// how many were done
+TERRAINGEN_TARGET_AVX2 static uint32_t JumpFloodSpanAVX2(const int32_t* up, const int32_t* mid, const int32_t* down,
+                                                         int32_t* out, uint32_t y, uint32_t x0, uint32_t x1,
+                                                         uint32_t k) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i py = _mm256_set1_epi32(static_cast<int32_t>(y));
+    uint32_t x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        const __m256i px = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(x)), lane);
+        __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + x));
+        __m256i bestD = Dist2AVX2(best, px, py);
+        CloserAVX2(up + x - k, px, py, best, bestD);
+        CloserAVX2(up + x, px, py, best, bestD);
+        CloserAVX2(up + x + k, px, py, best, bestD);
+        CloserAVX2(mid + x - k, px, py, best, bestD);
+        CloserAVX2(mid + x + k, px, py, best, bestD);
+        CloserAVX2(down + x - k, px, py, best, bestD);
+        CloserAVX2(down + x, px, py, best, bestD);
+        CloserAVX2(down + x + k, px, py, best, bestD);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), best);
+    }
+    return x - x0;
+}
+#endif
+
+// One jump-flood step of size k over rows [y0, y1): each texel keeps the nearest seed among its
+// own and those of the 8 texels k away, in a fixed order so ties, and the output, do not depend
+// on threading. Rows outside the map read `none`; the interior columns run without bounds
+// checks, through the AVX2 kernel where available.
+static void JumpFloodRows(const int32_t* cur, int32_t* next, const int32_t* none, uint32_t w, uint32_t h,
+                          uint32_t y0, uint32_t y1, uint32_t k) {
+    for (uint32_t y = y0; y < y1; ++y) {
+        const int32_t* up = y >= k ? cur + static_cast<size_t>(y - k) * w : none;
+        const int32_t* mid = cur + static_cast<size_t>(y) * w;
+        const int32_t* down = y + k < h ? cur + static_cast<size_t>(y + k) * w : none;
+        int32_t* out = next + static_cast<size_t>(y) * w;
+        auto texel = [&](uint32_t x, bool left, bool right) {
+            const int32_t p = SeedAt(x, y);
+            int32_t best = mid[x];
+            int32_t bestD = Dist2(p, best);
+            if (left) Closer(p, up[x - k], best, bestD);
+            Closer(p, up[x], best, bestD);
+            if (right) Closer(p, up[x + k], best, bestD);
+            if (left) Closer(p, mid[x - k], best, bestD);
+            if (right) Closer(p, mid[x + k], best, bestD);
+            if (left) Closer(p, down[x - k], best, bestD);
+            Closer(p, down[x], best, bestD);
+            if (right) Closer(p, down[x + k], best, bestD);
+            out[x] = best;
+        };
+        const uint32_t lo = std::min(k, w), hi = w > k ? w - k : 0;
+        for (uint32_t x = 0; x < lo; ++x) texel(x, false, x + k < w);
+        uint32_t x = lo;
+#if TERRAINGEN_X86_SIMD
+        if (hi > lo && ActiveSimdISA() != SimdISA::Scalar) x += JumpFloodSpanAVX2(up, mid, down, out, y, lo, hi, k);
+#endif
+        for (; x < hi; ++x) texel(x, true, true);
+        for (uint32_t x = std::max(lo, hi); x < w; ++x) texel(x, x >= k, false);
+    }
+}
+
+BiomeDistanceField BiomeEdgeDistance(const PackedBiomeMap& map, float reach) {
+    if (map.empty() || reach <= 0.0f || map.width() > kMaxSide || map.height() > kMaxSide) {
+        return BiomeDistanceField();
+    }
+    const BiomeEdges e = FindEdges(map);
+    const uint32_t w = e.map.width, h = e.map.height;
+
+    // Steps from the first power of two covering the reach down to 1, plus one more step-1
+    // pass (JFA+1) that fixes most of the remaining misses
+    std::vector<int32_t> cur = e.seeds, next(cur.size());
+    std::vector<uint32_t> steps;
+    uint32_t first = 1;
+    while (first < reach) first <<= 1;
+    for (uint32_t k = first; k >= 1; k >>= 1) steps.push_back(k);
+    steps.push_back(1);
+    const std::vector<int32_t> none(w, kNoSeed);
+    for (uint32_t k : steps) {
+        ThreadPool::Global().ParallelFor(0, h, 16, [&, k](uint32_t y0, uint32_t y1) {
+            JumpFloodRows(cur.data(), next.data(), none.data(), w, h, y0, y1, k);
+        });
+        cur.swap(next);
+    }
+    return Resolve(e, cur, reach);
+}
+
+BiomeDistanceField BiomeEdgeDistanceBruteForce(const PackedBiomeMap& map, float reach) {
+    if (map.empty() || reach <= 0.0f || map.width() > kMaxSide || map.height() > kMaxSide) {
+        return BiomeDistanceField();
+    }
+    const BiomeEdges e = FindEdges(map);
+    const uint32_t w = e.map.width, h = e.map.height;
+    // Seeds up to reach + 0.5 away can still be nearer than the reach
+    const int32_t r = static_cast<int32_t>(std::ceil(reach)) + 1;
+    std::vector<int32_t> nearest(e.map.size());
+    ThreadPool::Global().ParallelFor(0, h, 16, [&](uint32_t y0, uint32_t y1) {
+        for (uint32_t y = y0; y < y1; ++y) {
+            for (uint32_t x = 0; x < w; ++x) {
+                const int32_t p = SeedAt(x, y);
+                const int32_t yi = static_cast<int32_t>(y), xi = static_cast<int32_t>(x);
+                int32_t best = kNoSeed;
+                int32_t bestD = Dist2(p, kNoSeed);
+                for (int32_t qy = std::max(0, yi - r); qy <= std::min<int32_t>(h - 1, yi + r); ++qy) {
+                    for (int32_t qx = std::max(0, xi - r); qx <= std::min<int32_t>(w - 1, xi + r); ++qx) {
+                        Closer(p, e.seeds[static_cast<size_t>(qy) * w + qx], best, bestD);
+                    }
+                }
+                nearest[static_cast<size_t>(y) * w + x] = best;
+            }
+        }
+    });
+    return Resolve(e, nearest, reach);
+}
+
+BiomeDistanceField BiomeTransitionField(const PackedBiomeMap& map, float worldWidth) {
+    const float reach = BiomeTransitionReach(map.width(), worldWidth);
+    if (map.empty() || reach < 0.5f) return BiomeDistanceField();
+    return BiomeEdgeDistance(map, reach);
+}
+
+} // namespace terraingen
@@ -0,0 +1,279 @@
+#include "BiomeMap.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cstring>
+#if TERRAINGEN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace terraingen {
+
+static uint32_t BitsForMaxId(uint8_t maxId) {
+    return maxId < 4 ? 2 : maxId < 16 ? 4 : 8;
+}
+
+// Runs are addressed with 16-bit ends
+static constexpr uint32_t kMaxRunWidth = 65535;
+
+PackedBiomeMap::PackedBiomeMap(uint32_t width, uint32_t height, uint8_t maxId)
+    : width_(width), height_(height), bits_(BitsForMaxId(maxId)) {
+    wordsPerRow_ = static_cast<uint32_t>((static_cast<uint64_t>(width) * bits_ + 63) / 64);
+    rows_.resize(height);
+    for (uint32_t y = 0; y < height; ++y) rows_[y].offset = y * wordsPerRow_;
+    words_.assign(static_cast<size_t>(wordsPerRow_) * height, 0);
+}
+
+// Texels are packed from the low bits of each byte up, so byte order is the same on any host
+// and a byte-aligned texel can be unpacked straight from the row's bytes
+static uint8_t PackedAt(const uint8_t* bytes, uint32_t bits, uint32_t x) {
+    const uint32_t bit = x * bits;
+    return static_cast<uint8_t>((bytes[bit >> 3] >> (bit & 7)) & ((1u << bits) - 1));
+}
+
+void PackedBiomeMap::PackRow(uint32_t y, const uint8_t* ids) {
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&words_[rows_[y].offset]);
+    if (bits_ == 8) {
+        std::memcpy(bytes, ids, width_);
+        return;
+    }
+    const uint32_t perByte = 8 / bits_;
+    const uint32_t full = width_ / perByte;
+    for (uint32_t b = 0; b < full; ++b) {
+        const uint8_t* src = ids + b * perByte;
+        uint8_t v = 0;
+        for (uint32_t j = 0; j < perByte; ++j) v |= static_cast<uint8_t>(src[j] << (j * bits_));
+        bytes[b] = v;
+    }
+    if (full * perByte < width_) {
+        uint8_t v = 0;
+        for (uint32_t x = full * perByte; x < width_; ++x) v |= static_cast<uint8_t>(ids[x] << ((x % perByte) * bits_));
+        bytes[full] = v;
+    }
+}
+
+PackedBiomeMap PackedBiomeMap::Pack(const BiomeMap& map, bool rowRuns) {
+    if (map.empty()) return PackedBiomeMap();
+    const uint8_t maxId = *std::max_element(map.ids.begin(), map.ids.end());
+    PackedBiomeMap packed(map.width, map.height, maxId);
+    ThreadPool::Global().ParallelFor(0, map.height, 32, [&](uint32_t y0, uint32_t y1) {
+        for (uint32_t y = y0; y < y1; ++y) packed.PackRow(y, &map.ids[static_cast<size_t>(y) * map.width]);
+    });
+    if (rowRuns) packed.CompressRuns();
+    return packed;
+}
+
+BiomeMap PackedBiomeMap::Unpack() const {
+    BiomeMap map(width_, height_);
+    if (empty()) return map;
+    ThreadPool::Global().ParallelFor(0, height_, 32, [&](uint32_t y0, uint32_t y1) {
+        UnpackTile(0, y0, width_, y1 - y0, &map.ids[static_cast<size_t>(y0) * width_], width_);
+    });
+    return map;
+}
+
+void PackedBiomeMap::CompressRuns() {
+    if (empty() || runRows_ != 0 || width_ > kMaxRunWidth) return;
+    // Count runs per row, keep the rows where they beat the packed words
+    const size_t packedBytes = static_cast<size_t>(wordsPerRow_) * sizeof(uint64_t);
+    std::vector<uint32_t> counts(height_);
+    ThreadPool::Global().ParallelFor(0, height_, 32, [&](uint32_t y0, uint32_t y1) {
+        thread_local std::vector<uint8_t> ids;
+        ids.resize(width_);
+        for (uint32_t y = y0; y < y1; ++y) {
+            UnpackRow(y, 0, width_, ids.data());
+            uint32_t runs = 1;
+            for (uint32_t x = 1; x < width_; ++x) runs += ids[x] != ids[x - 1];
+            counts[y] = runs * sizeof(BiomeRun) < packedBytes ? runs : 0;
+        }
+    });
+
+    std::vector<Row> rows(height_);
+    size_t words = 0, runs = 0;
+    for (uint32_t y = 0; y < height_; ++y) {
+        rows[y].runs = counts[y];
+        rows[y].offset = static_cast<uint32_t>(counts[y] ? runs : words);
+        if (counts[y]) {
+            runs += counts[y];
+            ++runRows_;
+        } else {
+            words += wordsPerRow_;
+        }
+    }
+    if (runRows_ == 0) return;
+
+    std::vector<uint64_t> newWords(words);
+    std::vector<BiomeRun> newRuns(runs);
+    ThreadPool::Global().ParallelFor(0, height_, 32, [&](uint32_t y0, uint32_t y1) {
+        thread_local std::vector<uint8_t> ids;
+        ids.resize(width_);
+        for (uint32_t y = y0; y < y1; ++y) {
+            if (rows[y].runs == 0) {
+                std::copy_n(&words_[rows_[y].offset], wordsPerRow_, &newWords[rows[y].offset]);
+                continue;
+            }
+            UnpackRow(y, 0, width_, ids.data());
+            BiomeRun* run = &newRuns[rows[y].offset];
+            for (uint32_t x = 1; x <= width_; ++x) {
+                if (x == width_ || ids[x] != ids[x - 1]) {
+                    run->end = static_cast<uint16_t>(x);
+                    run->id = ids[x - 1];
+                    ++run;
+                }
+            }
+        }
+    });
+    rows_ = std::move(rows);
+    words_ = std::move(newWords);
+    runs_ = std::move(newRuns);
+}
+
+uint8_t PackedBiomeMap::At(uint32_t x, uint32_t y) const {
+    const Row& row = rows_[y];
+    if (row.runs) {
+        const BiomeRun* first = &runs_[row.offset];
+        const BiomeRun* run = std::upper_bound(first, first + row.runs, x,
+                                               [](uint32_t v, const BiomeRun& r) { return v < r.end; });
+        return run->id;
+    }
+    return PackedAt(reinterpret_cast<const uint8_t*>(&words_[row.offset]), bits_, x);
+}
+
+#if TERRAINGEN_X86_SIMD
+// 64 texels from 32 bytes of nibbles
+TERRAINGEN_TARGET_AVX2 static size_t Unpack4AVX2(const uint8_t* src, uint8_t* out, size_t n) {
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i / 2));
+        const __m256i lo = _mm256_and_si256(v, mask);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+        // Interleaving works per 128-bit half: a = bytes 0-7 | 16-23, b = bytes 8-15 | 24-31
+        const __m256i a = _mm256_unpacklo_epi8(lo, hi);
+        const __m256i b = _mm256_unpackhi_epi8(lo, hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    return i;
+}
+
+// 128 texels from 32 bytes of 2-bit fields
+TERRAINGEN_TARGET_AVX2 static size_t Unpack2AVX2(const uint8_t* src, uint8_t* out, size_t n) {
+    const __m256i mask = _mm256_set1_epi8(0x03);
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i / 4));
+        const __m256i t0 = _mm256_and_si256(v, mask);
+        const __m256i t1 = _mm256_and_si256(_mm256_srli_epi16(v, 2), mask);
+        const __m256i t2 = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+        const __m256i t3 = _mm256_and_si256(_mm256_srli_epi16(v, 6), mask);
+        const __m256i lo01 = _mm256_unpacklo_epi8(t0, t1), hi01 = _mm256_unpackhi_epi8(t0, t1);
+        const __m256i lo23 = _mm256_unpacklo_epi8(t2, t3), hi23 = _mm256_unpackhi_epi8(t2, t3);
+        // Per 128-bit half, q0..q3 expand source bytes 0-3, 4-7, 8-11, 12-15
+        const __m256i q0 = _mm256_unpacklo_epi16(lo01, lo23), q1 = _mm256_unpackhi_epi16(lo01, lo23);
+        const __m256i q2 = _mm256_unpacklo_epi16(hi01, hi23), q3 = _mm256_unpackhi_epi16(hi01, hi23);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute2x128_si256(q0, q1, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 32), _mm256_permute2x128_si256(q2, q3, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 64), _mm256_permute2x128_si256(q0, q1, 0x31));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 96), _mm256_permute2x128_si256(q2, q3, 0x31));
+    }
+    return i;
+}
+
+// 128 texels from 64 bytes of nibbles
+TERRAINGEN_TARGET_AVX512 static size_t Unpack4AVX512(const uint8_t* src, uint8_t* out, size_t n) {
+    const __m512i mask = _mm512_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        const __m512i v = _mm512_loadu_si512(src + i / 2);
+        const __m512i lo = _mm512_and_si512(v, mask);
+        const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), mask);
+        const __m512i a = _mm512_unpacklo_epi8(lo, hi);
+        const __m512i b = _mm512_unpackhi_epi8(lo, hi);
+        // 128-bit lanes a0 b0 a1 b1, then a2 b2 a3 b3
+        const __m512i first = _mm512_shuffle_i64x2(a, b, 0x44);
+        const __m512i second = _mm512_shuffle_i64x2(a, b, 0xEE);
+        _mm512_storeu_si512(out + i, _mm512_shuffle_i64x2(first, first, 0xD8));
+        _mm512_storeu_si512(out + i + 64, _mm512_shuffle_i64x2(second, second, 0xD8));
+    }
+    return i;
+}
+
+// 256 texels from 64 bytes of 2-bit fields
+TERRAINGEN_TARGET_AVX512 static size_t Unpack2AVX512(const uint8_t* src, uint8_t* out, size_t n) {
+    const __m512i mask = _mm512_set1_epi8(0x03);
+    size_t i = 0;
+    for (; i + 256 <= n; i += 256) {
+        const __m512i v = _mm512_loadu_si512(src + i / 4);
+        const __m512i t0 = _mm512_and_si512(v, mask);
+        const __m512i t1 = _mm512_and_si512(_mm512_srli_epi16(v, 2), mask);
+        const __m512i t2 = _mm512_and_si512(_mm512_srli_epi16(v, 4), mask);
+        const __m512i t3 = _mm512_and_si512(_mm512_srli_epi16(v, 6), mask);
+        const __m512i lo01 = _mm512_unpacklo_epi8(t0, t1), hi01 = _mm512_unpackhi_epi8(t0, t1);
+        const __m512i lo23 = _mm512_unpacklo_epi8(t2, t3), hi23 = _mm512_unpackhi_epi8(t2, t3);
+        const __m512i q0 = _mm512_unpacklo_epi16(lo01, lo23), q1 = _mm512_unpackhi_epi16(lo01, lo23);
+        const __m512i q2 = _mm512_unpacklo_epi16(hi01, hi23), q3 = _mm512_unpackhi_epi16(hi01, hi23);
+        // 4x4 transpose of 128-bit lanes: output k takes lane k of q0..q3
+        const __m512i a01 = _mm512_shuffle_i64x2(q0, q1, 0x44), a23 = _mm512_shuffle_i64x2(q2, q3, 0x44);
+        const __m512i b01 = _mm512_shuffle_i64x2(q0, q1, 0xEE), b23 = _mm512_shuffle_i64x2(q2, q3, 0xEE);
+        _mm512_storeu_si512(out + i, _mm512_shuffle_i64x2(a01, a23, 0x88));
+        _mm512_storeu_si512(out + i + 64, _mm512_shuffle_i64x2(a01, a23, 0xDD));
+        _mm512_storeu_si512(out + i + 128, _mm512_shuffle_i64x2(b01, b23, 0x88));
+        _mm512_storeu_si512(out + i + 192, _mm512_shuffle_i64x2(b01, b23, 0xDD));
+    }
+    return i;
+}
+#endif
+
+// Unpack n texels starting at a byte boundary; returns how many the vector kernels covered
+static size_t UnpackAligned(const uint8_t* src, uint32_t bits, uint8_t* out, size_t n) {
+#if TERRAINGEN_X86_SIMD
+    switch (ActiveSimdISA()) {
+        case SimdISA::AVX512: return bits == 4 ? Unpack4AVX512(src, out, n) : Unpack2AVX512(src, out, n);
+        case SimdISA::AVX2: return bits == 4 ? Unpack4AVX2(src, out, n) : Unpack2AVX2(src, out, n);
+        default: break;
+    }
+#endif
+    (void)src;
+    (void)bits;
+    (void)out;
+    (void)n;
+    return 0;
+}
+
+void PackedBiomeMap::UnpackRow(uint32_t y, uint32_t x0, uint32_t n, uint8_t* out) const {
+    const Row& row = rows_[y];
+    if (row.runs) {
+        const BiomeRun* first = &runs_[row.offset];
+        const BiomeRun* run = std::upper_bound(first, first + row.runs, x0,
+                                               [](uint32_t v, const BiomeRun& r) { return v < r.end; });
+        for (uint32_t x = x0, end = x0 + n; x < end; ++run) {
+            const uint32_t stop = std::min<uint32_t>(run->end, end);
+            std::memset(out + (x - x0), run->id, stop - x);
+            x = stop;
+        }
+        return;
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&words_[row.offset]);
+    if (bits_ == 8) {
+        std::memcpy(out, bytes + x0, n);
+        return;
+    }
+    // Scalar up to a byte boundary, vectors through the middle, scalar tail
+    const uint32_t perByte = 8 / bits_;
+    uint32_t k = 0;
+    for (; k < n && (x0 + k) % perByte != 0; ++k) out[k] = PackedAt(bytes, bits_, x0 + k);
+    k += static_cast<uint32_t>(UnpackAligned(bytes + (x0 + k) / perByte, bits_, out + k, n - k));
+    for (; k < n; ++k) out[k] = PackedAt(bytes, bits_, x0 + k);
+}
+
+void PackedBiomeMap::UnpackTile(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, uint8_t* out,
+                                size_t pitch) const {
+    for (uint32_t y = 0; y < h; ++y) UnpackRow(y0 + y, x0, w, out + y * pitch);
+}
+
+size_t PackedBiomeMap::Bytes() const {
+    return rows_.size() * sizeof(Row) + words_.size() * sizeof(uint64_t) + runs_.size() * sizeof(BiomeRun);
+}
+
+} // namespace terraingen
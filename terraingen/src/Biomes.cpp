@@ -1,197 +1,396 @@
 #include "Biomes.hpp"
+#include "BiomeDistance.hpp"
 #include "GPUContext.hpp"
+#include "PipelineRegistry.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <array>
 #include <cmath>
-#ifdef __EMSCRIPTEN__
-#include <webgpu/webgpu.h>
-#include <emscripten.h>
-#include <fstream>
-#include <iterator>
-#include <string>
+#if TERRAINGEN_X86_SIMD
+#include <immintrin.h>
 #endif
 
 namespace terraingen {
 
-BiomeMap Biomes::Classify(const GPUTexture heightTex, GPUContext& gpu) {
-    const auto& heightInfo = gpu.GetTexture(heightTex);
-    uint32_t w = heightInfo.width;
-    uint32_t h = heightInfo.height;
+BiomePreset DefaultBiomePreset() {
+    BiomePreset p;
+    auto rule = [&](BiomeID id) -> BiomeRule& {
+        p.rules.push_back(BiomeRule{});
+        p.rules.back().id = id;
+        return p.rules.back();
+    };
+    rule(BiomeID::Water).maxHeight = 0.33f;
+    rule(BiomeID::Rock).minSlope = 0.015f;
+    rule(BiomeID::Snow).minHeight = 0.66f;
+    // Snow line drops to 0.5 in cold climates
+    BiomeRule& coldSnow = rule(BiomeID::Snow);
+    coldSnow.minHeight = 0.5f;
+    coldSnow.maxTemperature = 0.25f;
+    rule(BiomeID::Tundra).maxTemperature = 0.25f;
+    BiomeRule& desert = rule(BiomeID::Desert);
+    desert.maxHumidity = 0.25f;
+    desert.minTemperature = 0.6f;
+    rule(BiomeID::Forest).minHumidity = 0.6f;
+    p.fallback = BiomeID::Grass;
+    return p;
+}
 
-#ifdef __EMSCRIPTEN__
-    if (gpu.HasDevice()) {
-        // 1. Create output R8 texture
-        GPUTexture outTexID = gpu.CreateTexture2D_U8(w, h);
-        auto& outTex = gpu.GetTexture(outTexID);
-
-        WGPUDevice device = emscripten_webgpu_get_device();
-
-        // --- create / cache shader module & pipeline ---
-        struct PipelineCache {
-            WGPUShaderModule module = nullptr;
-            WGPUBindGroupLayout bgl = nullptr;
-            WGPUPipelineLayout pl = nullptr;
-            WGPUComputePipeline pipeline = nullptr;
+const BiomeMaterial* BiomeMaterials() {
+    static const auto table = [] {
+        std::array<BiomeMaterial, 256> t{};
+        auto set = [&](BiomeID id, float param, float albedo, float roughness) {
+            t[static_cast<uint8_t>(id)] = BiomeMaterial{param, albedo, roughness};
         };
-        static PipelineCache cache;
-        if (!cache.pipeline) {
-            // Load WGSL shader source from external file
-            std::ifstream file("terraingen/shaders/biome_classify.wgsl");
-            std::string wgslSrc((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            if (!file) {
-                // Failed to load shader file; fallback to CPU path
+        set(BiomeID::Water, 0.2f, 0.2f, 0.4f);   // dark, smooth
+        set(BiomeID::Grass, 0.6f, 0.5f, 0.9f);   // diffuse
+        set(BiomeID::Snow, 0.8f, 0.9f, 0.3f);    // bright, semi-smooth
+        set(BiomeID::Rock, 0.7f, 0.45f, 0.8f);
+        set(BiomeID::Desert, 0.4f, 0.75f, 0.7f); // sand
+        set(BiomeID::Forest, 0.5f, 0.3f, 0.95f); // dark canopy
+        set(BiomeID::Tundra, 0.3f, 0.6f, 0.6f);
+        return t;
+    }();
+    return table.data();
+}
+
+// Bin index of v * scale clamped to [0, maxBin]; NaN lands in bin 0. The SIMD kernels use the
+// same mul / max / min / truncate sequence, so bins match bit for bit.
+static inline uint32_t Quantize(float v, float scale, float maxBin) {
+    v = v * scale;
+    v = v > 0.0f ? v : 0.0f;
+    v = v < maxBin ? v : maxBin;
+    return static_cast<uint32_t>(v);
+}
+
+BiomeClassifier::BiomeClassifier(const BiomePreset& preset) : preset_(preset) {
+    if (preset_.rules.size() > kMaxBiomeRules) preset_.rules.resize(kMaxBiomeRules);
+    slopeScale_ = kSlopeBins / std::max(preset_.maxSlope, 1e-6f);
+
+    // Gathers read 32 bits at a byte offset, so both tables carry 3 bytes of padding
+    std::vector<uint32_t> zoneMasks;
+    climate_.assign(kClimateBins * kClimateBins + 3, 0);
+    for (uint32_t t = 0; t < kClimateBins; ++t) {
+        const float temperature = (t + 0.5f) / kClimateBins;
+        for (uint32_t u = 0; u < kClimateBins; ++u) {
+            const float humidity = (u + 0.5f) / kClimateBins;
+            uint32_t mask = 0;
+            for (size_t r = 0; r < preset_.rules.size(); ++r) {
+                const BiomeRule& rule = preset_.rules[r];
+                if (humidity >= rule.minHumidity && humidity < rule.maxHumidity &&
+                    temperature >= rule.minTemperature && temperature < rule.maxTemperature) {
+                    mask |= 1u << r;
+                }
+            }
+            auto it = std::find(zoneMasks.begin(), zoneMasks.end(), mask);
+            if (it == zoneMasks.end() && zoneMasks.size() < kMaxZones) {
+                zoneMasks.push_back(mask);
+                it = zoneMasks.end() - 1;
+            } else if (it == zoneMasks.end()) {
+                it = zoneMasks.end() - 1;
             }
-            WGPUShaderModuleWGSLDescriptor wgslDesc{};
-            wgslDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
-            wgslDesc.code = wgslSrc.c_str();
-            WGPUShaderModuleDescriptor smDesc{};
-            smDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgslDesc);
-            cache.module = wgpuDeviceCreateShaderModule(device, &smDesc);
-
-            // Bind group layout (uniform, height tex, writable tex)
-            WGPUBindGroupLayoutEntry entries[3] = {};
-            entries[0].binding = 0;
-            entries[0].visibility = WGPUShaderStage_Compute;
-            entries[0].buffer.type = WGPUBufferBindingType_Uniform;
-            entries[0].buffer.minBindingSize = sizeof(float) * 2;
-
-            entries[1].binding = 1;
-            entries[1].visibility = WGPUShaderStage_Compute;
-            entries[1].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
-            entries[1].texture.viewDimension = WGPUTextureViewDimension_2D;
-
-            entries[2].binding = 2;
-            entries[2].visibility = WGPUShaderStage_Compute;
-            entries[2].storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
-            entries[2].storageTexture.format = WGPUTextureFormat_R8Uint;
-            entries[2].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
-
-            WGPUBindGroupLayoutDescriptor bglDesc{};
-            bglDesc.entryCount = 3;
-            bglDesc.entries = entries;
-            cache.bgl = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
-
-            WGPUPipelineLayoutDescriptor plDesc{};
-            plDesc.bindGroupLayoutCount = 1;
-            plDesc.bindGroupLayouts = &cache.bgl;
-            cache.pl = wgpuDeviceCreatePipelineLayout(device, &plDesc);
-
-            WGPUComputePipelineDescriptor cpDesc{};
-            cpDesc.layout = cache.pl;
-            cpDesc.compute.module = cache.module;
-            cpDesc.compute.entryPoint = "main";
-            cache.pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
+            climate_[t * kClimateBins + u] = static_cast<uint8_t>(it - zoneMasks.begin());
         }
+    }
+    zones_ = static_cast<uint32_t>(zoneMasks.size());
 
-        // --- Create uniform buffer with thresholds ---
-        struct ThresholdUBO { float low; float mid; } thresholds{0.33f, 0.66f};
-        WGPUBufferDescriptor ubDesc{};
-        ubDesc.size = sizeof(ThresholdUBO);
-        ubDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
-        ubDesc.mappedAtCreation = false;
-        WGPUBuffer ubo = wgpuDeviceCreateBuffer(device, &ubDesc);
-        wgpuQueueWriteBuffer(gpu.Queue(), ubo, 0, &thresholds, sizeof(thresholds));
-
-        // Bind group
-        WGPUBindGroupEntry bgEntries[3] = {};
-        bgEntries[0].binding = 0;
-        bgEntries[0].buffer = ubo;
-        bgEntries[0].offset = 0;
-        bgEntries[0].size = sizeof(ThresholdUBO);
-
-        bgEntries[1].binding = 1;
-        bgEntries[1].textureView = heightInfo.gpuView;
-
-        bgEntries[2].binding = 2;
-        bgEntries[2].textureView = outTex.gpuView;
-
-        WGPUBindGroupDescriptor bgDesc{};
-        bgDesc.layout = cache.bgl;
-        bgDesc.entryCount = 3;
-        bgDesc.entries = bgEntries;
-        WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
-
-        // Command encoder & pass
-        WGPUCommandEncoderDescriptor encDesc{};
-        WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &encDesc);
-
-        WGPUComputePassDescriptor passDesc{};
-        WGPUComputePassEncoder cpass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
-        wgpuComputePassEncoderSetPipeline(cpass, cache.pipeline);
-        wgpuComputePassEncoderSetBindGroup(cpass, 0, bindGroup, 0, nullptr);
-        uint32_t wgX = (w + 7) / 8;
-        uint32_t wgY = (h + 7) / 8;
-        wgpuComputePassEncoderDispatchWorkgroups(cpass, wgX, wgY, 1);
-        wgpuComputePassEncoderEnd(cpass);
-
-        WGPUCommandBufferDescriptor cbDesc{};
-        WGPUCommandBuffer cmdBuf = wgpuCommandEncoderFinish(encoder, &cbDesc);
-        wgpuQueueSubmit(gpu.Queue(), 1, &cmdBuf);
-
-        // --- Read back outputTex into CPU ---
-        size_t byteSize = static_cast<size_t>(w) * h;
-        WGPUBufferDescriptor readDesc{};
-        readDesc.size = byteSize;
-        readDesc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead;
-        readDesc.mappedAtCreation = false;
-        WGPUBuffer readBuf = wgpuDeviceCreateBuffer(device, &readDesc);
-
-        WGPUImageCopyTexture srcTex{};
-        srcTex.texture = outTex.gpuTex;
-        srcTex.mipLevel = 0;
-        srcTex.origin = {0,0,0};
-
-        WGPUImageCopyBuffer dstBuf{};
-        dstBuf.buffer = readBuf;
-        dstBuf.layout.bytesPerRow = w;
-        dstBuf.layout.rowsPerImage = h;
-
-        WGPUExtent3D copySize = {w, h, 1};
-        WGPUCommandEncoder encoder2 = wgpuDeviceCreateCommandEncoder(device, nullptr);
-        wgpuCommandEncoderCopyTextureToBuffer(encoder2, &srcTex, &dstBuf, &copySize);
-        WGPUCommandBuffer copyCmd = wgpuCommandEncoderFinish(encoder2, nullptr);
-        wgpuQueueSubmit(gpu.Queue(), 1, &copyCmd);
-
-        // Wait and map
-        struct UserData { bool done; } userdata{false};
-        auto callback = [](WGPUBufferMapAsyncStatus status, void* userdata) {
-            auto* ud = static_cast<UserData*>(userdata);
-            ud->done = true;
-        };
-        wgpuBufferMapAsync(readBuf, WGPUMapMode_Read, 0, byteSize, callback, &userdata);
-        // busy wait (not ideal but fine for WASM single-thread demo)
-        while(!userdata.done) { emscripten_sleep(0); }
+    terrain_.assign(static_cast<size_t>(zones_) * kHeightBins * kSlopeBins + 3, static_cast<uint8_t>(preset_.fallback));
+    for (uint32_t z = 0; z < zones_; ++z) {
+        for (uint32_t hb = 0; hb < kHeightBins; ++hb) {
+            const float height = (hb + 0.5f) / kHeightBins;
+            for (uint32_t sb = 0; sb < kSlopeBins; ++sb) {
+                const float slope = (sb + 0.5f) / slopeScale_;
+                uint8_t& cell = terrain_[(static_cast<size_t>(z) * kHeightBins + hb) * kSlopeBins + sb];
+                for (size_t r = 0; r < preset_.rules.size(); ++r) {
+                    const BiomeRule& rule = preset_.rules[r];
+                    if ((zoneMasks[z] >> r & 1u) && height >= rule.minHeight && height < rule.maxHeight &&
+                        slope >= rule.minSlope && slope < rule.maxSlope) {
+                        cell = static_cast<uint8_t>(rule.id);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    maxId_ = *std::max_element(terrain_.begin(), terrain_.end());
+}
 
-        const uint8_t* mapped = static_cast<const uint8_t*>(wgpuBufferGetMappedRange(readBuf, 0, byteSize));
-        BiomeMap gpuMap(byteSize);
-        memcpy(gpuMap.data(), mapped, byteSize);
-        wgpuBufferUnmap(readBuf);
+std::vector<uint32_t> BiomeClassifier::PackedTables() const {
+    const size_t climateBytes = kClimateBins * kClimateBins;
+    const size_t terrainBytes = terrain_.size() - 3;
+    std::vector<uint32_t> words((climateBytes + terrainBytes + 3) / 4, 0);
+    auto put = [&](size_t i, uint8_t v) { words[i / 4] |= uint32_t{v} << (i % 4 * 8); };
+    for (size_t i = 0; i < climateBytes; ++i) put(i, climate_[i]);
+    for (size_t i = 0; i < terrainBytes; ++i) put(climateBytes + i, terrain_[i]);
+    return words;
+}
 
-        // Move data into outTex CPU mirror for debug
-        outTex.dataU8.assign(gpuMap.begin(), gpuMap.end());
+BiomeID BiomeClassifier::Evaluate(float height, float slope, float humidity, float temperature) const {
+    for (const BiomeRule& rule : preset_.rules) {
+        if (height >= rule.minHeight && height < rule.maxHeight && slope >= rule.minSlope &&
+            slope < rule.maxSlope && humidity >= rule.minHumidity && humidity < rule.maxHumidity &&
+            temperature >= rule.minTemperature && temperature < rule.maxTemperature) {
+            return rule.id;
+        }
+    }
+    return preset_.fallback;
+}
 
-        return gpuMap;
+// Tables and scales shared by the row kernels
+struct BiomeLUT {
+    const uint8_t* climate;
+    const uint8_t* terrain;
+    float slopeScale;
+};
+
+static void ClassifyRowScalar(const BiomeLUT& lut, const float* height, const float* gradX, const float* gradZ,
+                              const float* humidity, const float* temperature, uint8_t* out, size_t n) {
+    const float kHeightScale = BiomeClassifier::kHeightBins;
+    const float kClimateScale = BiomeClassifier::kClimateBins;
+    for (size_t i = 0; i < n; ++i) {
+        const float slope = std::sqrt(gradX[i] * gradX[i] + gradZ[i] * gradZ[i]);
+        const uint32_t hb = Quantize(height[i], kHeightScale, kHeightScale - 1.0f);
+        const uint32_t sb = Quantize(slope, lut.slopeScale, BiomeClassifier::kSlopeBins - 1.0f);
+        const uint32_t ub = Quantize(humidity[i], kClimateScale, kClimateScale - 1.0f);
+        const uint32_t tb = Quantize(temperature[i], kClimateScale, kClimateScale - 1.0f);
+        const uint32_t zone = lut.climate[tb * BiomeClassifier::kClimateBins + ub];
+        out[i] = lut.terrain[(zone * BiomeClassifier::kHeightBins + hb) * BiomeClassifier::kSlopeBins + sb];
     }
+}
+
+#if TERRAINGEN_X86_SIMD
+// Table index math below hard-codes these shifts
+static_assert(BiomeClassifier::kClimateBins == 16 && BiomeClassifier::kSlopeBins == 16 &&
+              BiomeClassifier::kHeightBins == 64, "biome LUT layout");
+
+TERRAINGEN_TARGET_AVX2 static inline __m256i QuantizeAVX2(__m256 v, __m256 scale, __m256 maxBin) {
+    v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, scale), _mm256_setzero_ps()), maxBin);
+    return _mm256_cvttps_epi32(v);
+}
+
+// Eight texels: quantize, climate gather, terrain gather; ids in the low byte of each lane
+TERRAINGEN_TARGET_AVX2 static inline __m256i ClassifyAVX2(const BiomeLUT& lut, const float* height,
+                                                          const float* gradX, const float* gradZ,
+                                                          const float* humidity, const float* temperature) {
+    const __m256 heightScale = _mm256_set1_ps(BiomeClassifier::kHeightBins);
+    const __m256 heightMax = _mm256_set1_ps(BiomeClassifier::kHeightBins - 1.0f);
+    const __m256 slopeScale = _mm256_set1_ps(lut.slopeScale);
+    const __m256 slopeMax = _mm256_set1_ps(BiomeClassifier::kSlopeBins - 1.0f);
+    const __m256 climateScale = _mm256_set1_ps(BiomeClassifier::kClimateBins);
+    const __m256 climateMax = _mm256_set1_ps(BiomeClassifier::kClimateBins - 1.0f);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256 gx = _mm256_loadu_ps(gradX), gz = _mm256_loadu_ps(gradZ);
+    const __m256 slope = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gz, gz)));
+    const __m256i hb = QuantizeAVX2(_mm256_loadu_ps(height), heightScale, heightMax);
+    const __m256i sb = QuantizeAVX2(slope, slopeScale, slopeMax);
+    const __m256i ub = QuantizeAVX2(_mm256_loadu_ps(humidity), climateScale, climateMax);
+    const __m256i tb = QuantizeAVX2(_mm256_loadu_ps(temperature), climateScale, climateMax);
+    const __m256i cidx = _mm256_add_epi32(_mm256_slli_epi32(tb, 4), ub);
+    const __m256i zone = _mm256_and_si256(
+        _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut.climate), cidx, 1), byteMask);
+    const __m256i tidx = _mm256_add_epi32(_mm256_slli_epi32(zone, 10), _mm256_add_epi32(_mm256_slli_epi32(hb, 4), sb));
+    return _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(lut.terrain), tidx, 1), byteMask);
+}
+
+TERRAINGEN_TARGET_AVX2 static size_t ClassifyRowAVX2(const BiomeLUT& lut, const float* height, const float* gradX,
+                                                     const float* gradZ, const float* humidity,
+                                                     const float* temperature, uint8_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i a = ClassifyAVX2(lut, height + i, gradX + i, gradZ + i, humidity + i, temperature + i);
+        const __m256i b = ClassifyAVX2(lut, height + i + 8, gradX + i + 8, gradZ + i + 8, humidity + i + 8,
+                                       temperature + i + 8);
+        // 32 -> 16 bits packs per 128-bit half; restore order, then 16 -> 8 bits
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+    }
+    return i;
+}
+
+TERRAINGEN_TARGET_AVX512 static inline __m512i QuantizeAVX512(__m512 v, __m512 scale, __m512 maxBin) {
+    v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(v, scale), _mm512_setzero_ps()), maxBin);
+    return _mm512_cvttps_epi32(v);
+}
+
+// Sixteen texels; ids in the low byte of each lane
+TERRAINGEN_TARGET_AVX512 static inline __m512i ClassifyAVX512(const BiomeLUT& lut, const float* height,
+                                                              const float* gradX, const float* gradZ,
+                                                              const float* humidity, const float* temperature) {
+    const __m512 heightScale = _mm512_set1_ps(BiomeClassifier::kHeightBins);
+    const __m512 heightMax = _mm512_set1_ps(BiomeClassifier::kHeightBins - 1.0f);
+    const __m512 slopeScale = _mm512_set1_ps(lut.slopeScale);
+    const __m512 slopeMax = _mm512_set1_ps(BiomeClassifier::kSlopeBins - 1.0f);
+    const __m512 climateScale = _mm512_set1_ps(BiomeClassifier::kClimateBins);
+    const __m512 climateMax = _mm512_set1_ps(BiomeClassifier::kClimateBins - 1.0f);
+    const __m512 gx = _mm512_loadu_ps(gradX), gz = _mm512_loadu_ps(gradZ);
+    const __m512 slope = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(gx, gx), _mm512_mul_ps(gz, gz)));
+    const __m512i hb = QuantizeAVX512(_mm512_loadu_ps(height), heightScale, heightMax);
+    const __m512i sb = QuantizeAVX512(slope, slopeScale, slopeMax);
+    const __m512i ub = QuantizeAVX512(_mm512_loadu_ps(humidity), climateScale, climateMax);
+    const __m512i tb = QuantizeAVX512(_mm512_loadu_ps(temperature), climateScale, climateMax);
+    const __m512i cidx = _mm512_add_epi32(_mm512_slli_epi32(tb, 4), ub);
+    const __m512i zone = _mm512_and_si512(_mm512_i32gather_epi32(cidx, lut.climate, 1), _mm512_set1_epi32(0xff));
+    const __m512i tidx = _mm512_add_epi32(_mm512_slli_epi32(zone, 10), _mm512_add_epi32(_mm512_slli_epi32(hb, 4), sb));
+    return _mm512_i32gather_epi32(tidx, lut.terrain, 1);
+}
+
+TERRAINGEN_TARGET_AVX512 static size_t ClassifyRowAVX512(const BiomeLUT& lut, const float* height,
+                                                         const float* gradX, const float* gradZ,
+                                                         const float* humidity, const float* temperature,
+                                                         uint8_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m512i a = ClassifyAVX512(lut, height + i, gradX + i, gradZ + i, humidity + i, temperature + i);
+        const __m512i b = ClassifyAVX512(lut, height + i + 16, gradX + i + 16, gradZ + i + 16, humidity + i + 16,
+                                         temperature + i + 16);
+        // vpmovdb keeps the low byte of each lane
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm512_cvtepi32_epi8(a));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 16), _mm512_cvtepi32_epi8(b));
+    }
+    for (; i + 16 <= n; i += 16) {
+        const __m512i a = ClassifyAVX512(lut, height + i, gradX + i, gradZ + i, humidity + i, temperature + i);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm512_cvtepi32_epi8(a));
+    }
+    return i;
+}
 #endif
 
-    // CPU fallback / data for pipeline
-    size_t pixelCount = static_cast<size_t>(w) * h;
-    BiomeMap map(pixelCount);
-    for (size_t i = 0; i < pixelCount; ++i) {
-        float v = heightInfo.data[i];
-        uint8_t id = (v < 0.33f) ? 0 : (v < 0.66f ? 1 : 2);
-        map[i] = id;
+void BiomeClassifier::ClassifyRow(const float* height, const float* gradX, const float* gradZ,
+                                  const float* humidity, const float* temperature, uint8_t* out, size_t n) const {
+    // Missing inputs read from constant rows, so the kernels never branch on them
+    thread_local std::vector<float> zeros, halves;
+    if (!gradX || !gradZ) {
+        if (zeros.size() < n) zeros.assign(n, 0.0f);
+        gradX = gradZ = zeros.data();
+    }
+    if (!humidity || !temperature) {
+        if (halves.size() < n) halves.assign(n, 0.5f);
+        if (!humidity) humidity = halves.data();
+        if (!temperature) temperature = halves.data();
+    }
+    const BiomeLUT lut{climate_.data(), terrain_.data(), slopeScale_};
+    size_t done = 0;
+#if TERRAINGEN_X86_SIMD
+    switch (ActiveSimdISA()) {
+        case SimdISA::AVX512:
+            done = ClassifyRowAVX512(lut, height, gradX, gradZ, humidity, temperature, out, n);
+            break;
+        case SimdISA::AVX2: done = ClassifyRowAVX2(lut, height, gradX, gradZ, humidity, temperature, out, n); break;
+        default: break;
     }
+#endif
+    ClassifyRowScalar(lut, height + done, gradX + done, gradZ + done, humidity + done, temperature + done,
+                      out + done, n - done);
+}
+
+BiomeMap Biomes::Classify(const GPUTexture heightTex, GPUContext& gpu) {
+    BiomeInputs inputs;
+    inputs.height = heightTex;
+    return Classify(inputs, gpu);
+}
+
+const BiomeClassifier& DefaultBiomeClassifier() {
+    static const BiomeClassifier classifier(DefaultBiomePreset());
+    return classifier;
+}
+
+BiomeMap Biomes::Classify(const BiomeInputs& inputs, GPUContext& gpu) {
+    return Classify(inputs, gpu, DefaultBiomeClassifier());
+}
+
+GPUTexture Biomes::RecordClassify(const BiomeInputs& inputs, GPUContext& gpu, const BiomeClassifier& classifier) {
+    if (!gpu.HasDevice()) return 0;
+    const auto& heightInfo = gpu.GetTexture(inputs.height);
+    const uint32_t w = heightInfo.width;
+    const uint32_t h = heightInfo.height;
+    // The classifier's tables in a storage buffer, indexed as ClassifyRow does, into an R8
+    // texture. A missing input binds the height in its place, and the flags tell the shader to
+    // use the default instead.
+    const GPUTexture outTex = gpu.CreateTexture2D_U8(w, h);
+    struct ClassifyUBO {
+        float slopeScale;
+        uint32_t flags;
+        uint32_t terrainOffset;
+        uint32_t pad;
+    } params{classifier.SlopeScale(), 0u, BiomeClassifier::kClimateBins * BiomeClassifier::kClimateBins, 0u};
+    const bool hasGrad = inputs.gradX && inputs.gradZ;
+    params.flags = (hasGrad ? 1u : 0u) | (inputs.humidity ? 2u : 0u) | (inputs.temperature ? 4u : 0u);
+    auto bound = [&](GPUTexture tex, bool present) { return PassBinding::Texture(present ? tex : inputs.height); };
+    const std::vector<uint32_t> tables = classifier.PackedTables();
+    PassGraph& passes = gpu.Passes();
+    const PassGraph::BufferID ubo = passes.CreateBuffer(PassGraph::BufferUsage::Uniform, sizeof(params), &params);
+    const PassGraph::BufferID lut =
+        passes.CreateBuffer(PassGraph::BufferUsage::Storage, tables.size() * sizeof(uint32_t), tables.data());
+    passes.Add({PipelineID::BiomeClassify, w, h,
+                {PassBinding::Buffer(ubo), PassBinding::Buffer(lut), PassBinding::Texture(inputs.height),
+                 bound(inputs.gradX, hasGrad), bound(inputs.gradZ, hasGrad),
+                 bound(inputs.humidity, inputs.humidity != 0), bound(inputs.temperature, inputs.temperature != 0),
+                 PassBinding::Texture(outTex)}});
+    passes.ReleaseBuffer(ubo);
+    passes.ReleaseBuffer(lut);
+    return outTex;
+}
+
+BiomeMap Biomes::Classify(const BiomeInputs& inputs, GPUContext& gpu, const BiomeClassifier& classifier) {
+    const auto& heightInfo = gpu.GetTexture(inputs.height);
+    uint32_t w = heightInfo.width;
+    uint32_t h = heightInfo.height;
+
+    if (gpu.HasDevice()) {
+        // Reading the ids back submits the chunk's passes so far together with the copy
+        ScopedTexture outTex(gpu, RecordClassify(inputs, gpu, classifier));
+        gpu.Readback(outTex.get());
+        BiomeMap gpuMap(w, h);
+        const uint8_t* ids = gpu.GetTexture(outTex.get()).As<uint8_t>();
+        std::copy(ids, ids + gpuMap.size(), gpuMap.ids.begin());
+        return gpuMap;
+    }
+
+    // CPU fallback / data for pipeline
+    auto rows = [&](GPUTexture tex) { return tex ? gpu.GetTexture(tex).As<float>() : nullptr; };
+    const float* height = heightInfo.As<float>();
+    const float* gradX = rows(inputs.gradX);
+    const float* gradZ = rows(inputs.gradZ);
+    const float* humidity = rows(inputs.humidity);
+    const float* temperature = rows(inputs.temperature);
+    BiomeMap map(w, h);
+    ThreadPool::Global().ParallelFor(0, h, 32, [&](uint32_t y0, uint32_t y1) {
+        for (uint32_t y = y0; y < y1; ++y) {
+            const size_t row = static_cast<size_t>(y) * w;
+            auto at = [&](const float* p) { return p ? p + row : nullptr; };
+            classifier.ClassifyRow(height + row, at(gradX), at(gradZ), at(humidity), at(temperature),
+                                   &map.ids[row], w);
+        }
+    });
     return map;
 }
 
-GPUTexture Biomes::GenerateParameters(const BiomeMap& map, GPUContext& gpu) {
+GPUTexture Biomes::GenerateParameters(const PackedBiomeMap& map, GPUContext& gpu, const BiomeDistanceField* edges) {
     if (map.empty()) return 0;
-    uint32_t size = static_cast<uint32_t>(std::sqrt(map.size()));
-    GPUTexture texID = gpu.CreateTexture2D(size, size);
+    const uint32_t w = map.width();
+    // Every row is written below
+    GPUTexture texID = gpu.CreateTexture2D(w, map.height(), kMaterialFormat, TextureInit::Uninitialized);
     auto& tex = gpu.GetTexture(texID);
-    for (size_t i = 0; i < map.size(); ++i) {
-        uint8_t id = map[i];
-        tex.data[i] = id == 0 ? 0.2f : (id == 1 ? 0.6f : 0.8f);
-    }
+    const BiomeMaterial* materials = BiomeMaterials();
+    ThreadPool::Global().ParallelFor(0, map.height(), 32, [&](uint32_t y0, uint32_t y1) {
+        thread_local std::vector<uint8_t> ids;
+        thread_local std::vector<float> row;
+        ids.resize(w);
+        row.resize(w);
+        for (uint32_t y = y0; y < y1; ++y) {
+            map.UnpackRow(y, 0, w, ids.data());
+            const size_t base = static_cast<size_t>(y) * w;
+            if (edges) {
+                for (uint32_t x = 0; x < w; ++x) {
+                    row[x] = BlendedChannel(materials, ids[x], *edges, base + x, &BiomeMaterial::param);
+                }
+            } else {
+                for (uint32_t x = 0; x < w; ++x) row[x] = materials[ids[x]].param;
+            }
+            tex.Write(base, w, row.data());
+        }
+    });
     return texID;
 }
 
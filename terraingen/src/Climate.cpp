@@ -0,0 +1,192 @@
+#include "Climate.hpp"
+#include "GPUContext.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace terraingen {
+
+// Lines blurred per task; also the tile height of the transposed writes
+static constexpr uint32_t kLineBlock = 32;
+
+// One box pass with clamp-to-edge: dst[i] = mean of src[i - r .. i + r]. The running sum is kept
+// in double so the result barely depends on where the line starts.
+static void BoxLine(const float* src, float* dst, uint32_t n, uint32_t r) {
+    const int64_t last = static_cast<int64_t>(n) - 1;
+    auto at = [&](int64_t i) { return static_cast<double>(src[std::min(std::max(i, int64_t(0)), last)]); };
+    const double inv = 1.0 / (2.0 * r + 1.0);
+    double sum = 0.0;
+    for (int64_t k = -static_cast<int64_t>(r); k <= static_cast<int64_t>(r); ++k) sum += at(k);
+    for (uint32_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<float>(sum * inv);
+        sum += at(static_cast<int64_t>(i) + r + 1) - at(static_cast<int64_t>(i) - r);
+    }
+}
+
+// Three box passes; the result ends up in `b`
+static const float* BlurLine(float* a, float* b, uint32_t n, uint32_t r) {
+    if (r == 0) {
+        std::copy_n(a, n, b);
+        return b;
+    }
+    BoxLine(a, b, n, r);
+    BoxLine(b, a, n, r);
+    BoxLine(a, b, n, r);
+    return b;
+}
+
+// Blur `lines` lines of length `len` and write samples [keep0, keep0 + keepN) of each line
+// transposed: dst[(k - keep0) * lines + line]. Each block of lines is finished in L1 and then
+// written one kLineBlock-wide column run per kept sample.
+static void BlurLinesTransposed(const float* src, uint32_t lines, uint32_t len, uint32_t keep0, uint32_t keepN,
+                                uint32_t r, float* dst) {
+    const uint32_t blocks = (lines + kLineBlock - 1) / kLineBlock;
+    ThreadPool::Global().ParallelFor(0, blocks, 1, [&](uint32_t b0, uint32_t b1) {
+        thread_local std::vector<float> block, scratch;
+        block.resize(static_cast<size_t>(kLineBlock) * len);
+        scratch.resize(len);
+        for (uint32_t b = b0; b < b1; ++b) {
+            const uint32_t first = b * kLineBlock;
+            const uint32_t count = std::min(kLineBlock, lines - first);
+            for (uint32_t l = 0; l < count; ++l) {
+                float* line = &block[static_cast<size_t>(l) * len];
+                std::copy_n(src + static_cast<size_t>(first + l) * len, len, line);
+                const float* out = BlurLine(line, scratch.data(), len, r);
+                if (out != line) std::copy_n(out, len, line);
+            }
+            for (uint32_t k = 0; k < keepN; ++k) {
+                float* column = dst + static_cast<size_t>(k) * lines + first;
+                for (uint32_t l = 0; l < count; ++l) column[l] = block[static_cast<size_t>(l) * len + keep0 + k];
+            }
+        }
+    });
+}
+
+void DiffuseField(const float* src, uint32_t width, uint32_t height, uint32_t border, uint32_t radius, float* dst) {
+    const uint32_t r = radius / 3;
+    const uint32_t iw = width - 2 * border;
+    const uint32_t ih = height - 2 * border;
+    // Rows -> transposed interior columns -> rows again. Held per call: the pool's workers may
+    // run another chunk's DiffuseField while this one waits in ParallelFor.
+    std::vector<float> transposed(static_cast<size_t>(iw) * height);
+    BlurLinesTransposed(src, height, width, border, iw, r, transposed.data());
+    BlurLinesTransposed(transposed.data(), iw, height, border, ih, r, dst);
+}
+
+void DiffuseFieldStrided(const float* src, uint32_t width, uint32_t height, uint32_t border, uint32_t radius,
+                         float* dst) {
+    const uint32_t r = radius / 3;
+    const uint32_t iw = width - 2 * border;
+    std::vector<float> rows(static_cast<size_t>(width) * height);
+    ThreadPool::Global().ParallelFor(0, height, kLineBlock, [&](uint32_t y0, uint32_t y1) {
+        std::vector<float> line(width), scratch(width);
+        for (uint32_t y = y0; y < y1; ++y) {
+            std::copy_n(src + static_cast<size_t>(y) * width, width, line.data());
+            const float* out = BlurLine(line.data(), scratch.data(), width, r);
+            std::copy_n(out, width, &rows[static_cast<size_t>(y) * width]);
+        }
+    });
+    ThreadPool::Global().ParallelFor(border, width - border, kLineBlock, [&](uint32_t x0, uint32_t x1) {
+        std::vector<float> line(height), scratch(height);
+        for (uint32_t x = x0; x < x1; ++x) {
+            for (uint32_t y = 0; y < height; ++y) line[y] = rows[static_cast<size_t>(y) * width + x];
+            const float* out = BlurLine(line.data(), scratch.data(), height, r);
+            for (uint32_t y = border; y < height - border; ++y) {
+                dst[static_cast<size_t>(y - border) * iw + (x - border)] = out[y];
+            }
+        }
+    });
+}
+
+static uint64_t MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+uint32_t Climate::DiffusionTexels(const ClimateParams& params, uint32_t resolution) {
+    const double texel = static_cast<double>(kChunkWorldSize) / resolution;
+    return std::max(1u, static_cast<uint32_t>(std::lround(params.diffusionRadius / texel)));
+}
+
+ClimateMaps Climate::Generate(const ChunkRequest& req, GPUTexture heightTex, const HeightmapOutputs& heightOut,
+                              GPUContext& gpu, const ClimateParams& params) {
+    ClimateMaps maps;
+    const uint32_t size = gpu.GetTexture(heightTex).width;
+    if (size == 0) return maps;
+    // Both maps are written in full below
+    maps.humidity = gpu.CreateTexture2D(size, size, TextureFormat::R32Float, TextureInit::Uninitialized);
+    maps.temperature = gpu.CreateTexture2D(size, size, TextureFormat::R32Float, TextureInit::Uninitialized);
+    float* humidity = gpu.GetTexture(maps.humidity).As<float>();
+    float* temperature = gpu.GetTexture(maps.temperature).As<float>();
+    const float* heights = gpu.GetTexture(heightTex).As<float>();
+
+    // Humidity sources over the heightmap's extended domain when there is one
+    const uint32_t apron = heightOut.extended ? heightOut.apron : 0;
+    const uint32_t ext = size + 2 * apron;
+    const float* domain = apron ? gpu.GetTexture(heightOut.extended).As<float>() : heights;
+    const double texel = static_cast<double>(kChunkWorldSize) / size;
+    const double originX = static_cast<double>(req.id.x) * kChunkWorldSize - apron * texel;
+    const double originZ = static_cast<double>(req.id.z) * kChunkWorldSize - apron * texel;
+    maps.diffusionRadius = DiffusionTexels(params, size);
+    maps.seamless = heightOut.sharedApron && apron >= maps.diffusionRadius;
+
+    auto start = std::chrono::steady_clock::now();
+    FbmParams moisture;
+    moisture.frequency = params.humidityFrequency;
+    moisture.seed = 4242u;
+    const int humidityOctaves = std::max(1, std::min(params.humidityOctaves, kMaxFbmOctaves));
+    const float moistureScale = 0.5f / FbmAmplitudeSum(moisture, humidityOctaves);
+    std::vector<float> source(static_cast<size_t>(ext) * ext);
+    gpu.Dispatch(ext, ext, [&](const GPUContext::ComputeTile& t) {
+        thread_local NoiseScratch scratch;
+        thread_local std::vector<NoiseSample> row;
+        row.resize(t.x1 - t.x0);
+        for (uint32_t y = t.y0; y < t.y1; ++y) {
+            FbmRowN(humidityOctaves, moisture, originX + t.x0 * texel, texel, t.x1 - t.x0, originZ + y * texel,
+                    scratch, row.data());
+            const size_t base = static_cast<size_t>(y) * ext + t.x0;
+            for (uint32_t x = 0; x < t.x1 - t.x0; ++x) {
+                const float noise = row[x].value * moistureScale + 0.5f;
+                const float water = domain[base + x] < params.seaLevel ? 1.0f : 0.0f;
+                source[base + x] = noise + (water - noise) * params.waterWeight;
+            }
+        }
+    });
+    maps.humidityUs = MicrosecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    DiffuseField(source.data(), ext, ext, apron, maps.diffusionRadius, humidity);
+    maps.diffusionUs = MicrosecondsSince(start);
+
+    // Temperature is pointwise, so only the interior is evaluated
+    start = std::chrono::steady_clock::now();
+    FbmParams perturb;
+    perturb.frequency = params.temperatureFrequency;
+    perturb.seed = 4243u;
+    const float perturbScale = params.temperatureNoise / FbmAmplitudeSum(perturb, 2);
+    const double chunkX = static_cast<double>(req.id.x) * kChunkWorldSize;
+    const double chunkZ = static_cast<double>(req.id.z) * kChunkWorldSize;
+    const double kTwoPi = 6.283185307179586;
+    gpu.Dispatch(size, size, [&](const GPUContext::ComputeTile& t) {
+        thread_local NoiseScratch scratch;
+        thread_local std::vector<NoiseSample> row;
+        row.resize(t.x1 - t.x0);
+        for (uint32_t y = t.y0; y < t.y1; ++y) {
+            const double z = chunkZ + y * texel;
+            const float latitude = static_cast<float>(0.5 + 0.5 * std::cos(kTwoPi * z / params.latitudePeriod));
+            FbmRowN(2, perturb, chunkX + t.x0 * texel, texel, t.x1 - t.x0, z, scratch, row.data());
+            const size_t base = static_cast<size_t>(y) * size + t.x0;
+            for (uint32_t x = 0; x < t.x1 - t.x0; ++x) {
+                const float above = std::max(0.0f, heights[base + x] - params.seaLevel);
+                const float value = latitude - params.lapseRate * above + row[x].value * perturbScale;
+                temperature[base + x] = std::min(1.0f, std::max(0.0f, value));
+            }
+        }
+    });
+    maps.temperatureUs = MicrosecondsSince(start);
+    return maps;
+}
+
+} // namespace terraingen
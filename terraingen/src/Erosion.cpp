@@ -0,0 +1,531 @@
+#include "Erosion.hpp"
+#include "Random.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+#if TERRAINGEN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace terraingen {
+
+namespace {
+
+// Droplets per ParallelFor chunk; also the granularity of the ordered delta lists
+constexpr uint32_t kDropletGrain = 64;
+
+// Thermal iterations per sweep, and the fewest rows per band: a band recomputes
+// steps * (steps - 1) halo rows per sweep, at most about a tenth of its own work
+constexpr uint32_t kThermalSteps = 8;
+constexpr uint32_t kThermalBand = 64;
+
+// One height change recorded by a droplet, expanded when the batch is applied: a bilinear
+// deposit into the cell whose corner is `index` (weights from u, v), or, when u < 0, a
+// brush-shaped removal around the node `index`
+struct HeightEvent {
+    uint32_t index;
+    float amount;
+    float u;
+    float v;
+};
+
+struct SurfaceSample {
+    float height;
+    float gx;
+    float gz;
+};
+
+// Bilinear height and its gradient inside the cell containing (px, pz)
+inline SurfaceSample SampleSurface(const float* h, uint32_t width, float px, float pz) {
+    const uint32_t ix = static_cast<uint32_t>(px);
+    const uint32_t iz = static_cast<uint32_t>(pz);
+    const float u = px - ix;
+    const float v = pz - iz;
+    const size_t i = static_cast<size_t>(iz) * width + ix;
+    const float h00 = h[i], h10 = h[i + 1], h01 = h[i + width], h11 = h[i + width + 1];
+    SurfaceSample s;
+    s.gx = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+    s.gz = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+    s.height = h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v) + h01 * (1.0f - u) * v + h11 * u * v;
+    return s;
+}
+
+// Footprints of a droplet's height changes, in texels of a grid `spacing` world units apart.
+// Erosion takes cells within `r` texels of a node, weighted by (r - distance); deposits a tent
+// `deposit` texels wide around the droplet (bilinear when 1). Amounts are volumes (height times
+// square world units), so both footprints sum to weight / spacing^2: a droplet moves the same
+// material at every resolution, times the number of droplets it stands for.
+struct ErosionBrush {
+    int32_t radius = 0;
+    std::vector<int32_t> dx, dz;
+    std::vector<int64_t> offsets; // dz * width + dx
+    std::vector<float> weights;
+    int32_t deposit = 1;
+    float volumeScale = 1.0f;
+
+    ErosionBrush(float r, float spacing, float weight, uint32_t width)
+        : radius(static_cast<int32_t>(std::ceil(r))),
+          deposit(std::max(1, static_cast<int32_t>(std::lround(1.0f / spacing)))),
+          volumeScale(weight / (spacing * spacing)) {
+        float sum = 0.0f;
+        for (int32_t z = -radius; z <= radius; ++z) {
+            for (int32_t x = -radius; x <= radius; ++x) {
+                const float w = r - std::sqrt(static_cast<float>(x * x + z * z));
+                if (w <= 0.0f) continue;
+                dx.push_back(x);
+                dz.push_back(z);
+                offsets.push_back(static_cast<int64_t>(z) * width + x);
+                weights.push_back(w);
+                sum += w;
+            }
+        }
+        if (weights.empty()) { // radius 0: the node alone
+            dx.push_back(0);
+            dz.push_back(0);
+            offsets.push_back(0);
+            weights.push_back(1.0f);
+            sum = 1.0f;
+        }
+        for (float& w : weights) w = w / sum * volumeScale;
+    }
+};
+
+inline void Deposit(std::vector<HeightEvent>& out, uint32_t width, float px, float pz, float amount) {
+    const uint32_t ix = static_cast<uint32_t>(px);
+    const uint32_t iz = static_cast<uint32_t>(pz);
+    out.push_back({iz * width + ix, amount, px - ix, pz - iz});
+}
+
+inline void Erode(std::vector<HeightEvent>& out, uint32_t width, float px, float pz, float amount) {
+    const uint32_t ix = static_cast<uint32_t>(px + 0.5f);
+    const uint32_t iz = static_cast<uint32_t>(pz + 0.5f);
+    out.push_back({iz * width + ix, amount, -1.0f, 0.0f});
+}
+
+void ApplyEvent(float* h, uint32_t width, uint32_t height, const ErosionBrush& brush, const HeightEvent& e) {
+    const int32_t cx = static_cast<int32_t>(e.index % width);
+    const int32_t cz = static_cast<int32_t>(e.index / width);
+    if (e.u >= 0.0f && brush.deposit == 1) {
+        const float u = e.u, v = e.v;
+        const float amount = e.amount * brush.volumeScale;
+        h[e.index] += amount * (1.0f - u) * (1.0f - v);
+        h[e.index + 1] += amount * u * (1.0f - v);
+        h[e.index + width] += amount * (1.0f - u) * v;
+        h[e.index + width + 1] += amount * u * v;
+        return;
+    }
+    if (e.u >= 0.0f) {
+        // Tent of half-width d texels around the droplet: cells cx - d + 1 .. cx + d along each
+        // axis, weighted (d - distance) / d^2 so that a row of weights sums to 1
+        const int32_t d = brush.deposit;
+        const float norm = 1.0f / static_cast<float>(d * d);
+        const float amount = e.amount * brush.volumeScale;
+        for (int32_t j = 1 - d; j <= d; ++j) {
+            const int32_t z = cz + j;
+            if (z < 0 || z >= static_cast<int32_t>(height)) continue;
+            const float wz = (static_cast<float>(d) - std::fabs(static_cast<float>(j) - e.v)) * norm;
+            float* row = h + static_cast<size_t>(z) * width;
+            for (int32_t i = 1 - d; i <= d; ++i) {
+                const int32_t x = cx + i;
+                if (x < 0 || x >= static_cast<int32_t>(width)) continue;
+                row[x] += amount * wz * (static_cast<float>(d) - std::fabs(static_cast<float>(i) - e.u)) * norm;
+            }
+        }
+        return;
+    }
+    const size_t n = brush.weights.size();
+    if (cx >= brush.radius && cz >= brush.radius && cx + brush.radius < static_cast<int32_t>(width) &&
+        cz + brush.radius < static_cast<int32_t>(height)) {
+        float* center = h + e.index;
+        for (size_t i = 0; i < n; ++i) center[brush.offsets[i]] -= e.amount * brush.weights[i];
+        return;
+    }
+    // Near the domain edge: skip cells outside
+    for (size_t i = 0; i < n; ++i) {
+        const int32_t x = cx + brush.dx[i];
+        const int32_t z = cz + brush.dz[i];
+        if (x < 0 || z < 0 || x >= static_cast<int32_t>(width) || z >= static_cast<int32_t>(height)) continue;
+        h[static_cast<size_t>(z) * width + x] -= e.amount * brush.weights[i];
+    }
+}
+
+inline float UnitFloat(uint64_t r) {
+    return static_cast<float>(r >> 40) * (1.0f / 16777216.0f);
+}
+
+struct Droplet {
+    float x;
+    float z;
+    uint64_t order; // processing rank, from the spawning texel's hash
+};
+
+// Trace one droplet over the (read-only) snapshot, recording its height changes.
+// Returns the number of steps taken.
+uint32_t TraceDroplet(const float* h, uint32_t width, uint32_t height, const HydraulicErosionParams& p,
+                      float stepTexels, Droplet start, std::vector<HeightEvent>& events) {
+    const float maxX = static_cast<float>(width - 1);
+    const float maxZ = static_cast<float>(height - 1);
+    float px = start.x;
+    float pz = start.z;
+    float dirX = 0.0f, dirZ = 0.0f;
+    float speed = p.initialSpeed;
+    float water = p.initialWater;
+    float sediment = 0.0f;
+
+    uint32_t step = 0;
+    while (step < p.maxLifetime) {
+        ++step;
+        const SurfaceSample s = SampleSurface(h, width, px, pz);
+
+        // Blend the previous direction with the downhill direction, then move one world unit
+        dirX = dirX * p.inertia - s.gx * (1.0f - p.inertia);
+        dirZ = dirZ * p.inertia - s.gz * (1.0f - p.inertia);
+        const float len = std::sqrt(dirX * dirX + dirZ * dirZ);
+        if (len <= 0.0f) break; // flat: nowhere to flow
+        dirX /= len;
+        dirZ /= len;
+        const float nx = px + dirX * stepTexels;
+        const float nz = pz + dirZ * stepTexels;
+        if (!(nx >= 0.0f && nx < maxX && nz >= 0.0f && nz < maxZ)) break;
+
+        const float deltaH = SampleSurface(h, width, nx, nz).height - s.height;
+        const float capacity = std::max(-deltaH * speed * water * p.sedimentCapacity, p.minSedimentCapacity);
+        if (deltaH > 0.0f || sediment > capacity) {
+            // Uphill: fill the pit behind us; over capacity: drop part of the excess
+            const float amount = deltaH > 0.0f ? std::min(deltaH, sediment)
+                                               : (sediment - capacity) * p.depositSpeed;
+            sediment -= amount;
+            Deposit(events, width, px, pz, amount);
+        } else {
+            // Never dig deeper than the drop we are about to take
+            const float amount = std::min((capacity - sediment) * p.erodeSpeed, -deltaH);
+            sediment += amount;
+            Erode(events, width, px, pz, amount);
+        }
+
+        speed = std::sqrt(std::max(0.0f, speed * speed - deltaH * p.gravity));
+        water *= 1.0f - p.evaporateSpeed;
+        px = nx;
+        pz = nz;
+    }
+    return step;
+}
+
+} // namespace
+
+// Droplets spawned by the cells of row z, in cell order. Cell (x, z) hashes its world texel to
+// pick its droplet count and seeds one PCG stream per droplet for the start offset.
+struct SpawnScratch {
+    std::vector<int64_t> xs, zs, zeros;
+    std::vector<uint64_t> hashes;
+};
+
+static void SpawnRow(uint32_t z, uint32_t cells, int64_t originX, int64_t originZ, float perTexel,
+                     uint64_t seed, SpawnScratch& scratch, std::vector<Droplet>& out) {
+    scratch.xs.resize(cells);
+    scratch.zs.assign(cells, originZ + z);
+    scratch.zeros.assign(cells, 0);
+    scratch.hashes.resize(cells);
+    for (uint32_t x = 0; x < cells; ++x) scratch.xs[x] = originX + x;
+    const std::vector<uint64_t>& hashes = scratch.hashes;
+    HashCoordsN(scratch.xs.data(), scratch.zs.data(), scratch.zeros.data(), seed, scratch.hashes.data(), cells);
+    const uint32_t whole = static_cast<uint32_t>(perTexel);
+    const float fraction = perTexel - static_cast<float>(whole);
+    for (uint32_t x = 0; x < cells; ++x) {
+        const uint32_t count = whole + (UnitFloat(hashes[x]) < fraction ? 1u : 0u);
+        for (uint32_t k = 0; k < count; ++k) {
+            PCG64State rng = InitPCG64(hashes[x], k);
+            // x + offset can round up to x + 1 in float; keep the start inside its cell
+            const float px = std::min(static_cast<float>(x) + UnitFloat(PCG64Next(rng)),
+                                      std::nextafter(static_cast<float>(x + 1), 0.0f));
+            const float pz = std::min(static_cast<float>(z) + UnitFloat(PCG64Next(rng)),
+                                      std::nextafter(static_cast<float>(z + 1), 0.0f));
+            out.push_back({px, pz, hashes[x] + k});
+        }
+    }
+}
+
+HydraulicErosionStats HydraulicErode(float* heights, uint32_t width, uint32_t height, float spacing,
+                                     const HydraulicErosionParams& params, uint64_t seed,
+                                     int64_t originX, int64_t originZ) {
+    HydraulicErosionStats stats;
+    if (width < 2 || height < 2 || params.dropletDensity <= 0.0f) return stats;
+    const float texelArea = spacing * spacing;
+    // Texels coarser than a square world unit spawn droplets at the density of a unit grid and
+    // each one carries `weight` droplets' worth of material, so a coarse LOD traces no more
+    // droplets than it has texels instead of as many as the finest one.
+    const float weight = std::max(1.0f, texelArea);
+    const float perTexel = params.dropletDensity * texelArea / weight;
+
+    // Spawn droplets per row in parallel, then concatenate in row order
+    const uint32_t cellRows = height - 1;
+    std::vector<std::vector<Droplet>> rowDroplets(cellRows);
+    ThreadPool::Global().ParallelFor(0, cellRows, 16, [&](uint32_t z0, uint32_t z1) {
+        SpawnScratch scratch;
+        for (uint32_t z = z0; z < z1; ++z) {
+            SpawnRow(z, width - 1, originX, originZ, perTexel, seed, scratch, rowDroplets[z]);
+        }
+    });
+    std::vector<Droplet> droplets;
+    for (const auto& row : rowDroplets) droplets.insert(droplets.end(), row.begin(), row.end());
+    // Spawn order would put each batch in a few neighbouring rows, where droplets reading the
+    // same snapshot dig the same cells over and over. Hash order scatters every batch over the
+    // whole domain, and keeps droplets shared by overlapping domains in the same relative order.
+    std::sort(droplets.begin(), droplets.end(), [](const Droplet& a, const Droplet& b) {
+        if (a.order != b.order) return a.order < b.order;
+        return a.z != b.z ? a.z < b.z : a.x < b.x;
+    });
+    const uint64_t total = droplets.size();
+
+    const ErosionBrush brush(params.erosionRadius / spacing, spacing, weight, width);
+    const float stepTexels = 1.0f / spacing;
+    const uint32_t batchSize = std::max(
+        kDropletGrain, static_cast<uint32_t>(params.batchDensity * texelArea / weight * static_cast<float>(width) * height));
+    const uint32_t lists = (batchSize + kDropletGrain - 1) / kDropletGrain;
+    std::vector<std::vector<HeightEvent>> events(lists);
+    std::vector<uint64_t> steps(lists);
+
+    for (uint64_t first = 0; first < total; first += batchSize) {
+        const uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(batchSize, total - first));
+        // Every droplet in the batch reads the same heights; chunk boundaries are fixed by
+        // kDropletGrain, so each list always holds the same droplets in the same order.
+        ThreadPool::Global().ParallelFor(0, count, kDropletGrain, [&](uint32_t d0, uint32_t d1) {
+            const uint32_t list = d0 / kDropletGrain;
+            std::vector<HeightEvent>& out = events[list];
+            out.clear();
+            uint64_t taken = 0;
+            for (uint32_t d = d0; d < d1; ++d) {
+                taken += TraceDroplet(heights, width, height, params, stepTexels, droplets[first + d], out);
+            }
+            steps[list] = taken;
+        });
+        for (uint32_t l = 0; l * kDropletGrain < count; ++l) {
+            for (const HeightEvent& e : events[l]) ApplyEvent(heights, width, height, brush, e);
+            stats.steps += steps[l];
+        }
+        stats.droplets += count;
+    }
+    return stats;
+}
+
+// Material gained from a neighbour `d` higher (negative: lost to one lower), beyond the talus.
+// Written as compare-selects so the vector kernels below reproduce it bit for bit.
+static inline float TalusFlux(float d, float talus) {
+    const float over = d - talus;
+    const float under = d + talus;
+    return (over > 0.0f ? over : 0.0f) + (under < 0.0f ? under : 0.0f);
+}
+
+static inline float ThermalCell(float c, float l, float r, float u, float dn, float talus, float rate) {
+    return c + rate * (((TalusFlux(l - c, talus) + TalusFlux(r - c, talus)) + TalusFlux(u - c, talus)) +
+                       TalusFlux(dn - c, talus));
+}
+
+// out[x] for x < n, with left/right neighbours at c[x - 1] and c[x + 1]
+static void ThermalRowScalar(const float* c, const float* up, const float* down, float* out, size_t n,
+                             float talus, float rate) {
+    for (size_t x = 0; x < n; ++x) {
+        out[x] = ThermalCell(c[x], c[x - 1], c[x + 1], up[x], down[x], talus, rate);
+    }
+}
+
+#if TERRAINGEN_X86_SIMD
+TERRAINGEN_TARGET_AVX2 static inline __m256 TalusFluxAVX2(__m256 d, __m256 talus, __m256 zero) {
+    return _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(d, talus), zero),
+                         _mm256_min_ps(_mm256_add_ps(d, talus), zero));
+}
+
+TERRAINGEN_TARGET_AVX2 static inline void ThermalVecAVX2(const float* c, const float* up, const float* down,
+                                                         float* out, __m256 vt, __m256 vr, __m256 zero) {
+    const __m256 vc = _mm256_loadu_ps(c);
+    __m256 sum = _mm256_add_ps(TalusFluxAVX2(_mm256_sub_ps(_mm256_loadu_ps(c - 1), vc), vt, zero),
+                               TalusFluxAVX2(_mm256_sub_ps(_mm256_loadu_ps(c + 1), vc), vt, zero));
+    sum = _mm256_add_ps(sum, TalusFluxAVX2(_mm256_sub_ps(_mm256_loadu_ps(up), vc), vt, zero));
+    sum = _mm256_add_ps(sum, TalusFluxAVX2(_mm256_sub_ps(_mm256_loadu_ps(down), vc), vt, zero));
+    _mm256_storeu_ps(out, _mm256_add_ps(vc, _mm256_mul_ps(vr, sum)));
+}
+
+TERRAINGEN_TARGET_AVX2 static void ThermalRowAVX2(const float* c, const float* up, const float* down,
+                                                  float* out, size_t n, float talus, float rate) {
+    const __m256 vt = _mm256_set1_ps(talus);
+    const __m256 vr = _mm256_set1_ps(rate);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t x = 0;
+    for (; x + 8 <= n; x += 8) ThermalVecAVX2(c + x, up + x, down + x, out + x, vt, vr, zero);
+    if (x < n && n >= 8) {
+        // Finish with one overlapping vector rather than a scalar tail
+        // (out never aliases the inputs, so recomputed texels get the same values)
+        x = n - 8;
+        ThermalVecAVX2(c + x, up + x, down + x, out + x, vt, vr, zero);
+        return;
+    }
+    // Inline tail: calling the SSE-compiled scalar row from here would pay for AVX/SSE transitions
+    for (; x < n; ++x) out[x] = ThermalCell(c[x], c[x - 1], c[x + 1], up[x], down[x], talus, rate);
+}
+
+TERRAINGEN_TARGET_AVX512 static inline __m512 TalusFluxAVX512(__m512 d, __m512 talus, __m512 zero) {
+    return _mm512_add_ps(_mm512_max_ps(_mm512_sub_ps(d, talus), zero),
+                         _mm512_min_ps(_mm512_add_ps(d, talus), zero));
+}
+
+TERRAINGEN_TARGET_AVX512 static inline void ThermalVecAVX512(const float* c, const float* up, const float* down,
+                                                             float* out, __m512 vt, __m512 vr, __m512 zero) {
+    const __m512 vc = _mm512_loadu_ps(c);
+    __m512 sum = _mm512_add_ps(TalusFluxAVX512(_mm512_sub_ps(_mm512_loadu_ps(c - 1), vc), vt, zero),
+                               TalusFluxAVX512(_mm512_sub_ps(_mm512_loadu_ps(c + 1), vc), vt, zero));
+    sum = _mm512_add_ps(sum, TalusFluxAVX512(_mm512_sub_ps(_mm512_loadu_ps(up), vc), vt, zero));
+    sum = _mm512_add_ps(sum, TalusFluxAVX512(_mm512_sub_ps(_mm512_loadu_ps(down), vc), vt, zero));
+    _mm512_storeu_ps(out, _mm512_add_ps(vc, _mm512_mul_ps(vr, sum)));
+}
+
+TERRAINGEN_TARGET_AVX512 static void ThermalRowAVX512(const float* c, const float* up, const float* down,
+                                                      float* out, size_t n, float talus, float rate) {
+    const __m512 vt = _mm512_set1_ps(talus);
+    const __m512 vr = _mm512_set1_ps(rate);
+    const __m512 zero = _mm512_setzero_ps();
+    size_t x = 0;
+    for (; x + 16 <= n; x += 16) ThermalVecAVX512(c + x, up + x, down + x, out + x, vt, vr, zero);
+    if (x < n && n >= 16) {
+        x = n - 16;
+        ThermalVecAVX512(c + x, up + x, down + x, out + x, vt, vr, zero);
+        return;
+    }
+    for (; x < n; ++x) out[x] = ThermalCell(c[x], c[x - 1], c[x + 1], up[x], down[x], talus, rate);
+}
+#endif
+
+static void ThermalRow(const float* c, const float* up, const float* down, float* out, size_t n,
+                       float talus, float rate) {
+#if TERRAINGEN_X86_SIMD
+    switch (ActiveSimdISA()) {
+        case SimdISA::AVX512: ThermalRowAVX512(c, up, down, out, n, talus, rate); return;
+        case SimdISA::AVX2: ThermalRowAVX2(c, up, down, out, n, talus, rate); return;
+        default: break;
+    }
+#endif
+    ThermalRowScalar(c, up, down, out, n, talus, rate);
+}
+
+// One thermal iteration of a full row `row`, whose neighbours are `up` and `down`. At the
+// domain edge the missing neighbour counts as level ground (no flux).
+static void ThermalFullRow(const float* row, const float* up, const float* down, float* out, uint32_t width,
+                           float talus, float rate) {
+    if (width == 1) {
+        out[0] = ThermalCell(row[0], row[0], row[0], up[0], down[0], talus, rate);
+        return;
+    }
+    const uint32_t e = width - 1;
+    out[0] = ThermalCell(row[0], row[0], row[1], up[0], down[0], talus, rate);
+    out[e] = ThermalCell(row[e], row[e - 1], row[e], up[e], down[e], talus, rate);
+    if (e > 1) ThermalRow(row + 1, up + 1, down + 1, out + 1, e - 1, talus, rate);
+}
+
+// One thermal iteration over rows [z0, z1) of a width x height grid
+static void ThermalStep(const float* src, float* dst, uint32_t width, uint32_t height, uint32_t z0,
+                        uint32_t z1, float talus, float rate) {
+    for (uint32_t z = z0; z < z1; ++z) {
+        const float* row = src + static_cast<size_t>(z) * width;
+        const float* up = z > 0 ? row - width : row;
+        const float* down = z + 1 < height ? row + width : row;
+        ThermalFullRow(row, up, down, dst + static_cast<size_t>(z) * width, width, talus, rate);
+    }
+}
+
+// `steps` thermal iterations of rows [z0, z1), from src into dst, as a wavefront: row z of
+// iteration s is computed as soon as rows z - 1..z + 1 of iteration s - 1 are, so each
+// iteration keeps only three rows live (in `rings`, 3 * (steps - 1) rows) and src and dst are
+// swept once. Iteration s covers (steps - s) rows beyond the band on either side, which the
+// neighbouring bands compute again rather than wait for.
+static void ThermalBand(const float* src, float* dst, uint32_t width, uint32_t height, uint32_t z0, uint32_t z1,
+                        uint32_t steps, float talus, float rate, float* rings) {
+    auto lo = [&](uint32_t s) { return z0 > steps - s ? z0 - (steps - s) : 0u; };
+    auto hi = [&](uint32_t s) { return std::min(height, z1 + (steps - s)); };
+    auto row = [&](uint32_t s, uint32_t z) -> float* {
+        if (s == 0) return const_cast<float*>(src) + static_cast<size_t>(z) * width;
+        if (s == steps) return dst + static_cast<size_t>(z) * width;
+        return rings + (static_cast<size_t>(s - 1) * 3 + z % 3) * width;
+    };
+    // At time t iteration s computes row t + 1 - s
+    for (uint32_t t = lo(1); t + 1 < z1 + steps; ++t) {
+        for (uint32_t s = 1; s <= steps && s <= t + 1; ++s) {
+            const uint32_t z = t + 1 - s;
+            if (z < lo(s)) break;
+            if (z >= hi(s)) continue;
+            const float* c = row(s - 1, z);
+            const float* up = z > 0 ? row(s - 1, z - 1) : c;
+            const float* down = z + 1 < height ? row(s - 1, z + 1) : c;
+            ThermalFullRow(c, up, down, row(s, z), width, talus, rate);
+        }
+    }
+}
+
+uint32_t ThermalIterations(const ThermalErosionParams& params, float spacing) {
+    return static_cast<uint32_t>(std::lround(std::max(0.0f, params.reach) / spacing));
+}
+
+void ThermalErode(float* heights, uint32_t width, uint32_t height, float spacing,
+                  const ThermalErosionParams& params) {
+    const uint32_t iterations = ThermalIterations(params, spacing);
+    if (iterations == 0 || width == 0 || height == 0) return;
+    const float talus = params.talus * spacing;
+    std::vector<float> pong(static_cast<size_t>(width) * height);
+    float* src = heights;
+    float* dst = pong.data();
+    // One band per thread: the halo rows only pay for parallelism. The results do not depend
+    // on the bands.
+    const unsigned threads = ThreadPool::Global().ThreadCount();
+    const uint32_t band = std::max(kThermalBand, (height + threads - 1) / threads);
+    for (uint32_t done = 0; done < iterations; done += kThermalSteps) {
+        const uint32_t steps = std::min(kThermalSteps, iterations - done);
+        ThreadPool::Global().ParallelFor(0, height, band, [&](uint32_t z0, uint32_t z1) {
+            std::vector<float> rings(static_cast<size_t>(steps - 1) * 3 * width);
+            ThermalBand(src, dst, width, height, z0, z1, steps, talus, params.rate, rings.data());
+        });
+        std::swap(src, dst);
+    }
+    if (src != heights) std::memcpy(heights, src, pong.size() * sizeof(float));
+}
+
+void ThermalErodeSweep(float* heights, uint32_t width, uint32_t height, float spacing,
+                       const ThermalErosionParams& params) {
+    const uint32_t iterations = ThermalIterations(params, spacing);
+    if (iterations == 0 || width == 0 || height == 0) return;
+    const float talus = params.talus * spacing;
+    std::vector<float> pong(static_cast<size_t>(width) * height);
+    float* src = heights;
+    float* dst = pong.data();
+    for (uint32_t it = 0; it < iterations; ++it) {
+        ThreadPool::Global().ParallelFor(0, height, 16, [&](uint32_t z0, uint32_t z1) {
+            ThermalStep(src, dst, width, height, z0, z1, talus, params.rate);
+        });
+        std::swap(src, dst);
+    }
+    if (src != heights) std::memcpy(heights, src, pong.size() * sizeof(float));
+}
+
+void ComputeGradient(const float* heights, uint32_t width, uint32_t height, float spacing,
+                     float* gradX, float* gradZ) {
+    if (width < 2 || height < 2) return;
+    const float inv2 = 0.5f / spacing;
+    const float inv1 = 1.0f / spacing;
+    ThreadPool::Global().ParallelFor(0, height, 16, [&](uint32_t y0, uint32_t y1) {
+        for (uint32_t y = y0; y < y1; ++y) {
+            const float* row = heights + static_cast<size_t>(y) * width;
+            const float* up = y > 0 ? row - width : row;
+            const float* down = y + 1 < height ? row + width : row;
+            const float zScale = (y > 0 && y + 1 < height) ? inv2 : inv1;
+            float* gx = gradX + static_cast<size_t>(y) * width;
+            float* gz = gradZ + static_cast<size_t>(y) * width;
+            gx[0] = (row[1] - row[0]) * inv1;
+            for (uint32_t x = 1; x + 1 < width; ++x) gx[x] = (row[x + 1] - row[x - 1]) * inv2;
+            gx[width - 1] = (row[width - 1] - row[width - 2]) * inv1;
+            for (uint32_t x = 0; x < width; ++x) gz[x] = (down[x] - up[x]) * zScale;
+        }
+    });
+}
+
+} // namespace terraingen
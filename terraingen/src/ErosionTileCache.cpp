@@ -0,0 +1,109 @@
+#include "ErosionTileCache.hpp"
+#include "Random.hpp"
+
+namespace terraingen {
+
+size_t ErosionTileCache::KeyHash::operator()(const ErosionTileKey& k) const {
+    const uint64_t setup = (static_cast<uint64_t>(k.resolution) << 32) ^
+                           (static_cast<uint64_t>(static_cast<uint32_t>(k.octaves)) << 8) ^
+                           static_cast<uint64_t>(static_cast<uint32_t>(k.coarseOctaves)) ^ k.erosion;
+    return static_cast<size_t>(HashCoords(k.tx, k.tz, 0, setup));
+}
+
+ErosionTileCache::ErosionTileCache(size_t maxBytes) : maxBytes_(maxBytes) {}
+
+// Tile builds running on this thread. Such a thread never waits for another one's build: that
+// build may be helping the thread pool with a task of ours that waits for our own tile.
+static thread_local int t_building = 0;
+
+std::shared_ptr<const ErosionTile> ErosionTileCache::Acquire(const ErosionTileKey& key, const Builder& build,
+                                                             bool* built) {
+    std::promise<std::shared_ptr<const ErosionTile>> promise;
+    bool owner = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            ++stats_.hits;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            if (built) *built = false;
+            return it->second->second;
+        }
+        auto pending = building_.find(key);
+        if (pending != building_.end() && t_building == 0) {
+            ++stats_.joins;
+            const Pending tile = pending->second;
+            lock.unlock();
+            if (built) *built = false;
+            return tile.get();
+        }
+        ++stats_.misses;
+        if (pending == building_.end()) {
+            building_.emplace(key, promise.get_future().share());
+            owner = true;
+        }
+    }
+
+    ++t_building;
+    std::shared_ptr<const ErosionTile> tile = build();
+    --t_building;
+    if (built) *built = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (owner) building_.erase(key);
+        InsertLocked(key, tile);
+    }
+    if (owner) promise.set_value(tile);
+    return tile;
+}
+
+void ErosionTileCache::InsertLocked(const ErosionTileKey& key, std::shared_ptr<const ErosionTile> tile) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        // Built again by a thread that could not wait for it; the contents are identical
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+    stats_.bytes += Bytes(*tile);
+    lru_.emplace_front(key, std::move(tile));
+    index_[key] = lru_.begin();
+    EvictLocked();
+}
+
+void ErosionTileCache::EvictLocked() {
+    // The newest tile stays even when it alone exceeds the bound
+    while (lru_.size() > 1 && stats_.bytes > maxBytes_) {
+        stats_.bytes -= Bytes(*lru_.back().second);
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    stats_.entries = lru_.size();
+}
+
+void ErosionTileCache::SetMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxBytes_ = maxBytes;
+    EvictLocked();
+}
+
+void ErosionTileCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_ = ErosionTileCacheStats{};
+}
+
+ErosionTileCacheStats ErosionTileCache::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+ErosionTileCache& ErosionTileCache::Global() {
+    // A 256-texel tile is ~330 KiB, a 1024-texel one ~5 MiB; 64 MiB keeps two rows of tiles of
+    // a streaming window warm at any resolution
+    static ErosionTileCache cache(64u << 20);
+    return cache;
+}
+
+} // namespace terraingen
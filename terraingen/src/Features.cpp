@@ -2,130 +2,183 @@
 #include "GPUContext.hpp"
 #include "Random.hpp"
 #include <vector>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
-#ifdef __EMSCRIPTEN__
-#include <emscripten/html5_webgpu.h>
-#include <emscripten.h>
-#include <fstream>
-#include <iterator>
-#include <string>
-#endif
 
 namespace terraingen {
 
-static std::vector<IFeature*>& Registry() {
-    static std::vector<IFeature*> vec;
-    return vec;
+static bool Conflict(const FeatureInfo& a, const FeatureInfo& b) {
+    return (a.writes & (b.reads | b.writes)) || (b.writes & a.reads);
 }
 
-void FeatureRegistry::Add(IFeature* feature) {
-    Registry().push_back(feature);
+bool FeatureRegistry::Add(IFeature* feature, const FeatureInfo& info) {
+    if (!feature || !info.name) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto same = std::find_if(entries_.begin(), entries_.end(),
+                             [&](const Entry& e) { return std::strcmp(e.info.name, info.name) == 0; });
+    if (same != entries_.end()) {
+        if (same->info.version >= info.version) return false;
+        entries_.erase(same);
+    }
+    entries_.push_back({info, feature, 0});
+    std::sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+        if (a.info.priority != b.info.priority) return a.info.priority < b.info.priority;
+        return std::strcmp(a.info.name, b.info.name) < 0;
+    });
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        uint32_t wave = 0;
+        for (size_t j = 0; j < i; ++j) {
+            if (Conflict(entries_[j].info, entries_[i].info)) wave = std::max(wave, entries_[j].wave + 1);
+        }
+        entries_[i].wave = wave;
+    }
+    return true;
+}
+
+std::vector<std::pair<FeatureInfo, uint32_t>> FeatureRegistry::Schedule() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<FeatureInfo, uint32_t>> schedule;
+    for (const Entry& e : entries_) schedule.emplace_back(e.info, e.wave);
+    return schedule;
 }
 
-void FeatureRegistry::ApplyAll(ChunkCtx& ctx) {
-    for (auto* f : Registry()) {
-        if (f) f->Apply(ctx);
+void FeatureRegistry::ApplyAll(ChunkCtx& ctx, std::vector<FeatureRun>* runs) {
+    using Clock = std::chrono::steady_clock;
+    auto microseconds = [](Clock::duration d) {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    };
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries = entries_;
     }
+    // A wave's features need not be next to each other in run order
+    uint32_t waves = 0;
+    for (const Entry& e : entries) waves = std::max(waves, e.wave + 1);
+    std::vector<std::atomic<uint64_t>> tileNs(entries.size());
+    std::vector<uint32_t> applyUs(entries.size(), 0);
+    for (uint32_t wave = 0; wave < waves; ++wave) {
+        std::vector<GPUContext::DispatchDesc> dispatches;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].wave != wave) continue;
+            const auto start = Clock::now();
+            FeatureWork work = entries[i].feature->Apply(ctx);
+            applyUs[i] = microseconds(Clock::now() - start);
+            if (!work.kernel || work.width == 0 || work.height == 0) continue;
+            std::atomic<uint64_t>& ns = tileNs[i];
+            dispatches.push_back({work.width, work.height,
+                                  [&ns, kernel = std::move(work.kernel)](const GPUContext::ComputeTile& t) {
+                                      const auto start = Clock::now();
+                                      kernel(t);
+                                      ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                Clock::now() - start).count();
+                                  }});
+        }
+        ctx.gpu->Dispatch(dispatches);
+    }
+    if (!runs) return;
+    runs->clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        runs->push_back({entries[i].info.name, entries[i].wave, applyUs[i],
+                         static_cast<uint32_t>(tileNs[i].load() / 1000)});
+    }
+}
+
+FeatureRegistry& FeatureRegistry::Global() {
+    static FeatureRegistry registry;
+    return registry;
 }
 
 // ---------------- Demo Feature: SimpleCaves ----------------
 class SimpleCaves : public IFeature {
 public:
-    void Apply(ChunkCtx& ctx) override {
-        // GPU path for cave SDF
-#ifdef __EMSCRIPTEN__
-        if (ctx.gpu->HasDevice()) {
-            // Ensure SDF texture exists
-            if (ctx.sdfTexture == 0) {
-                const auto& ht = ctx.gpu->GetTexture(ctx.heightTexture);
-                ctx.sdfTexture = ctx.gpu->CreateTexture2D(ht.width, ht.height);
-            }
-            // Compile & cache compute pipeline
-            static struct { WGPUShaderModule module; WGPUBindGroupLayout bgl; WGPUPipelineLayout pl; WGPUComputePipeline pipeline; } cache;
-            auto device = emscripten_webgpu_get_device();
-            if (!cache.pipeline) {
-                std::ifstream file("terraingen/shaders/caves.wgsl");
-                std::string src((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-                WGPUShaderModuleWGSLDescriptor wgslDesc{}; wgslDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor; wgslDesc.code = src.c_str();
-                WGPUShaderModuleDescriptor smDesc{}; smDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgslDesc);
-                cache.module = wgpuDeviceCreateShaderModule(device, &smDesc);
-                WGPUBindGroupLayoutEntry entries[2]{};
-                entries[0].binding = 0; entries[0].visibility = WGPUShaderStage_Compute; entries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat; entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
-                entries[1].binding = 1; entries[1].visibility = WGPUShaderStage_Compute; entries[1].storageTexture.access = WGPUStorageTextureAccess_WriteOnly; entries[1].storageTexture.format = WGPUTextureFormat_R32Float; entries[1].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
-                WGPUBindGroupLayoutDescriptor bglDesc{}; bglDesc.entryCount = 2; bglDesc.entries = entries;
-                cache.bgl = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
-                WGPUPipelineLayoutDescriptor plDesc{}; plDesc.bindGroupLayoutCount = 1; plDesc.bindGroupLayouts = &cache.bgl;
-                cache.pl = wgpuDeviceCreatePipelineLayout(device, &plDesc);
-                WGPUComputePipelineDescriptor cpDesc{}; cpDesc.layout = cache.pl; cpDesc.compute.module = cache.module; cpDesc.compute.entryPoint = "main";
-                cache.pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
-            }
-            // Dispatch shader
-            const auto& sdf = ctx.gpu->GetTexture(ctx.sdfTexture);
-            uint32_t w = sdf.width, h = sdf.height;
-            WGPUBindGroupEntry bgEntries[2]{};
-            bgEntries[0].binding = 0; bgEntries[0].textureView = ctx.gpu->GetTexture(ctx.heightTexture).gpuView;
-            bgEntries[1].binding = 1; bgEntries[1].textureView = sdf.gpuView;
-            WGPUBindGroupDescriptor bgd{}; bgd.layout = cache.bgl; bgd.entryCount = 2; bgd.entries = bgEntries;
-            WGPUBindGroup bg = wgpuDeviceCreateBindGroup(device, &bgd);
-            WGPUCommandEncoder enc = wgpuDeviceCreateCommandEncoder(device, nullptr);
-            WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(enc, nullptr);
-            wgpuComputePassEncoderSetPipeline(pass, cache.pipeline);
-            wgpuComputePassEncoderSetBindGroup(pass, 0, bg, 0, nullptr);
-            wgpuComputePassEncoderDispatchWorkgroups(pass, (w+7)/8, (h+7)/8, 1);
-            wgpuComputePassEncoderEnd(pass);
-            WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(enc, nullptr);
-            wgpuQueueSubmit(ctx.gpu->Queue(), 1, &cmd);
-            // Cleanup
-            wgpuBindGroupRelease(bg);
-            wgpuCommandEncoderRelease(enc);
-            wgpuCommandBufferRelease(cmd);
-            return;
-        }
-#endif
-        // Create SDF texture same resolution as heightmap if not yet
-        if (ctx.sdfTexture == 0) {
+    FeatureWork Apply(ChunkCtx& ctx) override {
+        // Create SDF texture same resolution as heightmap if not yet; the kernel below then
+        // starts every texel empty rather than reading it. Distances are in texels, at most a
+        // cave radius, so half floats hold them to well under a texel.
+        const bool fresh = ctx.sdfTexture == 0;
+        if (fresh) {
             const auto& heightTex = ctx.gpu->GetTexture(ctx.heightTexture);
-            ctx.sdfTexture = ctx.gpu->CreateTexture2D(heightTex.width, heightTex.height);
-            auto& sdf = ctx.gpu->GetTexture(ctx.sdfTexture);
-            std::fill(sdf.data.begin(), sdf.data.end(), 1.0f); // positive = empty
+            ctx.sdfTexture = ctx.gpu->CreateTexture2D(heightTex.width, heightTex.height, TextureFormat::R16Float,
+                                                      TextureInit::Uninitialized);
         }
 
-        auto& sdf = ctx.gpu->GetTexture(ctx.sdfTexture);
+        GPUContext::Texture* sdf = &ctx.gpu->GetTexture(ctx.sdfTexture);
         const auto& hm = ctx.gpu->GetTexture(ctx.heightTexture);
 
         uint32_t w = hm.width;
         uint32_t h = hm.height;
 
-        // Carve 5 random circular caves based on chunk seed
-        uint64_t seed = HashCoords(ctx.id.x, 1234, ctx.id.z, 9876);
-        PCG64State rng = InitPCG64(seed);
-        auto rand01 = [&](void) {
-            return (PCG64Next(rng) >> 40) / double(1ull << 24);
-        };
-
-        for (int i = 0; i < 5; ++i) {
-            float cx = rand01() * w;
-            float cy = rand01() * h;
-            float radius = 10.0f + rand01() * 20.0f;
-            float r2 = radius * radius;
-            for (uint32_t y = 0; y < h; ++y) {
-                for (uint32_t x = 0; x < w; ++x) {
-                    float dx = x - cx;
-                    float dy = y - cy;
-                    float dist2 = dx*dx + dy*dy;
-                    if (dist2 < r2) {
-                        float sdfVal = std::sqrt(dist2) - radius;
-                        sdf.data[y * w + x] = std::min(sdf.data[y * w + x], sdfVal);
+        // Each chunk owns 5 random circular caves seeded from its ID. Caves reach up to 30 world
+        // units, so the neighbours' caves are carved too and the SDF is continuous across edges.
+        struct Cave { float cx, cy, radius; };
+        std::vector<Cave> caves;
+        const float texelsPerUnit = static_cast<float>(w) / kChunkWorldSize;
+        // Three values per cave straight from the chunk's counter stream, no sequential seeding
+        constexpr uint64_t kCaveKey = 9876;
+        constexpr uint32_t kCaveStage = 1;
+        uint64_t bits[15];
+        for (int nz = -1; nz <= 1; ++nz) {
+            for (int nx = -1; nx <= 1; ++nx) {
+                CounterRandomN(kCaveKey, CounterStream(ctx.id.x + nx, ctx.id.z + nz, kCaveStage), 0, bits, 15);
+                const uint64_t* next = bits;
+                auto rand01 = [&](void) {
+                    return (*next++ >> 40) / double(1ull << 24);
+                };
+                for (int i = 0; i < 5; ++i) {
+                    // Positions in this chunk's texels; radii are in world units
+                    Cave c;
+                    c.cx = (nx + rand01()) * w;
+                    c.cy = (nz + rand01()) * h;
+                    c.radius = (10.0f + rand01() * 20.0f) * texelsPerUnit;
+                    if (c.cx + c.radius < 0.0f || c.cx - c.radius >= w ||
+                        c.cy + c.radius < 0.0f || c.cy - c.radius >= h) {
+                        continue;
                     }
+                    caves.push_back(c);
                 }
             }
         }
+
+        // Each texel keeps the least distance over the caves; min() is order-independent, so the
+        // tiles can run in any order. Each tile row is carved in floats and converted back once.
+        return {w, h, [sdf, w, fresh, caves = std::move(caves)](const GPUContext::ComputeTile& t) {
+            thread_local std::vector<float> row;
+            const uint32_t n = t.x1 - t.x0;
+            row.resize(n);
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                const size_t base = static_cast<size_t>(y) * w + t.x0;
+                if (fresh) {
+                    std::fill(row.begin(), row.end(), 1.0f); // positive = empty
+                } else {
+                    sdf->Read(base, n, row.data());
+                }
+                for (const auto& c : caves) {
+                    float r2 = c.radius * c.radius;
+                    for (uint32_t i = 0; i < n; ++i) {
+                        float dx = (t.x0 + i) - c.cx;
+                        float dy = y - c.cy;
+                        float dist2 = dx*dx + dy*dy;
+                        if (dist2 < r2) {
+                            float sdfVal = std::sqrt(dist2) - c.radius;
+                            row[i] = std::min(row[i], sdfVal);
+                        }
+                    }
+                }
+                sdf->Write(base, n, row.data());
+            }
+        }};
     }
 };
 
-// Static registration
+// Static registration. Caves take the heightmap's size, never its heights: it sets the SDF's
+// resolution and the texels per world unit of the radii. That is still a read of heightTexture,
+// so a feature that replaces the heightmap runs first.
 static SimpleCaves g_simpleCaves;
-static bool g_registered = [](){ FeatureRegistry::Add(&g_simpleCaves); return true; }();
+static bool g_registered = FeatureRegistry::Global().Add(
+    &g_simpleCaves, {"SimpleCaves", 1, 100, kFeatureHeight, kFeatureSDF});
 
 } // namespace terraingen 
\ No newline at end of file
@@ -1,92 +1,983 @@
 #include "GPUContext.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
 #include <utility>
 
 using TextureID = terraingen::GPUContext::TextureID;
 
 namespace terraingen {
 
-GPUContext::GPUContext() {
-    // Reserve slot 0 as "null" texture so valid IDs start at 1
-    textures_.push_back({});
+// ---------------- TexturePool ----------------
 
-#ifdef __EMSCRIPTEN__
-    device_ = emscripten_webgpu_get_device();
-    if (device_) {
-        queue_ = wgpuDeviceGetQueue(device_);
+// Free list holding buffers with capacity in (2^(b-1), 2^b]
+static int BucketFor(size_t n) {
+    int b = 0;
+    while ((size_t{1} << b) < n) ++b;
+    return b;
+}
+
+TexturePool::TexturePool(size_t maxBytes) : maxBytes_(maxBytes) {}
+
+TextureBuffer TexturePool::Acquire(size_t n, bool zero) {
+    TextureBuffer buffer;
+    const int b = BucketFor(n);
+    if (b < kBuckets) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& list = free_[b];
+        for (size_t i = list.size(); i-- > 0;) {
+            if (list[i].capacity < n) continue;
+            buffer = std::move(list[i]);
+            list[i] = std::move(list.back());
+            list.pop_back();
+            ++stats_.reuses;
+            --stats_.buffers;
+            stats_.bytes -= buffer.capacity;
+            break;
+        }
+        if (!buffer.bytes) ++stats_.allocations;
+    }
+    if (!buffer.bytes) {
+        // Left uninitialized, a new buffer's pages are not touched until the texture writes them
+        buffer.bytes.reset(zero ? new uint8_t[n]() : new uint8_t[n]);
+        buffer.capacity = n;
+    } else if (zero) {
+        std::fill_n(buffer.bytes.get(), n, uint8_t(0));
+    }
+    return buffer;
+}
+
+void TexturePool::Recycle(TextureBuffer&& buffer) {
+    const size_t bytes = buffer.capacity;
+    const int b = BucketFor(bytes);
+    if (!buffer.bytes || bytes == 0 || b >= kBuckets) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stats_.bytes + bytes > maxBytes_) {
+        ++stats_.dropped;
+        return;
+    }
+    free_[b].push_back(std::move(buffer));
+    ++stats_.buffers;
+    stats_.bytes += bytes;
+}
+
+// Drops the largest buffers first until the pool fits
+void TexturePool::TrimLocked() {
+    for (int b = kBuckets - 1; b >= 0 && stats_.bytes > maxBytes_; --b) {
+        while (!free_[b].empty() && stats_.bytes > maxBytes_) {
+            stats_.bytes -= free_[b].back().capacity;
+            free_[b].pop_back();
+            --stats_.buffers;
+            ++stats_.dropped;
+        }
     }
+}
+
+void TexturePool::SetMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxBytes_ = maxBytes;
+    TrimLocked();
+}
+
+void TexturePool::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& list : free_) list.clear();
+    stats_ = TexturePoolStats();
+}
+
+TexturePoolStats TexturePool::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+TexturePool& TexturePool::Global() {
+    // A 1024^2 chunk keeps about a dozen 4 MiB textures alive at once
+    static TexturePool pool(128u << 20);
+    return pool;
+}
+
+// ---------------- GPUContext ----------------
+
+uint8_t* GPUContext::Texture::Mirror() const {
+    uint8_t* mirror = mirror_.load(std::memory_order_acquire);
+    if (mirror || !owner_) return mirror;
+    return owner_->Materialize(*this);
+}
+
+void GPUContext::Texture::Read(size_t first, size_t n, float* out, uint32_t channel) const {
+    if (format == TextureFormat::R32Float) {
+        std::copy_n(As<float>() + first, n, out);
+    } else {
+        DecodeTexels(format, As<uint8_t>() + first * TexelBytes(format), n, out, channel);
+    }
+}
+
+void GPUContext::Texture::Write(size_t first, size_t n, const float* in, uint32_t channel) {
+    if (format == TextureFormat::R32Float) {
+        std::copy_n(in, n, As<float>() + first);
+    } else {
+        EncodeTexels(format, in, n, As<uint8_t>() + first * TexelBytes(format), channel);
+    }
+}
+
+std::vector<float> GPUContext::Texture::ToFloats() const {
+    std::vector<float> out(Texels());
+    Read(0, out.size(), out.data());
+    return out;
+}
+
+#if TERRAINGEN_WEBGPU && !defined(__EMSCRIPTEN__)
+static WGPUAdapter RequestAdapter(WGPUInstance instance, bool fallback) {
+    WGPURequestAdapterOptions options{};
+    options.forceFallbackAdapter = fallback;
+    WGPUAdapter adapter = nullptr;
+    // wgpu-native answers before returning
+    wgpuInstanceRequestAdapter(instance, &options,
+        [](WGPURequestAdapterStatus status, WGPUAdapter a, const char*, void* usr) {
+            if (status == WGPURequestAdapterStatus_Success) *static_cast<WGPUAdapter*>(usr) = a;
+        }, &adapter);
+    return adapter;
+}
+
+// One device for the whole process, as the browser has. A GPU-less machine still gets one
+// from a software Vulkan driver such as lavapipe, which wgpu offers as a CPU-type adapter when
+// nothing better is there, or as the fallback adapter. Null when there is no adapter at all.
+static WGPUDevice NativeDevice() {
+    static const WGPUDevice device = [] {
+        WGPUInstanceDescriptor instanceDesc{};
+        WGPUInstance instance = wgpuCreateInstance(&instanceDesc);
+        if (!instance) return WGPUDevice(nullptr);
+        WGPUAdapter adapter = RequestAdapter(instance, false);
+        if (!adapter) adapter = RequestAdapter(instance, true);
+        WGPUDevice dev = nullptr;
+        if (adapter) {
+            WGPUDeviceDescriptor deviceDesc{};
+            deviceDesc.label = "terraingen";
+            wgpuAdapterRequestDevice(adapter, &deviceDesc,
+                [](WGPURequestDeviceStatus status, WGPUDevice d, const char* message, void* usr) {
+                    if (status == WGPURequestDeviceStatus_Success) {
+                        *static_cast<WGPUDevice*>(usr) = d;
+                    } else {
+                        std::fprintf(stderr, "WebGPU device request failed: %s\n", message ? message : "");
+                    }
+                }, &dev);
+            wgpuAdapterRelease(adapter);
+        }
+        wgpuInstanceRelease(instance);
+        return dev;
+    }();
+    return device;
+}
 #endif
+
+GPUContext::GPUContext(TexturePool& pool) : GPUContext(GPUBackend::CPU, pool) {}
+
+GPUContext::GPUContext(GPUBackend backend, TexturePool& pool) : pool_(pool), backend_(backend) {
+    if (backend_ == GPUBackend::WebGPU) {
+        backend_ = GPUBackend::CPU;
+#ifdef __EMSCRIPTEN__
+        device_ = emscripten_webgpu_get_device();
+#elif TERRAINGEN_WEBGPU
+        device_ = NativeDevice();
+#endif
+#if TERRAINGEN_WEBGPU
+        if (device_) {
+            queue_ = wgpuDeviceGetQueue(device_);
+            backend_ = GPUBackend::WebGPU;
+        }
+#endif
+    }
+    passes_ = std::make_unique<PassGraph>(*this, backend_);
 }
 
 GPUContext::~GPUContext() {
-#ifdef __EMSCRIPTEN__
-    // Cleanup GPU textures
-    for (auto& tex : textures_) {
+    // Passes still recorded go out while their textures exist
+    passes_->Submit();
+    for (uint32_t h = 0; h < kShards; ++h) {
+        std::vector<TextureID> live;
+        {
+            std::lock_guard<std::mutex> lock(shards_[h].mutex);
+            for (uint32_t s = 1; s < shards_[h].slotCount; ++s) {
+                const Slot& slot = shards_[h].At(s);
+                if (slot.live) live.push_back(slot.generation << kGenerationShift | h << kSlotBits | s);
+            }
+        }
+        for (TextureID id : live) Release(id);
+    }
+    // The device is shared, but this context's reference to its queue is not
+    passes_.reset();
+#if TERRAINGEN_WEBGPU
+    if (queue_) wgpuQueueRelease(queue_);
+#endif
+}
+
+// Shard whose slots a thread creates textures in: threads are dealt shards round-robin on
+// their first texture
+static uint32_t ThreadShard(uint32_t shards) {
+    static std::atomic<uint32_t> next{0};
+    thread_local const uint32_t shard = next.fetch_add(1, std::memory_order_relaxed);
+    return shard % shards;
+}
+
+// Core WebGPU cannot write r8uint from a shader, so R8Uint textures are r32uint on the device:
+// each byte widens to a word on upload and narrows back on readback
+static uint32_t DeviceTexelBytes(TextureFormat format) {
+    return format == TextureFormat::R8Uint ? 4 : TexelBytes(format);
+}
+
+#if TERRAINGEN_WEBGPU
+// R16Unorm is not a core WebGPU format; such textures stay CPU-side
+static WGPUTextureFormat DeviceFormat(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::R32Float: return WGPUTextureFormat_R32Float;
+        case TextureFormat::R16Float: return WGPUTextureFormat_R16Float;
+        case TextureFormat::R8Unorm: return WGPUTextureFormat_R8Unorm;
+        case TextureFormat::R8Uint: return WGPUTextureFormat_R32Uint;
+        case TextureFormat::RG8Snorm: return WGPUTextureFormat_RG8Snorm;
+        case TextureFormat::RGBA8Unorm: return WGPUTextureFormat_RGBA8Unorm;
+        default: return WGPUTextureFormat_Undefined;
+    }
+}
+
+// Formats core WebGPU lets a shader write; the others cannot even be created with storage usage
+static bool DeviceStorable(WGPUTextureFormat format) {
+    return format == WGPUTextureFormat_R32Float || format == WGPUTextureFormat_R32Uint ||
+           format == WGPUTextureFormat_RGBA8Unorm;
+}
+
+static void CreateDeviceTexture(WGPUDevice device, GPUContext::Texture& tex) {
+    WGPUTextureDescriptor td{};
+    td.dimension = WGPUTextureDimension_2D;
+    td.format = DeviceFormat(tex.format);
+    if (td.format == WGPUTextureFormat_Undefined) return;
+    td.size = {tex.width, tex.height, 1};
+    td.sampleCount = 1;
+    td.mipLevelCount = 1;
+    td.usage = WGPUTextureUsage_CopySrc | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+    if (DeviceStorable(td.format)) td.usage |= WGPUTextureUsage_StorageBinding;
+    tex.gpuTex = wgpuDeviceCreateTexture(device, &td);
+    WGPUTextureViewDescriptor vd{};
+    vd.format = td.format;
+    vd.dimension = WGPUTextureViewDimension_2D;
+    vd.baseArrayLayer = 0;
+    vd.arrayLayerCount = 1;
+    vd.baseMipLevel = 0;
+    vd.mipLevelCount = 1;
+    tex.gpuView = wgpuTextureCreateView(tex.gpuTex, &vd);
+}
+#endif
+
+TextureID GPUContext::CreateTexture2D(uint32_t width, uint32_t height, TextureFormat format, TextureInit init) {
+    const uint32_t h = ThreadShard(kShards);
+    Shard& shard = shards_[h];
+    TextureID id;
+    bool newSlot = false;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        uint32_t s;
+        if (!shard.freeSlots.empty()) {
+            s = shard.freeSlots.back();
+            shard.freeSlots.pop_back();
+        } else {
+            if (shard.slotCount > kSlotMask) return 0;
+            if (shard.slotCount / kSlabSlots == shard.slabs.size()) {
+                shard.slabs.push_back(std::make_unique<Slot[]>(kSlabSlots));
+            }
+            s = shard.slotCount++;
+            newSlot = true;
+        }
+        Slot& slot = shard.At(s);
+        slot.live = true;
+        Texture& tex = slot.texture;
+        tex.width = width;
+        tex.height = height;
+        tex.format = format;
+        tex.owner_ = this;
+        tex.zeroed_ = init == TextureInit::Zeroed;
+#if TERRAINGEN_WEBGPU
+        if (device_) CreateDeviceTexture(device_, tex);
+#endif
+        id = slot.generation << kGenerationShift | h << kSlotBits | s;
+    }
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    ++stats_.created;
+    ++stats_.liveTextures;
+    if (newSlot) ++stats_.slots;
+    return id;
+}
+
+uint8_t* GPUContext::Materialize(const Texture& tex) {
+    // Threads racing for this texture's mirror wait here, and only they: the zero-fill and any
+    // readback run without holding up other textures or the stats
+    std::lock_guard<std::mutex> claim(tex.mirrorMutex_);
+    uint8_t* mirror = tex.mirror_.load(std::memory_order_relaxed);
+    if (mirror) return mirror;
+    const size_t bytes = tex.ByteSize();
+    tex.buffer_ = pool_.Acquire(bytes, tex.zeroed_);
+    mirror = tex.buffer_.bytes.get();
+    // Written by a pass: fetch its contents before anyone sees the mirror. If the copy fails
+    // the mirror reads as zero rather than as whatever the pool buffer held.
+    if (tex.deviceNewer_.exchange(false) && !passes_->ReadMirror(tex, mirror).Wait()) {
+        std::fprintf(stderr, "Texture readback failed; its %ux%u mirror reads as zero\n", tex.width, tex.height);
+        std::fill_n(mirror, bytes, uint8_t(0));
+    }
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.mirrorBytes += bytes;
+        if (tex.zeroed_) stats_.zeroedBytes += bytes;
+        stats_.liveBytes += bytes;
+        stats_.peakBytes = std::max(stats_.peakBytes, stats_.liveBytes);
+    }
+    tex.mirror_.store(mirror, std::memory_order_release);
+    return mirror;
+}
+
+void GPUContext::Release(TextureID id) {
+    // Readbacks into the texture finish before its mirror goes back to the pool
+    passes_->Forget(id);
+    Shard& shard = shards_[id >> kSlotBits & (kShards - 1)];
+    TextureBuffer buffer;
+    size_t bytes;
+    bool mirrored;
+    bool unread;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const uint32_t s = id & kSlotMask;
+        if (s == 0 || s >= shard.slotCount) return;
+        Slot& slot = shard.At(s);
+        if (!slot.live || slot.generation != id >> kGenerationShift) return;
+        Texture& tex = slot.texture;
+#if TERRAINGEN_WEBGPU
         if (tex.gpuView) wgpuTextureViewRelease(tex.gpuView);
         if (tex.gpuTex) wgpuTextureRelease(tex.gpuTex);
-    }
+        tex.gpuView = nullptr;
+        tex.gpuTex = nullptr;
 #endif
+        bytes = tex.ByteSize();
+        mirrored = tex.HasMirror();
+        unread = tex.deviceNewer_.exchange(false);
+        tex.mirrorNewer_.store(false, std::memory_order_relaxed);
+        buffer = std::move(tex.buffer_);
+        tex.buffer_ = TextureBuffer();
+        tex.mirror_.store(nullptr, std::memory_order_relaxed);
+        tex.width = tex.height = 0;
+        tex.format = TextureFormat::R32Float;
+        tex.owner_ = nullptr;
+        tex.zeroed_ = true;
+        slot.live = false;
+        // Generation 0 is skipped so that no handle is ever 0
+        slot.generation = slot.generation == kGenerationMask ? 1 : slot.generation + 1;
+        shard.freeSlots.push_back(s);
+    }
+    pool_.Recycle(std::move(buffer));
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    if (unread) ++stats_.skippedReadbacks;
+    if (mirrored) {
+        stats_.liveBytes -= bytes;
+    } else {
+        stats_.untouchedBytes += bytes;
+    }
+    ++stats_.released;
+    --stats_.liveTextures;
 }
 
-TextureID GPUContext::CreateTexture2D(uint32_t width, uint32_t height) {
-    Texture tex;
-    tex.width = width;
-    tex.height = height;
-    tex.data.resize(static_cast<size_t>(width) * height, 0.0f);
-#ifdef __EMSCRIPTEN__
-    if (device_) {
-        WGPUTextureDescriptor td{};
-        td.dimension = WGPUTextureDimension_2D;
-        td.format = WGPUTextureFormat_R32Float;
-        td.size = {width, height, 1};
-        td.sampleCount = 1;
-        td.mipLevelCount = 1;
-        td.usage = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_CopySrc | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
-        tex.gpuTex = wgpuDeviceCreateTexture(device_, &td);
-        WGPUTextureViewDescriptor vd{};
-        vd.format = td.format;
-        vd.dimension = WGPUTextureViewDimension_2D;
-        vd.baseArrayLayer = 0;
-        vd.arrayLayerCount = 1;
-        vd.baseMipLevel = 0;
-        vd.mipLevelCount = 1;
-        tex.gpuView = wgpuTextureCreateView(tex.gpuTex, &vd);
-    }
-#endif
-    textures_.push_back(std::move(tex));
-    return static_cast<TextureID>(textures_.size() - 1);
-}
-
-TextureID GPUContext::CreateTexture2D_U8(uint32_t width, uint32_t height) {
-    Texture tex;
-    tex.width = width;
-    tex.height = height;
-    tex.dataU8.resize(static_cast<size_t>(width) * height, 0u);
-#ifdef __EMSCRIPTEN__
-    if (device_) {
-        WGPUTextureDescriptor td{};
-        td.dimension = WGPUTextureDimension_2D;
-        td.format = WGPUTextureFormat_R8Uint;
-        td.size = {width, height, 1};
-        td.sampleCount = 1;
-        td.mipLevelCount = 1;
-        td.usage = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_CopySrc | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
-        tex.gpuTex = wgpuDeviceCreateTexture(device_, &td);
-        WGPUTextureViewDescriptor vd{};
-        vd.format = td.format;
-        vd.dimension = WGPUTextureViewDimension_2D;
-        vd.baseArrayLayer = 0;
-        vd.arrayLayerCount = 1;
-        vd.baseMipLevel = 0;
-        vd.mipLevelCount = 1;
-        tex.gpuView = wgpuTextureCreateView(tex.gpuTex, &vd);
-    }
-#endif
-    textures_.push_back(std::move(tex));
-    return static_cast<TextureID>(textures_.size() - 1);
+bool GPUContext::Readback(TextureID id) {
+    return ReadbackAsync(id).Wait();
+}
+
+PendingReadback GPUContext::ReadbackAsync(TextureID id) {
+    Slot* slot = Find(id);
+    if (!slot) return PendingReadback();
+    Texture& tex = slot->texture;
+    // Only what a pass wrote since the last readback needs copying; any other texture is
+    // current on the CPU
+    const bool fetch = tex.deviceNewer_.exchange(false);
+    uint8_t* mirror = tex.Mirror();
+    if (!fetch) return PendingReadback();
+    return passes_->ReadTextureAsync(id, mirror);
+}
+
+void GPUContext::Dispatch(uint32_t width, uint32_t height, const ComputeKernel& kernel, uint32_t groupRows) {
+    if (width == 0 || height == 0) return;
+    const uint32_t groupsX = (width + kWorkgroupSize - 1) / kWorkgroupSize;
+    const uint32_t groupsY = (height + kWorkgroupSize - 1) / kWorkgroupSize;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        ++stats_.dispatches;
+        stats_.workgroups += static_cast<uint64_t>(groupsX) * groupsY;
+    }
+    ThreadPool::Global().ParallelFor(0, groupsY, std::max(1u, groupRows), [&](uint32_t g0, uint32_t g1) {
+        for (uint32_t g = g0; g < g1; ++g) {
+            const uint32_t y0 = g * kWorkgroupSize;
+            kernel(ComputeTile{0, width, y0, std::min(height, y0 + kWorkgroupSize)});
+        }
+    });
+}
+
+void GPUContext::Dispatch(const std::vector<DispatchDesc>& dispatches, uint32_t groupRows) {
+    if (dispatches.empty()) return;
+    if (dispatches.size() == 1) {
+        Dispatch(dispatches[0].width, dispatches[0].height, dispatches[0].kernel, groupRows);
+        return;
+    }
+    // Bands of dispatch d are [firstBand[d], firstBand[d + 1])
+    groupRows = std::max(1u, groupRows);
+    std::vector<uint32_t> firstBand(1, 0);
+    uint64_t workgroups = 0;
+    for (const DispatchDesc& d : dispatches) {
+        const bool empty = d.width == 0 || d.height == 0;
+        const uint32_t groupsX = empty ? 0 : (d.width + kWorkgroupSize - 1) / kWorkgroupSize;
+        const uint32_t groupsY = empty ? 0 : (d.height + kWorkgroupSize - 1) / kWorkgroupSize;
+        workgroups += static_cast<uint64_t>(groupsX) * groupsY;
+        firstBand.push_back(firstBand.back() + (groupsY + groupRows - 1) / groupRows);
+    }
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.dispatches += dispatches.size();
+        stats_.workgroups += workgroups;
+    }
+    ThreadPool::Global().ParallelFor(0, firstBand.back(), 1, [&](uint32_t b0, uint32_t b1) {
+        for (uint32_t b = b0; b < b1; ++b) {
+            const size_t d = std::upper_bound(firstBand.begin(), firstBand.end(), b) - firstBand.begin() - 1;
+            const DispatchDesc& desc = dispatches[d];
+            const uint32_t g0 = (b - firstBand[d]) * groupRows;
+            for (uint32_t g = g0; g < g0 + groupRows; ++g) {
+                const uint32_t y0 = g * kWorkgroupSize;
+                if (y0 >= desc.height) break;
+                desc.kernel(ComputeTile{0, desc.width, y0, std::min(desc.height, y0 + kWorkgroupSize)});
+            }
+        }
+    });
+}
+
+GPUContext::Stats GPUContext::GetStats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
+
+GPUContext::Slot* GPUContext::Find(TextureID id) const {
+    const Shard& shard = shards_[id >> kSlotBits & (kShards - 1)];
+    const uint32_t s = id & kSlotMask;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (s == 0 || s >= shard.slotCount) return nullptr;
+    Slot& slot = shard.At(s);
+    return slot.live && slot.generation == id >> kGenerationShift ? &slot : nullptr;
+}
+
+bool GPUContext::IsValid(TextureID id) const {
+    return Find(id) != nullptr;
 }
 
 GPUContext::Texture& GPUContext::GetTexture(TextureID id) {
-    return textures_.at(id);
+    Slot* slot = Find(id);
+    return slot ? slot->texture : null_;
+}
+
+const GPUContext::Texture& GPUContext::GetTexture(TextureID id) const {
+    const Slot* slot = Find(id);
+    return slot ? slot->texture : null_;
+}
+
+// ---------------- PassGraph ----------------
+
+PassGraph::PassGraph(GPUContext& gpu, GPUBackend backend) : gpu_(gpu), backend_(backend) {}
+
+PassGraph::~PassGraph() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (uint32_t s = 0; s < kStagingSlots; ++s) {
+        if (staging_[s].ticket) FinishLocked(s, staging_[s].ticket, lock);
+    }
+    SubmitLocked();
+#if TERRAINGEN_WEBGPU
+    for (Staging& staging : staging_) {
+        if (staging.handle) wgpuBufferRelease(staging.handle);
+    }
+    for (BindGroup& group : bindGroups_) {
+        if (group.handle) wgpuBindGroupRelease(group.handle);
+    }
+    for (Buffer& buffer : buffers_) {
+        if (buffer.handle) wgpuBufferRelease(buffer.handle);
+    }
+#endif
+}
+
+PassGraph::BufferID PassGraph::CreateBuffer(BufferUsage usage, size_t bytes, const void* data) {
+    if (backend_ == GPUBackend::CPU || bytes == 0) return 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    BufferID id;
+    if (!freeBuffers_.empty()) {
+        id = freeBuffers_.back();
+        freeBuffers_.pop_back();
+    } else {
+        buffers_.emplace_back();
+        id = static_cast<BufferID>(buffers_.size());
+    }
+    Buffer& buffer = buffers_[id - 1];
+    buffer.usage = usage;
+    buffer.bytes = bytes;
+    buffer.live = true;
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU) {
+        WGPUBufferDescriptor desc{};
+        desc.size = bytes;
+        desc.usage = usage == BufferUsage::Uniform
+                         ? WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst
+                         : WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst;
+        buffer.handle = wgpuDeviceCreateBuffer(gpu_.Device(), &desc);
+        // Queue writes land before the next submit, so before any pass using the buffer
+        if (data) wgpuQueueWriteBuffer(gpu_.Queue(), buffer.handle, 0, data, bytes);
+    }
+#endif
+    if (backend_ == GPUBackend::Recording) {
+        buffer.contents.assign(bytes, 0);
+        if (data) std::copy_n(static_cast<const uint8_t*>(data), bytes, buffer.contents.data());
+    }
+    ++stats_.liveBuffers;
+    return id;
+}
+
+void PassGraph::ReleaseBuffer(BufferID id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id == 0 || id > buffers_.size() || !buffers_[id - 1].live) return;
+    ForgetLocked(PassBinding::Buffer(id));
+    Buffer& buffer = buffers_[id - 1];
+#if TERRAINGEN_WEBGPU
+    if (buffer.handle) {
+        if (pending_) {
+            retiredBuffers_.push_back(buffer.handle);
+        } else {
+            wgpuBufferRelease(buffer.handle);
+        }
+    }
+#endif
+    buffer = Buffer();
+    freeBuffers_.push_back(id);
+    --stats_.liveBuffers;
+}
+
+PassGraph::BindGroup& PassGraph::BindGroupLocked(const ComputePass& pass) {
+    for (BindGroup& group : bindGroups_) {
+        if (group.pipeline == pass.pipeline && group.bindings == pass.bindings) {
+            ++stats_.bindGroupHits;
+            return group;
+        }
+    }
+    bindGroups_.push_back(BindGroup{pass.pipeline, pass.bindings});
+    BindGroup& group = bindGroups_.back();
+    ++stats_.bindGroups;
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU) {
+        WGPUDevice device = gpu_.Device();
+        WGPUBindGroupEntry entries[PipelineDesc::kMaxBindings]{};
+        const uint32_t count = static_cast<uint32_t>(pass.bindings.size());
+        for (uint32_t i = 0; i < count; ++i) {
+            const PassBinding& b = pass.bindings[i];
+            entries[i].binding = i;
+            if (b.buffer) {
+                entries[i].buffer = buffers_[b.buffer - 1].handle;
+                entries[i].size = buffers_[b.buffer - 1].bytes;
+            } else {
+                entries[i].textureView = gpu_.GetTexture(b.texture).gpuView;
+            }
+        }
+        WGPUBindGroupDescriptor desc{};
+        desc.layout = PipelineRegistry::Global().Get(device, pass.pipeline).bgl;
+        desc.entryCount = count;
+        desc.entries = entries;
+        group.handle = wgpuDeviceCreateBindGroup(device, &desc);
+    }
+#endif
+    return group;
+}
+
+bool PassGraph::Add(const ComputePass& pass) {
+    if (backend_ == GPUBackend::CPU || pass.width == 0 || pass.height == 0) return false;
+    const PipelineDesc& desc = GetPipelineDesc(pass.pipeline);
+    if (pass.bindings.size() != desc.bindingCount) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < desc.bindingCount; ++i) {
+        const PassBinding& b = pass.bindings[i];
+        const BindingKind kind = desc.bindings[i];
+        if (kind == BindingKind::Uniform || kind == BindingKind::StorageBuffer ||
+            kind == BindingKind::ReadOnlyStorage) {
+            const BufferUsage usage = kind == BindingKind::Uniform ? BufferUsage::Uniform : BufferUsage::Storage;
+            if (b.texture || b.buffer == 0 || b.buffer > buffers_.size()) return false;
+            if (!buffers_[b.buffer - 1].live || buffers_[b.buffer - 1].usage != usage) return false;
+        } else if (b.buffer || !gpu_.IsValid(b.texture)) {
+            return false;
+        }
+    }
+    // Sampled textures the CPU wrote go to the device first, once however often they are bound
+    for (uint32_t i = 0; i < desc.bindingCount; ++i) {
+        if (desc.bindings[i] != BindingKind::SampledFloat) continue;
+        GPUContext::Texture& tex = gpu_.GetTexture(pass.bindings[i].texture);
+        if (!tex.deviceNewer_.load() && tex.mirrorNewer_.exchange(false)) UploadLocked(tex, pass.bindings[i].texture);
+    }
+    // Storage textures it writes are newer on the device until read back
+    for (uint32_t i = 0; i < desc.bindingCount; ++i) {
+        if (desc.bindings[i] == BindingKind::StorageR32Float || desc.bindings[i] == BindingKind::StorageR8Uint) {
+            GPUContext::Texture& tex = gpu_.GetTexture(pass.bindings[i].texture);
+            tex.deviceNewer_.store(true);
+            tex.mirrorNewer_.store(false, std::memory_order_relaxed);
+        }
+    }
+    BindGroup& group = BindGroupLocked(pass);
+    constexpr uint32_t kGroup = GPUContext::kWorkgroupSize;
+    const uint32_t groupsX = (pass.width + kGroup - 1) / kGroup;
+    const uint32_t groupsY = (pass.height + kGroup - 1) / kGroup;
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU) {
+        WGPUDevice device = gpu_.Device();
+        if (!encoder_) encoder_ = wgpuDeviceCreateCommandEncoder(device, nullptr);
+        WGPUComputePassEncoder cpass = wgpuCommandEncoderBeginComputePass(encoder_, nullptr);
+        wgpuComputePassEncoderSetPipeline(cpass, PipelineRegistry::Global().Get(device, pass.pipeline).pipeline);
+        wgpuComputePassEncoderSetBindGroup(cpass, 0, group.handle, 0, nullptr);
+        wgpuComputePassEncoderDispatchWorkgroups(cpass, groupsX, groupsY, 1);
+        wgpuComputePassEncoderEnd(cpass);
+        wgpuComputePassEncoderRelease(cpass);
+    }
+#else
+    (void)group;
+#endif
+    ++stats_.passes;
+    RecordLocked({Command::Dispatch, pass.pipeline, groupsX, groupsY});
+    for (const PassBinding& b : pass.bindings) {
+        if (b.texture) pendingTextures_.push_back(b.texture);
+    }
+    return true;
+}
+
+void PassGraph::UploadLocked(const GPUContext::Texture& tex, TextureID id) {
+    // Queue writes land ahead of the next submit, so passes recorded before that use the
+    // texture go out first and keep seeing its old contents
+    if (std::find(pendingTextures_.begin(), pendingTextures_.end(), id) != pendingTextures_.end()) SubmitLocked();
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU) {
+        if (!tex.gpuTex) return;
+        WGPUImageCopyTexture dst{};
+        dst.texture = tex.gpuTex;
+        WGPUTextureDataLayout layout{};
+        layout.bytesPerRow = static_cast<uint32_t>(tex.width * DeviceTexelBytes(tex.format));
+        layout.rowsPerImage = tex.height;
+        const WGPUExtent3D size = {tex.width, tex.height, 1};
+        const uint8_t* bytes = tex.As<uint8_t>();
+        if (DeviceTexelBytes(tex.format) != TexelBytes(tex.format)) {
+            const std::vector<uint32_t> words(bytes, bytes + tex.Texels());
+            wgpuQueueWriteTexture(gpu_.Queue(), &dst, words.data(), words.size() * 4, &layout, &size);
+        } else {
+            wgpuQueueWriteTexture(gpu_.Queue(), &dst, bytes, tex.ByteSize(), &layout, &size);
+        }
+    }
+#else
+    (void)tex;
+#endif
+    ++stats_.uploads;
+    RecordLocked({Command::Upload, PipelineID::Count, 0, 0});
+}
+
+void PassGraph::RecordLocked(const Command& command) {
+    // Uploads go through the queue, not the encoder
+    if (command.kind != Command::Submit && command.kind != Command::Upload) pending_ = true;
+    if (backend_ == GPUBackend::Recording) log_.push_back(command);
+}
+
+void PassGraph::SubmitLocked() {
+    if (!pending_) return;
+#if TERRAINGEN_WEBGPU
+    if (encoder_) {
+        WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(encoder_, nullptr);
+        wgpuQueueSubmit(gpu_.Queue(), 1, &cmd);
+        wgpuCommandBufferRelease(cmd);
+        wgpuCommandEncoderRelease(encoder_);
+        encoder_ = nullptr;
+    }
+    for (WGPUBindGroup group : retiredGroups_) wgpuBindGroupRelease(group);
+    for (WGPUBuffer buffer : retiredBuffers_) wgpuBufferRelease(buffer);
+    retiredGroups_.clear();
+    retiredBuffers_.clear();
+#endif
+    ++stats_.submits;
+    RecordLocked({Command::Submit, PipelineID::Count, 0, 0});
+    pending_ = false;
+    pendingTextures_.clear();
+}
+
+void PassGraph::Submit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SubmitLocked();
+}
+
+void PassGraph::SetMapLatency(std::chrono::microseconds latency) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mapLatency_ = latency;
+}
+
+void PassGraph::SetMapFailure(bool fail) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mapFailure_ = fail;
+}
+
+uint32_t PassGraph::AcquireStagingLocked(size_t bytes, std::unique_lock<std::mutex>& lock) {
+    for (;;) {
+        // The smallest free buffer that fits, else the smallest free one, which is regrown
+        uint32_t fit = kStagingSlots, spare = kStagingSlots, oldest = kStagingSlots;
+        for (uint32_t s = 0; s < kStagingSlots; ++s) {
+            const Staging& st = staging_[s];
+            if (st.ticket) {
+                if (oldest == kStagingSlots || st.ticket < staging_[oldest].ticket) oldest = s;
+            } else if (st.capacity >= bytes) {
+                if (fit == kStagingSlots || st.capacity < staging_[fit].capacity) fit = s;
+            } else if (spare == kStagingSlots || st.capacity < staging_[spare].capacity) {
+                spare = s;
+            }
+        }
+        if (fit != kStagingSlots) return fit;
+        if (spare != kStagingSlots) {
+            Staging& st = staging_[spare];
+            size_t capacity = 256;
+            while (capacity < bytes) capacity <<= 1;
+#if TERRAINGEN_WEBGPU
+            if (backend_ == GPUBackend::WebGPU) {
+                if (st.handle) wgpuBufferRelease(st.handle);
+                WGPUBufferDescriptor desc{};
+                desc.size = capacity;
+                desc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead;
+                st.handle = wgpuDeviceCreateBuffer(gpu_.Device(), &desc);
+            }
+#endif
+            st.capacity = capacity;
+            ++stats_.stagingBuffers;
+            return spare;
+        }
+        // Every buffer is in flight: the oldest readback finishes first
+        FinishLocked(oldest, staging_[oldest].ticket, lock);
+    }
+}
+
+PendingReadback PassGraph::StartReadbackLocked(uint32_t s, size_t bytes) {
+    Staging& st = staging_[s];
+    st.ticket = nextTicket_++;
+    st.mapped = false;
+    st.failed = backend_ == GPUBackend::Recording && mapFailure_;
+    ++stats_.readbacks;
+    SubmitLocked();
+    st.readyAt = Clock::now() + mapLatency_;
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU) {
+        wgpuBufferMapAsync(st.handle, WGPUMapMode_Read, 0, bytes,
+            [](WGPUBufferMapAsyncStatus status, void* usr) {
+                Staging* staging = static_cast<Staging*>(usr);
+                staging->failed = status != WGPUBufferMapAsyncStatus_Success;
+                staging->mapped = true;
+            }, &st);
+    }
+#else
+    (void)bytes;
+#endif
+    return PendingReadback(this, s, st.ticket);
+}
+
+bool PassGraph::ReadyLocked(uint32_t s, uint64_t ticket) const {
+    const Staging& st = staging_[s];
+    if (st.ticket != ticket) return true;
+    if (backend_ == GPUBackend::Recording) return Clock::now() >= st.readyAt;
+    return st.mapped;
+}
+
+void PassGraph::FinishLocked(uint32_t s, uint64_t ticket, std::unique_lock<std::mutex>& lock) {
+    Staging& st = staging_[s];
+    if (st.ticket != ticket) return;
+    if (!ReadyLocked(s, ticket)) {
+        ++stats_.stalls;
+        const Clock::time_point readyAt = st.readyAt;
+        lock.unlock();
+#if TERRAINGEN_WEBGPU
+        // Map callbacks fire while the device is polled
+        if (backend_ == GPUBackend::WebGPU) {
+            while (!st.mapped) { PollDevice(gpu_.Device()); }
+        }
+#endif
+        if (backend_ == GPUBackend::Recording) std::this_thread::sleep_until(readyAt);
+        lock.lock();
+        // Another waiter may have finished it meanwhile
+        if (st.ticket != ticket) return;
+    }
+    bool ok = !st.failed;
+    const uint8_t* mapped = nullptr;
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU && ok) {
+        mapped = static_cast<const uint8_t*>(wgpuBufferGetConstMappedRange(st.handle, 0, st.pitch * st.rows));
+        ok = mapped != nullptr;
+    }
+#endif
+    // The fake queue models buffer contents only; texture readbacks leave the mirror as it is
+    if (backend_ == GPUBackend::Recording && !st.fake.empty()) mapped = st.fake.data();
+    if (ok && mapped && st.out) {
+        for (uint32_t y = 0; y < st.rows; ++y) {
+            const uint8_t* row = mapped + y * st.pitch;
+            uint8_t* out = st.out + y * st.rowBytes;
+            if (st.widened) {
+                // Little-endian words: a texel's byte is the first of its word
+                for (size_t x = 0; x < st.rowBytes; ++x) out[x] = row[x * 4];
+            } else {
+                std::copy_n(row, st.rowBytes, out);
+            }
+        }
+    }
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU && !st.failed) wgpuBufferUnmap(st.handle);
+#endif
+    if (!ok) {
+        ++stats_.failedReadbacks;
+        failedTickets_.push_back(ticket);
+    }
+    st.ticket = 0;
+    st.texture = 0;
+    st.out = nullptr;
+    st.fake.clear();
+}
+
+PendingReadback PassGraph::ReadTextureLocked(const GPUContext::Texture& tex, TextureID id, uint8_t* out,
+                                             std::unique_lock<std::mutex>& lock) {
+    if (tex.width == 0 || tex.height == 0) return PendingReadback();
+    // Buffer rows of a texture copy must be 256-byte aligned
+    const size_t rowBytes = tex.width * TexelBytes(tex.format);
+    const uint32_t stride = backend_ == GPUBackend::WebGPU ? DeviceTexelBytes(tex.format) : TexelBytes(tex.format);
+    const size_t pitch = backend_ == GPUBackend::WebGPU ? (tex.width * stride + 255) & ~size_t{255} : rowBytes;
+    const uint32_t width = tex.width, height = tex.height;
+#if TERRAINGEN_WEBGPU
+    WGPUTexture source = tex.gpuTex;
+#endif
+    const uint32_t s = AcquireStagingLocked(pitch * height, lock);
+    Staging& st = staging_[s];
+    st.texture = id;
+    st.out = out;
+    st.rowBytes = rowBytes;
+    st.pitch = pitch;
+    st.rows = height;
+    st.widened = stride != TexelBytes(tex.format);
+    ++stats_.copies;
+    RecordLocked({Command::CopyTexture, PipelineID::Count, 0, 0});
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU) {
+        WGPUImageCopyTexture srcTex{};
+        srcTex.texture = source;
+        WGPUImageCopyBuffer dstBuf{};
+        dstBuf.buffer = st.handle;
+        dstBuf.layout.bytesPerRow = static_cast<uint32_t>(pitch);
+        dstBuf.layout.rowsPerImage = height;
+        WGPUExtent3D copySize = {width, height, 1};
+        if (!encoder_) encoder_ = wgpuDeviceCreateCommandEncoder(gpu_.Device(), nullptr);
+        wgpuCommandEncoderCopyTextureToBuffer(encoder_, &srcTex, &dstBuf, &copySize);
+    }
+#else
+    (void)width;
+#endif
+    return StartReadbackLocked(s, pitch * height);
+}
+
+PendingReadback PassGraph::ReadTextureAsync(TextureID id, uint8_t* out) {
+    if (backend_ == GPUBackend::CPU) return PendingReadback();
+    std::unique_lock<std::mutex> lock(mutex_);
+    return ReadTextureLocked(gpu_.GetTexture(id), id, out, lock);
+}
+
+PendingReadback PassGraph::ReadMirror(const GPUContext::Texture& tex, uint8_t* out) {
+    if (backend_ == GPUBackend::CPU) return PendingReadback();
+    std::unique_lock<std::mutex> lock(mutex_);
+    return ReadTextureLocked(tex, 0, out, lock);
+}
+
+PendingReadback PassGraph::ReadBufferAsync(BufferID id, void* out, size_t bytes) {
+    if (backend_ == GPUBackend::CPU) return PendingReadback();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (id == 0 || id > buffers_.size() || !buffers_[id - 1].live) return PendingReadback();
+    bytes = std::min(bytes, buffers_[id - 1].bytes);
+    // Copies and mappings come in multiples of 4 bytes
+    const size_t copyBytes = (bytes + 3) & ~size_t{3};
+    const uint32_t s = AcquireStagingLocked(copyBytes, lock);
+    // The buffer may have gone while the ring waited for a free slot
+    const Buffer& buffer = buffers_[id - 1];
+    if (!buffer.live) return PendingReadback();
+    Staging& st = staging_[s];
+    st.texture = 0;
+    st.out = static_cast<uint8_t*>(out);
+    st.rowBytes = bytes;
+    st.pitch = copyBytes;
+    st.rows = 1;
+    st.widened = false;
+    if (backend_ == GPUBackend::Recording) st.fake.assign(buffer.contents.begin(), buffer.contents.begin() + bytes);
+    ++stats_.copies;
+    RecordLocked({Command::CopyBuffer, PipelineID::Count, 0, 0});
+#if TERRAINGEN_WEBGPU
+    if (backend_ == GPUBackend::WebGPU) {
+        if (!encoder_) encoder_ = wgpuDeviceCreateCommandEncoder(gpu_.Device(), nullptr);
+        wgpuCommandEncoderCopyBufferToBuffer(encoder_, buffer.handle, 0, st.handle, 0, copyBytes);
+    }
+#endif
+    return StartReadbackLocked(s, copyBytes);
+}
+
+void PassGraph::ForgetLocked(const PassBinding& binding) {
+    for (size_t i = bindGroups_.size(); i-- > 0;) {
+        const std::vector<PassBinding>& bindings = bindGroups_[i].bindings;
+        if (std::find(bindings.begin(), bindings.end(), binding) == bindings.end()) continue;
+#if TERRAINGEN_WEBGPU
+        if (WGPUBindGroup handle = bindGroups_[i].handle) {
+            // A pass recorded but not yet submitted may still use it
+            if (pending_) {
+                retiredGroups_.push_back(handle);
+            } else {
+                wgpuBindGroupRelease(handle);
+            }
+        }
+#endif
+        if (i + 1 != bindGroups_.size()) bindGroups_[i] = std::move(bindGroups_.back());
+        bindGroups_.pop_back();
+    }
+}
+
+void PassGraph::Forget(TextureID id) {
+    if (id == 0) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    ForgetLocked(PassBinding::Texture(id));
+    for (uint32_t s = 0; s < kStagingSlots; ++s) {
+        if (staging_[s].ticket && staging_[s].texture == id) FinishLocked(s, staging_[s].ticket, lock);
+    }
+}
+
+PassGraph::Stats PassGraph::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::vector<PassGraph::Command> PassGraph::Log() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return log_;
+}
+
+bool PendingReadback::Ready() const {
+    if (!graph_) return true;
+    std::lock_guard<std::mutex> lock(graph_->mutex_);
+    return graph_->ReadyLocked(slot_, ticket_);
+}
+
+bool PassGraph::TakeFailureLocked(uint64_t ticket) {
+    auto it = std::find(failedTickets_.begin(), failedTickets_.end(), ticket);
+    if (it == failedTickets_.end()) return false;
+    failedTickets_.erase(it);
+    return true;
+}
+
+bool PendingReadback::Wait() {
+    if (!graph_) return ok_;
+    std::unique_lock<std::mutex> lock(graph_->mutex_);
+    graph_->FinishLocked(slot_, ticket_, lock);
+    ok_ = !graph_->TakeFailureLocked(ticket_);
+    graph_ = nullptr;
+    return ok_;
 }
 
-} // namespace terraingen 
\ No newline at end of file
+} // namespace terraingen
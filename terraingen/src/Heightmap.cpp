@@ -1,204 +1,432 @@
 #include "Heightmap.hpp"
+#include "ApronCache.hpp"
+#include "Erosion.hpp"
+#include "ErosionTileCache.hpp"
 #include "GPUContext.hpp"
-#include "Random.hpp"
-#ifdef __EMSCRIPTEN__
-#include <webgpu/webgpu.h>
-#include <emscripten.h>
-#include <fstream>
-#include <iterator>
-#include <string>
-#endif
+#include "Noise.hpp"
+#include "OctaveCache.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
 
 namespace terraingen {
 
-static float RandomFloat01(uint64_t hash) {
-    // Convert 24 LSBs to float in range [0,1)
-    return static_cast<float>((hash & 0xFFFFFFULL) / double(0x1000000ULL));
+// FBM shared by every resolution, so LODs agree at common sample points
+static FbmParams TerrainFbm() {
+    FbmParams fbm;
+    fbm.basis = NoiseBasis::Perlin;
+    fbm.frequency = 1.0f / 64.0f;
+    fbm.lacunarity = 2.0f;
+    fbm.gain = 0.5f;
+    fbm.seed = 1337u;
+    return fbm;
 }
 
-GPUTexture Heightmap::Generate(const ChunkID& id, GPUContext& gpu) {
-    constexpr uint32_t kSize = 256; // 256×256 heightmap for now
-
-    // If we have a WebGPU device, run compute shader path
-#ifdef __EMSCRIPTEN__
-    if (gpu.HasDevice()) {
-        GPUTexture texID = gpu.CreateTexture2D(kSize, kSize);
-        auto& texInfo = gpu.GetTexture(texID);
-
-        // --- create shader module (static cache) ---
-        static WGPUDevice device = nullptr;
-        static WGPUComputePipeline pipeline = nullptr;
-        if (!pipeline) {
-            device = emscripten_webgpu_get_device();
-            // Load noise WGSL from external file
-            std::ifstream file("terraingen/shaders/heightmap_noise.wgsl");
-            std::string src((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            if (!file) {
-                // failed to load shader, fallback to CPU path
-            }
-            const char* shaderSrc = src.c_str();
+// Erosion runs on world-aligned tiles instead of each chunk's own domain, so a texel's eroded
+// height is the same whichever chunk, and whatever apron, asks for it. On a grid of S texels
+// per chunk, tile t owns the core [t*S - S/2, t*S + S/2) along each axis (centred on a chunk
+// corner, so a chunk spans 2x2 tiles) and is eroded over its core plus a margin; across a band
+// of kErosionBlend world units centred on each core edge the two tiles are cross-faded.
+// Tiles of one chunk are the cheapest a chunk alone can use: a smaller core puts three tiles
+// across it, and a core edge on the chunk edge needs the neighbours' tiles for the band.
+constexpr double kErosionBlend = 32.0;
+
+struct ErosionTiling {
+    int64_t size = 0;   // S
+    int64_t band = 0;   // blend band in texels, even
+    int64_t margin = 0; // texels eroded beyond the core on every side
+
+    // First texel of the part of tile t that chunks read: its core plus half a band per side
+    int64_t Start(int64_t t) const { return t * size - size / 2 - band / 2; }
+    uint32_t Side() const { return static_cast<uint32_t>(size + band); }
+};
+
+static ErosionTiling MakeErosionTiling(const ChunkRequest& req, uint32_t size, double texel) {
+    ErosionTiling g;
+    g.size = size;
+    g.band = std::max<int64_t>(2, 2 * std::lround(kErosionBlend / texel / 2.0));
+    const HydraulicErosionParams& h = req.hydraulic;
+    const int64_t travel =
+        h.dropletDensity > 0.0f
+            ? static_cast<int64_t>(std::ceil((static_cast<double>(h.maxLifetime) + h.erosionRadius + 1.0) / texel))
+            : 0;
+    // Wherever a tile has half the weight or more, droplets from as far as they travel are in
+    // its domain; beyond the core edge its weight fades out. Thermal erosion's edge effect
+    // dies out within a few world units, well inside that.
+    g.margin = std::max(g.band / 2, travel);
+    return g;
+}
+
+static int64_t FloorDiv(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Tiles whose heights texel x takes along one axis, lowest first, with their blend weights.
+// Depends on x alone, so every chunk blends a shared texel identically.
+struct AxisBlend {
+    int64_t tile[2];
+    float weight[2];
+    uint32_t count;
+};
+
+static AxisBlend BlendAt(int64_t x, const ErosionTiling& g) {
+    const int64_t t = FloorDiv(x + g.size / 2, g.size);
+    const int64_t core = t * g.size - g.size / 2;
+    const int64_t half = g.band / 2;
+    const float invBand = 1.0f / static_cast<float>(g.band);
+    if (x < core + half) {
+        const float w = (static_cast<float>(x - (core - half)) + 0.5f) * invBand;
+        return AxisBlend{{t - 1, t}, {1.0f - w, w}, 2};
+    }
+    if (x >= core + g.size - half) {
+        const float w = (static_cast<float>(x - (core + g.size - half)) + 0.5f) * invBand;
+        return AxisBlend{{t, t + 1}, {1.0f - w, w}, 2};
+    }
+    return AxisBlend{{t, t}, {1.0f, 0.0f}, 1};
+}
+
+static uint64_t FloatBits(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static uint64_t ErosionFingerprint(const HydraulicErosionParams& h, const ThermalErosionParams& t) {
+    const float fields[] = {h.dropletDensity, static_cast<float>(h.maxLifetime), h.inertia, h.sedimentCapacity,
+                            h.minSedimentCapacity, h.erodeSpeed, h.erosionRadius, h.depositSpeed,
+                            h.evaporateSpeed, h.gravity, h.initialWater, h.initialSpeed, h.batchDensity,
+                            t.reach, t.talus, t.rate};
+    uint64_t hash = 0;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        hash = HashCoords(static_cast<int64_t>(FloatBits(fields[i])), static_cast<int64_t>(i), 0, hash);
+    }
+    return hash;
+}
+
+// Noise over tile (tx, tz)'s eroded domain, hydraulic and thermal erosion, and the part chunks
+// read cropped out
+static std::shared_ptr<const ErosionTile> BuildErosionTile(const ChunkRequest& req, GPUContext& gpu,
+                                                           const ErosionTiling& g, int64_t tx, int64_t tz,
+                                                           const FbmParams& fbm, int octaves, int coarseOctaves,
+                                                           float scale, double texel) {
+    const uint32_t domain = static_cast<uint32_t>(g.size + 2 * g.margin);
+    const int64_t x0 = tx * g.size - g.size / 2 - g.margin;
+    const int64_t z0 = tz * g.size - g.size / 2 - g.margin;
+    const double originX = static_cast<double>(x0) * texel;
+    const double originZ = static_cast<double>(z0) * texel;
+    const double extent = (domain - 1) * texel;
+    const CoarseOctaveField coarse =
+        OctaveCache::Global().Acquire(fbm, coarseOctaves, originX, originZ, originX + extent, originZ + extent);
+    std::vector<float> heights(static_cast<size_t>(domain) * domain);
+    gpu.Dispatch(domain, domain, [&](const GPUContext::ComputeTile& t) {
+        thread_local NoiseScratch scratch;
+        thread_local std::vector<NoiseSample> row;
+        row.resize(t.x1 - t.x0);
+        for (uint32_t y = t.y0; y < t.y1; ++y) {
+            coarse.FbmRow(octaves, fbm, originX + t.x0 * texel, texel, t.x1 - t.x0, originZ + y * texel, scratch,
+                          row.data());
+            float* out = &heights[static_cast<size_t>(y) * domain + t.x0];
+            for (uint32_t x = 0; x < t.x1 - t.x0; ++x) out[x] = row[x].value * scale + 0.5f;
+        }
+    });
+    // One world-wide droplet stream keyed by world texel, so overlapping tile domains spawn the
+    // same droplets and reruns reproduce them on any thread count
+    const uint64_t erosionSeed = HashCoords(0, 1, 0, fbm.seed);
+    HydraulicErode(heights.data(), domain, domain, static_cast<float>(texel), req.hydraulic, erosionSeed, x0, z0);
+    ThermalErode(heights.data(), domain, domain, static_cast<float>(texel), req.thermal);
+
+    auto tile = std::make_shared<ErosionTile>();
+    tile->side = g.Side();
+    tile->heights.resize(static_cast<size_t>(tile->side) * tile->side);
+    const size_t skip = static_cast<size_t>(g.margin - g.band / 2);
+    for (uint32_t z = 0; z < tile->side; ++z) {
+        std::copy_n(&heights[(skip + z) * domain + skip], tile->side, &tile->heights[static_cast<size_t>(z) * tile->side]);
+    }
+    return tile;
+}
 
-            WGPUShaderModuleWGSLDescriptor wgslDesc{};
-            wgslDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
-            wgslDesc.code = shaderSrc;
+uint32_t ResolutionForLOD(uint32_t lod) {
+    uint32_t res = kMaxChunkResolution;
+    for (uint32_t l = 0; l < lod && res > kMinChunkResolution; ++l) res >>= 1;
+    return res;
+}
+
+int Heightmap::EffectiveOctaves(const ChunkRequest& req) {
+    const FbmParams fbm = TerrainFbm();
+    const float texel = req.TexelSize();
+    int octaves = std::max(1, std::min(req.octaves, kMaxFbmOctaves));
+    float freq = fbm.frequency;
+    for (int o = 0; o < octaves; ++o) {
+        if (freq * texel > 0.5f) return std::max(1, o);
+        freq *= fbm.lacunarity;
+    }
+    return octaves;
+}
+
+GPUTexture Heightmap::Generate(const ChunkRequest& req, GPUContext& gpu, HeightmapOutputs* outputs) {
+    const ChunkID& id = req.id;
+    const uint32_t kSize = std::max(kMinChunkResolution, std::min(req.resolution, kMaxChunkResolution));
+
+    // Halo-aware generation works on an extended domain and crops the interior at the end
+    const uint32_t apron = std::min(req.apron, kSize / 2);
+    const uint32_t ext = kSize + 2 * apron;
+    const double texel = static_cast<double>(kChunkWorldSize) / kSize;
+    const bool erode = req.hydraulic.dropletDensity > 0.0f || ThermalIterations(req.thermal, static_cast<float>(texel)) > 0;
 
-            WGPUShaderModuleDescriptor smDesc{};
-            smDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgslDesc);
-            smDesc.label = "heightmap_noise";
+    // Every texel of these is written below (evaluated, copied from a cache or cropped)
+    constexpr TextureInit kWritten = TextureInit::Uninitialized;
+    GPUTexture texID = gpu.CreateTexture2D(kSize, kSize, TextureFormat::R32Float, kWritten);
+    GPUTexture gradXID = outputs ? gpu.CreateTexture2D(kSize, kSize, TextureFormat::R32Float, kWritten) : 0;
+    GPUTexture gradZID = outputs ? gpu.CreateTexture2D(kSize, kSize, TextureFormat::R32Float, kWritten) : 0;
+    GPUTexture extID = apron ? gpu.CreateTexture2D(ext, ext, TextureFormat::R32Float, kWritten) : 0;
+    float* heights = gpu.GetTexture(texID).As<float>();
+    float* gradX = gradXID ? gpu.GetTexture(gradXID).As<float>() : nullptr;
+    float* gradZ = gradZID ? gpu.GetTexture(gradZID).As<float>() : nullptr;
 
-            WGPUShaderModule module = wgpuDeviceCreateShaderModule(device, &smDesc);
+    // Working domain: the output textures themselves, or the extended texture plus slope
+    // scratch (the overlap cache always stores slopes, so noise alone needs them with an apron)
+    float* domH = heights;
+    float* domGX = gradX;
+    float* domGZ = gradZ;
+    std::vector<float> extGradX, extGradZ;
+    if (apron) {
+        domH = gpu.GetTexture(extID).As<float>();
+        if (gradX || !erode) {
+            extGradX.resize(static_cast<size_t>(ext) * ext);
+            extGradZ.resize(extGradX.size());
+        }
+        domGX = extGradX.data();
+        domGZ = extGradZ.data();
+    }
+
+    // Gradient-noise FBM over the chunk's world area, minus octaves finer than a texel
+    const FbmParams fbm = TerrainFbm();
+    const int octaves = EffectiveOctaves(req);
+    const int requestedOctaves = std::max(1, std::min(req.octaves, kMaxFbmOctaves));
+    // Map FBM from [-1,1] to [0,1]; normalizing by the requested (not retained) octaves keeps
+    // every LOD on the same scale. Derivatives scale by the same factor.
+    const float scale = 0.5f / FbmAmplitudeSum(fbm, requestedOctaves);
+    // Low octaves come from coarse tiles shared with the neighbours (and other LODs). When every
+    // texel is a lattice node the field equals direct evaluation, so the tiles would only cost.
+    const bool useCoarse = req.coarseOctaveCache && texel < kCoarseSpacing;
+    const int coarseOctaves = useCoarse ? CoarseOctaveCount(fbm, octaves) : 0;
+    uint64_t evaluatedTexels = 0;
+    uint64_t cachedTexels = 0;
+
+    if (erode) {
+        // Erosion moves material the noise knows nothing about, so gradients are then re-derived
+        // from the eroded heights instead of taken from the FBM derivatives
+        const ErosionTiling tiling = MakeErosionTiling(req, kSize, texel);
+        const int64_t x0 = static_cast<int64_t>(id.x) * kSize - apron;
+        const int64_t z0 = static_cast<int64_t>(id.z) * kSize - apron;
+        std::vector<AxisBlend> columns(ext), rows(ext);
+        for (uint32_t i = 0; i < ext; ++i) {
+            columns[i] = BlendAt(x0 + i, tiling);
+            rows[i] = BlendAt(z0 + i, tiling);
+        }
+        const int64_t tx0 = columns.front().tile[0], tz0 = rows.front().tile[0];
+        const int64_t tx1 = columns.back().tile[columns.back().count - 1];
+        const int64_t tz1 = rows.back().tile[rows.back().count - 1];
+        const size_t tilesX = static_cast<size_t>(tx1 - tx0 + 1);
+        std::vector<std::shared_ptr<const ErosionTile>> tiles(tilesX * static_cast<size_t>(tz1 - tz0 + 1));
+        ErosionTileKey key;
+        key.resolution = kSize;
+        key.octaves = requestedOctaves;
+        key.coarseOctaves = coarseOctaves;
+        key.erosion = ErosionFingerprint(req.hydraulic, req.thermal);
+        // Missing tiles are built in parallel, and a tile another chunk is building is waited for
+        std::vector<uint8_t> built(tiles.size());
+        ThreadPool::Global().ParallelFor(0, static_cast<uint32_t>(tiles.size()), 1, [&](uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; ++i) {
+                const int64_t tx = tx0 + static_cast<int64_t>(i % tilesX);
+                const int64_t tz = tz0 + static_cast<int64_t>(i / tilesX);
+                ErosionTileKey tileKey = key;
+                tileKey.tx = static_cast<int32_t>(tx);
+                tileKey.tz = static_cast<int32_t>(tz);
+                bool fresh = false;
+                tiles[i] = ErosionTileCache::Global().Acquire(tileKey, [&] {
+                    return BuildErosionTile(req, gpu, tiling, tx, tz, fbm, octaves, coarseOctaves, scale, texel);
+                }, &fresh);
+                built[i] = fresh;
+            }
+        });
+        const uint64_t domain = static_cast<uint64_t>(tiling.size + 2 * tiling.margin);
+        for (uint8_t fresh : built) {
+            if (fresh) {
+                evaluatedTexels += domain * domain;
+            } else {
+                cachedTexels += domain * domain;
+            }
+        }
 
-            // Pipeline layout inferred
-            WGPUComputePipelineDescriptor cpDesc{};
-            cpDesc.compute.module = module;
-            cpDesc.compute.entryPoint = "main";
+        // Blend in a fixed tile order; where one tile covers a texel its height is copied as is
+        gpu.Dispatch(ext, ext, [&](const GPUContext::ComputeTile& t) {
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                const AxisBlend& row = rows[y];
+                float* out = domH + static_cast<size_t>(y) * ext;
+                for (uint32_t x = t.x0; x < t.x1; ++x) {
+                    const AxisBlend& column = columns[x];
+                    float sum = 0.0f;
+                    for (uint32_t a = 0; a < row.count; ++a) {
+                        const int64_t tz = row.tile[a];
+                        const size_t tileRow = static_cast<size_t>(tz - tz0) * tilesX;
+                        const size_t texelRow = static_cast<size_t>(z0 + y - tiling.Start(tz));
+                        for (uint32_t b = 0; b < column.count; ++b) {
+                            const int64_t tx = column.tile[b];
+                            const ErosionTile& tile = *tiles[tileRow + static_cast<size_t>(tx - tx0)];
+                            const size_t texelCol = static_cast<size_t>(x0 + x - tiling.Start(tx));
+                            sum += row.weight[a] * column.weight[b] * tile.heights[texelRow * tile.side + texelCol];
+                        }
+                    }
+                    out[x] = sum;
+                }
+            }
+        });
+        if (gradX) ComputeGradient(domH, ext, ext, static_cast<float>(texel), domGX, domGZ);
+    } else {
+        // Texel spacing is a power of two, so every chunk computes a shared world position exactly
+        const double originX = static_cast<double>(id.x) * kChunkWorldSize - apron * texel;
+        const double originZ = static_cast<double>(id.z) * kChunkWorldSize - apron * texel;
+        const double extent = (ext - 1) * texel;
+        const CoarseOctaveField coarse =
+            OctaveCache::Global().Acquire(fbm, coarseOctaves, originX, originZ, originX + extent, originZ + extent);
 
-            pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
-            wgpuShaderModuleRelease(module);
+        // Overlaps with the left, right, top and bottom neighbours' extended domains: a band of
+        // 2 * apron texels centred on each chunk edge. Cached bands are copied, not evaluated.
+        struct Overlap {
+            ApronKey key;
+            uint32_t x0, z0, w, h;
+            std::shared_ptr<const ApronStrip> cached;
+        };
+        Overlap overlaps[4];
+        const uint32_t band = 2 * apron;
+        if (apron) {
+            auto key = [&](uint8_t axis, int32_t line, int32_t along) {
+                ApronKey k;
+                k.line = line;
+                k.along = along;
+                k.axis = axis;
+                k.resolution = kSize;
+                k.octaves = requestedOctaves;
+                k.apron = apron;
+                k.coarseOctaves = coarseOctaves;
+                return k;
+            };
+            overlaps[0] = {key(0, id.x, id.z), 0, 0, band, ext, nullptr};
+            overlaps[1] = {key(0, id.x + 1, id.z), ext - band, 0, band, ext, nullptr};
+            overlaps[2] = {key(1, id.z, id.x), 0, 0, ext, band, nullptr};
+            overlaps[3] = {key(1, id.z + 1, id.x), 0, ext - band, ext, band, nullptr};
+            for (Overlap& o : overlaps) {
+                o.cached = ApronCache::Global().Lookup(o.key);
+                if (!o.cached) continue;
+                for (uint32_t z = 0; z < o.h; ++z) {
+                    const size_t dst = static_cast<size_t>(o.z0 + z) * ext + o.x0;
+                    const size_t src = static_cast<size_t>(z) * o.w;
+                    std::copy_n(&o.cached->heights[src], o.w, domH + dst);
+                    std::copy_n(&o.cached->gradX[src], o.w, domGX + dst);
+                    std::copy_n(&o.cached->gradZ[src], o.w, domGZ + dst);
+                }
+            }
         }
+        const bool skipLeft = overlaps[0].cached != nullptr;
+        const bool skipRight = overlaps[1].cached != nullptr;
+        const bool skipTop = overlaps[2].cached != nullptr;
+        const bool skipBottom = overlaps[3].cached != nullptr;
+        const uint32_t xs = skipLeft ? band : 0;
+        const uint32_t xe = skipRight ? ext - band : ext;
 
-        // --- bind group ---
-        WGPUBindGroupLayout bgl = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
-
-        WGPUBindGroupEntry entry{};
-        entry.binding = 0;
-        entry.textureView = texInfo.gpuView;
-
-        WGPUBindGroupDescriptor bgDesc{};
-        bgDesc.layout = bgl;
-        bgDesc.entryCount = 1;
-        bgDesc.entries = &entry;
-
-        WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
-
-        // --- command encoder ---
-        WGPUCommandEncoder enc = wgpuDeviceCreateCommandEncoder(device, nullptr);
-        WGPUComputePassDescriptor passDesc{};
-        WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(enc, &passDesc);
-        wgpuComputePassEncoderSetPipeline(pass, pipeline);
-        wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 0, nullptr);
-        wgpuComputePassEncoderDispatchWorkgroups(pass, (kSize + 7)/8, (kSize + 7)/8, 1);
-        wgpuComputePassEncoderEnd(pass);
-
-        WGPUCommandBuffer cb = wgpuCommandEncoderFinish(enc, nullptr);
-        wgpuQueueSubmit(gpu.Queue(), 1, &cb);
-        // Note: we don't map/read back yet; CPU mirror remains zero.
-
-        wgpuBindGroupRelease(bindGroup);
-        wgpuCommandBufferRelease(cb);
-        wgpuCommandEncoderRelease(enc);
-
-        // --- GPU Erosion Passes ---
-        // define cache for both erosion shaders
-        struct ErosionCache { WGPUShaderModule module; WGPUBindGroupLayout bgl; WGPUPipelineLayout pl; WGPUComputePipeline pipeline; };
-        static ErosionCache hydroCache{};
-        static ErosionCache thermoCache{};
-        // Hydraulic erosion pass
-        GPUTexture hydroTexID = gpu.CreateTexture2D(kSize, kSize);
-        auto& hydroTex = gpu.GetTexture(hydroTexID);
-        {
-            if (!hydroCache.pipeline) {
-                std::ifstream efile("terraingen/shaders/hydraulic_erosion.wgsl");
-                std::string src((std::istreambuf_iterator<char>(efile)), std::istreambuf_iterator<char>());
-                WGPUShaderModuleWGSLDescriptor wgslDesc{}; wgslDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor; wgslDesc.code = src.c_str();
-                WGPUShaderModuleDescriptor smDesc{}; smDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgslDesc);
-                hydroCache.module = wgpuDeviceCreateShaderModule(device, &smDesc);
-                WGPUBindGroupLayoutEntry entries[2]{};
-                entries[0].binding = 0; entries[0].visibility = WGPUShaderStage_Compute; entries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat; entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
-                entries[1].binding = 1; entries[1].visibility = WGPUShaderStage_Compute; entries[1].storageTexture.access = WGPUStorageTextureAccess_WriteOnly; entries[1].storageTexture.format = WGPUTextureFormat_R32Float; entries[1].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
-                WGPUBindGroupLayoutDescriptor bglDesc{}; bglDesc.entryCount = 2; bglDesc.entries = entries;
-                hydroCache.bgl = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
-                WGPUPipelineLayoutDescriptor plDesc{}; plDesc.bindGroupLayoutCount = 1; plDesc.bindGroupLayouts = &hydroCache.bgl;
-                hydroCache.pl = wgpuDeviceCreatePipelineLayout(device, &plDesc);
-                WGPUComputePipelineDescriptor cpDesc{}; cpDesc.layout = hydroCache.pl; cpDesc.compute.module = hydroCache.module; cpDesc.compute.entryPoint = "main";
-                hydroCache.pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
+        // One invocation per texel of the extended domain; cached bands are skipped. Each writes
+        // only its own texel, so the output is bit-identical on any thread count.
+        gpu.Dispatch(ext, ext, [&](const GPUContext::ComputeTile& t) {
+            thread_local NoiseScratch scratch;
+            thread_local std::vector<NoiseSample> row;
+            const uint32_t x0 = std::max(t.x0, xs), x1 = std::min(t.x1, xe);
+            if (x0 >= x1) return;
+            row.resize(x1 - x0);
+            for (uint32_t y = t.y0; y < t.y1; ++y) {
+                if ((skipTop && y < band) || (skipBottom && y >= ext - band)) continue;
+                coarse.FbmRow(octaves, fbm, originX + x0 * texel, texel, x1 - x0, originZ + y * texel, scratch, row.data());
+                size_t base = static_cast<size_t>(y) * ext + x0;
+                for (uint32_t x = 0; x < x1 - x0; ++x) {
+                    domH[base + x] = row[x].value * scale + 0.5f;
+                }
+                if (domGX) {
+                    for (uint32_t x = 0; x < x1 - x0; ++x) {
+                        domGX[base + x] = row[x].dx * scale;
+                        domGZ[base + x] = row[x].dz * scale;
+                    }
+                }
             }
-            WGPUBindGroupEntry bge[2]{};
-            bge[0].binding = 0; bge[0].textureView = texInfo.gpuView;
-            bge[1].binding = 1; bge[1].textureView = hydroTex.gpuView;
-            WGPUBindGroupDescriptor bgd{}; bgd.layout = hydroCache.bgl; bgd.entryCount = 2; bgd.entries = bge;
-            WGPUBindGroup bg = wgpuDeviceCreateBindGroup(device, &bgd);
-            WGPUCommandEncoder enc2 = wgpuDeviceCreateCommandEncoder(device, nullptr);
-            WGPUComputePassEncoder pass2 = wgpuCommandEncoderBeginComputePass(enc2, nullptr);
-            wgpuComputePassEncoderSetPipeline(pass2, hydroCache.pipeline);
-            wgpuComputePassEncoderSetBindGroup(pass2, 0, bg, 0, nullptr);
-            wgpuComputePassEncoderDispatchWorkgroups(pass2, (kSize + 7)/8, (kSize + 7)/8, 1);
-            wgpuComputePassEncoderEnd(pass2);
-            WGPUCommandBuffer cb2 = wgpuCommandEncoderFinish(enc2, nullptr);
-            wgpuQueueSubmit(gpu.Queue(), 1, &cb2);
-            wgpuBindGroupRelease(bg);
-            wgpuCommandEncoderRelease(enc2);
-            wgpuCommandBufferRelease(cb2);
+        });
+        const uint64_t evaluatedRows = ext - (skipTop ? band : 0) - (skipBottom ? band : 0);
+        evaluatedTexels = evaluatedRows * (xe - xs);
+        cachedTexels = static_cast<uint64_t>(ext) * ext - evaluatedTexels;
+
+        // Publish the bands this chunk evaluated
+        for (const Overlap& o : overlaps) {
+            if (!apron || o.cached) continue;
+            auto strip = std::make_shared<ApronStrip>();
+            strip->width = o.w;
+            strip->height = o.h;
+            strip->heights.resize(static_cast<size_t>(o.w) * o.h);
+            strip->gradX.resize(strip->heights.size());
+            strip->gradZ.resize(strip->heights.size());
+            for (uint32_t z = 0; z < o.h; ++z) {
+                const size_t src = static_cast<size_t>(o.z0 + z) * ext + o.x0;
+                const size_t dst = static_cast<size_t>(z) * o.w;
+                std::copy_n(domH + src, o.w, &strip->heights[dst]);
+                std::copy_n(domGX + src, o.w, &strip->gradX[dst]);
+                std::copy_n(domGZ + src, o.w, &strip->gradZ[dst]);
+            }
+            ApronCache::Global().Insert(o.key, std::move(strip));
         }
-        // Thermal erosion pass
-        GPUTexture thermTexID = gpu.CreateTexture2D(kSize, kSize);
-        auto& thermTex = gpu.GetTexture(thermTexID);
-        {
-            if (!thermoCache.pipeline) {
-                std::ifstream efile("terraingen/shaders/thermal_erosion.wgsl");
-                std::string src((std::istreambuf_iterator<char>(efile)), std::istreambuf_iterator<char>());
-                WGPUShaderModuleWGSLDescriptor wgslDesc{}; wgslDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor; wgslDesc.code = src.c_str();
-                WGPUShaderModuleDescriptor smDesc{}; smDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgslDesc);
-                thermoCache.module = wgpuDeviceCreateShaderModule(device, &smDesc);
-                WGPUBindGroupLayoutEntry entries[2]{};
-                entries[0].binding = 0; entries[0].visibility = WGPUShaderStage_Compute; entries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat; entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
-                entries[1].binding = 1; entries[1].visibility = WGPUShaderStage_Compute; entries[1].storageTexture.access = WGPUStorageTextureAccess_WriteOnly; entries[1].storageTexture.format = WGPUTextureFormat_R32Float; entries[1].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
-                WGPUBindGroupLayoutDescriptor bglDesc{}; bglDesc.entryCount = 2; bglDesc.entries = entries;
-                thermoCache.bgl = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
-                WGPUPipelineLayoutDescriptor plDesc{}; plDesc.bindGroupLayoutCount = 1; plDesc.bindGroupLayouts = &thermoCache.bgl;
-                thermoCache.pl = wgpuDeviceCreatePipelineLayout(device, &plDesc);
-                WGPUComputePipelineDescriptor cpDesc{}; cpDesc.layout = thermoCache.pl; cpDesc.compute.module = thermoCache.module; cpDesc.compute.entryPoint = "main";
-                thermoCache.pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
+    }
+
+    // Emit the interior
+    if (apron) {
+        for (uint32_t z = 0; z < kSize; ++z) {
+            const size_t src = static_cast<size_t>(z + apron) * ext + apron;
+            const size_t dst = static_cast<size_t>(z) * kSize;
+            std::copy_n(domH + src, kSize, heights + dst);
+            if (gradX) {
+                std::copy_n(domGX + src, kSize, gradX + dst);
+                std::copy_n(domGZ + src, kSize, gradZ + dst);
             }
-            WGPUBindGroupEntry bge[2]{};
-            bge[0].binding = 0; bge[0].textureView = hydroTex.gpuView;
-            bge[1].binding = 1; bge[1].textureView = thermTex.gpuView;
-            WGPUBindGroupDescriptor bgd{}; bgd.layout = thermoCache.bgl; bgd.entryCount = 2; bgd.entries = bge;
-            WGPUBindGroup bg = wgpuDeviceCreateBindGroup(device, &bgd);
-            WGPUCommandEncoder enc3 = wgpuDeviceCreateCommandEncoder(device, nullptr);
-            WGPUComputePassEncoder pass3 = wgpuCommandEncoderBeginComputePass(enc3, nullptr);
-            wgpuComputePassEncoderSetPipeline(pass3, thermoCache.pipeline);
-            wgpuComputePassEncoderSetBindGroup(pass3, 0, bg, 0, nullptr);
-            wgpuComputePassEncoderDispatchWorkgroups(pass3, (kSize + 7)/8, (kSize + 7)/8, 1);
-            wgpuComputePassEncoderEnd(pass3);
-            WGPUCommandBuffer cb3 = wgpuCommandEncoderFinish(enc3, nullptr);
-            wgpuQueueSubmit(gpu.Queue(), 1, &cb3);
-            wgpuBindGroupRelease(bg);
-            wgpuCommandEncoderRelease(enc3);
-            wgpuCommandBufferRelease(cb3);
         }
-        return thermTexID;
     }
-#endif
-
-    GPUTexture texID = gpu.CreateTexture2D(kSize, kSize);
-    auto& tex = gpu.GetTexture(texID);
-
-    // Simple 4-octave FBM using HashCoords as value noise
-    constexpr int kOctaves = 4;
-    constexpr float lacunarity = 2.0f;
-    constexpr float gain = 0.5f;
-
-    for (uint32_t y = 0; y < kSize; ++y) {
-        for (uint32_t x = 0; x < kSize; ++x) {
-            float amp = 1.0f;
-            float freq = 1.0f / 64.0f; // base frequency
-            float value = 0.0f;
-            for (int o = 0; o < kOctaves; ++o) {
-                int64_t sampleX = static_cast<int64_t>(id.x * kSize + x) * freq * 1000.0f;
-                int64_t sampleZ = static_cast<int64_t>(id.z * kSize + y) * freq * 1000.0f;
-                uint64_t h = HashCoords(sampleX, 0, sampleZ, 1337u + static_cast<uint64_t>(o));
-                float n = RandomFloat01(h) * 2.0f - 1.0f; // [-1,1]
-                value += n * amp;
-                amp *= gain;
-                freq *= lacunarity;
+
+    if (outputs || req.normalize) {
+        MinMaxPyramid bounds = BuildMinMaxPyramid(heights, kSize, kSize);
+        if (req.normalize) {
+            const HeightBounds from = bounds.Chunk();
+            const HeightBounds unit{0.0f, 1.0f};
+            const size_t count = static_cast<size_t>(kSize) * kSize;
+            NormalizeHeights(heights, count, from, unit);
+            if (apron) NormalizeHeights(domH, static_cast<size_t>(ext) * ext, from, unit);
+            RemapPyramid(bounds, from, unit);
+            if (gradX) {
+                // Slopes scale by the same factor, without the offset
+                const float span = from.max - from.min;
+                const HeightBounds slopeFrom{0.0f, span > 0.0f ? span : 1.0f};
+                NormalizeHeights(gradX, count, slopeFrom, unit);
+                NormalizeHeights(gradZ, count, slopeFrom, unit);
             }
-            // Normalize to [0,1]
-            value = value * 0.5f + 0.5f;
-            tex.data[y * kSize + x] = value;
         }
+        if (outputs) outputs->bounds = std::move(bounds);
     }
 
+    if (outputs) {
+        outputs->gradX = gradXID;
+        outputs->gradZ = gradZID;
+        outputs->extended = extID;
+        outputs->apron = apron;
+        outputs->sharedApron = apron > 0 && !req.normalize;
+        outputs->evaluatedTexels = evaluatedTexels;
+        outputs->cachedTexels = cachedTexels;
+    }
     return texID;
 }
 
@@ -0,0 +1,281 @@
+#include "Noise.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace terraingen {
+
+// 16 unit gradients evenly spaced on the circle, picked by hash bits 32..35
+struct GradientTable {
+    float x[16];
+    float z[16];
+    GradientTable() {
+        for (int k = 0; k < 16; ++k) {
+            double a = (k + 0.5) * (6.283185307179586 / 16.0);
+            x[k] = static_cast<float>(std::cos(a));
+            z[k] = static_cast<float>(std::sin(a));
+        }
+    }
+};
+static const GradientTable kGrad;
+
+static inline int GradIndex(uint64_t h) { return static_cast<int>((h >> 32) & 15u); }
+
+// Same 24-bit mapping the original value-noise FBM used, into [-1,1)
+static inline float CornerValue(uint64_t h) {
+    return static_cast<float>(static_cast<int32_t>(h & 0xFFFFFFULL)) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+// Quintic fade and its derivative
+static inline float Fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+static inline float FadeDeriv(float t) { return 30.0f * t * t * (t * (t - 2.0f) + 1.0f); }
+
+static constexpr float kPerlinScale = 1.41421356f;      // unit gradients peak at sqrt(1/2)
+static constexpr double kSkew = 0.36602540378443865;    // (sqrt(3) - 1) / 2
+static constexpr float kUnskew = 0.21132486540518713f;  // (3 - sqrt(3)) / 6
+static constexpr float kSimplexScale = 99.20689f;       // unit gradients, r^2 = 0.5 falloff
+
+// Per-cell corner data. Point and row evaluation both fill these and run the same kernels,
+// so their results are bit-identical; rows refill them only when the cell changes.
+struct ValueCorners {
+    float a, b, c, d;
+    template <typename HashFn>
+    void Load(int64_t i, int64_t j, const HashFn& hash) {
+        a = CornerValue(hash(i, j));
+        b = CornerValue(hash(i + 1, j));
+        c = CornerValue(hash(i, j + 1));
+        d = CornerValue(hash(i + 1, j + 1));
+    }
+};
+
+struct PerlinCorners {
+    int g00, g10, g01, g11;
+    template <typename HashFn>
+    void Load(int64_t i, int64_t j, const HashFn& hash) {
+        g00 = GradIndex(hash(i, j));
+        g10 = GradIndex(hash(i + 1, j));
+        g01 = GradIndex(hash(i, j + 1));
+        g11 = GradIndex(hash(i + 1, j + 1));
+    }
+};
+
+static inline NoiseSample ValueKernel(const ValueCorners& c, float fx, float fz) {
+    float u = Fade(fx), w = Fade(fz);
+    float k1 = c.b - c.a, k2 = c.c - c.a, k3 = c.a - c.b - c.c + c.d;
+    NoiseSample s;
+    s.value = c.a + k1 * u + k2 * w + k3 * u * w;
+    s.dx = FadeDeriv(fx) * (k1 + k3 * w);
+    s.dz = FadeDeriv(fz) * (k2 + k3 * u);
+    return s;
+}
+
+static inline NoiseSample PerlinKernel(const PerlinCorners& c, float fx, float fz) {
+    const float gx00 = kGrad.x[c.g00], gz00 = kGrad.z[c.g00];
+    const float gx10 = kGrad.x[c.g10], gz10 = kGrad.z[c.g10];
+    const float gx01 = kGrad.x[c.g01], gz01 = kGrad.z[c.g01];
+    const float gx11 = kGrad.x[c.g11], gz11 = kGrad.z[c.g11];
+    float n00 = gx00 * fx + gz00 * fz;
+    float n10 = gx10 * (fx - 1.0f) + gz10 * fz;
+    float n01 = gx01 * fx + gz01 * (fz - 1.0f);
+    float n11 = gx11 * (fx - 1.0f) + gz11 * (fz - 1.0f);
+    float u = Fade(fx), w = Fade(fz);
+    float k1 = n10 - n00, k2 = n01 - n00, k3 = n00 - n10 - n01 + n11;
+    NoiseSample s;
+    s.value = (n00 + k1 * u + k2 * w + k3 * u * w) * kPerlinScale;
+    float gx = gx00 + (gx10 - gx00) * u + (gx01 - gx00) * w + (gx00 - gx10 - gx01 + gx11) * u * w;
+    float gz = gz00 + (gz10 - gz00) * u + (gz01 - gz00) * w + (gz00 - gz10 - gz01 + gz11) * u * w;
+    s.dx = (gx + FadeDeriv(fx) * (k1 + k3 * w)) * kPerlinScale;
+    s.dz = (gz + FadeDeriv(fz) * (k2 + k3 * u)) * kPerlinScale;
+    return s;
+}
+
+static inline void SimplexCorner(uint64_t h, float dx, float dz, NoiseSample& s) {
+    float a = 0.5f - dx * dx - dz * dz;
+    if (a <= 0.0f) return;
+    int g = GradIndex(h);
+    float dot = kGrad.x[g] * dx + kGrad.z[g] * dz;
+    float a2 = a * a, a4 = a2 * a2;
+    float k = -8.0f * a2 * a * dot;
+    s.value += a4 * dot;
+    s.dx += k * dx + a4 * kGrad.x[g];
+    s.dz += k * dz + a4 * kGrad.z[g];
+}
+
+// (i, j) is the skewed cell, (x0, z0) the unskewed offset from its origin corner
+template <typename HashFn>
+static inline NoiseSample SimplexKernel(int64_t i, int64_t j, float x0, float z0, const HashFn& hash) {
+    NoiseSample s;
+    SimplexCorner(hash(i, j), x0, z0, s);
+    if (x0 > z0) {
+        SimplexCorner(hash(i + 1, j), x0 - 1.0f + kUnskew, z0 + kUnskew, s);
+    } else {
+        SimplexCorner(hash(i, j + 1), x0 + kUnskew, z0 - 1.0f + kUnskew, s);
+    }
+    SimplexCorner(hash(i + 1, j + 1), x0 - 1.0f + 2.0f * kUnskew, z0 - 1.0f + 2.0f * kUnskew, s);
+    s.value *= kSimplexScale;
+    s.dx *= kSimplexScale;
+    s.dz *= kSimplexScale;
+    return s;
+}
+
+// Skewed cell and in-cell offset for a point, in the form SimplexKernel expects
+static inline void SimplexCell(double x, double z, int64_t& i, int64_t& j, float& x0, float& z0) {
+    double s = (x + z) * kSkew;
+    double xs = std::floor(x + s), zs = std::floor(z + s);
+    i = static_cast<int64_t>(xs);
+    j = static_cast<int64_t>(zs);
+    float xi = static_cast<float>(x + s - xs);
+    float zi = static_cast<float>(z + s - zs);
+    float t = (xi + zi) * kUnskew;
+    x0 = xi - t;
+    z0 = zi - t;
+}
+
+template <typename Corners, typename Kernel>
+static inline NoiseSample SquarePoint(double x, double z, uint64_t seed, const Kernel& kernel) {
+    double fi = std::floor(x), fj = std::floor(z);
+    Corners c{};
+    c.Load(static_cast<int64_t>(fi), static_cast<int64_t>(fj),
+           [seed](int64_t i, int64_t j) { return HashCoords(i, 0, j, seed); });
+    return kernel(c, static_cast<float>(x - fi), static_cast<float>(z - fj));
+}
+
+NoiseSample ValueNoise2D(double x, double z, uint64_t seed) {
+    return SquarePoint<ValueCorners>(x, z, seed, ValueKernel);
+}
+
+NoiseSample PerlinNoise2D(double x, double z, uint64_t seed) {
+    return SquarePoint<PerlinCorners>(x, z, seed, PerlinKernel);
+}
+
+NoiseSample OpenSimplex2Noise2D(double x, double z, uint64_t seed) {
+    int64_t i, j;
+    float x0, z0;
+    SimplexCell(x, z, i, j, x0, z0);
+    auto hash = [seed](int64_t a, int64_t b) { return HashCoords(a, 0, b, seed); };
+    return SimplexKernel(i, j, x0, z0, hash);
+}
+
+void LatticeBlock::Build(int64_t bi0, int64_t bj0, uint32_t bni, uint32_t bnj, uint64_t seed) {
+    i0 = bi0;
+    j0 = bj0;
+    ni = bni;
+    nj = bnj;
+    size_t count = static_cast<size_t>(ni) * nj;
+    xs_.resize(count);
+    ys_.assign(count, 0);
+    zs_.resize(count);
+    hashes.resize(count);
+    for (uint32_t j = 0; j < nj; ++j) {
+        for (uint32_t i = 0; i < ni; ++i) {
+            xs_[static_cast<size_t>(j) * ni + i] = i0 + i;
+            zs_[static_cast<size_t>(j) * ni + i] = j0 + j;
+        }
+    }
+    HashCoordsN(xs_.data(), ys_.data(), zs_.data(), seed, hashes.data(), count);
+}
+
+// Square lattice: the row stays within cell rows j and j+1, and corners are reloaded only
+// when x crosses into a new cell
+template <typename Corners, typename Kernel>
+static void SquareRow(double x0, double step, uint32_t n, double z, uint64_t seed,
+                      LatticeBlock& block, NoiseSample* out, const Kernel& kernel) {
+    double fj = std::floor(z);
+    int64_t j = static_cast<int64_t>(fj);
+    float fz = static_cast<float>(z - fj);
+    double xFirst = x0, xLast = x0 + (n - 1) * step;
+    int64_t iMin = static_cast<int64_t>(std::floor(std::min(xFirst, xLast)));
+    int64_t iMax = static_cast<int64_t>(std::floor(std::max(xFirst, xLast)));
+    block.Build(iMin, j, static_cast<uint32_t>(iMax - iMin + 2), 2, seed);
+    auto hash = [&block](int64_t a, int64_t b) { return block.At(a, b); };
+
+    Corners c{};
+    int64_t cell = INT64_MIN;
+    for (uint32_t k = 0; k < n; ++k) {
+        double x = x0 + k * step;
+        double fi = std::floor(x);
+        int64_t i = static_cast<int64_t>(fi);
+        if (i != cell) {
+            c.Load(i, j, hash);
+            cell = i;
+        }
+        out[k] = kernel(c, static_cast<float>(x - fi), fz);
+    }
+}
+
+void NoiseRow(NoiseBasis basis, double x0, double step, uint32_t n, double z, uint64_t seed,
+              NoiseScratch& scratch, NoiseSample* out) {
+    if (n == 0) return;
+    LatticeBlock& block = scratch.block;
+    switch (basis) {
+        case NoiseBasis::Value:
+            SquareRow<ValueCorners>(x0, step, n, z, seed, block, out, ValueKernel);
+            return;
+        case NoiseBasis::Perlin:
+            SquareRow<PerlinCorners>(x0, step, n, z, seed, block, out, PerlinKernel);
+            return;
+        case NoiseBasis::OpenSimplex2:
+            break;
+    }
+
+    // Skewed cells drift in both i and j along a row, so record them and hash their bounds
+    scratch.cells.resize(static_cast<size_t>(n) * 2);
+    scratch.offsets.resize(static_cast<size_t>(n) * 2);
+    int64_t iMin = INT64_MAX, iMax = INT64_MIN, jMin = INT64_MAX, jMax = INT64_MIN;
+    for (uint32_t k = 0; k < n; ++k) {
+        int64_t i, j;
+        SimplexCell(x0 + k * step, z, i, j, scratch.offsets[2 * k], scratch.offsets[2 * k + 1]);
+        scratch.cells[2 * k] = i;
+        scratch.cells[2 * k + 1] = j;
+        iMin = std::min(iMin, i); iMax = std::max(iMax, i);
+        jMin = std::min(jMin, j); jMax = std::max(jMax, j);
+    }
+    block.Build(iMin, jMin, static_cast<uint32_t>(iMax - iMin + 2),
+                static_cast<uint32_t>(jMax - jMin + 2), seed);
+    auto hash = [&block](int64_t a, int64_t b) { return block.At(a, b); };
+    for (uint32_t k = 0; k < n; ++k) {
+        out[k] = SimplexKernel(scratch.cells[2 * k], scratch.cells[2 * k + 1],
+                               scratch.offsets[2 * k], scratch.offsets[2 * k + 1], hash);
+    }
+}
+
+template <int... Os>
+struct FbmTable {
+    using Fn = void (*)(const FbmParams&, double, double, uint32_t, double, NoiseScratch&, NoiseSample*);
+    static constexpr Fn kFns[sizeof...(Os)] = {&FbmRow<Os + 1>...};
+};
+
+void FbmRowN(int octaves, const FbmParams& p, double worldX0, double step, uint32_t n,
+             double worldZ, NoiseScratch& scratch, NoiseSample* out) {
+    using Table = FbmTable<0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11>;
+    static_assert(sizeof(Table::kFns) / sizeof(Table::kFns[0]) == kMaxFbmOctaves, "octave table size");
+    octaves = std::max(1, std::min(octaves, kMaxFbmOctaves));
+    Table::kFns[octaves - 1](p, worldX0, step, n, worldZ, scratch, out);
+}
+
+void FbmAddOctaves(int first, int last, const FbmParams& p, double worldX0, double step, uint32_t n,
+                   double worldZ, NoiseScratch& scratch, NoiseSample* out) {
+    last = std::min(last, kMaxFbmOctaves);
+    if (first >= last) return;
+    scratch.octave.resize(n);
+    NoiseSample* oct = scratch.octave.data();
+    float freq = p.frequency;
+    float amp = 1.0f;
+    for (int o = 0; o < first; ++o) {
+        amp *= p.gain;
+        freq *= p.lacunarity;
+    }
+    for (int o = first; o < last; ++o) {
+        NoiseRow(p.basis, worldX0 * freq, step * freq, n, worldZ * freq,
+                 p.seed + static_cast<uint64_t>(o), scratch, oct);
+        const float dScale = amp * freq;
+        for (uint32_t k = 0; k < n; ++k) {
+            out[k].value += oct[k].value * amp;
+            out[k].dx += oct[k].dx * dScale;
+            out[k].dz += oct[k].dz * dScale;
+        }
+        amp *= p.gain;
+        freq *= p.lacunarity;
+    }
+}
+
+} // namespace terraingen
@@ -0,0 +1,237 @@
+#include "OctaveCache.hpp"
+#include "Random.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace terraingen {
+
+static int64_t FloorDiv(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int64_t FloorToLattice(double world) {
+    return static_cast<int64_t>(std::floor(world / kCoarseSpacing));
+}
+
+static uint64_t FloatBits(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static uint64_t FbmFingerprint(const FbmParams& p) {
+    return HashCoords(static_cast<int64_t>(FloatBits(p.frequency)), static_cast<int64_t>(FloatBits(p.lacunarity)),
+                      static_cast<int64_t>(FloatBits(p.gain) << 8 | static_cast<uint64_t>(p.basis)), p.seed);
+}
+
+int CoarseOctaveCount(const FbmParams& p, int octaves) {
+    const float longest = kCoarseCellsPerWavelength * static_cast<float>(kCoarseSpacing);
+    octaves = std::max(0, std::min(octaves, kMaxFbmOctaves));
+    float freq = p.frequency;
+    for (int o = 0; o < octaves; ++o) {
+        if (freq * longest > 1.0f) return o;
+        freq *= p.lacunarity;
+    }
+    return octaves;
+}
+
+// Cubic Hermite basis on [0,1] and its derivatives: h0/h1 weight the end values, g0/g1 the end
+// tangents
+struct HermiteBasis {
+    float h0, h1, g0, g1;
+    float dh0, dh1, dg0, dg1;
+
+    explicit HermiteBasis(float t) {
+        const float t2 = t * t, t3 = t2 * t;
+        h0 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+        h1 = 3.0f * t2 - 2.0f * t3;
+        g0 = t3 - 2.0f * t2 + t;
+        g1 = t3 - t2;
+        dh0 = 6.0f * t2 - 6.0f * t;
+        dh1 = 6.0f * t - 6.0f * t2;
+        dg0 = 3.0f * t2 - 4.0f * t + 1.0f;
+        dg1 = 3.0f * t2 - 2.0f * t;
+    }
+};
+
+void CoarseOctaveField::Row(double worldX0, double step, uint32_t n, double worldZ, NoiseSample* out) const {
+    constexpr uint32_t kNodes = kCoarseRegionCells + 1;
+    const float s = static_cast<float>(kCoarseSpacing);
+    const float invS = 1.0f / s;
+
+    // The z interpolation is fixed for the row: collapse each column of a cell's two node rows
+    // into a 1D Hermite segment along x (value a, tangent b, and their z-derivatives c, d)
+    const double gz = worldZ / kCoarseSpacing;
+    const int64_t j = FloorToLattice(worldZ);
+    const HermiteBasis hz(static_cast<float>(gz - static_cast<double>(j)));
+    const int64_t rz = FloorDiv(j, kCoarseRegionCells);
+    const size_t rowOffset = static_cast<size_t>(j - rz * kCoarseRegionCells) * kNodes;
+    const size_t tileRow = static_cast<size_t>(rz - rz0_) * nx_;
+
+    struct Column { float a, b, c, d; };
+    auto collapse = [&](const CoarseNode& n0, const CoarseNode& n1) {
+        Column col;
+        col.a = hz.h0 * n0.value + hz.h1 * n1.value + s * (hz.g0 * n0.dz + hz.g1 * n1.dz);
+        col.b = hz.h0 * n0.dx + hz.h1 * n1.dx + s * (hz.g0 * n0.dxz + hz.g1 * n1.dxz);
+        col.c = (hz.dh0 * n0.value + hz.dh1 * n1.value) * invS + (hz.dg0 * n0.dz + hz.dg1 * n1.dz);
+        col.d = (hz.dh0 * n0.dx + hz.dh1 * n1.dx) * invS + (hz.dg0 * n0.dxz + hz.dg1 * n1.dxz);
+        return col;
+    };
+
+    int64_t cell = 0;
+    Column left{}, right{};
+    for (uint32_t k = 0; k < n; ++k) {
+        const double x = worldX0 + k * step;
+        const int64_t i = FloorToLattice(x);
+        if (k == 0 || i != cell) {
+            cell = i;
+            const int64_t rx = FloorDiv(i, kCoarseRegionCells);
+            const CoarseTile& tile = *tiles_[tileRow + static_cast<size_t>(rx - rx0_)];
+            const CoarseNode* n0 = &tile.nodes[rowOffset + static_cast<size_t>(i - rx * kCoarseRegionCells)];
+            const CoarseNode* n1 = n0 + kNodes;
+            left = collapse(n0[0], n1[0]);
+            right = collapse(n0[1], n1[1]);
+        }
+        const HermiteBasis hx(static_cast<float>(x / kCoarseSpacing - static_cast<double>(i)));
+        out[k].value = hx.h0 * left.a + hx.h1 * right.a + s * (hx.g0 * left.b + hx.g1 * right.b);
+        out[k].dx = (hx.dh0 * left.a + hx.dh1 * right.a) * invS + (hx.dg0 * left.b + hx.dg1 * right.b);
+        out[k].dz = hx.h0 * left.c + hx.h1 * right.c + s * (hx.g0 * left.d + hx.g1 * right.d);
+    }
+}
+
+void CoarseOctaveField::FbmRow(int octaves, const FbmParams& p, double worldX0, double step, uint32_t n,
+                               double worldZ, NoiseScratch& scratch, NoiseSample* out) const {
+    if (octaves_ == 0 || octaves < octaves_) {
+        FbmRowN(octaves, p, worldX0, step, n, worldZ, scratch, out);
+        return;
+    }
+    Row(worldX0, step, n, worldZ, out);
+    FbmAddOctaves(octaves_, octaves, p, worldX0, step, n, worldZ, scratch, out);
+}
+
+// Evaluates the padded node grid with the regular row FBM, so node values are exactly what
+// direct evaluation produces; the cross derivative comes from central differences of the
+// analytic gradient.
+static std::shared_ptr<const CoarseTile> BuildTile(const FbmParams& p, const CoarseTileKey& key) {
+    constexpr uint32_t kNodes = kCoarseRegionCells + 1;
+    constexpr uint32_t kPadded = kNodes + 2;
+    const double x0 = (static_cast<double>(key.rx) * kCoarseRegionCells - 1.0) * kCoarseSpacing;
+    const double z0 = (static_cast<double>(key.rz) * kCoarseRegionCells - 1.0) * kCoarseSpacing;
+    std::vector<NoiseSample> grid(static_cast<size_t>(kPadded) * kPadded);
+    NoiseScratch scratch;
+    for (uint32_t z = 0; z < kPadded; ++z) {
+        FbmRowN(key.octaves, p, x0, kCoarseSpacing, kPadded, z0 + z * kCoarseSpacing, scratch,
+                &grid[static_cast<size_t>(z) * kPadded]);
+    }
+
+    auto tile = std::make_shared<CoarseTile>();
+    tile->nodes.resize(static_cast<size_t>(kNodes) * kNodes);
+    const float twistScale = 1.0f / (4.0f * static_cast<float>(kCoarseSpacing));
+    for (uint32_t z = 0; z < kNodes; ++z) {
+        for (uint32_t x = 0; x < kNodes; ++x) {
+            const size_t c = static_cast<size_t>(z + 1) * kPadded + (x + 1);
+            CoarseNode& node = tile->nodes[static_cast<size_t>(z) * kNodes + x];
+            node.value = grid[c].value;
+            node.dx = grid[c].dx;
+            node.dz = grid[c].dz;
+            node.dxz = ((grid[c + kPadded].dx - grid[c - kPadded].dx) + (grid[c + 1].dz - grid[c - 1].dz)) *
+                       twistScale;
+        }
+    }
+    return tile;
+}
+
+static size_t TileBytes() {
+    return static_cast<size_t>(kCoarseRegionCells + 1) * (kCoarseRegionCells + 1) * sizeof(CoarseNode);
+}
+
+size_t OctaveCache::KeyHash::operator()(const CoarseTileKey& k) const {
+    return static_cast<size_t>(HashCoords(k.rx, k.rz, k.octaves, k.fbm));
+}
+
+OctaveCache::OctaveCache(size_t maxBytes) : maxBytes_(maxBytes) {}
+
+std::shared_ptr<const CoarseTile> OctaveCache::Tile(const FbmParams& p, const CoarseTileKey& key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            ++stats_.hits;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->second;
+        }
+        ++stats_.misses;
+    }
+    std::shared_ptr<const CoarseTile> tile = BuildTile(p, key);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) return it->second->second; // built concurrently; identical contents
+    lru_.emplace_front(key, tile);
+    index_[key] = lru_.begin();
+    EvictLocked();
+    return tile;
+}
+
+CoarseOctaveField OctaveCache::Acquire(const FbmParams& p, int octaves, double x0, double z0, double x1,
+                                       double z1) {
+    CoarseOctaveField field;
+    field.octaves_ = std::max(0, std::min(octaves, kMaxFbmOctaves));
+    if (field.octaves_ == 0) return field;
+    const int64_t rx0 = FloorDiv(FloorToLattice(x0), kCoarseRegionCells);
+    const int64_t rz0 = FloorDiv(FloorToLattice(z0), kCoarseRegionCells);
+    const int64_t rx1 = FloorDiv(FloorToLattice(x1), kCoarseRegionCells);
+    const int64_t rz1 = FloorDiv(FloorToLattice(z1), kCoarseRegionCells);
+    field.rx0_ = static_cast<int32_t>(rx0);
+    field.rz0_ = static_cast<int32_t>(rz0);
+    field.nx_ = static_cast<uint32_t>(rx1 - rx0 + 1);
+    field.nz_ = static_cast<uint32_t>(rz1 - rz0 + 1);
+    CoarseTileKey key;
+    key.octaves = field.octaves_;
+    key.fbm = FbmFingerprint(p);
+    for (int64_t rz = rz0; rz <= rz1; ++rz) {
+        for (int64_t rx = rx0; rx <= rx1; ++rx) {
+            key.rx = static_cast<int32_t>(rx);
+            key.rz = static_cast<int32_t>(rz);
+            field.tiles_.push_back(Tile(p, key));
+        }
+    }
+    return field;
+}
+
+void OctaveCache::EvictLocked() {
+    const size_t tileBytes = TileBytes();
+    while (!lru_.empty() && lru_.size() * tileBytes > maxBytes_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    stats_.entries = lru_.size();
+    stats_.bytes = lru_.size() * tileBytes;
+}
+
+void OctaveCache::SetMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxBytes_ = maxBytes;
+    EvictLocked();
+}
+
+void OctaveCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_ = OctaveCacheStats{};
+}
+
+OctaveCacheStats OctaveCache::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+OctaveCache& OctaveCache::Global() {
+    // A tile is ~1 MiB and covers 4x4 chunks; 16 MiB keeps 15 regions (about 240 chunks) warm
+    static OctaveCache cache(16u << 20);
+    return cache;
+}
+
+} // namespace terraingen
@@ -0,0 +1,245 @@
+#include "PipelineRegistry.hpp"
+#include "ThreadPool.hpp"
+#include <cstring>
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#elif TERRAINGEN_WEBGPU
+#include <webgpu/wgpu.h>
+#endif
+
+namespace terraingen {
+
+// kEmbeddedShaders, generated from shaders/*.wgsl by compile.py
+#include "ShaderSources.inc"
+
+using BK = BindingKind;
+
+static constexpr PipelineDesc kPipelines[] = {
+    // Params, tables, height, gradX, gradZ, humidity, temperature, ids
+    {"biome_classify", "biome_classify", 8,
+     {BK::Uniform, BK::ReadOnlyStorage, BK::SampledFloat, BK::SampledFloat, BK::SampledFloat, BK::SampledFloat,
+      BK::SampledFloat, BK::StorageR8Uint}},
+    // Params, height, gradX, gradZ, vertices, indices
+    {"mesh_tile", "mesh_tile", 6,
+     {BK::Uniform, BK::SampledFloat, BK::SampledFloat, BK::SampledFloat, BK::StorageBuffer, BK::StorageBuffer}},
+};
+static_assert(sizeof(kPipelines) / sizeof(kPipelines[0]) == static_cast<size_t>(PipelineID::Count),
+              "one descriptor per pipeline");
+
+static constexpr bool SameName(const char* a, const char* b) {
+    while (*a && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return *a == *b;
+}
+
+static constexpr const ShaderSource* FindEmbedded(const char* name) {
+    for (const ShaderSource& shader : kEmbeddedShaders) {
+        if (SameName(shader.name, name)) return &shader;
+    }
+    return nullptr;
+}
+
+// Hashes of the shaders as reviewed. Editing, adding or removing a shader fails the build
+// until this table says the same: FNV-1a 64 of the file's text with CRLF as LF, which is the
+// hash compile.py writes next to it in ShaderSources.inc.
+struct GoldenShader {
+    const char* name;
+    uint64_t hash;
+};
+static constexpr GoldenShader kGoldenShaders[] = {
+    {"biome_classify", 0xcea0c177dd941d62ull},
+    {"mesh_tile", 0x8d5a4c13b9e883b8ull},
+};
+
+static constexpr uint64_t FindGolden(const char* name) {
+    for (const GoldenShader& golden : kGoldenShaders) {
+        if (SameName(golden.name, name)) return golden.hash;
+    }
+    return 0;
+}
+
+// Every embedded shader has its golden hash, and its text (as embedded, and as hashed by
+// compile.py) still hashes to it
+static constexpr bool HashesMatch() {
+    for (const ShaderSource& shader : kEmbeddedShaders) {
+        const uint64_t golden = FindGolden(shader.name);
+        if (ShaderHash(shader.code, shader.size) != golden || shader.hash != golden) return false;
+    }
+    return sizeof(kGoldenShaders) / sizeof(kGoldenShaders[0]) == sizeof(kEmbeddedShaders) / sizeof(kEmbeddedShaders[0]);
+}
+
+static constexpr bool PipelineShadersEmbedded() {
+    for (const PipelineDesc& desc : kPipelines) {
+        if (!FindEmbedded(desc.shader)) return false;
+    }
+    return true;
+}
+
+static_assert(HashesMatch(), "shaders/ no longer matches kGoldenShaders; update the table with the shader");
+static_assert(PipelineShadersEmbedded(), "a pipeline's shader is missing from shaders/");
+
+size_t ShaderCount() {
+    return sizeof(kEmbeddedShaders) / sizeof(kEmbeddedShaders[0]);
+}
+
+const ShaderSource& GetShader(size_t i) {
+    return kEmbeddedShaders[i];
+}
+
+const ShaderSource* FindShader(const char* name) {
+    return FindEmbedded(name);
+}
+
+uint64_t GoldenShaderHash(const char* name) {
+    return FindGolden(name);
+}
+
+const PipelineDesc& GetPipelineDesc(PipelineID id) {
+    return kPipelines[static_cast<size_t>(id)];
+}
+
+#if TERRAINGEN_WEBGPU
+void PollDevice(WGPUDevice device) {
+#ifdef __EMSCRIPTEN__
+    (void)device;
+    emscripten_sleep(0);
+#else
+    wgpuDevicePoll(device, false, nullptr);
+#endif
+}
+
+// Shader module and layouts of a pipeline, without the pipeline object
+static ComputePipeline BuildLayout(WGPUDevice device, const PipelineDesc& desc) {
+    ComputePipeline p;
+    WGPUShaderModuleWGSLDescriptor wgslDesc{};
+    wgslDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+    wgslDesc.code = FindShader(desc.shader)->code;
+    WGPUShaderModuleDescriptor smDesc{};
+    smDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgslDesc);
+    smDesc.label = desc.name;
+    p.module = wgpuDeviceCreateShaderModule(device, &smDesc);
+
+    WGPUBindGroupLayoutEntry entries[PipelineDesc::kMaxBindings]{};
+    for (uint32_t i = 0; i < desc.bindingCount; ++i) {
+        WGPUBindGroupLayoutEntry& e = entries[i];
+        e.binding = i;
+        e.visibility = WGPUShaderStage_Compute;
+        switch (desc.bindings[i]) {
+            case BK::Uniform:
+                e.buffer.type = WGPUBufferBindingType_Uniform;
+                break;
+            case BK::StorageBuffer:
+                e.buffer.type = WGPUBufferBindingType_Storage;
+                break;
+            case BK::ReadOnlyStorage:
+                e.buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+                break;
+            case BK::SampledFloat:
+                e.texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+                e.texture.viewDimension = WGPUTextureViewDimension_2D;
+                break;
+            case BK::StorageR32Float:
+            case BK::StorageR8Uint:
+                e.storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+                // R8Uint textures are r32uint on the device; see DeviceFormat in GPUContext.cpp
+                e.storageTexture.format = desc.bindings[i] == BK::StorageR8Uint ? WGPUTextureFormat_R32Uint
+                                                                                : WGPUTextureFormat_R32Float;
+                e.storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+                break;
+        }
+    }
+    WGPUBindGroupLayoutDescriptor bglDesc{};
+    bglDesc.entryCount = desc.bindingCount;
+    bglDesc.entries = entries;
+    p.bgl = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
+
+    WGPUPipelineLayoutDescriptor plDesc{};
+    plDesc.bindGroupLayoutCount = 1;
+    plDesc.bindGroupLayouts = &p.bgl;
+    p.pl = wgpuDeviceCreatePipelineLayout(device, &plDesc);
+    return p;
+}
+
+static WGPUComputePipelineDescriptor PipelineDescriptor(const ComputePipeline& p) {
+    WGPUComputePipelineDescriptor cpDesc{};
+    cpDesc.layout = p.pl;
+    cpDesc.compute.module = p.module;
+    cpDesc.compute.entryPoint = "main";
+    return cpDesc;
+}
+
+static ComputePipeline BuildPipeline(WGPUDevice device, const PipelineDesc& desc) {
+    ComputePipeline p = BuildLayout(device, desc);
+    const WGPUComputePipelineDescriptor cpDesc = PipelineDescriptor(p);
+    p.pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
+    return p;
+}
+
+static void ReleasePipeline(const ComputePipeline& p) {
+    if (p.pipeline) wgpuComputePipelineRelease(p.pipeline);
+    if (p.pl) wgpuPipelineLayoutRelease(p.pl);
+    if (p.bgl) wgpuBindGroupLayoutRelease(p.bgl);
+    if (p.module) wgpuShaderModuleRelease(p.module);
+}
+
+const ComputePipeline& PipelineRegistry::Get(WGPUDevice device, PipelineID id) {
+    const size_t i = static_cast<size_t>(id);
+    std::call_once(once_[i], [&] { pipelines_[i] = BuildPipeline(device, kPipelines[i]); });
+    return pipelines_[i];
+}
+
+uint32_t PipelineRegistry::WarmUp(WGPUDevice device) {
+    struct Pending {
+        ComputePipeline pipeline;
+        bool done = false;
+    };
+    Pending pending[kCount];
+#ifdef __EMSCRIPTEN__
+    for (size_t i = 0; i < kCount; ++i) {
+        pending[i].pipeline = BuildLayout(device, kPipelines[i]);
+        const WGPUComputePipelineDescriptor cpDesc = PipelineDescriptor(pending[i].pipeline);
+        wgpuDeviceCreateComputePipelineAsync(device, &cpDesc,
+            [](WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline, const char*, void* usr) {
+                Pending* p = static_cast<Pending*>(usr);
+                if (status == WGPUCreatePipelineAsyncStatus_Success) p->pipeline.pipeline = pipeline;
+                p->done = true;
+            }, &pending[i]);
+    }
+    for (Pending& p : pending) {
+        while (!p.done) { PollDevice(device); }
+    }
+#else
+    // wgpu-native has no async pipeline creation, but its device takes calls from any thread
+    ThreadPool::Global().ParallelFor(0, kCount, 1, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; ++i) pending[i].pipeline = BuildPipeline(device, kPipelines[i]);
+    });
+#endif
+    uint32_t built = 0;
+    for (size_t i = 0; i < kCount; ++i) {
+        ComputePipeline& p = pending[i].pipeline;
+        // A failed async build is redone the blocking way, which reports its error
+        if (!p.pipeline) {
+            const WGPUComputePipelineDescriptor cpDesc = PipelineDescriptor(p);
+            p.pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
+        }
+        bool installed = false;
+        std::call_once(once_[i], [&] {
+            pipelines_[i] = p;
+            installed = true;
+        });
+        // Built meanwhile through Get
+        if (!installed) ReleasePipeline(p);
+        built += installed;
+    }
+    return built;
+}
+
+PipelineRegistry& PipelineRegistry::Global() {
+    static PipelineRegistry registry;
+    return registry;
+}
+#endif
+
+} // namespace terraingen
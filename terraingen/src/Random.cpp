@@ -1,5 +1,9 @@
 #include "Random.hpp"
+#include "Simd.hpp"
 #include <cstdint>
+#if TERRAINGEN_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace terraingen {
 
@@ -43,24 +47,31 @@ uint64_t PCG64Next(PCG64State& s) {
     return (static_cast<uint64_t>(hi32) << 32) | lo32;
 }
 
-void PCG64Jump(PCG64State& s) {
-    // Jump ahead 2^64 steps using exponentiation by squaring (simple version)
+// Apply `steps` LCG steps at once: the composed map x -> A*x + C is built by squaring
+static uint64_t LcgAdvance(uint64_t state, uint64_t inc, uint64_t steps) {
     uint64_t cur_mult = PCG64_MULT;
-    uint64_t cur_inc  = s.inc;
+    uint64_t cur_inc  = inc;
     uint64_t acc_mult = 1ull;
     uint64_t acc_inc  = 0ull;
-
-    uint64_t delta = 0x8000000000000000ull; // 2^63 (arbitrary large step)
-    while (delta > 0) {
-        if (delta & 1ull) {
+    while (steps > 0) {
+        if (steps & 1ull) {
             acc_mult *= cur_mult;
             acc_inc   = acc_inc * cur_mult + cur_inc;
         }
         cur_inc *= (cur_mult + 1ull);
         cur_mult *= cur_mult;
-        delta >>= 1u;
+        steps >>= 1u;
     }
-    s.state = acc_mult * s.state + acc_inc;
+    return acc_mult * state + acc_inc;
+}
+
+void PCG64Jump(PCG64State& s) {
+    s.state = LcgAdvance(s.state, s.inc, 0x8000000000000000ull); // 2^63 (arbitrary large step)
+}
+
+void PCG64Advance(PCG64State& s, uint64_t delta) {
+    // Every output consumes two LCG steps
+    s.state = LcgAdvance(s.state, s.inc | 1ull, delta * 2u);
 }
 
 // splitmix64 hash helper
@@ -78,4 +89,259 @@ uint64_t HashCoords(int64_t x, int64_t y, int64_t z, uint64_t seed) {
     return h;
 }
 
+#if TERRAINGEN_X86_SIMD
+// AVX2 has no 64-bit multiply; build it from three 32x32->64 partial products
+TERRAINGEN_TARGET_AVX2 static inline __m256i Mul64AVX2(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i t1 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+    __m256i t2 = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(_mm256_add_epi64(t1, t2), 32));
+}
+
+TERRAINGEN_TARGET_AVX2 static inline __m256i Splitmix64AVX2(__m256i x) {
+    const __m256i k0 = _mm256_set1_epi64x(static_cast<int64_t>(0x9e3779b97f4a7c15ull));
+    const __m256i k1 = _mm256_set1_epi64x(static_cast<int64_t>(0xbf58476d1ce4e5b9ull));
+    const __m256i k2 = _mm256_set1_epi64x(static_cast<int64_t>(0x94d049bb133111ebull));
+    x = _mm256_add_epi64(x, k0);
+    x = Mul64AVX2(_mm256_xor_si256(x, _mm256_srli_epi64(x, 30)), k1);
+    x = Mul64AVX2(_mm256_xor_si256(x, _mm256_srli_epi64(x, 27)), k2);
+    return _mm256_xor_si256(x, _mm256_srli_epi64(x, 31));
+}
+
+TERRAINGEN_TARGET_AVX2 static inline __m256i HashCoordsAVX2(__m256i x, __m256i y, __m256i z, __m256i seed) {
+    __m256i h = Splitmix64AVX2(_mm256_xor_si256(x, seed));
+    h = Splitmix64AVX2(_mm256_xor_si256(h, y));
+    return Splitmix64AVX2(_mm256_xor_si256(h, z));
+}
+
+TERRAINGEN_TARGET_AVX2 static size_t HashCoordsN_AVX2(const int64_t* x, const int64_t* y, const int64_t* z,
+                                                      uint64_t seed, uint64_t* out, size_t n) {
+    const __m256i s = _mm256_set1_epi64x(static_cast<int64_t>(seed));
+    size_t i = 0;
+    // Two independent vectors per iteration hide the multiply latency
+    for (; i + 8 <= n; i += 8) {
+        __m256i h0 = HashCoordsAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + i)), s);
+        __m256i h1 = HashCoordsAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i + 4)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i + 4)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + i + 4)), s);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), h0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4), h1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256i h = HashCoordsAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)),
+                                   _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i)),
+                                   _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + i)), s);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), h);
+    }
+    return i;
+}
+
+TERRAINGEN_TARGET_AVX512 static inline __m512i Splitmix64AVX512(__m512i x) {
+    const __m512i k0 = _mm512_set1_epi64(static_cast<int64_t>(0x9e3779b97f4a7c15ull));
+    const __m512i k1 = _mm512_set1_epi64(static_cast<int64_t>(0xbf58476d1ce4e5b9ull));
+    const __m512i k2 = _mm512_set1_epi64(static_cast<int64_t>(0x94d049bb133111ebull));
+    x = _mm512_add_epi64(x, k0);
+    x = _mm512_mullo_epi64(_mm512_xor_si512(x, _mm512_srli_epi64(x, 30)), k1);
+    x = _mm512_mullo_epi64(_mm512_xor_si512(x, _mm512_srli_epi64(x, 27)), k2);
+    return _mm512_xor_si512(x, _mm512_srli_epi64(x, 31));
+}
+
+TERRAINGEN_TARGET_AVX512 static inline __m512i HashCoordsAVX512(__m512i x, __m512i y, __m512i z, __m512i seed) {
+    __m512i h = Splitmix64AVX512(_mm512_xor_si512(x, seed));
+    h = Splitmix64AVX512(_mm512_xor_si512(h, y));
+    return Splitmix64AVX512(_mm512_xor_si512(h, z));
+}
+
+TERRAINGEN_TARGET_AVX512 static size_t HashCoordsN_AVX512(const int64_t* x, const int64_t* y, const int64_t* z,
+                                                          uint64_t seed, uint64_t* out, size_t n) {
+    const __m512i s = _mm512_set1_epi64(static_cast<int64_t>(seed));
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i h0 = HashCoordsAVX512(_mm512_loadu_si512(x + i), _mm512_loadu_si512(y + i),
+                                      _mm512_loadu_si512(z + i), s);
+        __m512i h1 = HashCoordsAVX512(_mm512_loadu_si512(x + i + 8), _mm512_loadu_si512(y + i + 8),
+                                      _mm512_loadu_si512(z + i + 8), s);
+        _mm512_storeu_si512(out + i, h0);
+        _mm512_storeu_si512(out + i + 8, h1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m512i h = HashCoordsAVX512(_mm512_loadu_si512(x + i), _mm512_loadu_si512(y + i),
+                                     _mm512_loadu_si512(z + i), s);
+        _mm512_storeu_si512(out + i, h);
+    }
+    return i;
+}
+#endif
+
+// Philox4x32 round multipliers and Weyl key increments
+static constexpr uint32_t kPhiloxM0 = 0xD2511F53u;
+static constexpr uint32_t kPhiloxM1 = 0xCD9E8D57u;
+static constexpr uint32_t kPhiloxW0 = 0x9E3779B9u;
+static constexpr uint32_t kPhiloxW1 = 0xBB67AE85u;
+static constexpr int kPhiloxRounds = 10;
+
+// Salt separating counter streams from other HashCoords users
+static constexpr uint64_t kCounterStreamSeed = 0x5ca1ab1e0ddba11ull;
+
+Philox4x32 Philox4x32_10(Philox4x32 c, uint64_t key) {
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+    for (int r = 0; r < kPhiloxRounds; ++r) {
+        const uint64_t p0 = static_cast<uint64_t>(kPhiloxM0) * c.v[0];
+        const uint64_t p1 = static_cast<uint64_t>(kPhiloxM1) * c.v[2];
+        c = Philox4x32{{static_cast<uint32_t>(p1 >> 32) ^ c.v[1] ^ k0, static_cast<uint32_t>(p1),
+                        static_cast<uint32_t>(p0 >> 32) ^ c.v[3] ^ k1, static_cast<uint32_t>(p0)}};
+        k0 += kPhiloxW0;
+        k1 += kPhiloxW1;
+    }
+    return c;
+}
+
+static inline Philox4x32 CounterBlock(uint64_t key, uint64_t stream, uint64_t block) {
+    Philox4x32 c{{static_cast<uint32_t>(block), static_cast<uint32_t>(block >> 32),
+                  static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)}};
+    return Philox4x32_10(c, key);
+}
+
+uint64_t CounterStream(int64_t chunkX, int64_t chunkZ, uint32_t stage) {
+    return HashCoords(chunkX, chunkZ, stage, kCounterStreamSeed);
+}
+
+uint64_t CounterRandom(uint64_t key, uint64_t stream, uint64_t index) {
+    const Philox4x32 r = CounterBlock(key, stream, index >> 1);
+    const uint32_t* half = r.v + 2 * (index & 1u);
+    return (static_cast<uint64_t>(half[1]) << 32) | half[0];
+}
+
+#if TERRAINGEN_X86_SIMD
+// One Philox block per 64-bit lane; only the low 32 bits of each lane are meaningful until the
+// final pack, since _mm*_mul_epu32 reads just those.
+TERRAINGEN_TARGET_AVX2 static inline void PhiloxAVX2(__m256i& c0, __m256i& c1, __m256i& c2, __m256i& c3,
+                                                     uint64_t key) {
+    const __m256i m0 = _mm256_set1_epi64x(kPhiloxM0);
+    const __m256i m1 = _mm256_set1_epi64x(kPhiloxM1);
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+    for (int r = 0; r < kPhiloxRounds; ++r) {
+        const __m256i p0 = _mm256_mul_epu32(c0, m0);
+        const __m256i p1 = _mm256_mul_epu32(c2, m1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1), _mm256_set1_epi64x(k0));
+        c1 = p1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3), _mm256_set1_epi64x(k1));
+        c3 = p0;
+        k0 += kPhiloxW0;
+        k1 += kPhiloxW1;
+    }
+}
+
+TERRAINGEN_TARGET_AVX2 static size_t CounterRandomN_AVX2(uint64_t key, uint64_t stream, uint64_t block,
+                                                         uint64_t* out, size_t n) {
+    const __m256i lo32 = _mm256_set1_epi64x(0xffffffffll);
+    const __m256i s0 = _mm256_set1_epi64x(static_cast<uint32_t>(stream));
+    const __m256i s1 = _mm256_set1_epi64x(static_cast<uint32_t>(stream >> 32));
+    __m256i b = _mm256_add_epi64(_mm256_set1_epi64x(static_cast<int64_t>(block)), _mm256_setr_epi64x(0, 1, 2, 3));
+    const __m256i step = _mm256_set1_epi64x(4);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i c0 = b, c1 = _mm256_srli_epi64(b, 32), c2 = s0, c3 = s1;
+        PhiloxAVX2(c0, c1, c2, c3, key);
+        const __m256i v0 = _mm256_or_si256(_mm256_slli_epi64(c1, 32), _mm256_and_si256(c0, lo32));
+        const __m256i v1 = _mm256_or_si256(_mm256_slli_epi64(c3, 32), _mm256_and_si256(c2, lo32));
+        // Interleave so each block's two values land next to each other
+        const __m256i lo = _mm256_unpacklo_epi64(v0, v1);
+        const __m256i hi = _mm256_unpackhi_epi64(v0, v1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+        b = _mm256_add_epi64(b, step);
+    }
+    return i;
+}
+
+TERRAINGEN_TARGET_AVX512 static inline void PhiloxAVX512(__m512i& c0, __m512i& c1, __m512i& c2, __m512i& c3,
+                                                         uint64_t key) {
+    const __m512i m0 = _mm512_set1_epi64(kPhiloxM0);
+    const __m512i m1 = _mm512_set1_epi64(kPhiloxM1);
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+    for (int r = 0; r < kPhiloxRounds; ++r) {
+        const __m512i p0 = _mm512_mul_epu32(c0, m0);
+        const __m512i p1 = _mm512_mul_epu32(c2, m1);
+        // xor(a, b, c) in one instruction: truth table 0x96
+        c0 = _mm512_ternarylogic_epi64(_mm512_srli_epi64(p1, 32), c1, _mm512_set1_epi64(k0), 0x96);
+        c1 = p1;
+        c2 = _mm512_ternarylogic_epi64(_mm512_srli_epi64(p0, 32), c3, _mm512_set1_epi64(k1), 0x96);
+        c3 = p0;
+        k0 += kPhiloxW0;
+        k1 += kPhiloxW1;
+    }
+}
+
+TERRAINGEN_TARGET_AVX512 static size_t CounterRandomN_AVX512(uint64_t key, uint64_t stream, uint64_t block,
+                                                             uint64_t* out, size_t n) {
+    const __m512i s0 = _mm512_set1_epi64(static_cast<uint32_t>(stream));
+    const __m512i s1 = _mm512_set1_epi64(static_cast<uint32_t>(stream >> 32));
+    const __m512i first = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m512i idxLo = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+    const __m512i idxHi = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+    __m512i b = _mm512_add_epi64(_mm512_set1_epi64(static_cast<int64_t>(block)), first);
+    const __m512i step = _mm512_set1_epi64(8);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i c0 = b, c1 = _mm512_srli_epi64(b, 32), c2 = s0, c3 = s1;
+        PhiloxAVX512(c0, c1, c2, c3, key);
+        // Pack the word pairs into 64-bit values: (hi << 32) | (lo & 0xffffffff)
+        const __m512i v0 = _mm512_mask_blend_epi32(0x5555, _mm512_slli_epi64(c1, 32), c0);
+        const __m512i v1 = _mm512_mask_blend_epi32(0x5555, _mm512_slli_epi64(c3, 32), c2);
+        _mm512_storeu_si512(out + i, _mm512_permutex2var_epi64(v0, idxLo, v1));
+        _mm512_storeu_si512(out + i + 8, _mm512_permutex2var_epi64(v0, idxHi, v1));
+        b = _mm512_add_epi64(b, step);
+    }
+    return i;
+}
+#endif
+
+void CounterRandomN(uint64_t key, uint64_t stream, uint64_t first, uint64_t* out, size_t n) {
+    size_t done = 0;
+    if (n > 0 && (first & 1u)) {
+        out[0] = CounterRandom(key, stream, first);
+        done = 1;
+    }
+#if TERRAINGEN_X86_SIMD
+    switch (ActiveSimdISA()) {
+        case SimdISA::AVX512:
+            done += CounterRandomN_AVX512(key, stream, (first + done) >> 1, out + done, n - done);
+            break;
+        case SimdISA::AVX2:
+            done += CounterRandomN_AVX2(key, stream, (first + done) >> 1, out + done, n - done);
+            break;
+        default: break;
+    }
+#endif
+    // Scalar tail (and full fallback): whole blocks, then a trailing half block
+    for (; done + 2 <= n; done += 2) {
+        const Philox4x32 r = CounterBlock(key, stream, (first + done) >> 1);
+        out[done] = (static_cast<uint64_t>(r.v[1]) << 32) | r.v[0];
+        out[done + 1] = (static_cast<uint64_t>(r.v[3]) << 32) | r.v[2];
+    }
+    if (done < n) out[done] = CounterRandom(key, stream, first + done);
+}
+
+void HashCoordsN(const int64_t* x, const int64_t* y, const int64_t* z,
+                 uint64_t seed, uint64_t* out, size_t n) {
+    size_t done = 0;
+#if TERRAINGEN_X86_SIMD
+    switch (ActiveSimdISA()) {
+        case SimdISA::AVX512: done = HashCoordsN_AVX512(x, y, z, seed, out, n); break;
+        case SimdISA::AVX2: done = HashCoordsN_AVX2(x, y, z, seed, out, n); break;
+        default: break;
+    }
+#endif
+    // Scalar tail (and full fallback)
+    for (size_t i = done; i < n; ++i) {
+        out[i] = HashCoords(x[i], y[i], z[i], seed);
+    }
+}
+
 } // namespace terraingen 
\ No newline at end of file
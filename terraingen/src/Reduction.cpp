@@ -0,0 +1,225 @@
+#include "Reduction.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#if TERRAINGEN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace terraingen {
+
+static HeightBounds ReduceMinMaxScalar(const float* data, size_t n) {
+    HeightBounds b;
+    for (size_t i = 0; i < n; ++i) {
+        b.min = data[i] < b.min ? data[i] : b.min;
+        b.max = data[i] > b.max ? data[i] : b.max;
+    }
+    return b;
+}
+
+#if TERRAINGEN_X86_SIMD
+TERRAINGEN_TARGET_AVX2 static HeightBounds ReduceMinMaxAVX2(const float* data, size_t n) {
+    __m256 mn0 = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 mx0 = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    __m256 mn1 = mn0, mx1 = mx0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_loadu_ps(data + i);
+        __m256 b = _mm256_loadu_ps(data + i + 8);
+        mn0 = _mm256_min_ps(mn0, a);
+        mx0 = _mm256_max_ps(mx0, a);
+        mn1 = _mm256_min_ps(mn1, b);
+        mx1 = _mm256_max_ps(mx1, b);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_loadu_ps(data + i);
+        mn0 = _mm256_min_ps(mn0, a);
+        mx0 = _mm256_max_ps(mx0, a);
+    }
+    mn0 = _mm256_min_ps(mn0, mn1);
+    mx0 = _mm256_max_ps(mx0, mx1);
+    alignas(32) float lo[8], hi[8];
+    _mm256_store_ps(lo, mn0);
+    _mm256_store_ps(hi, mx0);
+    HeightBounds b = ReduceMinMaxScalar(data + i, n - i);
+    for (int k = 0; k < 8; ++k) b.Merge(HeightBounds{lo[k], hi[k]});
+    return b;
+}
+
+TERRAINGEN_TARGET_AVX512 static HeightBounds ReduceMinMaxAVX512(const float* data, size_t n) {
+    __m512 mn0 = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+    __m512 mx0 = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+    __m512 mn1 = mn0, mx1 = mx0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 a = _mm512_loadu_ps(data + i);
+        __m512 b = _mm512_loadu_ps(data + i + 16);
+        mn0 = _mm512_min_ps(mn0, a);
+        mx0 = _mm512_max_ps(mx0, a);
+        mn1 = _mm512_min_ps(mn1, b);
+        mx1 = _mm512_max_ps(mx1, b);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m512 a = _mm512_loadu_ps(data + i);
+        mn0 = _mm512_min_ps(mn0, a);
+        mx0 = _mm512_max_ps(mx0, a);
+    }
+    HeightBounds b = ReduceMinMaxScalar(data + i, n - i);
+    b.Merge(HeightBounds{_mm512_reduce_min_ps(_mm512_min_ps(mn0, mn1)),
+                         _mm512_reduce_max_ps(_mm512_max_ps(mx0, mx1))});
+    return b;
+}
+#endif
+
+// lo[i] = min(lo[i], row[i]), hi[i] = max(hi[i], row[i])
+static void AccumulateRowScalar(const float* row, float* lo, float* hi, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        lo[i] = row[i] < lo[i] ? row[i] : lo[i];
+        hi[i] = row[i] > hi[i] ? row[i] : hi[i];
+    }
+}
+
+#if TERRAINGEN_X86_SIMD
+TERRAINGEN_TARGET_AVX2 static void AccumulateRowAVX2(const float* row, float* lo, float* hi, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(row + i);
+        _mm256_storeu_ps(lo + i, _mm256_min_ps(_mm256_loadu_ps(lo + i), v));
+        _mm256_storeu_ps(hi + i, _mm256_max_ps(_mm256_loadu_ps(hi + i), v));
+    }
+    AccumulateRowScalar(row + i, lo + i, hi + i, n - i);
+}
+
+TERRAINGEN_TARGET_AVX512 static void AccumulateRowAVX512(const float* row, float* lo, float* hi, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(row + i);
+        _mm512_storeu_ps(lo + i, _mm512_min_ps(_mm512_loadu_ps(lo + i), v));
+        _mm512_storeu_ps(hi + i, _mm512_max_ps(_mm512_loadu_ps(hi + i), v));
+    }
+    AccumulateRowScalar(row + i, lo + i, hi + i, n - i);
+}
+#endif
+
+static void AccumulateRow(const float* row, float* lo, float* hi, size_t n) {
+#if TERRAINGEN_X86_SIMD
+    switch (ActiveSimdISA()) {
+        case SimdISA::AVX512: AccumulateRowAVX512(row, lo, hi, n); return;
+        case SimdISA::AVX2: AccumulateRowAVX2(row, lo, hi, n); return;
+        default: break;
+    }
+#endif
+    AccumulateRowScalar(row, lo, hi, n);
+}
+
+HeightBounds ReduceMinMax(const float* data, size_t n) {
+#if TERRAINGEN_X86_SIMD
+    switch (ActiveSimdISA()) {
+        case SimdISA::AVX512: return ReduceMinMaxAVX512(data, n);
+        case SimdISA::AVX2: return ReduceMinMaxAVX2(data, n);
+        default: break;
+    }
+#endif
+    return ReduceMinMaxScalar(data, n);
+}
+
+MinMaxPyramid BuildMinMaxPyramid(const float* data, uint32_t width, uint32_t height, uint32_t tileSize) {
+    MinMaxPyramid pyr;
+    if (!data || width == 0 || height == 0) return pyr;
+    tileSize = std::max(1u, tileSize);
+    pyr.tileSize = tileSize;
+
+    MinMaxPyramid::Level level0;
+    level0.width = (width + tileSize - 1) / tileSize;
+    level0.height = (height + tileSize - 1) / tileSize;
+    level0.cells.assign(static_cast<size_t>(level0.width) * level0.height, HeightBounds{});
+
+    // One band of tile rows per task. Rows stream through once and fold element-wise into a
+    // row-wide min/max accumulator that stays in L1; each tile is reduced horizontally only
+    // once per band.
+    ThreadPool::Global().ParallelFor(0, level0.height, 1, [&](uint32_t ty0, uint32_t ty1) {
+        std::vector<float> lo(width), hi(width);
+        for (uint32_t ty = ty0; ty < ty1; ++ty) {
+            uint32_t y0 = ty * tileSize;
+            uint32_t yEnd = std::min(height, y0 + tileSize);
+            const float* first = data + static_cast<size_t>(y0) * width;
+            std::copy(first, first + width, lo.begin());
+            std::copy(first, first + width, hi.begin());
+            for (uint32_t y = y0 + 1; y < yEnd; ++y) {
+                AccumulateRow(data + static_cast<size_t>(y) * width, lo.data(), hi.data(), width);
+            }
+            HeightBounds* tiles = &level0.cells[static_cast<size_t>(ty) * level0.width];
+            for (uint32_t tx = 0; tx < level0.width; ++tx) {
+                uint32_t x0 = tx * tileSize;
+                uint32_t n = std::min(width, x0 + tileSize) - x0;
+                tiles[tx].min = ReduceMinMax(lo.data() + x0, n).min;
+                tiles[tx].max = ReduceMinMax(hi.data() + x0, n).max;
+            }
+        }
+    });
+    pyr.levels.push_back(std::move(level0));
+
+    // Coarser levels are tiny; merge 2x2 serially until one cell is left
+    while (pyr.levels.back().width > 1 || pyr.levels.back().height > 1) {
+        const auto& prev = pyr.levels.back();
+        MinMaxPyramid::Level next;
+        next.width = (prev.width + 1) / 2;
+        next.height = (prev.height + 1) / 2;
+        next.cells.assign(static_cast<size_t>(next.width) * next.height, HeightBounds{});
+        for (uint32_t y = 0; y < prev.height; ++y) {
+            for (uint32_t x = 0; x < prev.width; ++x) {
+                next.cells[static_cast<size_t>(y / 2) * next.width + x / 2].Merge(prev.At(x, y));
+            }
+        }
+        pyr.levels.push_back(std::move(next));
+    }
+    return pyr;
+}
+
+HeightBounds MinMaxPyramid::Query(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const {
+    HeightBounds b;
+    if (levels.empty() || x0 >= x1 || y0 >= y1) return b;
+    const Level& l0 = levels[0];
+    uint32_t tx1 = std::min(l0.width, (x1 + tileSize - 1) / tileSize);
+    uint32_t ty1 = std::min(l0.height, (y1 + tileSize - 1) / tileSize);
+    for (uint32_t ty = y0 / tileSize; ty < ty1; ++ty) {
+        for (uint32_t tx = x0 / tileSize; tx < tx1; ++tx) {
+            b.Merge(l0.At(tx, ty));
+        }
+    }
+    return b; // conservative: whole tiles touching the rectangle
+}
+
+// Affine map from one range onto another; a degenerate source maps to to.min
+static void RemapCoefficients(const HeightBounds& from, const HeightBounds& to, float& scale, float& offset) {
+    float span = from.max - from.min;
+    scale = span > 0.0f ? (to.max - to.min) / span : 0.0f;
+    offset = to.min - from.min * scale;
+}
+
+void NormalizeHeights(float* data, size_t n, const HeightBounds& from, const HeightBounds& to) {
+    float scale, offset;
+    RemapCoefficients(from, to, scale, offset);
+    const uint32_t kBlock = 1u << 14;
+    uint32_t blocks = static_cast<uint32_t>((n + kBlock - 1) / kBlock);
+    ThreadPool::Global().ParallelFor(0, blocks, 1, [&](uint32_t b0, uint32_t b1) {
+        size_t end = std::min(n, static_cast<size_t>(b1) * kBlock);
+        for (size_t i = static_cast<size_t>(b0) * kBlock; i < end; ++i) {
+            data[i] = data[i] * scale + offset;
+        }
+    });
+}
+
+void RemapPyramid(MinMaxPyramid& pyramid, const HeightBounds& from, const HeightBounds& to) {
+    float scale, offset;
+    RemapCoefficients(from, to, scale, offset);
+    for (auto& level : pyramid.levels) {
+        for (auto& c : level.cells) {
+            if (c.Empty()) continue;
+            c.min = c.min * scale + offset;
+            c.max = c.max * scale + offset;
+        }
+    }
+}
+
+} // namespace terraingen
@@ -0,0 +1,47 @@
+#include "Simd.hpp"
+#include <atomic>
+
+namespace terraingen {
+
+static SimdISA DetectOnce() {
+#if TERRAINGEN_X86_SIMD
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("f16c")) return SimdISA::Scalar;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+        __builtin_cpu_supports("avx512bw")) {
+        return SimdISA::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdISA::AVX2;
+    }
+#endif
+    return SimdISA::Scalar;
+}
+
+SimdISA DetectSimdISA() {
+    static const SimdISA detected = DetectOnce();
+    return detected;
+}
+
+static std::atomic<int> s_override{-1};
+
+SimdISA ActiveSimdISA() {
+    int forced = s_override.load(std::memory_order_relaxed);
+    return forced < 0 ? DetectSimdISA() : static_cast<SimdISA>(forced);
+}
+
+void SetSimdISA(SimdISA isa) {
+    SimdISA best = DetectSimdISA();
+    if (static_cast<int>(isa) > static_cast<int>(best)) isa = best;
+    s_override.store(static_cast<int>(isa), std::memory_order_relaxed);
+}
+
+const char* SimdISAName(SimdISA isa) {
+    switch (isa) {
+        case SimdISA::AVX2: return "avx2";
+        case SimdISA::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+} // namespace terraingen
@@ -0,0 +1,239 @@
+#include "TextureFormat.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if TERRAINGEN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace terraingen {
+
+uint32_t TexelBytes(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::R32Float: return 4;
+        case TextureFormat::R16Float: return 2;
+        case TextureFormat::R16Unorm: return 2;
+        case TextureFormat::R8Unorm: return 1;
+        case TextureFormat::R8Uint: return 1;
+        case TextureFormat::RG8Snorm: return 2;
+        case TextureFormat::RGBA8Unorm: return 4;
+    }
+    return 0;
+}
+
+uint32_t ChannelCount(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::RG8Snorm: return 2;
+        case TextureFormat::RGBA8Unorm: return 4;
+        default: return 1;
+    }
+}
+
+const char* TextureFormatName(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::R32Float: return "r32float";
+        case TextureFormat::R16Float: return "r16float";
+        case TextureFormat::R16Unorm: return "r16unorm";
+        case TextureFormat::R8Unorm: return "r8unorm";
+        case TextureFormat::R8Uint: return "r8uint";
+        case TextureFormat::RG8Snorm: return "rg8snorm";
+        case TextureFormat::RGBA8Unorm: return "rgba8unorm";
+    }
+    return "?";
+}
+
+uint16_t FloatToHalf(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const uint16_t sign = static_cast<uint16_t>(x >> 16 & 0x8000);
+    x &= 0x7FFFFFFF;
+    if (x >= 0x7F800000) {
+        // Infinity, or a NaN keeping its top payload bits with the quiet bit set
+        return sign | 0x7C00 | (x > 0x7F800000 ? 0x200 | (x >> 13 & 0x3FF) : 0);
+    }
+    // 65520 and up is at least half way from the largest half (65504) to the next power of two
+    if (x >= 0x477FF000) return sign | 0x7C00;
+    if (x < 0x38800000) {
+        // Below the smallest normal half: a multiple of 2^-24, or zero under 2^-25
+        const uint32_t e = x >> 23;
+        if (e < 102) return sign;
+        const uint32_t m = (x & 0x7FFFFF) | 0x800000;
+        const uint32_t shift = 126 - e;
+        const uint32_t rem = m & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        uint32_t h = m >> shift;
+        h += rem > halfway || (rem == halfway && (h & 1));
+        return sign | static_cast<uint16_t>(h);
+    }
+    // Rebias the exponent (127 -> 15) and round the dropped 13 mantissa bits; a carry moves
+    // into the exponent as it should
+    uint32_t h = (x - 0x38000000) >> 13;
+    const uint32_t rem = x & 0x1FFF;
+    h += rem > 0x1000 || (rem == 0x1000 && (h & 1));
+    return sign | static_cast<uint16_t>(h);
+}
+
+float HalfToFloat(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    const uint32_t e = h >> 10 & 0x1F, m = h & 0x3FF;
+    uint32_t x;
+    if (e == 0x1F) {
+        x = sign | 0x7F800000 | (m ? 0x400000 | m << 13 : 0);
+    } else if (e == 0) {
+        if (m == 0) {
+            x = sign;
+        } else {
+            // Subnormal: normalize the mantissa
+            int shift = 0;
+            uint32_t mm = m;
+            while (!(mm & 0x400)) {
+                mm <<= 1;
+                ++shift;
+            }
+            x = sign | static_cast<uint32_t>(113 - shift) << 23 | (mm & 0x3FF) << 13;
+        }
+    } else {
+        x = sign | (e + 112) << 23 | m << 13;
+    }
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// Clamp to [lo, hi] with NaN going to lo, matching max(v, lo) then min(., hi) in the kernels
+static inline float Saturate(float v, float lo, float hi) {
+    v = v > lo ? v : lo;
+    return v < hi ? v : hi;
+}
+
+// Through int32, which converts branch-free (the value is known to be small)
+static inline uint32_t EncodeUnorm(float v, float scale) {
+    return static_cast<uint32_t>(static_cast<int32_t>(Saturate(v, 0.0f, 1.0f) * scale + 0.5f));
+}
+
+#if TERRAINGEN_X86_SIMD
+TERRAINGEN_TARGET_AVX2 static size_t EncodeHalfAVX2(const float* in, size_t n, uint16_t* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+    }
+    return i;
+}
+
+TERRAINGEN_TARGET_AVX2 static size_t DecodeHalfAVX2(const uint16_t* in, size_t n, float* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+    }
+    return i;
+}
+
+TERRAINGEN_TARGET_AVX2 static inline __m256i UnormAVX2(const float* in, __m256 scale) {
+    const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), _mm256_set1_ps(0.5f)));
+}
+
+// 32 texels per step: two 32 -> 16 bit packs and a 16 -> 8 bit pack interleave the four
+// vectors by 128-bit lane, which the final dword permute undoes
+TERRAINGEN_TARGET_AVX2 static size_t EncodeUnorm8AVX2(const float* in, size_t n, uint8_t* out) {
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i ab = _mm256_packus_epi32(UnormAVX2(in + i, scale), UnormAVX2(in + i + 8, scale));
+        const __m256i cd = _mm256_packus_epi32(UnormAVX2(in + i + 16, scale), UnormAVX2(in + i + 24, scale));
+        const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(ab, cd), order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), bytes);
+    }
+    return i;
+}
+
+TERRAINGEN_TARGET_AVX2 static size_t EncodeUnorm16AVX2(const float* in, size_t n, uint16_t* out) {
+    const __m256 scale = _mm256_set1_ps(65535.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i ab = _mm256_packus_epi32(UnormAVX2(in + i, scale), UnormAVX2(in + i + 8, scale));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(ab, 0xD8));
+    }
+    return i;
+}
+#endif
+
+void EncodeTexels(TextureFormat format, const float* in, size_t n, void* texels, uint32_t channel) {
+    uint8_t* bytes = static_cast<uint8_t*>(texels);
+    size_t i = 0;
+#if TERRAINGEN_X86_SIMD
+    if (ActiveSimdISA() != SimdISA::Scalar) {
+        switch (format) {
+            case TextureFormat::R16Float: i = EncodeHalfAVX2(in, n, reinterpret_cast<uint16_t*>(bytes)); break;
+            case TextureFormat::R16Unorm: i = EncodeUnorm16AVX2(in, n, reinterpret_cast<uint16_t*>(bytes)); break;
+            case TextureFormat::R8Unorm: i = EncodeUnorm8AVX2(in, n, bytes); break;
+            default: break;
+        }
+    }
+#endif
+    switch (format) {
+        case TextureFormat::R32Float:
+            std::memcpy(bytes, in, n * sizeof(float));
+            break;
+        case TextureFormat::R16Float:
+            for (uint16_t* out = reinterpret_cast<uint16_t*>(bytes); i < n; ++i) out[i] = FloatToHalf(in[i]);
+            break;
+        case TextureFormat::R16Unorm:
+            for (uint16_t* out = reinterpret_cast<uint16_t*>(bytes); i < n; ++i) {
+                out[i] = static_cast<uint16_t>(EncodeUnorm(in[i], 65535.0f));
+            }
+            break;
+        case TextureFormat::R8Unorm:
+            for (; i < n; ++i) bytes[i] = static_cast<uint8_t>(EncodeUnorm(in[i], 255.0f));
+            break;
+        case TextureFormat::R8Uint:
+            for (; i < n; ++i) bytes[i] = static_cast<uint8_t>(static_cast<int32_t>(Saturate(in[i], 0.0f, 255.0f)));
+            break;
+        case TextureFormat::RG8Snorm:
+            for (; i < n; ++i) {
+                const float v = Saturate(in[i], -1.0f, 1.0f) * 127.0f;
+                bytes[2 * i + channel] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(v)));
+            }
+            break;
+        case TextureFormat::RGBA8Unorm:
+            for (; i < n; ++i) bytes[4 * i + channel] = static_cast<uint8_t>(EncodeUnorm(in[i], 255.0f));
+            break;
+    }
+}
+
+void DecodeTexels(TextureFormat format, const void* texels, size_t n, float* out, uint32_t channel) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(texels);
+    size_t i = 0;
+    switch (format) {
+        case TextureFormat::R32Float:
+            std::memcpy(out, bytes, n * sizeof(float));
+            break;
+        case TextureFormat::R16Float: {
+            const uint16_t* in = reinterpret_cast<const uint16_t*>(bytes);
+#if TERRAINGEN_X86_SIMD
+            if (ActiveSimdISA() != SimdISA::Scalar) i = DecodeHalfAVX2(in, n, out);
+#endif
+            for (; i < n; ++i) out[i] = HalfToFloat(in[i]);
+            break;
+        }
+        case TextureFormat::R16Unorm:
+            for (const uint16_t* in = reinterpret_cast<const uint16_t*>(bytes); i < n; ++i) out[i] = in[i] / 65535.0f;
+            break;
+        case TextureFormat::R8Unorm:
+            for (; i < n; ++i) out[i] = bytes[i] / 255.0f;
+            break;
+        case TextureFormat::R8Uint:
+            for (; i < n; ++i) out[i] = bytes[i];
+            break;
+        case TextureFormat::RG8Snorm:
+            for (; i < n; ++i) out[i] = std::max(static_cast<int8_t>(bytes[2 * i + channel]) / 127.0f, -1.0f);
+            break;
+        case TextureFormat::RGBA8Unorm:
+            for (; i < n; ++i) out[i] = bytes[4 * i + channel] / 255.0f;
+            break;
+    }
+}
+
+} // namespace terraingen
@@ -1,117 +1,168 @@
 #include "TextureSynth.hpp"
+#include "BiomeDistance.hpp"
 #include "GPUContext.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
 #include <cmath>
-#ifdef __EMSCRIPTEN__
-#include <emscripten/html5_webgpu.h>
-#include <emscripten.h>
-#include <fstream>
-#include <iterator>
-#include <string>
-#endif
+#include <functional>
 
 namespace terraingen {
 
-void TextureSynth::Generate(const GPUTexture heightTex,
-                             const BiomeMap& biomeMap,
+// One material channel for `count` texels starting at texel `first`, shaded in floats a short
+// span at a time and encoded into the texture's format; ids cover just those texels
+static void ShadeChannel(const uint8_t* ids, size_t first, size_t count, const BiomeDistanceField* edges,
+                         float BiomeMaterial::*channel, GPUContext::Texture& out) {
+    const BiomeMaterial* materials = BiomeMaterials();
+    constexpr size_t kSpan = 256;
+    float values[kSpan];
+    if (!edges && TexelBytes(out.format) == 1) {
+        // Hard steps into a byte format: encode the 256 materials once and look texels up
+        uint8_t encoded[256];
+        for (size_t id = 0; id < 256; ++id) values[id] = materials[id].*channel;
+        EncodeTexels(out.format, values, 256, encoded);
+        uint8_t* texels = out.As<uint8_t>() + first;
+        for (size_t i = 0; i < count; ++i) texels[i] = encoded[ids[i]];
+        return;
+    }
+    for (size_t s = 0; s < count; s += kSpan) {
+        const size_t n = std::min(kSpan, count - s);
+        if (edges) {
+            for (size_t i = 0; i < n; ++i) {
+                values[i] = BlendedChannel(materials, ids[s + i], *edges, first + s + i, channel);
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) values[i] = materials[ids[s + i]].*channel;
+        }
+        out.Write(first + s, n, values);
+    }
+}
+
+void TextureSynth::Generate([[maybe_unused]] const GPUTexture heightTex,
+                             const PackedBiomeMap& biomeMap,
                              GPUContext& gpu,
                              GPUTexture& outAlbedo,
                              GPUTexture& outNormal,
-                             GPUTexture& outRoughness) {
+                             GPUTexture& outRoughness,
+                             const BiomeDistanceField* edges) {
     if (biomeMap.empty()) {
         outAlbedo = outNormal = outRoughness = 0;
         return;
     }
 
-    // GPU path: load and dispatch texturesynth shader
-#ifdef __EMSCRIPTEN__
-    if (gpu.HasDevice()) {
-        auto device = emscripten_webgpu_get_device();
-        uint32_t size = static_cast<uint32_t>(std::sqrt(biomeMap.size()));
-        struct PipelineCache { WGPUShaderModule module; WGPUBindGroupLayout bgl; WGPUPipelineLayout pl; WGPUComputePipeline pipeline; };
-        static PipelineCache cache{};
-        if (!cache.pipeline) {
-            std::ifstream file("terraingen/shaders/texturesynth.wgsl");
-            std::string src((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            WGPUShaderModuleWGSLDescriptor wgslDesc{}; wgslDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor; wgslDesc.code = src.c_str();
-            WGPUShaderModuleDescriptor smDesc{}; smDesc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgslDesc);
-            cache.module = wgpuDeviceCreateShaderModule(device, &smDesc);
-            WGPUBindGroupLayoutEntry entries[4]{};
-            entries[0].binding = 0; entries[0].visibility = WGPUShaderStage_Compute; entries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat; entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
-            entries[1].binding = 1; entries[1].visibility = WGPUShaderStage_Compute; entries[1].storageTexture.access = WGPUStorageTextureAccess_WriteOnly; entries[1].storageTexture.format = WGPUTextureFormat_R32Float; entries[1].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
-            entries[2].binding = 2; entries[2].visibility = WGPUShaderStage_Compute; entries[2].storageTexture.access = WGPUStorageTextureAccess_WriteOnly; entries[2].storageTexture.format = WGPUTextureFormat_R32Float; entries[2].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
-            entries[3].binding = 3; entries[3].visibility = WGPUShaderStage_Compute; entries[3].storageTexture.access = WGPUStorageTextureAccess_WriteOnly; entries[3].storageTexture.format = WGPUTextureFormat_R32Float; entries[3].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
-            WGPUBindGroupLayoutDescriptor bglDesc{}; bglDesc.entryCount = 4; bglDesc.entries = entries;
-            cache.bgl = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
-            WGPUPipelineLayoutDescriptor plDesc{}; plDesc.bindGroupLayoutCount = 1; plDesc.bindGroupLayouts = &cache.bgl;
-            cache.pl = wgpuDeviceCreatePipelineLayout(device, &plDesc);
-            WGPUComputePipelineDescriptor cpDesc{}; cpDesc.layout = cache.pl; cpDesc.compute.module = cache.module; cpDesc.compute.entryPoint = "main";
-            cache.pipeline = wgpuDeviceCreateComputePipeline(device, &cpDesc);
-        }
-        // allocate outputs
-        outAlbedo   = gpu.CreateTexture2D(size, size);
-        outNormal   = gpu.CreateTexture2D(size, size);
-        outRoughness= gpu.CreateTexture2D(size, size);
-        auto& aTex = gpu.GetTexture(outAlbedo);
-        auto& nTex = gpu.GetTexture(outNormal);
-        auto& rTex = gpu.GetTexture(outRoughness);
-        // bind group
-        WGPUBindGroupEntry bgEntries[4]{};
-        bgEntries[0].binding = 0; bgEntries[0].textureView = gpu.GetTexture(heightTex).gpuView;
-        bgEntries[1].binding = 1; bgEntries[1].textureView = aTex.gpuView;
-        bgEntries[2].binding = 2; bgEntries[2].textureView = nTex.gpuView;
-        bgEntries[3].binding = 3; bgEntries[3].textureView = rTex.gpuView;
-        WGPUBindGroupDescriptor bgDesc{}; bgDesc.layout = cache.bgl; bgDesc.entryCount = 4; bgDesc.entries = bgEntries;
-        WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
-        // dispatch workgroups
-        WGPUCommandEncoder enc = wgpuDeviceCreateCommandEncoder(device, nullptr);
-        WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(enc, nullptr);
-        wgpuComputePassEncoderSetPipeline(pass, cache.pipeline);
-        wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 0, nullptr);
-        uint32_t wgX = (size + 7) / 8;
-        uint32_t wgY = (size + 7) / 8;
-        wgpuComputePassEncoderDispatchWorkgroups(pass, wgX, wgY, 1);
-        wgpuComputePassEncoderEnd(pass);
-        WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(enc, nullptr);
-        wgpuQueueSubmit(gpu.Queue(), 1, &cmd);
-        // cleanup
-        wgpuBindGroupRelease(bindGroup);
-        wgpuCommandEncoderRelease(enc);
-        wgpuCommandBufferRelease(cmd);
-        return;
-    }
-#endif
-
-    uint32_t size = static_cast<uint32_t>(std::sqrt(biomeMap.size()));
-    auto createAndFill = [&](GPUTexture& texID, float (*mapFn)(uint8_t)) {
-        texID = gpu.CreateTexture2D(size, size);
+    const uint32_t w = biomeMap.width(), h = biomeMap.height();
+    auto createAndFill = [&](GPUTexture& texID, float BiomeMaterial::*field) {
+        texID = gpu.CreateTexture2D(w, h, kMaterialFormat, TextureInit::Uninitialized);
         auto& tex = gpu.GetTexture(texID);
-        for (size_t i = 0; i < biomeMap.size(); ++i) {
-            tex.data[i] = mapFn(biomeMap[i]);
-        }
+        ThreadPool::Global().ParallelFor(0, h, 32, [&](uint32_t y0, uint32_t y1) {
+            thread_local std::vector<uint8_t> ids;
+            ids.resize(w);
+            for (uint32_t y = y0; y < y1; ++y) {
+                biomeMap.UnpackRow(y, 0, w, ids.data());
+                ShadeChannel(ids.data(), static_cast<size_t>(y) * w, w, edges, field, tex);
+            }
+        });
     };
 
     // Albedo brightness
-    createAndFill(outAlbedo, [](uint8_t id) {
-        switch (id) {
-            case 0: return 0.2f; // water dark
-            case 1: return 0.5f; // grass mid
-            case 2: return 0.9f; // snow bright
-            default: return 0.5f;
-        }
-    });
+    createAndFill(outAlbedo, &BiomeMaterial::albedo);
 
-    // Normal Y component only (encoded as brightness 1.0)
-    createAndFill(outNormal, [](uint8_t) { return 1.0f; });
+    // Normal X and Z, flat (Y = 1 is implied): a zeroed texture, which costs nothing until
+    // its mirror is touched
+    outNormal = gpu.CreateTexture2D(w, h, kNormalFormat);
 
     // Roughness value per biome
-    createAndFill(outRoughness, [](uint8_t id) {
-        switch (id) {
-            case 0: return 0.4f; // water smoother
-            case 1: return 0.9f; // grass rougher (diffuse)
-            case 2: return 0.3f; // snow semi-smooth
-            default: return 0.5f;
+    createAndFill(outRoughness, &BiomeMaterial::roughness);
+}
+
+SurfaceMaps TextureSynth::GenerateStaged(const BiomeInputs& inputs, GPUContext& gpu,
+                                         const BiomeClassifier& classifier, float transitionWidth) {
+    SurfaceMaps maps;
+    maps.biomes = PackedBiomeMap::Pack(Biomes::Classify(inputs, gpu, classifier));
+    const BiomeDistanceField edges = BiomeTransitionField(maps.biomes, transitionWidth);
+    const BiomeDistanceField* blend = edges.empty() ? nullptr : &edges;
+    maps.params = Biomes::GenerateParameters(maps.biomes, gpu, blend);
+    Generate(inputs.height, maps.biomes, gpu, maps.albedo, maps.normal, maps.roughness, blend);
+    return maps;
+}
+
+SurfaceMaps TextureSynth::GenerateFused(const BiomeInputs& inputs, GPUContext& gpu,
+                                        const BiomeClassifier& classifier, float transitionWidth) {
+    // On a device classification is its own pass, so the stages run apart
+    if (gpu.HasDevice()) return GenerateStaged(inputs, gpu, classifier, transitionWidth);
+    SurfaceMaps maps;
+    const uint32_t w = gpu.GetTexture(inputs.height).width;
+    const uint32_t h = gpu.GetTexture(inputs.height).height;
+    if (w == 0 || h == 0) return maps;
+    maps.biomes = PackedBiomeMap(w, h, classifier.MaxId());
+    // Every band shades params, albedo and roughness in full; the normal map stays flat, i.e.
+    // zeroed, and gets no mirror unless something reads it
+    maps.params = gpu.CreateTexture2D(w, h, kMaterialFormat, TextureInit::Uninitialized);
+    maps.albedo = gpu.CreateTexture2D(w, h, kMaterialFormat, TextureInit::Uninitialized);
+    maps.normal = gpu.CreateTexture2D(w, h, kNormalFormat);
+    maps.roughness = gpu.CreateTexture2D(w, h, kMaterialFormat, TextureInit::Uninitialized);
+    auto rows = [&](GPUTexture tex) { return tex ? gpu.GetTexture(tex).As<float>() : nullptr; };
+    const float* height = rows(inputs.height);
+    const float* gradX = rows(inputs.gradX);
+    const float* gradZ = rows(inputs.gradZ);
+    const float* humidity = rows(inputs.humidity);
+    const float* temperature = rows(inputs.temperature);
+    GPUContext::Texture& params = gpu.GetTexture(maps.params);
+    GPUContext::Texture& albedo = gpu.GetTexture(maps.albedo);
+    GPUContext::Texture& roughness = gpu.GetTexture(maps.roughness);
+
+    auto classifyBand = [&](uint32_t b0, uint32_t rows, uint8_t* band) {
+        for (uint32_t r = 0; r < rows; ++r) {
+            const size_t i = static_cast<size_t>(b0 + r) * w;
+            auto at = [&](const float* p) { return p ? p + i : nullptr; };
+            classifier.ClassifyRow(height + i, at(gradX), at(gradZ), at(humidity), at(temperature),
+                                   band + static_cast<size_t>(r) * w, w);
         }
+    };
+    // One output at a time: a single load and store stream each rather than nine interleaved
+    auto shadeBand = [&](uint32_t b0, uint32_t rows, const uint8_t* band, const BiomeDistanceField* edges) {
+        const size_t first = static_cast<size_t>(b0) * w;
+        const size_t count = static_cast<size_t>(rows) * w;
+        ShadeChannel(band, first, count, edges, &BiomeMaterial::param, params);
+        ShadeChannel(band, first, count, edges, &BiomeMaterial::albedo, albedo);
+        ShadeChannel(band, first, count, edges, &BiomeMaterial::roughness, roughness);
+    };
+    // Bands of rows per task, ids kept in a thread-local band buffer
+    constexpr uint32_t kBand = 32;
+    auto sweep = [&](const std::function<void(uint32_t, uint32_t, uint8_t*)>& fn) {
+        ThreadPool::Global().ParallelFor(0, h, kBand, [&](uint32_t y0, uint32_t y1) {
+            thread_local std::vector<uint8_t> band;
+            band.resize(static_cast<size_t>(kBand) * w);
+            for (uint32_t b0 = y0; b0 < y1; b0 += kBand) fn(b0, std::min(y1, b0 + kBand) - b0, band.data());
+        });
+    };
+    auto pack = [&](uint32_t b0, uint32_t rows, const uint8_t* band) {
+        for (uint32_t r = 0; r < rows; ++r) maps.biomes.PackRow(b0 + r, band + static_cast<size_t>(r) * w);
+    };
+
+    if (BiomeTransitionReach(w, transitionWidth) < 0.5f) {
+        // Hard steps: each band is classified, shaded and packed while its ids are in L1/L2,
+        // so every texture is touched exactly once
+        sweep([&](uint32_t b0, uint32_t rows, uint8_t* band) {
+            classifyBand(b0, rows, band);
+            shadeBand(b0, rows, band, nullptr);
+            pack(b0, rows, band);
+        });
+        maps.biomes.CompressRuns();
+        return maps;
+    }
+    // Blending needs edge distances from neighbouring bands: classify and pack, jump flood,
+    // then shade from the packed ids
+    sweep([&](uint32_t b0, uint32_t rows, uint8_t* band) {
+        classifyBand(b0, rows, band);
+        pack(b0, rows, band);
+    });
+    maps.biomes.CompressRuns();
+    const BiomeDistanceField edges = BiomeTransitionField(maps.biomes, transitionWidth);
+    sweep([&](uint32_t b0, uint32_t rows, uint8_t* band) {
+        maps.biomes.UnpackTile(0, b0, w, rows, band, w);
+        shadeBand(b0, rows, band, &edges);
     });
+    return maps;
 }
 
 } // namespace terraingen 
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace terraingen {
+
+static unsigned ResolveThreadCount(unsigned requested) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    (void)requested;
+    return 1; // no pthreads in the plain WASM build
+#else
+    if (requested == 0) requested = std::thread::hardware_concurrency();
+    return std::max(1u, requested);
+#endif
+}
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    unsigned workers = ResolveThreadCount(threadCount) - 1;
+    for (unsigned i = 0; i < workers; ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned i = 0; i < workers; ++i) {
+        workers_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void ThreadPool::Push(unsigned queue, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+        queues_[queue]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        pending_.fetch_add(1);
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::TryRunOne(unsigned preferredQueue) {
+    const unsigned n = static_cast<unsigned>(queues_.size());
+    for (unsigned k = 0; k < n; ++k) {
+        unsigned q = (preferredQueue + k) % n;
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+            auto& dq = queues_[q]->tasks;
+            if (dq.empty()) continue;
+            // Owner takes the most recent task (cache-warm), thieves the oldest
+            if (k == 0) {
+                task = std::move(dq.back());
+                dq.pop_back();
+            } else {
+                task = std::move(dq.front());
+                dq.pop_front();
+            }
+        }
+        pending_.fetch_sub(1);
+        task();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned index) {
+    while (true) {
+        if (TryRunOne(index)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this] { return stop_ || pending_.load() > 0; });
+        if (stop_) return;
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t begin, uint32_t end, uint32_t grain,
+                             const std::function<void(uint32_t, uint32_t)>& fn) {
+    if (begin >= end) return;
+    grain = std::max(1u, grain);
+    const uint32_t chunks = (end - begin + grain - 1) / grain;
+    if (workers_.empty() || chunks == 1) {
+        for (uint32_t first = begin; first < end; first += grain) {
+            fn(first, std::min(end, first + grain));
+        }
+        return;
+    }
+
+    std::atomic<uint32_t> remaining{chunks};
+    unsigned base = nextQueue_.fetch_add(1);
+    for (uint32_t c = 0; c < chunks; ++c) {
+        uint32_t first = begin + c * grain;
+        uint32_t last = std::min(end, first + grain);
+        Push((base + c) % queues_.size(), [&fn, &remaining, first, last] {
+            fn(first, last);
+            remaining.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    // Help until every chunk of this call has finished
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (!TryRunOne(base % queues_.size())) std::this_thread::yield();
+    }
+}
+
+static std::unique_ptr<ThreadPool>& GlobalSlot() {
+    static std::unique_ptr<ThreadPool> pool;
+    return pool;
+}
+
+static std::mutex s_globalMutex;
+
+ThreadPool& ThreadPool::Global() {
+    std::lock_guard<std::mutex> lock(s_globalMutex);
+    auto& pool = GlobalSlot();
+    if (!pool) pool = std::make_unique<ThreadPool>(0);
+    return *pool;
+}
+
+void ThreadPool::SetGlobalThreadCount(unsigned threadCount) {
+    std::lock_guard<std::mutex> lock(s_globalMutex);
+    auto& pool = GlobalSlot();
+    pool.reset();
+    pool = std::make_unique<ThreadPool>(threadCount);
+}
+
+} // namespace terraingen
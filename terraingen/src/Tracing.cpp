@@ -25,4 +25,9 @@ TraceScope::~TraceScope() {
     std::cout << "[TRACE] End   " << ev.name << " (" << us << " µs)" << std::endl;
 }
 
+void TraceValue(const char* key, int32_t value) {
+    const char* scope = s_stack.empty() ? "" : s_stack.back().name;
+    std::cout << "[TRACE]   " << scope << "." << key << " = " << value << std::endl;
+}
+
 } // namespace terraingen 
\ No newline at end of file
@@ -2,11 +2,15 @@
 #include "Random.hpp"
 #include "Heightmap.hpp"
 #include "Biomes.hpp"
+#include "Climate.hpp"
 #include "Features.hpp"
 #include "TextureSynth.hpp"
 #include "MeshTiler.hpp"
 #include "IO.hpp"
 #include "GPUContext.hpp"
+#include "PipelineRegistry.hpp"
+#include "Bench.hpp"
+#include "ThreadPool.hpp"
 #include <iostream>
 #include <vector>
 #include <cstdint>
@@ -17,32 +21,89 @@ using namespace terraingen;
 // -----------------------------------------------------------------------------
 // Extracted chunk-generation pipeline for CLI and WASM
 // -----------------------------------------------------------------------------
-int GenerateChunkCLI(int cx, int cz, const std::string& outDir) {
+int GenerateChunkCLI(const ChunkRequest& req, const std::string& outDir, bool fusedSurface = true,
+                     float biomeTransition = kDefaultBiomeTransition, GPUBackend backend = GPUBackend::CPU) {
     // Ensure output directory exists
     std::filesystem::create_directories(outDir);
-    ChunkID id{cx, cz};
-    GPUContext gpu;
+    const ChunkID id = req.id;
+    const int cx = id.x, cz = id.z;
+    GPUContext gpu(backend);
+    if (backend == GPUBackend::WebGPU && gpu.Backend() != GPUBackend::WebGPU) {
+        std::cerr << "No WebGPU device; running on the CPU" << std::endl;
+    }
 
     // Trace generation
     TraceScope trace("GenerateChunk");
+#if TERRAINGEN_WEBGPU
+    // Every pipeline is compiled up front, on the first chunk only
+    if (gpu.Backend() == GPUBackend::WebGPU) {
+        TraceScope warmUpTrace("PipelineWarmUp");
+        TraceValue("pipelinesBuilt", static_cast<int32_t>(PipelineRegistry::Global().WarmUp(gpu.Device())));
+    }
+#endif
 
     // 1. Heightmap
-    GPUTexture heightTex = Heightmap::Generate(id, gpu);
+    HeightmapOutputs heightOut;
+    GPUTexture heightTex = Heightmap::Generate(req, gpu, &heightOut);
+    if (heightOut.apron) {
+        // Cost of the halo relative to the chunk itself
+        const uint64_t interior = static_cast<uint64_t>(req.resolution) * req.resolution;
+        const uint64_t extended = heightOut.evaluatedTexels + heightOut.cachedTexels;
+        TraceValue("apronTexels", static_cast<int32_t>(heightOut.apron));
+        TraceValue("evaluatedTexels", static_cast<int32_t>(heightOut.evaluatedTexels));
+        TraceValue("cachedTexels", static_cast<int32_t>(heightOut.cachedTexels));
+        TraceValue("apronOverheadPct", static_cast<int32_t>((extended - interior) * 100 / interior));
+    }
 
-    // 2. Biomes
-    BiomeMap biomeMap = Biomes::Classify(heightTex, gpu);
-    GPUTexture paramTex = Biomes::GenerateParameters(biomeMap, gpu);
+    // 2. Climate
+    ClimateMaps climate;
+    {
+        TraceScope climateTrace("Climate");
+        climate = Climate::Generate(req, heightTex, heightOut, gpu);
+        TraceValue("humidityUs", static_cast<int32_t>(climate.humidityUs));
+        TraceValue("diffusionUs", static_cast<int32_t>(climate.diffusionUs));
+        TraceValue("temperatureUs", static_cast<int32_t>(climate.temperatureUs));
+        TraceValue("diffusionRadius", static_cast<int32_t>(climate.diffusionRadius));
+        TraceValue("seamless", climate.seamless ? 1 : 0);
+    }
+    // The extended heightmap only feeds the climate stage
+    gpu.Release(heightOut.extended);
+    heightOut.extended = 0;
 
-    // 3. Features
-    ChunkCtx ctx{id, &gpu, heightTex, paramTex, 0};
-    FeatureRegistry::ApplyAll(ctx);
+    // 3. Biomes and surface textures (albedo, normal, roughness)
+    BiomeInputs biomeIn;
+    biomeIn.height = heightTex;
+    biomeIn.gradX = heightOut.gradX;
+    biomeIn.gradZ = heightOut.gradZ;
+    biomeIn.humidity = climate.humidity;
+    biomeIn.temperature = climate.temperature;
+    // Classification, parameters and textures in fused sweeps unless staged; materials blend
+    // across biome edges over biomeTransition world units
+    const BiomeClassifier& classifier = DefaultBiomeClassifier();
+    SurfaceMaps surface = fusedSurface ? TextureSynth::GenerateFused(biomeIn, gpu, classifier, biomeTransition)
+                                       : TextureSynth::GenerateStaged(biomeIn, gpu, classifier, biomeTransition);
+    GPUTexture paramTex = surface.params;
+    gpu.Release(climate.humidity);
+    gpu.Release(climate.temperature);
+    // Albedo, normal and roughness are not written out
+    for (GPUTexture t : {surface.albedo, surface.normal, surface.roughness}) gpu.Release(t);
 
-    // 4. Textures
-    GPUTexture albedo, normal, roughness;
-    TextureSynth::Generate(heightTex, biomeMap, gpu, albedo, normal, roughness);
+    // 4. Features
+    ChunkCtx ctx{id, &gpu, heightTex, paramTex, 0, heightOut};
+    {
+        TraceScope featureTrace("Features");
+        std::vector<FeatureRun> runs;
+        FeatureRegistry::Global().ApplyAll(ctx, &runs);
+        for (const FeatureRun& run : runs) {
+            TraceScope runTrace(run.name);
+            TraceValue("wave", static_cast<int32_t>(run.wave));
+            TraceValue("applyUs", static_cast<int32_t>(run.applyUs));
+            TraceValue("tileUs", static_cast<int32_t>(run.tileUs));
+        }
+    }
 
     // 5. Mesh
-    MeshData mesh = MeshTiler::Generate(heightTex, ctx.sdfTexture, gpu);
+    MeshData mesh = MeshTiler::Generate(heightTex, ctx.sdfTexture, gpu, &ctx.heightOutputs);
 
     // 6. Serialize and write outputs
     auto vertBytes = std::vector<uint8_t>(
@@ -63,33 +124,35 @@ int GenerateChunkCLI(int cx, int cz, const std::string& outDir) {
     std::cout << "Chunk generation complete: " << vPath << " and " << iPath << std::endl;
     // 7. Save heightmap (float32)
     {
-        auto& hinfo = gpu.GetTexture(heightTex);
-        std::vector<uint8_t> heightBytes(
-            reinterpret_cast<uint8_t*>(hinfo.data.data()),
-            reinterpret_cast<uint8_t*>(hinfo.data.data()) + hinfo.data.size() * sizeof(float)
-        );
+        gpu.Readback(heightTex);
+        const auto& hinfo = gpu.GetTexture(heightTex);
+        const uint8_t* hdata = hinfo.As<uint8_t>();
+        std::vector<uint8_t> heightBytes(hdata, hdata + hinfo.ByteSize());
         std::string hPath = outDir + "/chunk_" + std::to_string(cx) + "_" + std::to_string(cz) + "_heightmap.raw";
         if (!SaveBinary(hPath, heightBytes)) {
             std::cerr << "Error writing heightmap " << hPath << std::endl;
             return 1;
         }
     }
-    // 8. Save biome parameters (uint8_t)
+    // 8. Save biome parameters (uint8_t, kMaterialFormat)
     {
-        auto& pinfo = gpu.GetTexture(paramTex);
-        const std::vector<uint8_t>& paramBytes = pinfo.dataU8;
+        gpu.Readback(paramTex);
+        const auto& pinfo = gpu.GetTexture(paramTex);
+        const uint8_t* pdata = pinfo.As<uint8_t>();
+        const std::vector<uint8_t> paramBytes(pdata, pdata + pinfo.ByteSize());
         std::string pPath = outDir + "/chunk_" + std::to_string(cx) + "_" + std::to_string(cz) + "_biomeparams.raw";
         if (!SaveBinary(pPath, paramBytes)) {
             std::cerr << "Error writing biome params " << pPath << std::endl;
             return 1;
         }
     }
-    // 9. Save SDF (float32) if generated
+    // 9. Save SDF (float32, whatever the texture format) if generated
     if (ctx.sdfTexture != 0) {
-        auto& sdfinfo = gpu.GetTexture(ctx.sdfTexture);
+        gpu.Readback(ctx.sdfTexture);
+        const std::vector<float> sdf = gpu.GetTexture(ctx.sdfTexture).ToFloats();
         std::vector<uint8_t> sdfBytes(
-            reinterpret_cast<uint8_t*>(sdfinfo.data.data()),
-            reinterpret_cast<uint8_t*>(sdfinfo.data.data()) + sdfinfo.data.size() * sizeof(float)
+            reinterpret_cast<const uint8_t*>(sdf.data()),
+            reinterpret_cast<const uint8_t*>(sdf.data()) + sdf.size() * sizeof(float)
         );
         std::string sPath = outDir + "/chunk_" + std::to_string(cx) + "_" + std::to_string(cz) + "_sdf.raw";
         if (!SaveBinary(sPath, sdfBytes)) {
@@ -97,26 +160,137 @@ int GenerateChunkCLI(int cx, int cz, const std::string& outDir) {
             return 1;
         }
     }
+    // 10. Save height bounds: tileSize, tilesX, tilesY (uint32), chunk min/max, then per-tile min/max
+    const MinMaxPyramid& bounds = ctx.heightOutputs.bounds;
+    if (!bounds.Empty()) {
+        const auto& tiles = bounds.levels[0];
+        const HeightBounds chunk = bounds.Chunk();
+        std::vector<uint8_t> boundsBytes;
+        auto append = [&](const void* p, size_t n) {
+            const uint8_t* b = static_cast<const uint8_t*>(p);
+            boundsBytes.insert(boundsBytes.end(), b, b + n);
+        };
+        const uint32_t header[3] = {bounds.tileSize, tiles.width, tiles.height};
+        append(header, sizeof(header));
+        append(&chunk, sizeof(chunk));
+        append(tiles.cells.data(), tiles.cells.size() * sizeof(HeightBounds));
+        std::string bPath = outDir + "/chunk_" + std::to_string(cx) + "_" + std::to_string(cz) + "_bounds.raw";
+        if (!SaveBinary(bPath, boundsBytes)) {
+            std::cerr << "Error writing bounds " << bPath << std::endl;
+            return 1;
+        }
+    }
     std::cout << "Heightmap, biome params, and SDF saved to " << outDir << std::endl;
+    // CPU mirror memory the chunk touched so far, against what it never needed
+    const GPUContext::Stats texStats = gpu.GetStats();
+    TraceValue("mirrorKiB", static_cast<int32_t>(texStats.mirrorBytes >> 10));
+    TraceValue("zeroedKiB", static_cast<int32_t>(texStats.zeroedBytes >> 10));
+    TraceValue("untouchedKiB", static_cast<int32_t>(texStats.untouchedBytes >> 10));
+    if (gpu.HasDevice()) {
+        // Compute passes of the chunk and the submits that carried them
+        const PassGraph::Stats passStats = gpu.Passes().GetStats();
+        TraceValue("gpuPasses", static_cast<int32_t>(passStats.passes));
+        TraceValue("gpuSubmits", static_cast<int32_t>(passStats.submits));
+    }
     return 0;
 }
 
 // -----------------------------------------------------------------------------
 // CLI entrypoint
 // -----------------------------------------------------------------------------
+static void PrintUsage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " <cx> <cz> [--outdir <dir>] [--threads <n>]"
+              << " [--resolution <64..1024> | --lod <n>] [--octaves <n>] [--normalize 0|1]"
+              << " [--droplets <per square world unit>] [--thermal <world units>]"
+              << " [--apron <texels, default: climate diffusion radius>] [--surface fused|staged] [--blend <world units, default 0: hard biome edges>]"
+              << " [--backend cpu|webgpu, default cpu]" << std::endl;
+    std::cerr << "       " << argv0 << " --bench [hash|rng|heightmap|noise|lod|biome|climate|biomemap|blend|surface|bounds|erosion|thermal|apron|region|textures|formats|compute|stress|passes|readback|backends|features|shaders|all] [--threads <n>]" << std::endl;
+    std::cerr << "       " << argv0 << " --verify-shaders" << std::endl;
+}
+
 int main(int argc, char** argv) {
+    if (argc >= 2 && std::string(argv[1]) == "--bench") {
+        if (argc >= 5 && std::string(argv[3]) == "--threads") {
+            ThreadPool::SetGlobalThreadCount(static_cast<unsigned>(std::stoul(argv[4])));
+        }
+        return RunBenchmarks(argc >= 3 ? argv[2] : "");
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--verify-shaders") {
+        return RunBenchmarks("shaders");
+    }
     if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <cx> <cz> [--outdir <dir>]" << std::endl;
+        PrintUsage(argv[0]);
         return 1;
     }
-    int cx = std::stoi(argv[1]);
-    int cz = std::stoi(argv[2]);
+    ChunkRequest req;
+    req.id = ChunkID{std::stoi(argv[1]), std::stoi(argv[2])};
     // Default output directory now points at the viewer's chunks folder
     std::string outDir = "../viewer/chunks";
-    if (argc >= 5 && std::string(argv[3]) == "--outdir") {
-        outDir = argv[4];
+    // 0 = one thread per hardware core; output does not depend on this
+    unsigned threads = 0;
+    bool fusedSurface = true;
+    float biomeTransition = kDefaultBiomeTransition;
+    bool apronSet = false;
+    GPUBackend backend = GPUBackend::CPU;
+    for (int i = 3; i < argc; i += 2) {
+        std::string opt = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << opt << " needs a value" << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        if (opt == "--outdir") {
+            outDir = argv[i + 1];
+        } else if (opt == "--threads") {
+            threads = static_cast<unsigned>(std::stoul(argv[i + 1]));
+        } else if (opt == "--resolution") {
+            req.resolution = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (opt == "--lod") {
+            req.resolution = ResolutionForLOD(static_cast<uint32_t>(std::stoul(argv[i + 1])));
+        } else if (opt == "--octaves") {
+            req.octaves = std::stoi(argv[i + 1]);
+        } else if (opt == "--normalize") {
+            req.normalize = std::stoi(argv[i + 1]) != 0;
+        } else if (opt == "--droplets") {
+            req.hydraulic.dropletDensity = std::stof(argv[i + 1]);
+        } else if (opt == "--apron") {
+            req.apron = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+            apronSet = true;
+        } else if (opt == "--surface") {
+            const std::string mode = argv[i + 1];
+            if (mode != "fused" && mode != "staged") {
+                std::cerr << "--surface takes fused or staged, not " << mode << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            fusedSurface = mode == "fused";
+        } else if (opt == "--backend") {
+            const std::string name = argv[i + 1];
+            if (name != "cpu" && name != "webgpu") {
+                std::cerr << "--backend takes cpu or webgpu, not " << name << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            backend = name == "webgpu" ? GPUBackend::WebGPU : GPUBackend::CPU;
+        } else if (opt == "--blend") {
+            biomeTransition = std::stof(argv[i + 1]);
+        } else if (opt == "--thermal") {
+            req.thermal.reach = std::stof(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+    ThreadPool::SetGlobalThreadCount(threads);
+    if (req.resolution < kMinChunkResolution || req.resolution > kMaxChunkResolution ||
+        (req.resolution & (req.resolution - 1)) != 0) {
+        std::cerr << "Resolution must be a power of two in [" << kMinChunkResolution << ", "
+                  << kMaxChunkResolution << "]" << std::endl;
+        return 1;
     }
-    return GenerateChunkCLI(cx, cz, outDir);
+    // By default the apron covers the humidity diffusion, so the climate is seamless
+    if (!apronSet) req.apron = Climate::DiffusionTexels(ClimateParams{}, req.resolution);
+    return GenerateChunkCLI(req, outDir, fusedSurface, biomeTransition, backend);
 }
 
 // -----------------------------------------------------------------------------
@@ -124,7 +298,10 @@ int main(int argc, char** argv) {
 // -----------------------------------------------------------------------------
 extern "C" {
     int GenerateChunk(int cx, int cz) {
-        return GenerateChunkCLI(cx, cz, "chunks");
+        ChunkRequest req;
+        req.id = ChunkID{cx, cz};
+        req.apron = Climate::DiffusionTexels(ClimateParams{}, req.resolution);
+        return GenerateChunkCLI(req, "chunks");
     }
 }
 // ----------------------------------------------------------------------------- 
\ No newline at end of file